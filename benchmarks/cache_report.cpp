@@ -0,0 +1,48 @@
+/**
+ * Simulated cache behaviour of a nearest-neighbour stencil
+ * on a 16^4 lattice in different layouts
+ * (see api_v2/cache_simulation.hpp):
+ * - lexicographic (Flatten);
+ * - hierarchical blocking in 4^4 blocks (QSub);
+ * - Hilbert order (SpaceFillingCurve).
+ * For each layout, the misses are split by the level of the tree
+ * where the stencil crosses a boundary.
+ */
+#include "api_v2/cache_simulation.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include <iostream>
+
+using namespace hypercubes::slow::internals;
+using hypercubes::slow::sfc::HILBERT;
+using transform_networks::TransformNetwork;
+using transform_requests::Build;
+using namespace trms;
+
+static const int L = 16;
+
+int main() {
+  TreeFactory f;
+  TransformNetwork n;
+  Build(f, n,
+        {Id({L, L, L, L}, {"X", "Y", "Z", "T"}, "root"),
+         Fork({Flatten("X", "T", "XYZT", "lex"),
+               TreeComposition({QSub("X", L / 4, "BX", 0, 0), //
+                                QSub("Y", L / 4, "BY", 0, 0), //
+                                QSub("Z", L / 4, "BZ", 0, 0), //
+                                QSub("T", L / 4, "BT", 0, 0), //
+                                Renumber(),
+                                LevelSwap({"BX", "BY", "BZ", "BT", //
+                                           "X", "Y", "Z", "T"})},
+                               "blocked"),
+               TreeComposition({Flatten("X", "T", "XYZT"), //
+                                SpaceFillingCurve("XYZT", HILBERT)},
+                               "hilbert")})});
+
+  cache_simulation::Options options;
+  for (auto layout : {"lex", "blocked", "hilbert"}) {
+    std::cout << "=== " << layout << std::endl;
+    cache_simulation::print(std::cout, cache_simulation::simulate(
+                                           n, "root", layout, options));
+  }
+  return 0;
+}
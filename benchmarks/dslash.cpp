@@ -0,0 +1,199 @@
+/**
+ * A Dslash-like hopping term on a 4D lattice of 3x3 complex matrices,
+ *   out(x) = sum_mu U_mu(x) in(x+mu) + U_mu(x-mu)^dagger in(x-mu),
+ * with all the fields stored in the same memory layout,
+ * built with PartitionTree/OffsetTree:
+ * - lexicographic, X running fastest, the matrix innermost;
+ * - HiRep-like: the even sites first, then the odd ones (EO);
+ * - Grid-like: 2x2 virtual nodes in X and Y (QOpen)
+ *   with their sites interleaved, as SIMD lanes;
+ * - blocked in 4^4 blocks (QOpen).
+ * The neighbour tables and the offsets of the matrix elements
+ * come from LookupTables.
+ * The argument is the number of threads the sites are split among,
+ * which run on the persistent workers of a TaskPool
+ * started before the timed loop.
+ * Per site, 17 matrices are counted as moved
+ * (8 U and 8 neighbours read, 1 written),
+ * so bytes_per_second is the conventional bandwidth of the kernel
+ * and items_per_second are sites per second.
+ */
+#include "api/lookup_tables.hpp"
+#include "api/memory_layout.hpp"
+#include "partitioners/partitioners.hpp"
+#include "utils/parallel.hpp"
+#include <benchmark/benchmark.h>
+#include <complex>
+#include <map>
+#include <thread>
+
+using namespace hypercubes::slow;
+namespace pm = hypercubes::slow::partitioner_makers;
+using Complex = std::complex<double>;
+
+enum { X, Y, Z, T, MATROW, MATCOL, EXTRA }; // EXTRA: sites in EO
+static const int L = 16;
+static const int N = 3;
+static const Sizes sizes({L, L, L, L, N, N});
+static const vector<int> nonspatial_dimensions{MATROW, MATCOL};
+static const int site_bytes = 17 * N * N * sizeof(Complex);
+
+struct Layout {
+  int nsites;
+  int noffsets;
+  // offsets of the N*N elements of each site, row-major,
+  // the sites being sorted by the offset of their first element
+  vector<int> elements;
+  // site numbers of the neighbours, 4 per site
+  vector<int> up, down;
+};
+
+static Layout make_layout(const PartList &partitioners,
+                          const vector<std::string> &permuted_level_names) {
+  PartitionTree pt(sizes, partitioners, nonspatial_dimensions);
+  auto skeleton_tree = pt.skeleton_tree();
+  if (not permuted_level_names.empty())
+    skeleton_tree = skeleton_tree.permute(permuted_level_names);
+  auto offset_tree = skeleton_tree.size_tree().offset_tree();
+  vector<BoundaryCondition> bcs(sizes.size(), BoundaryCondition::PERIODIC);
+  LookupTables tables(pt, offset_tree, bcs, {X, Y, Z, T});
+
+  Layout res;
+  res.noffsets = tables.noffsets();
+  // the first element of each site, in memory order
+  vector<int> firsts;
+  for (int offset = 0; offset < tables.noffsets(); ++offset) {
+    int64_t lex = tables.offset_to_lex()[offset];
+    if (lex == -1 or tables.coord_to_offset()[lex] != offset)
+      continue;
+    Coordinates xs = tables.lex_coordinates(lex);
+    if (xs[MATROW] == 0 and xs[MATCOL] == 0)
+      firsts.push_back(offset);
+  }
+  res.nsites = firsts.size();
+  vector<int> site_of_offset(tables.noffsets(), -1);
+  for (int s = 0; s < res.nsites; ++s) {
+    site_of_offset[firsts[s]] = s;
+    int64_t lex = tables.offset_to_lex()[firsts[s]];
+    Coordinates xs = tables.lex_coordinates(lex);
+    for (int r = 0; r < N; ++r)
+      for (int c = 0; c < N; ++c) {
+        xs[MATROW] = r;
+        xs[MATCOL] = c;
+        lex = tables.lex_index(xs);
+        res.elements.push_back(tables.coord_to_offset()[lex]);
+      }
+  }
+  for (int s = 0; s < res.nsites; ++s)
+    for (int mu = 0; mu < 4; ++mu) {
+      res.up.push_back(site_of_offset[tables.up(mu)[firsts[s]]]);
+      res.down.push_back(site_of_offset[tables.down(mu)[firsts[s]]]);
+    }
+  return res;
+}
+
+static std::map<std::string, Layout> &layouts() {
+  static std::map<std::string, Layout> res{
+      {"lex",
+       make_layout({pm::Plain("T", T), pm::Plain("Z", Z), pm::Plain("Y", Y),
+                    pm::Plain("X", X), pm::Plain("Local-matrow", MATROW),
+                    pm::Plain("Local-matcol", MATCOL), pm::Site()},
+                   {})},
+      {"hirep",
+       make_layout({pm::EO("EO", {true, true, true, true, false, false}),
+                    pm::Plain("Extra", EXTRA),
+                    pm::Plain("Local-matrow", MATROW),
+                    pm::Plain("Local-matcol", MATCOL), pm::Site()},
+                   {})},
+      {"grid",
+       make_layout({pm::QOpen("Vector X", X, 2), pm::QOpen("Vector Y", Y, 2),
+                    pm::EO("EO", {true, true, true, true, false, false}),
+                    pm::Plain("Extra", EXTRA),
+                    pm::Plain("Local-matrow", MATROW),
+                    pm::Plain("Local-matcol", MATCOL), pm::Site()},
+                   {"EO", "Extra", "Local-matrow", "Local-matcol", //
+                    "Vector X", "Vector Y", "Site"})},
+      {"blocked",
+       make_layout({pm::QOpen("Block T", T, L / 4),
+                    pm::QOpen("Block Z", Z, L / 4),
+                    pm::QOpen("Block Y", Y, L / 4),
+                    pm::QOpen("Block X", X, L / 4), pm::Plain("T", T),
+                    pm::Plain("Z", Z), pm::Plain("Y", Y), pm::Plain("X", X),
+                    pm::Plain("Local-matrow", MATROW),
+                    pm::Plain("Local-matcol", MATCOL), pm::Site()},
+                   {})}};
+  return res;
+}
+
+static void hopping(const Layout &l,          //
+                    const vector<Complex> *U, // 4 fields
+                    const Complex *in,        //
+                    Complex *out,             //
+                    int begin, int end) {
+  for (int s = begin; s < end; ++s) {
+    Complex acc[N * N] = {};
+    const int *e = l.elements.data() + N * N * s;
+    for (int mu = 0; mu < 4; ++mu) {
+      const Complex *u = U[mu].data();
+      const int *eup = l.elements.data() + N * N * l.up[4 * s + mu];
+      const int *edn = l.elements.data() + N * N * l.down[4 * s + mu];
+      for (int r = 0; r < N; ++r)
+        for (int c = 0; c < N; ++c)
+          for (int k = 0; k < N; ++k)
+            acc[N * r + c] +=
+                u[e[N * r + k]] * in[eup[N * k + c]] +
+                std::conj(u[edn[N * k + r]]) * in[edn[N * k + c]];
+    }
+    for (int i = 0; i < N * N; ++i)
+      out[e[i]] = acc[i];
+  }
+}
+
+static void BM_dslash(benchmark::State &state, const char *name) {
+  const Layout &l = layouts().at(name);
+  const int nthreads = state.range(0);
+  vector<Complex> U[4];
+  for (auto &u : U)
+    u.assign(l.noffsets, Complex(0.5, 0.1));
+  vector<Complex> in(l.noffsets, Complex(1, 0)), out(l.noffsets);
+  auto sweep = [&](int t) {
+    hopping(l, U, in.data(), out.data(),  //
+            (long)l.nsites * t / nthreads, //
+            (long)l.nsites * (t + 1) / nthreads);
+    return 0;
+  };
+  // The workers are started by the first map and then reused,
+  // so the timed iterations only hand them the chunks of sites.
+  TaskPool pool(nthreads);
+  pool.map(nthreads, sweep);
+  for (auto _ : state) {
+    pool.map(nthreads, sweep);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * l.nsites);
+  state.SetBytesProcessed(state.iterations() * l.nsites * site_bytes);
+}
+static const int max_threads =
+    std::max(1u, std::thread::hardware_concurrency());
+BENCHMARK_CAPTURE(BM_dslash, lex, "lex")
+    ->Arg(1)
+    ->Arg(max_threads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_dslash, hirep, "hirep")
+    ->Arg(1)
+    ->Arg(max_threads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_dslash, grid, "grid")
+    ->Arg(1)
+    ->Arg(max_threads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_dslash, blocked, "blocked")
+    ->Arg(1)
+    ->Arg(max_threads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
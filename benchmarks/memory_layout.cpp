@@ -0,0 +1,102 @@
+/**
+ * Comparison of the slow and fast implementations
+ * of the memory layout classes,
+ * on the GridLikeBase configuration (see grid_like.cpp):
+ * construction of the skeleton, size and offset trees
+ * for a single MPI rank, and offset/indices lookups.
+ */
+#include "api/memory_layout.hpp"
+#include "fast/memory_layout.hpp"
+#include "trees/kvtree.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace hypercubes::slow;
+namespace fast = hypercubes::fast;
+namespace pm = hypercubes::slow::partitioner_makers;
+
+enum { X, Y, Z, T, MATROW, MATCOL, EXTRA };
+static const vector<int> nonspatial_dimensions{MATROW, MATCOL};
+static const Sizes sizes({48, 48, 42, 42, 3, 3});
+static const PartList grid_partitioners({
+    pm::QPeriodic("MPI X", X, 4),                         //  0
+    pm::QPeriodic("MPI Y", Y, 4),                         //  1
+    pm::QPeriodic("MPI Z", Z, 4),                         //  2
+    pm::QPeriodic("MPI T", T, 4),                         //  3
+    pm::QOpen("Vector X", X, 2),                          //  4
+    pm::QOpen("Vector Y", Y, 2),                          //  5
+    pm::HBB("Halo X", X, 1),                              //  6
+    pm::HBB("Halo Y", Y, 1),                              //  7
+    pm::HBB("Halo Z", Z, 1),                              //  8
+    pm::HBB("Halo T", T, 1),                              //  9
+    pm::EO("EO", {true, true, true, true, false, false}), // 10
+    pm::Plain("Local-matrow", MATROW),                    // 11
+    pm::Plain("Local-matcol", MATCOL),                    // 12
+    pm::Plain("Extra", EXTRA),                            // 13
+    pm::Site()                                            // 14
+});
+
+template <class PartitionTree> auto offset_tree(const PartitionTree &pt) {
+  auto predicate = getp(selectors::mpi_rank, grid_partitioners, {2, 3, 1, 1});
+  return pt.skeleton_tree().prune(predicate).size_tree().offset_tree();
+}
+
+/* The indices and offsets of (at most) 4096 sites, evenly spaced. */
+static vector<std::pair<Indices, int>> sample_leaves() {
+  PartitionTree pt(sizes, grid_partitioners, nonspatial_dimensions);
+  auto leaves = internals::get_leaves_kv(offset_tree(pt).get_internal());
+  vector<std::pair<Indices, int>> res;
+  int stride = (leaves.size() + 4095) / 4096;
+  for (int i = 0; i < leaves.size(); i += stride)
+    res.push_back(leaves[i]);
+  return res;
+}
+
+template <class PartitionTree>
+static void BM_skeleton_tree(benchmark::State &state) {
+  PartitionTree pt(sizes, grid_partitioners, nonspatial_dimensions);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(pt.skeleton_tree());
+}
+BENCHMARK_TEMPLATE(BM_skeleton_tree, PartitionTree)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_skeleton_tree, fast::PartitionTree)
+    ->Unit(benchmark::kMillisecond);
+
+template <class PartitionTree>
+static void BM_offset_tree(benchmark::State &state) {
+  PartitionTree pt(sizes, grid_partitioners, nonspatial_dimensions);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(offset_tree(pt));
+}
+BENCHMARK_TEMPLATE(BM_offset_tree, PartitionTree)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_offset_tree, fast::PartitionTree)
+    ->Unit(benchmark::kMillisecond);
+
+template <class PartitionTree>
+static void BM_get_offset(benchmark::State &state) {
+  PartitionTree pt(sizes, grid_partitioners, nonspatial_dimensions);
+  auto ot = offset_tree(pt);
+  auto leaves = sample_leaves();
+  for (auto _ : state)
+    for (const auto &leaf : leaves)
+      benchmark::DoNotOptimize(ot.get_offset(leaf.first));
+  state.SetItemsProcessed(state.iterations() * leaves.size());
+}
+BENCHMARK_TEMPLATE(BM_get_offset, PartitionTree);
+BENCHMARK_TEMPLATE(BM_get_offset, fast::PartitionTree);
+
+template <class PartitionTree>
+static void BM_get_indices(benchmark::State &state) {
+  PartitionTree pt(sizes, grid_partitioners, nonspatial_dimensions);
+  auto ot = offset_tree(pt);
+  auto leaves = sample_leaves();
+  for (auto _ : state)
+    for (const auto &leaf : leaves)
+      benchmark::DoNotOptimize(ot.get_indices(leaf.second));
+  state.SetItemsProcessed(state.iterations() * leaves.size());
+}
+BENCHMARK_TEMPLATE(BM_get_indices, PartitionTree);
+BENCHMARK_TEMPLATE(BM_get_indices, fast::PartitionTree);
+
+BENCHMARK_MAIN();
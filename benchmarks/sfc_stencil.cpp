@@ -0,0 +1,104 @@
+/**
+ * Cache behaviour of a nearest-neighbour stencil on a 4D lattice
+ * stored with different layouts:
+ * - lexicographic (Flatten);
+ * - hierarchical blocking in 4^4 blocks (QSub);
+ * - Morton and Hilbert order (SpaceFillingCurve).
+ * The stencil visits the sites in memory order
+ * and reads the 8 neighbours of each site.
+ * Next to the measured time, the number of cache lines
+ * missed per site in a simulated hierarchy of a 32KiB 8-way
+ * and a 1MiB 16-way LRU cache is reported
+ * (see api_v2/cache_simulation.hpp).
+ */
+#include "api_v2/cache_simulation.hpp"
+#include "api_v2/layout_tuner.hpp"
+#include "api_v2/site_offsets.hpp"
+#include "api_v2/transform_network.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include <benchmark/benchmark.h>
+#include <map>
+
+using namespace hypercubes::slow::internals;
+using hypercubes::slow::sfc::HILBERT;
+using hypercubes::slow::sfc::MORTON;
+using transform_networks::TransformNetwork;
+using transform_requests::Build;
+using namespace trms;
+
+static const int L = 16;
+static const int V = L * L * L * L;
+static const int site_doubles = 24; // a Wilson spinor, double precision
+
+struct Layout {
+  vector<int> neighbours; // 8 per site, by memory offset
+  // per cache, from a simulated sweep
+  std::map<std::string, double> misses_per_site;
+};
+
+struct Layouts {
+  TreeFactory f;
+  TransformNetwork n;
+  std::map<std::string, Layout> layouts;
+
+  Layouts() {
+    Build(f, n,
+          {Id({L, L, L, L}, {"X", "Y", "Z", "T"}, "root"),
+           Fork({Flatten("X", "T", "XYZT", "lex"),
+                 TreeComposition({QSub("X", L / 4, "BX", 0, 0), //
+                                  QSub("Y", L / 4, "BY", 0, 0), //
+                                  QSub("Z", L / 4, "BZ", 0, 0), //
+                                  QSub("T", L / 4, "BT", 0, 0), //
+                                  Renumber(),
+                                  LevelSwap({"BX", "BY", "BZ", "BT", //
+                                             "X", "Y", "Z", "T"}),
+                                  Flatten("X", "T", "XYZT")},
+                                 "blocked"),
+                 TreeComposition({Flatten("X", "T", "XYZT"), //
+                                  SpaceFillingCurve("XYZT", MORTON)},
+                                 "morton"),
+                 TreeComposition({Flatten("X", "T", "XYZT"), //
+                                  SpaceFillingCurve("XYZT", HILBERT)},
+                                 "hilbert")})});
+    for (auto name : {"lex", "blocked", "morton", "hilbert"})
+      layouts[name] = make_layout(name);
+  }
+
+  Layout make_layout(const std::string &node) {
+    Layout res{site_offsets::neighbour_table(
+        site_offsets::make_site_offsets(n, "root", node))};
+    cache_simulation::Options options;
+    options.caches = {{"32KiB", 32 << 10, 8}, {"1MiB", 1 << 20, 16}};
+    options.site_bytes = site_doubles * sizeof(double);
+    auto report = cache_simulation::simulate(n, "root", node, options);
+    for (int c = 0; c < report.cache_names.size(); ++c)
+      res.misses_per_site[report.cache_names[c]] =
+          (double)report.misses[c] / report.nsites;
+    return res;
+  }
+};
+static Layouts &layouts() {
+  static Layouts l;
+  return l;
+}
+
+static void BM_stencil(benchmark::State &state, const char *name) {
+  const Layout &layout = layouts().layouts[name];
+  vector<double> in(V * site_doubles, 1.0), out(V * site_doubles);
+  for (auto _ : state) {
+    layout_tuning::stencil_sweep(layout.neighbours, 8, site_doubles,
+                                 in.data(), out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * V);
+  for (const auto &m : layout.misses_per_site)
+    state.counters["misses/site " + m.first] = m.second;
+}
+BENCHMARK_CAPTURE(BM_stencil, lex, "lex")->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_stencil, blocked, "blocked")
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_stencil, morton, "morton")->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_stencil, hilbert, "hilbert")
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
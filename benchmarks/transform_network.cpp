@@ -0,0 +1,105 @@
+/**
+ * Comparison of the index transformations returned by
+ * TransformNetwork::get_transform (a Composition,
+ * that goes through every step for every index)
+ * and TransformNetwork::get_fused_transform
+ * (a FusedComposition, evaluated once on all the leaves),
+ * on a 4D lattice with domain decomposition, halos and even/odd.
+ */
+#include "api_v2/transform_network.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace hypercubes::slow::internals;
+using hypercubes::slow::BoundaryCondition;
+using transform_networks::TransformNetwork;
+using transform_requests::Build;
+using namespace trms;
+
+static const int L = 16;
+
+struct Network {
+  TreeFactory f;
+  TransformNetwork n;
+  vector<int> sites; // all the coordinates, one after the other
+  Network() {
+    Build(f, n,
+          {Id({L, L, L, L}, {"X", "Y", "Z", "T"}, "root"),
+           TreeComposition(
+               {QFull("X", 2, "MPI X", 1, BoundaryCondition::OPEN), //
+                QFull("Y", 2, "MPI Y", 1, BoundaryCondition::OPEN), //
+                QFull("Z", 2, "MPI Z", 1, BoundaryCondition::OPEN), //
+                QFull("T", 2, "MPI T", 1, BoundaryCondition::OPEN), //
+                Renumber(),
+                LevelSwap({"MPI X", "MPI Y", "MPI Z", "MPI T", //
+                           "X", "Y", "Z", "T"}),
+                HBB("X", 1, "BB X"), //
+                HBB("Y", 1, "BB Y"), //
+                HBB("Z", 1, "BB Z"), //
+                HBB("T", 1, "BB T"), //
+                Renumber(),
+                LevelSwap({"BB X", "X", "BB Y", "Y", //
+                           "BB Z", "Z", "BB T", "T"},
+                          {"BB X", "BB Y", "BB Z", "BB T", //
+                           "X", "Y", "Z", "T"}),
+                Flatten("X", "T", "XYZT"), //
+                EONaive("XYZT", "EO")},
+               "layout")});
+    for (int x = 0; x < L; ++x)
+      for (int y = 0; y < L; ++y)
+        for (int z = 0; z < L; ++z)
+          for (int t = 0; t < L; ++t)
+            sites.insert(sites.end(), {x, y, z, t});
+  }
+};
+static Network &network() {
+  static Network n;
+  return n;
+}
+
+template <class Transform>
+static void apply_all(benchmark::State &state, const Transform &t) {
+  const auto &sites = network().sites;
+  for (auto _ : state)
+    for (int i = 0; i < sites.size(); i += 4)
+      benchmark::DoNotOptimize(
+          t->apply({sites[i], sites[i + 1], sites[i + 2], sites[i + 3]}));
+  state.SetItemsProcessed(state.iterations() * sites.size() / 4);
+}
+
+static void BM_composition_apply(benchmark::State &state) {
+  apply_all(state, network().n.get_transform("root", "layout"));
+}
+BENCHMARK(BM_composition_apply)->Unit(benchmark::kMillisecond);
+
+static void BM_fused_apply(benchmark::State &state) {
+  apply_all(state, network().n.get_fused_transform("root", "layout"));
+}
+BENCHMARK(BM_fused_apply)->Unit(benchmark::kMillisecond);
+
+static void BM_fused_apply_batch(benchmark::State &state) {
+  auto t = network().n.get_fused_transform("root", "layout");
+  const auto &sites = network().sites;
+  IndexList out;
+  vector<int> first_result;
+  for (auto _ : state) {
+    out.clear();
+    first_result.clear();
+    t->apply(sites.data(), sites.size() / 4, 4, out, first_result);
+    benchmark::DoNotOptimize(out.data.data());
+  }
+  state.SetItemsProcessed(state.iterations() * sites.size() / 4);
+}
+BENCHMARK(BM_fused_apply_batch)->Unit(benchmark::kMillisecond);
+
+// The cost of building the tables.
+static void BM_fusion(benchmark::State &state) {
+  auto &n = network().n;
+  auto t = n.get_transform("root", "layout");
+  for (auto _ : state)
+    benchmark::DoNotOptimize(transformers::FusedComposition(
+        n["root"]->output_tree, n["layout"]->output_tree, t));
+}
+BENCHMARK(BM_fusion)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
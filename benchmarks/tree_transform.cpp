@@ -0,0 +1,337 @@
+/**
+ * Micro-benchmarks for the TreeFactory transformations
+ * and for index_pullback/index_pushforward.
+ * Each iteration uses a new TreeFactory,
+ * so that the caches are cold
+ * (the input trees are built once, with another factory).
+ * Besides time, each benchmark reports
+ * the number of allocations per iteration
+ * and the peak RSS of the process.
+ *
+ * For machine readable output:
+ *   tree_transform_benchmark --benchmark_out=results.json \
+ *                            --benchmark_out_format=json
+ */
+#include "api_v2/compiled_tree.hpp"
+#include "api_v2/tree_transform.hpp"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+
+using namespace hypercubes::slow::internals;
+using hypercubes::slow::BoolM;
+using hypercubes::slow::BoundaryCondition;
+
+/***********************
+ * Allocation counting *
+ ***********************/
+static std::atomic<long> nallocations{0};
+
+void *operator new(std::size_t size) {
+  nallocations++;
+  if (void *p = std::malloc(size == 0 ? 1 : size))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+/* Runs the benchmark loop
+ * and adds the allocation and memory counters. */
+template <class F> void run(benchmark::State &state, F f) {
+  long allocations_start = nallocations.load();
+  for (auto _ : state)
+    f();
+  state.counters["allocations"] =
+      benchmark::Counter(nallocations.load() - allocations_start,
+                         benchmark::Counter::kAvgIterations);
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  state.counters["peak_rss_kB"] = usage.ru_maxrss;
+}
+
+/*****************
+ * Input trees *
+ *****************/
+// Arguments: {lattice side, number of dimensions}
+static std::vector<int> lattice(const benchmark::State &state) {
+  return std::vector<int>(state.range(1), state.range(0));
+}
+
+static void lattice_args(benchmark::internal::Benchmark *b) {
+  b->ArgsProduct({{8, 12, 16}, {2, 3, 4}})->ArgNames({"L", "D"});
+}
+
+static KVTreePv2<NodeType> nd_tree(const benchmark::State &state) {
+  TreeFactory f;
+  return f.generate_nd_tree(lattice(state));
+}
+
+// The first dimension split in 2 parts, with a halo of 1.
+static KVTreePv2<NodeType> qh_tree(const benchmark::State &state) {
+  TreeFactory f;
+  return f.qh(f.generate_nd_tree(lattice(state)), 0, 2, 1, 0,
+              BoundaryCondition::PERIODIC);
+}
+
+/* A lattice split in 2 parts in each dimension,
+ * with the local dimensions flattened and split in even and odd
+ * (levels: parts..., eo, flattened local index).
+ * Also returns the trees of all the steps,
+ * which are needed to compute the coordinates for eo_fix. */
+static std::pair<KVTreePv2<NodeType>, std::vector<KVTreePv2<NodeType>>>
+eo_naive_tree(const benchmark::State &state) {
+  TreeFactory f;
+  auto sizes = lattice(state);
+  int D = sizes.size();
+  std::vector<KVTreePv2<NodeType>> steps{f.generate_nd_tree(sizes)};
+  for (int d = 0; d < D; ++d)
+    steps.push_back(f.qh(steps.back(), 2 * d, 2, 0, 0, //
+                         BoundaryCondition::PERIODIC));
+  // from [p0,x0,p1,x1,...] to [p0,p1,...,x0,x1,...]
+  std::vector<int> ordering;
+  for (int d = 0; d < D; ++d)
+    ordering.push_back(2 * d);
+  for (int d = 0; d < D; ++d)
+    ordering.push_back(2 * d + 1);
+  steps.push_back(f.swap_levels(f.renumber_children(steps.back()), ordering));
+  steps.push_back(f.flatten(steps.back(), D, 2 * D));
+  steps.push_back(f.eo_naive(steps.back(), D));
+  return {steps.back(), steps};
+}
+
+/* All the indices of the leaves of a tree. */
+static void _leaf_indices(const KVTreePv2<NodeType> &t, //
+                          std::vector<int> &idx,        //
+                          std::vector<std::vector<int>> &res) {
+  if (t->children.size() == 0) {
+    res.push_back(idx);
+    return;
+  }
+  for (int i = 0; i < t->children.size(); ++i) {
+    idx.push_back(i);
+    _leaf_indices(t->children[i].second, idx, res);
+    idx.pop_back();
+  }
+}
+/* The indices of (at most) 1024 leaves, evenly spaced. */
+static std::vector<std::vector<int>>
+leaf_indices(const KVTreePv2<NodeType> &t) {
+  std::vector<std::vector<int>> all, res;
+  std::vector<int> idx;
+  _leaf_indices(t, idx, all);
+  int stride = (all.size() + 1023) / 1024;
+  for (int i = 0; i < all.size(); i += stride)
+    res.push_back(all[i]);
+  return res;
+}
+
+/*******************
+ * TreeFactory ops *
+ *******************/
+static void BM_generate_nd_tree(benchmark::State &state) {
+  auto sizes = lattice(state);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.generate_nd_tree(sizes));
+  });
+}
+BENCHMARK(BM_generate_nd_tree)->Apply(lattice_args);
+
+static void BM_qh(benchmark::State &state) {
+  auto t = nd_tree(state);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.qh(t, 0, 2, 1, 0, BoundaryCondition::PERIODIC));
+  });
+}
+BENCHMARK(BM_qh)->Apply(lattice_args);
+
+static void BM_bb(benchmark::State &state) {
+  auto t = nd_tree(state);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.bb(t, 0, 1));
+  });
+}
+BENCHMARK(BM_bb)->Apply(lattice_args);
+
+static void BM_hbb(benchmark::State &state) {
+  auto t = qh_tree(state);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.hbb(t, 1, 1));
+  });
+}
+BENCHMARK(BM_hbb)->Apply(lattice_args);
+
+static void BM_flatten(benchmark::State &state) {
+  auto t = nd_tree(state);
+  int D = state.range(1);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.flatten(t, 0, D));
+  });
+}
+BENCHMARK(BM_flatten)->Apply(lattice_args);
+
+static void BM_collect_leaves(benchmark::State &state) {
+  auto t = qh_tree(state);
+  int pad_to = 1;
+  for (int i = 1; i < state.range(1); ++i)
+    pad_to *= state.range(0);
+  pad_to += 8;
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.collect_leaves(t, 2, pad_to));
+  });
+}
+BENCHMARK(BM_collect_leaves)->Apply(lattice_args);
+
+static void BM_eo_naive(benchmark::State &state) {
+  TreeFactory f0;
+  auto t = f0.flatten(nd_tree(state), 0, state.range(1));
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.eo_naive(t, 0));
+  });
+}
+BENCHMARK(BM_eo_naive)->Apply(lattice_args);
+
+static void BM_eo_fix(benchmark::State &state) {
+  auto trees = eo_naive_tree(state);
+  const auto &steps = trees.second;
+  int D = state.range(1);
+  auto transform = [&steps](std::vector<int> idx) {
+    for (int i = steps.size() - 1; i > 0; --i)
+      idx = index_pullback(steps[i], idx);
+    return std::vector<std::vector<int>>{idx};
+  };
+  std::vector<int> levels_reference;
+  for (int d = 0; d < D; ++d)
+    levels_reference.push_back(d);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(
+        f.eo_fix(trees.first, D, transform, levels_reference));
+  });
+}
+BENCHMARK(BM_eo_fix)->Apply(lattice_args);
+
+static void BM_swap_levels(benchmark::State &state) {
+  auto t = nd_tree(state);
+  std::vector<int> reversed;
+  for (int d = state.range(1) - 1; d >= 0; --d)
+    reversed.push_back(d);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.swap_levels(t, reversed));
+  });
+}
+BENCHMARK(BM_swap_levels)->Apply(lattice_args);
+
+static void BM_select_subtree(benchmark::State &state) {
+  auto t = qh_tree(state);
+  // Only the first partition, without the halos
+  TreeFactory::Predicate p = [](const std::vector<int> &idx) {
+    if (idx.size() == 0)
+      return BoolM::M;
+    if (idx[0] != 0)
+      return BoolM::F;
+    if (idx.size() == 1)
+      return BoolM::M;
+    return idx[1] == 0 ? BoolM::F : BoolM::T;
+  };
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.select_subtree(t, p));
+  });
+}
+BENCHMARK(BM_select_subtree)->Apply(lattice_args);
+
+static void BM_tree_product(benchmark::State &state) {
+  TreeFactory f0;
+  std::vector<KVTreePv2<NodeType>> trees;
+  for (int d = 0; d < state.range(1); ++d)
+    trees.push_back(f0.generate_flat_level(state.range(0)));
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.tree_product(trees));
+  });
+}
+BENCHMARK(BM_tree_product)->Apply(lattice_args);
+
+static void BM_tree_sum(benchmark::State &state) {
+  auto t = nd_tree(state);
+  std::vector<KVTreePv2<NodeType>> trees(state.range(0), t);
+  run(state, [&]() {
+    TreeFactory f;
+    benchmark::DoNotOptimize(f.tree_sum(trees));
+  });
+}
+BENCHMARK(BM_tree_sum)->Apply(lattice_args);
+
+/**********************************
+ * Index transformation throughput *
+ **********************************/
+static void BM_index_pullback(benchmark::State &state) {
+  auto t = eo_naive_tree(state).first;
+  auto idxs = leaf_indices(t);
+  run(state, [&]() {
+    for (const auto &idx : idxs)
+      benchmark::DoNotOptimize(index_pullback(t, idx));
+  });
+  state.SetItemsProcessed(state.iterations() * idxs.size());
+}
+BENCHMARK(BM_index_pullback)->Apply(lattice_args);
+
+static void BM_index_pushforward(benchmark::State &state) {
+  auto t = eo_naive_tree(state).first;
+  std::vector<std::vector<int>> in;
+  for (const auto &idx : leaf_indices(t))
+    in.push_back(index_pullback(t, idx));
+  run(state, [&]() {
+    for (const auto &idx : in)
+      benchmark::DoNotOptimize(index_pushforward(t, idx));
+  });
+  state.SetItemsProcessed(state.iterations() * in.size());
+}
+BENCHMARK(BM_index_pushforward)->Apply(lattice_args);
+
+static void BM_compiled_index_pullback(benchmark::State &state) {
+  auto t = eo_naive_tree(state).first;
+  auto ct = compile(t);
+  auto idxs = leaf_indices(t);
+  std::vector<int> out;
+  run(state, [&]() {
+    for (const auto &idx : idxs) {
+      out.clear();
+      index_pullback(ct, idx.data(), idx.size(), out);
+      benchmark::DoNotOptimize(out.data());
+    }
+  });
+  state.SetItemsProcessed(state.iterations() * idxs.size());
+}
+BENCHMARK(BM_compiled_index_pullback)->Apply(lattice_args);
+
+static void BM_compiled_index_pushforward(benchmark::State &state) {
+  auto t = eo_naive_tree(state).first;
+  auto ct = compile(t);
+  std::vector<std::vector<int>> in;
+  for (const auto &idx : leaf_indices(t))
+    in.push_back(index_pullback(t, idx));
+  IndexList out;
+  run(state, [&]() {
+    for (const auto &idx : in) {
+      out.clear();
+      index_pushforward(ct, idx.data(), idx.size(), out);
+      benchmark::DoNotOptimize(out.data.data());
+    }
+  });
+  state.SetItemsProcessed(state.iterations() * in.size());
+}
+BENCHMARK(BM_compiled_index_pushforward)->Apply(lattice_args);
+
+BENCHMARK_MAIN();
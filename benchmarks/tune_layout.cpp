@@ -0,0 +1,42 @@
+/**
+ * Chooses the layout of a lattice for a nearest-neighbour stencil
+ * on this machine (see api_v2/layout_tuner.hpp).
+ * Usage: tune_layout [-c cache_directory] L0 L1 ...
+ * With a cache directory, the result of a previous run
+ * with the same lattice size on the same machine is reused.
+ */
+#include "api_v2/layout_tuner.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace hypercubes::slow::internals;
+using namespace layout_tuning;
+
+int main(int argc, char **argv) {
+  std::string cache_directory;
+  vector<int> sizes;
+  for (int i = 1; i < argc; ++i)
+    if (std::strcmp(argv[i], "-c") == 0 and i + 1 < argc)
+      cache_directory = argv[++i];
+    else
+      sizes.push_back(std::atoi(argv[i]));
+  if (sizes.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [-c cache_directory] L0 L1 ..."
+              << std::endl;
+    return 1;
+  }
+
+  TreeFactory f;
+  TunerOptions options;
+  TuningResult result;
+  if (cache_directory.empty())
+    result = tune(f, sizes, options);
+  else {
+    TuningCache cache(cache_directory);
+    if (cache.tune(f, sizes, options, result) == TuningCache::HIT)
+      std::cout << "From " << cache.filename(sizes, options) << std::endl;
+  }
+  print(std::cout, result);
+  return 0;
+}
@@ -0,0 +1,205 @@
+#ifndef FIELD_H_
+#define FIELD_H_
+#include "api/memory_layout.hpp"
+#include "api_v2/transform_network.hpp"
+#include "trees/flat_offset_tree.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace hypercubes {
+namespace slow {
+
+/** The offsets of the elements of a field
+ *  in a finished memory layout, and of the blocks they form.
+ *  The layout can be given as a SizeTree
+ *  or as the output tree of a node in a TransformNetwork
+ *  (where every leaf is an element, including the padding ones
+ *  created by CollectLeaves).
+ *  Subtrees share the tables with the whole layout,
+ *  their offsets are relative to the start of the subtree. */
+class FieldLayout {
+public:
+  FieldLayout(const SizeTree &);
+  // Coordinates are mapped to offsets through the partition tree.
+  FieldLayout(const SizeTree &, const PartitionTree &);
+  FieldLayout(const internals::KVTreePv2<internals::NodeType> &tree,
+              const vector<std::string> &level_names);
+  /* The output tree of 'layout_node' is the layout,
+   * coordinates are the indices of 'coordinates_node'
+   * (typically the tree built by the Id request).
+   * When a site has many copies (e.g., halos),
+   * coordinates give the one with the lowest offset. */
+  FieldLayout(internals::transform_networks::TransformNetwork &network,
+              const std::string &coordinates_node,
+              const std::string &layout_node);
+
+  vector<std::string> get_level_names() const;
+  // Number of elements, including padding.
+  int size() const;
+  // Offset of the first element in the whole layout.
+  int start() const;
+  /* Partial indices give the offset of the first element of the subtree.
+   * Throw std::invalid_argument if the indices are not in the layout. */
+  int get_offset(const Indices &) const;
+  int get_offset(const Coordinates &) const;
+  Indices get_indices(int offset) const;
+  FieldLayout get_subtree(const Indices &) const;
+  /* The (offset, size) of the blocks of elements
+   * whose parent has only leaves as children
+   * (e.g., the vectors created by CollectLeaves),
+   * in memory order. */
+  vector<std::pair<int, int>> leaf_parent_blocks() const;
+
+private:
+  struct Data {
+    internals::FlatOffsetTree tree;
+    // end[i] is the offset after the last element of node i
+    vector<int> end;
+    // The nodes whose children are all leaves, sorted by offset.
+    vector<int> leaf_parents;
+    vector<std::string> level_names;
+    // Absolute offset, empty if not available.
+    std::function<int(const Coordinates &)> coordinates_offset;
+
+    Data(internals::FlatOffsetTree &&, int size, vector<std::string> &&);
+  };
+  std::shared_ptr<const Data> data;
+  int node = 0;
+  int depth = 0;
+
+  FieldLayout(std::shared_ptr<const Data>, int node, int depth);
+};
+
+/** A contiguous range of elements. */
+template <class T> struct Span {
+  T *data;
+  int size;
+
+  T *begin() const { return data; }
+  T *end() const { return data + size; }
+  T &operator[](int i) const { return data[i]; }
+};
+
+/** Elements of a field in a subtree of its layout,
+ *  not owning the memory. */
+template <class T> class FieldView {
+public:
+  FieldView(T *_data, const FieldLayout &_layout)
+      : data(_data), layout(_layout) {}
+
+  int size() const { return layout.size(); }
+  T *begin() const { return data; }
+  T *end() const { return data + layout.size(); }
+  // Relative to the start of the view.
+  T &operator[](int offset) const { return data[offset]; }
+  T &operator()(const Indices &idxs) const {
+    return data[layout.get_offset(idxs)];
+  }
+  T &operator()(const Coordinates &xs) const {
+    return data[layout.get_offset(xs)];
+  }
+  FieldView<T> view(const Indices &prefix) const {
+    auto sublayout = layout.get_subtree(prefix);
+    return FieldView<T>(data + sublayout.start() - layout.start(), //
+                        sublayout);
+  }
+  vector<Span<T>> leaf_parent_blocks() const {
+    vector<Span<T>> res;
+    for (const auto &b : layout.leaf_parent_blocks())
+      res.push_back(Span<T>{data + b.first, b.second});
+    return res;
+  }
+  const FieldLayout &get_layout() const { return layout; }
+
+protected:
+  T *data;
+  FieldLayout layout;
+};
+
+/** Storage for one T per element of a memory layout,
+ *  aligned to 'alignment' bytes (64 by default, a cache line).
+ *  Blocks whose offset times sizeof(T) is a multiple of the alignment
+ *  (e.g., the vectors created by CollectLeaves
+ *  when the padding is chosen accordingly) are aligned as well.
+ *  Elements are value-initialised. */
+template <class T> class Field {
+public:
+  Field(const FieldLayout &_layout, std::size_t alignment = 64)
+      : layout(_layout), data(allocate(_layout.size(), alignment)) {}
+  Field(Field &&) = default;
+  Field &operator=(Field &&) = default;
+  Field(const Field &) = delete;
+  Field &operator=(const Field &) = delete;
+
+  int size() const { return layout.size(); }
+  T *begin() { return data.get(); }
+  T *end() { return data.get() + size(); }
+  const T *begin() const { return data.get(); }
+  const T *end() const { return data.get() + size(); }
+
+  T &operator[](int offset) { return data[offset]; }
+  const T &operator[](int offset) const { return data[offset]; }
+  T &operator()(const Indices &idxs) { return data[layout.get_offset(idxs)]; }
+  const T &operator()(const Indices &idxs) const {
+    return data[layout.get_offset(idxs)];
+  }
+  T &operator()(const Coordinates &xs) { return data[layout.get_offset(xs)]; }
+  const T &operator()(const Coordinates &xs) const {
+    return data[layout.get_offset(xs)];
+  }
+
+  FieldView<T> view() { return FieldView<T>(data.get(), layout); }
+  FieldView<const T> view() const {
+    return FieldView<const T>(data.get(), layout);
+  }
+  FieldView<T> view(const Indices &prefix) { return view().view(prefix); }
+  FieldView<const T> view(const Indices &prefix) const {
+    return view().view(prefix);
+  }
+  vector<Span<T>> leaf_parent_blocks() { return view().leaf_parent_blocks(); }
+  vector<Span<const T>> leaf_parent_blocks() const {
+    return view().leaf_parent_blocks();
+  }
+  const FieldLayout &get_layout() const { return layout; }
+
+private:
+  struct Deleter {
+    int size;
+    void operator()(T *p) const {
+      for (int i = 0; i < size; ++i)
+        p[i].~T();
+      std::free(p);
+    }
+  };
+  FieldLayout layout;
+  std::unique_ptr<T[], Deleter> data;
+
+  static std::unique_ptr<T[], Deleter> allocate(int size,
+                                                std::size_t alignment) {
+    if (alignment < alignof(T))
+      alignment = alignof(T);
+    void *p = nullptr;
+    if (posix_memalign(&p, alignment, std::max(size, 1) * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    T *elements = static_cast<T *>(p);
+    int i = 0;
+    try {
+      for (; i < size; ++i)
+        new (elements + i) T();
+    } catch (...) {
+      Deleter{i}(elements);
+      throw;
+    }
+    return std::unique_ptr<T[], Deleter>(elements, Deleter{size});
+  }
+};
+
+} // namespace slow
+} // namespace hypercubes
+
+#endif // FIELD_H_
@@ -0,0 +1,67 @@
+#ifndef HALO_EXCHANGE_H_
+#define HALO_EXCHANGE_H_
+#include "api/memory_layout.hpp"
+#include "geometry/geometry.hpp"
+#include "partitioners/partitioners.hpp"
+
+namespace hypercubes {
+namespace slow {
+
+// A range of consecutive offsets.
+struct Run {
+  int start;
+  int length;
+  bool operator==(const Run &other) const {
+    return start == other.start and length == other.length;
+  }
+};
+
+// Coalesces consecutive offsets into runs, keeping their order.
+vector<Run> coalesce(const vector<int> &offsets);
+
+/**
+ * The sites that the local MPI rank receives from a neighbour
+ * to fill a halo.
+ * src_offsets[i] (in the layout of the neighbour) is copied
+ * into dst_offsets[i] (in the local layout).
+ * The neighbour can be the local rank itself,
+ * for the halos between partitions inside a rank.
+ * Halos that belong to more than one HBB slice (e.g., corners)
+ * are assigned to the first direction in the partitioners list.
+ */
+struct HaloMessage {
+  int direction; // dimension of the HBB level
+  int side;      // HBB index of the halo: 0 (below) or 4 (above)
+  vector<int> neighbour; // cartesian MPI coordinates of the owner
+  vector<int> src_offsets;
+  vector<int> dst_offsets;
+  vector<Run> pack_runs;   // runs in src_offsets
+  vector<Run> unpack_runs; // runs in dst_offsets
+};
+
+struct HaloExchangePlan {
+  vector<HaloMessage> messages;
+  int nsites() const;
+  // Fraction of the sites packed (or unpacked)
+  // in runs longer than one site.
+  double pack_contiguous_fraction() const;
+  double unpack_contiguous_fraction() const;
+};
+
+/**
+ * Builds the plan to fill all the halos of the local MPI rank,
+ * in the layout given by the skeleton tree of the partition tree
+ * pruned with selectors::mpi_rank (see GridLike*Offset fixtures).
+ * The MPI levels are the ones with "MPI" in their names.
+ * Ghost sites outside of the lattice in directions
+ * with OPEN boundary conditions are not filled.
+ */
+HaloExchangePlan make_halo_exchange_plan(const PartitionTree &partition_tree,
+                                         const PartList &partitioners,
+                                         const vector<BoundaryCondition> &bcs,
+                                         const vector<int> &cart_mpi_rank);
+
+} // namespace slow
+} // namespace hypercubes
+
+#endif // HALO_EXCHANGE_H_
@@ -0,0 +1,92 @@
+#ifndef LOOKUP_TABLES_H_
+#define LOOKUP_TABLES_H_
+#include "api/memory_layout.hpp"
+#include "geometry/geometry.hpp"
+#include <cstdint>
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+
+/**
+ * Dense lookup tables for a memory layout:
+ * - coord_to_offset[lex]: offset of the site with lexicographic index lex
+ *   (first dimension running fastest), or -1 if the site is not in the layout.
+ *   Ghost copies of a site are never returned.
+ * - offset_to_lex[offset]: lexicographic index of the site stored at offset
+ *   (also for ghost copies), or -1 for sites outside the lattice.
+ * - up(i)[offset], down(i)[offset]: offset of the real copy
+ *   of the neighbour of the site in direction directions()[i],
+ *   or -1 if it is not in the layout or if the site at offset
+ *   is a ghost copy.
+ *   In particular, the neighbours whose real copy is on another rank
+ *   are -1 even if the layout has a ghost copy of them in a halo:
+ *   use NeighbourTables (api/neighbour_tables.hpp)
+ *   to read the neighbours from the halos.
+ *
+ * Lexicographic indices and the number of sites are 64-bit,
+ * as the lattice can have more than 2^31 sites
+ * (the offsets, local to a rank, are 32-bit).
+ * All the tables are stored in a single int32 buffer
+ * with the same layout as the file written by write(),
+ * so that a file can be memory-mapped and used directly (see map()).
+ * File layout (int32 unless stated, native endianness):
+ *   magic, version, ndims, ndirections, nsites (int64), noffsets, padding,
+ *   sizes[ndims], directions[ndirections], padding to 8 bytes,
+ *   offset_to_lex[noffsets] (int64), coord_to_offset[nsites],
+ *   up[ndirections][noffsets], down[ndirections][noffsets].
+ */
+class LookupTables {
+public:
+  static const int32_t magic = 0x544c4348; // "HCLT"
+  static const int32_t version = 2;
+
+  LookupTables(const PartitionTree &partition_tree,      //
+               const OffsetTree &offset_tree,            //
+               const vector<BoundaryCondition> &bcs,     //
+               const vector<int> &directions);
+  LookupTables(LookupTables &&);
+  LookupTables &operator=(LookupTables &&);
+  LookupTables(const LookupTables &) = delete;
+  LookupTables &operator=(const LookupTables &) = delete;
+  ~LookupTables();
+
+  void write(const std::string &filename) const;
+  // Checks the header and maps the file read-only.
+  static LookupTables map(const std::string &filename);
+
+  Sizes sizes() const;
+  vector<int> directions() const;
+  int64_t nsites() const;
+  int noffsets() const;
+  const int32_t *coord_to_offset() const;
+  const int64_t *offset_to_lex() const;
+  const int32_t *up(int i) const;
+  const int32_t *down(int i) const;
+
+  int64_t lex_index(const Coordinates &) const;
+  Coordinates lex_coordinates(int64_t lex) const;
+
+private:
+  enum {
+    MAGIC,
+    VERSION,
+    NDIMS,
+    NDIRS,
+    NSITES, // 2 words
+    NOFFSETS = NSITES + 2,
+    HEADER_SIZE = NOFFSETS + 2 // with padding
+  };
+  vector<int32_t> buffer;             // when built in memory
+  const int32_t *data = nullptr;      // start of the tables
+  std::size_t mapped_size = 0;        // when memory-mapped
+
+  LookupTables() = default;
+  const int32_t *tables_start() const; // 8-byte aligned
+  std::size_t nwords() const;
+};
+
+} // namespace slow
+} // namespace hypercubes
+
+#endif // LOOKUP_TABLES_H_
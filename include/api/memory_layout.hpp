@@ -2,9 +2,11 @@
 #define PARTITION_TREE_H_
 #include "geometry/geometry.hpp"
 #include "selectors/partition_predicates.hpp"
+#include "trees/flat_offset_tree.hpp"
 #include "trees/kvtree.hpp"
 #include "trees/level_swap.hpp" // TODO: move elsewhere
 #include "trees/partition_tree.hpp"
+#include <memory>
 
 namespace hypercubes {
 namespace slow {
@@ -18,6 +20,12 @@ class OffsetTree {
 private:
   vector<std::string> level_names;
   internals::KVTreeP<int> offset_tree;
+  // Same content as offset_tree, for fast lookups.
+  // Built on the first lookup (not for the intermediate trees
+  // made by get_subtree and shift) and shared by the copies.
+  struct LazyFlatOffsetTree;
+  std::shared_ptr<LazyFlatOffsetTree> lazy_flat_offset_tree;
+  const internals::FlatOffsetTree &flat_offset_tree() const;
 
   OffsetTree(internals::KVTreeP<int> &&_nct,
              vector<std::string> &&_level_names);
@@ -28,6 +36,10 @@ public:
   // Careful: indices are assumed to be ordered properly.
   int get_offset(const Indices &) const;
   Indices get_indices(int) const;
+  /* Same as get_offset for many elements at once:
+   * the indices of element i are idxs[i*idx_size, (i+1)*idx_size). */
+  void get_offsets(const int *idxs, int nindices, int idx_size,
+                   int *offsets) const;
   // Careful: indices are assumed to be ordered properly.
   OffsetTree get_subtree(const Indices &idxs) const;
   OffsetTree shift(int shift) const;
@@ -83,7 +95,17 @@ private:
 public:
   PartitionTree(Sizes, PartList, vector<int> nonspatial_indices);
   vector<std::string> get_level_names() const;
+  Sizes get_sizes() const;
   Indices get_indices(const Coordinates &) const;
+  // Number of indices returned by get_indices.
+  int get_indices_size() const;
+  /* Same as get_indices for many points at once:
+   * the indices of point i are written in
+   * indices[i*get_indices_size(), (i+1)*get_indices_size()).
+   * Coordinates out of the lattice give -1 from the first level
+   * where they are not found.
+   * The coordinates in the block are overwritten. */
+  void get_indices(partitioning::CoordinateBlock &, int *indices) const;
   // TODO: change according to needs
   vector<std::pair<int, Indices>> get_indices_wg(const Coordinates &) const;
   // Careful: indices are assumed to be ordered properly.
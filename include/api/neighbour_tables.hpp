@@ -0,0 +1,53 @@
+#ifndef NEIGHBOUR_TABLES_H_
+#define NEIGHBOUR_TABLES_H_
+#include "api/memory_layout.hpp"
+#include "geometry/geometry.hpp"
+#include <cstdint>
+
+namespace hypercubes {
+namespace slow {
+
+/**
+ * Halo-aware neighbour tables (iup/idn) for a memory layout:
+ * up(i)[offset], down(i)[offset] is the offset of the neighbour
+ * in direction directions()[i] of the site stored at offset,
+ * or -1 if the neighbour is outside of the lattice
+ * or has no copy in the layout.
+ *
+ * Unlike LookupTables, the neighbour can be a ghost copy
+ * (e.g., in a halo created by HBB) and ghost copies have neighbours too.
+ * Among the copies of the neighbour in the layout, the chosen one is
+ * - the one whose indices share the longest prefix
+ *   with the indices of the site, i.e. the closest in the partition tree,
+ * - then the one with the fewest ghost (cached) levels,
+ * - then the first one found by get_indices_tree_with_ghosts.
+ * So, a partition with a halo only reads its own sites and its halo.
+ *
+ * The tables are built walking down the partition tree once
+ * for each site and direction, following the branch of the site
+ * as long as the neighbour has a copy there,
+ * in parallel over the parents of the leaves of the offset tree.
+ */
+class NeighbourTables {
+public:
+  NeighbourTables(const PartitionTree &partition_tree,  //
+                  const OffsetTree &offset_tree,        //
+                  const vector<BoundaryCondition> &bcs, //
+                  const vector<int> &directions,        //
+                  int nthreads = 1);
+
+  vector<int> directions() const;
+  int noffsets() const;
+  const int32_t *up(int i) const;
+  const int32_t *down(int i) const;
+
+private:
+  vector<int> dirs;
+  int n;
+  vector<int32_t> iup, idn; // [direction][offset]
+};
+
+} // namespace slow
+} // namespace hypercubes
+
+#endif // NEIGHBOUR_TABLES_H_
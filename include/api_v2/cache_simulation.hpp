@@ -0,0 +1,112 @@
+#ifndef CACHE_SIMULATION_H_
+#define CACHE_SIMULATION_H_
+#include "transform_network.hpp"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace cache_simulation {
+
+using transform_networks::TransformNetwork;
+
+/** A set-associative cache with LRU replacement,
+ *  addressed by cache line number. */
+class SetAssociativeCache {
+public:
+  SetAssociativeCache(std::size_t size_bytes, int line_bytes, int ways);
+  // true on a hit. On a miss, the line is loaded.
+  bool access(long line);
+  long get_misses() const;
+
+private:
+  int ways;
+  long nsets;
+  vector<long> tags; // per set, the most recently used first
+  vector<int> nvalid;
+  long misses = 0;
+};
+
+/** The number of distinct lines accessed
+ *  since the last access to the same line (LRU stack distance).
+ *  The length of the access stream must be known in advance. */
+class ReuseDistance {
+public:
+  ReuseDistance(long naccesses);
+  // -1 for the first access to the line
+  long access(long line);
+
+private:
+  long time = 0;
+  vector<int> fenwick; // 1 at the time of the last access of each line
+  std::unordered_map<long, long> last_access;
+  void add(long t, int value);
+  long count_after(long t) const; // in (t, time)
+};
+
+struct CacheConfig {
+  std::string name;
+  std::size_t size_bytes;
+  int ways;
+};
+
+struct Options {
+  vector<CacheConfig> caches{{"L1", 32 << 10, 8},  //
+                             {"L2", 1 << 20, 16}, //
+                             {"LLC", 32 << 20, 16}};
+  int line_bytes = 64;
+  int site_bytes = 24 * sizeof(double);
+  // Displacements of the sites read for each site.
+  // If empty, the site itself and its nearest neighbours.
+  vector<vector<int>> stencil;
+};
+
+/** Accesses and misses of the reads of the neighbours
+ *  whose index first differs from the one of the site at a given level,
+ *  i.e. the level below which the stencil crosses a boundary.
+ *  Reads of the site itself are at the level "(site)". */
+struct LevelStats {
+  std::string level_name;
+  long accesses = 0;
+  vector<long> misses; // per cache
+};
+
+struct Report {
+  int nsites = 0;
+  vector<std::string> cache_names;
+  long accesses = 0;   // cache lines
+  vector<long> misses; // per cache
+  // [0]: first accesses to a line,
+  // [1]: distance 0, [k > 1]: distance in [2^(k-2), 2^(k-1))
+  vector<long> reuse_histogram;
+  vector<LevelStats> levels; // "(site)", then from the root down
+};
+
+/** Simulates a sweep of a stencil over the leaves of the output tree
+ *  of end_node, in depth-first order (i.e. in memory order),
+ *  with each leaf taking site_bytes bytes.
+ *  For each leaf, the sites at the displacements in the stencil
+ *  (with periodic boundary conditions) are read through the caches:
+ *  a read goes to the next cache only if it misses in the previous one.
+ *  The coordinates are the indices of the output tree of start_node,
+ *  which must be a box (e.g., an Id).
+ *  Padding leaves are skipped, sites that have many copies
+ *  are read from the copy with the smallest offset. */
+Report simulate(TransformNetwork &network,          //
+                const std::string &start_node_name, //
+                const std::string &end_node_name,   //
+                const Options &options);
+
+/** Misses per site at each level of the tree and for each cache,
+ *  and the histogram of the reuse distances. */
+void print(std::ostream &os, const Report &report);
+
+} // namespace cache_simulation
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // CACHE_SIMULATION_H_
@@ -0,0 +1,91 @@
+#ifndef CODEGEN_H_
+#define CODEGEN_H_
+#include "transform_network.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace codegen {
+
+using std::vector;
+using transform_networks::TransformNetwork;
+
+/** A box of coordinates [lo, hi) where the offset is affine:
+ *  offset = offset0 + sum_d strides[d] * (x[d] - lo[d]). */
+struct AffineRegion {
+  vector<int> lo;
+  vector<int> hi;
+  int offset0;
+  vector<int> strides;
+
+  int volume() const;
+};
+
+/** A range of offsets [start, start + length)
+ *  whose coordinates are given by nested loops:
+ *  x = base + sum_k steps[k] * ((offset - start) / radix[k] % extents[k]),
+ *  where radix[0] = 1 and radix[k+1] = radix[k] * extents[k],
+ *  and length is the product of the extents. */
+struct OffsetSegment {
+  int start;
+  int length;
+  vector<int> base;
+  vector<int> extents;
+  vector<vector<int>> steps;
+};
+
+/** The map between the coordinates of the leaves
+ *  of the output tree of one node of a TransformNetwork
+ *  (the "start" node, typically an Id)
+ *  and the offsets of the leaves in the output tree of another node
+ *  (the "end" node), i.e. the position of the leaf in depth-first order.
+ *  Sites that have many copies (halos) are mapped
+ *  to the copy with the smallest offset,
+ *  padding leaves are mapped to no coordinates.
+ *  The regions and segments that contain a single site
+ *  are stored as plain tables. */
+struct IndexFunctions {
+  std::string start_node_name;
+  std::string end_node_name;
+  vector<int> extents;
+  int noffsets;
+  vector<AffineRegion> regions;
+  vector<std::pair<vector<int>, int>> irregular_coords;
+  vector<OffsetSegment> segments;
+  vector<std::pair<int, vector<int>>> irregular_offsets;
+};
+
+/** Evaluates the transformation from start_node_name to end_node_name
+ *  on all the coordinates and all the offsets,
+ *  and splits the two maps in piecewise-affine parts.
+ *  The output tree of the start node must be a box,
+ *  i.e. all the nodes of a level have the same number of children.
+ *  The cost is proportional to the number of sites. */
+IndexFunctions analyse(TransformNetwork &network,            //
+                       const std::string &start_node_name, //
+                       const std::string &end_node_name);
+
+/** Same as the generated functions:
+ *  coords_to_offset returns -1 for coordinates out of the lattice,
+ *  offset_to_coords returns false for padding
+ *  and out-of-range offsets. */
+int coords_to_offset(const IndexFunctions &f, const int *x);
+bool offset_to_coords(const IndexFunctions &f, int offset, int *x);
+
+/** A self-contained C++14 header that defines,
+ *  in namespace namespace_name,
+ *  constexpr versions of coords_to_offset and offset_to_coords
+ *  (with the same signatures as above, without the first argument)
+ *  and the constants ndims, extents and noffsets. */
+std::string generate_header(const IndexFunctions &f,
+                            const std::string &namespace_name);
+
+} // namespace codegen
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // CODEGEN_H_
@@ -0,0 +1,134 @@
+#ifndef COMPILED_TREE_H_
+#define COMPILED_TREE_H_
+#include "trees/kvtree_data_structure.hpp"
+#include <map>
+#include <queue>
+#include <vector>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+/** A list of indices of possibly different lengths, stored contiguously.
+ *  Index i is in data[offsets[i]:offsets[i+1]].
+ *  Calling clear() keeps the allocated memory,
+ *  so that the same object can be reused in hot loops. */
+struct IndexList {
+  vector<int> data;
+  vector<int> offsets{0};
+
+  int size() const;
+  void clear();
+  void push_back(const vector<int> &);
+  vector<int> operator[](int i) const;
+};
+
+/** A flat, read-only copy of a KVTreePv2,
+ *  that can be walked without any allocation.
+ *  Every distinct node of the (possibly shared) tree
+ *  is stored only once, so the size of the tables
+ *  is proportional to the number of distinct nodes.
+ *  Children of node i are the entries
+ *  [child_start[i], child_start[i+1]) of child_node,
+ *  the key of child c is in keys[key_start[c]:key_start[c+1]].
+ *  When direct[i] is true, the keys of the children of node i
+ *  are {0}, {1}, ... {nchildren-1},
+ *  so that a key is also the position of the child. */
+struct CompiledKVTree {
+  vector<int> child_start;
+  vector<int> child_node;
+  vector<int> key_start;
+  vector<int> keys;
+  vector<bool> direct;
+  int root = 0;
+
+  int nnodes() const;
+  int nchildren(int node) const;
+};
+
+// Not a member of CompiledKVTree
+// so that the struct does not depend on Value.
+template <class Value> CompiledKVTree compile(const KVTreePv2<Value> &tree) {
+  CompiledKVTree res;
+  std::map<const KVTree<Value> *, int> ids;
+  std::queue<const KVTree<Value> *> to_visit;
+
+  auto get_id = [&](const KVTreePv2<Value> &t) {
+    auto it = ids.find(t.get());
+    if (it != ids.end())
+      return it->second;
+    int id = ids.size();
+    ids[t.get()] = id;
+    to_visit.push(t.get());
+    return id;
+  };
+
+  res.root = get_id(tree);
+  res.key_start.push_back(0);
+  // Nodes are visited in the same order as their ids,
+  // so that the children of node i are written
+  // right after the children of node i-1.
+  while (not to_visit.empty()) {
+    const KVTree<Value> *t = to_visit.front();
+    to_visit.pop();
+    res.child_start.push_back(res.child_node.size());
+    bool direct = true;
+    for (int i = 0; i < t->children.size(); ++i) {
+      const auto &c = t->children[i];
+      direct = direct and c.first.size() == 1 and c.first[0] == i;
+      std::copy(c.first.begin(), c.first.end(), std::back_inserter(res.keys));
+      res.key_start.push_back(res.keys.size());
+      res.child_node.push_back(c.second ? get_id(c.second) : -1);
+    }
+    res.direct.push_back(direct);
+  }
+  res.child_start.push_back(res.child_node.size());
+  return res;
+}
+
+/** Same as index_pullback in tree_transform.hpp,
+ *  but appends the result to 'out'
+ *  (which is not cleared). */
+void index_pullback(const CompiledKVTree &tree, //
+                    const int *in,              //
+                    int in_size,                //
+                    vector<int> &out);
+
+/** Same as index_pullback_safe in tree_transform.hpp:
+ *  returns false, leaving 'out' unchanged,
+ *  if the index points to a padding leaf. */
+bool index_pullback_safe(const CompiledKVTree &tree, //
+                         const int *in,              //
+                         int in_size,                //
+                         vector<int> &out);
+
+/** Same as index_pushforward in tree_transform.hpp,
+ *  but appends all the results to 'out'. */
+void index_pushforward(const CompiledKVTree &tree, //
+                       const int *in,              //
+                       int in_size,                //
+                       IndexList &out);
+
+/** Batch versions.
+ *  'in' contains 'nindices' indices of length 'in_size' each.
+ *  For pullback, the result for index i is out[i].
+ *  For pushforward, the results for index i are
+ *  out[first_result[i]] ... out[first_result[i+1]-1]. */
+void index_pullback(const CompiledKVTree &tree, //
+                    const int *in,              //
+                    int nindices,               //
+                    int in_size,                //
+                    IndexList &out);
+
+void index_pushforward(const CompiledKVTree &tree, //
+                       const int *in,              //
+                       int nindices,               //
+                       int in_size,                //
+                       IndexList &out,             //
+                       vector<int> &first_result);
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // COMPILED_TREE_H_
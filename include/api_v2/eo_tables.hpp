@@ -0,0 +1,65 @@
+#ifndef EO_TABLES_H_
+#define EO_TABLES_H_
+#include "transform_network.hpp"
+#include <cstdint>
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace eo_tables {
+
+using transform_networks::TransformNetwork;
+
+/** A node at the EO level of a layout,
+ *  whose children are the sites of the 2 parities. */
+struct EOSubtree {
+  vector<int> idx;   // positions of the node and its ancestors
+  int origin_parity; // parity of the sites in its first child
+};
+
+/** Nearest-neighbour tables split by parity.
+ *  The sites of each parity are numbered in memory order
+ *  (checkerboard-local offsets), so that a kernel working
+ *  on the sites of one parity reads contiguous tables.
+ *  up(p, i)[s] and down(p, i)[s] are the checkerboard-local offsets,
+ *  in the opposite parity, of the neighbours of the site s of parity p
+ *  in direction i (with periodic boundary conditions). */
+struct ParityTables {
+  vector<std::string> directions;
+  vector<EOSubtree> subtrees; // in memory order
+  vector<int> offsets[2];     // [parity][site]: offset in the layout
+  vector<int32_t> iup[2], idn[2]; // [parity][direction * nsites + site]
+
+  int nsites(int parity) const;
+  const int32_t *up(int parity, int i) const;
+  const int32_t *down(int parity, int i) const;
+};
+
+/** Builds the tables for the layout given by the output tree of end_node,
+ *  offsets being the positions of the leaves in depth-first order.
+ *  The coordinates are the indices of the output tree of start_node,
+ *  which must be a box (e.g., an Id),
+ *  and the parity of a site is the parity of the sum of its coordinates
+ *  in levels_reference, which are also the directions of the hopping term.
+ *  The end tree must have a level eo_level_name
+ *  made by EONaive (possibly fixed by EOFix):
+ *  the parity of a site is found from its index at that level
+ *  and the origin parity of its subtree, as computed by eo_fix.
+ *  Padding leaves are skipped, sites that have many copies
+ *  use the one with the smallest offset.
+ *  Throws std::invalid_argument if a neighbour has the same parity
+ *  (e.g., with an odd extent) or if the parities found at the EO level
+ *  do not match the coordinates. */
+ParityTables make_parity_tables(TransformNetwork &network,          //
+                                const std::string &start_node_name, //
+                                const std::string &end_node_name,   //
+                                const std::string &eo_level_name,   //
+                                const vector<std::string> &levels_reference);
+
+} // namespace eo_tables
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // EO_TABLES_H_
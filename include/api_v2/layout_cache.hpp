@@ -0,0 +1,66 @@
+#ifndef LAYOUT_CACHE_H_
+#define LAYOUT_CACHE_H_
+#include "transform_network.hpp"
+#include "transform_requests.hpp"
+#include <cstdint>
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace transform_requests {
+
+/** A directory of saved TransformNetworks (see serialisation.hpp),
+ *  each in a file named after the hash of the chain of requests
+ *  that builds it.
+ *  The file also contains the canonical form of the requests,
+ *  which is compared on load: when two chains of requests
+ *  have the same hash, the file of the other one is counted
+ *  as a collision and the network is rebuilt (and saved in its place).
+ *
+ *  Many processes can use the same directory at the same time:
+ *  networks are written to a temporary file which is then renamed,
+ *  so that readers find either no file or a complete one.
+ *  When many processes build the same network at the same time
+ *  they all write it, and the last rename wins.
+ *  Files that cannot be read (truncated, corrupted,
+ *  or of another format version) are counted as invalid,
+ *  and the network is rebuilt and saved again.
+ *  Failing to save a network is not an error. */
+class LayoutCache {
+public:
+  enum Result { HIT, MISS };
+  struct Stats {
+    int hits = 0;
+    int misses = 0;
+    int invalid = 0;
+    int collisions = 0;
+    int write_failures = 0;
+  };
+
+  /** The directory is created if it does not exist. */
+  LayoutCache(const std::string &directory);
+
+  /** Same as Build, but loads the network from the cache if possible.
+   *  'network' should be empty. */
+  Result build(TreeFactory &f,            //
+               TransformNetwork &network, //
+               const vector<TransformRequestP> &requests);
+
+  std::string filename(const vector<TransformRequestP> &requests) const;
+  const Stats &get_stats() const;
+
+private:
+  const std::string directory;
+  Stats stats;
+};
+
+/** Hash of the canonical form of a chain of requests. */
+std::uint64_t hash(const vector<TransformRequestP> &requests);
+
+} // namespace transform_requests
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // LAYOUT_CACHE_H_
@@ -0,0 +1,152 @@
+#ifndef LAYOUT_TUNER_H_
+#define LAYOUT_TUNER_H_
+#include "transform_network.hpp"
+#include "transform_requests.hpp"
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace layout_tuning {
+
+using transform_requests::TransformRequestP;
+
+/** A chain of requests that builds a layout of the whole lattice,
+ *  from an Id node named "root" to a node named "layout".
+ *  The name describes the choices made, e.g. "b4x4x4x4/TZYX/eo":
+ *  - the block size in each dimension (as in QSub),
+ *  - the order of the dimensions, from the slowest to the fastest,
+ *    both for the blocks and for the sites in a block (LevelSwap),
+ *  - whether the sites in a block are split in even and odd (EONaive).
+ *  The EO level cannot be moved above the blocks with LevelSwap,
+ *  as the children it creates have no keys.
+ *  The sites in a block are always flattened in a single level:
+ *  Flatten does not change the memory order, so smaller ranges
+ *  only matter for the level split by EONaive, and with a range
+ *  that does not include all the dimensions the naive parities
+ *  are wrong in the subtrees with an odd origin
+ *  (which would need EOFix, that has no request). */
+struct Candidate {
+  std::string name;
+  vector<TransformRequestP> requests;
+};
+
+struct TunerOptions {
+  // Tried in all the dimensions at the same time.
+  // Block sizes that do not divide the extent of a dimension
+  // leave it unblocked. The unblocked layouts are always tried.
+  vector<int> block_sizes{2, 4, 8};
+  // Permutations of the dimensions, from the slowest to the fastest.
+  // If empty, the natural order and its reverse are tried.
+  vector<vector<int>> dimension_orders;
+  // The even/odd split is tried only when all the blocks
+  // have an even origin.
+  bool try_eo = true;
+
+  // The stencil kernel: each site reads its 2*ndims nearest neighbours.
+  int site_doubles = 24;
+  // The cache of the static cost model.
+  std::size_t cache_bytes = 32 << 10;
+  int cache_ways = 8;
+  int line_bytes = 64;
+  // Number of candidates with the lowest cost that are measured.
+  int keep = 4;
+  // The best time is kept.
+  int repetitions = 5;
+};
+
+struct Measurement {
+  Candidate candidate;
+  double cost;    // simulated misses per site (see estimated_cost)
+  double seconds; // best time of a sweep, negative if not measured
+};
+
+struct TuningResult {
+  // By increasing cost, the measured ones first.
+  vector<Measurement> measurements;
+  int best; // the fastest of the measured ones
+
+  const Candidate &winner() const;
+};
+
+vector<std::string> dimension_names(int ndims);
+
+/** Deterministic: the same sizes and options give the same candidates,
+ *  in the same order. */
+vector<Candidate> enumerate_candidates(const vector<int> &sizes,
+                                       const TunerOptions &options);
+
+/** The neighbour table (see site_offsets::neighbour_table)
+ *  of the layout built by the candidate. */
+vector<int> neighbour_table(TreeFactory &f, const Candidate &candidate);
+
+/** Static model for a sweep of the stencil kernel over the sites
+ *  in memory order: the misses per site in a set-associative LRU cache
+ *  (see cache_simulation::SetAssociativeCache)
+ *  of the lines of the neighbours read from 'in'
+ *  and of the site written to 'out', stored after 'in'.
+ *  It ignores prefetching and the other levels of the hierarchy,
+ *  it is only meant to discard the worst candidates. */
+double estimated_cost(const vector<int> &neighbours, //
+                      int ndims,                     //
+                      const TunerOptions &options);
+
+/** The stencil kernel: for each offset o,
+ *  out[o] is the sum of in at the nn neighbours of o,
+ *  each site being site_doubles doubles. */
+void stencil_sweep(const vector<int> &neighbours, //
+                   int nn,                        //
+                   int site_doubles,              //
+                   const double *in,              //
+                   double *out);
+
+/** The best time of a sweep of the stencil kernel. */
+double measure_stencil(const vector<int> &neighbours, //
+                       int ndims,                     //
+                       const TunerOptions &options);
+
+/** Enumerates the candidates, measures the ones with the lowest cost
+ *  and returns all of them. Throws if there is no candidate. */
+TuningResult tune(TreeFactory &f,           //
+                  const vector<int> &sizes, //
+                  const TunerOptions &options);
+
+/** A table of the measurements and the chain of requests of the winner. */
+void print(std::ostream &os, const TuningResult &result);
+
+/** A directory of tuning results, one file per lattice size, options
+ *  and machine (host name and number of hardware threads).
+ *  The files only store the key of the result (the lattice size,
+ *  the options and the machine), the names of the candidates
+ *  and their timings: the chains of requests are enumerated again
+ *  when a file is read, and a file with another key
+ *  (i.e., with the same hash) is a miss.
+ *  Files are written as in LayoutCache (see layout_cache.hpp).
+ *  Failing to save a result is not an error. */
+class TuningCache {
+public:
+  enum Result { HIT, MISS };
+
+  /** The directory is created if it does not exist. */
+  TuningCache(const std::string &directory);
+
+  Result tune(TreeFactory &f,              //
+              const vector<int> &sizes,    //
+              const TunerOptions &options, //
+              TuningResult &result);
+
+  std::string filename(const vector<int> &sizes,
+                       const TunerOptions &options) const;
+
+private:
+  const std::string directory;
+};
+
+} // namespace layout_tuning
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // LAYOUT_TUNER_H_
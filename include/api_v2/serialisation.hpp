@@ -0,0 +1,77 @@
+#ifndef SERIALISATION_H_
+#define SERIALISATION_H_
+#include "transform_network.hpp"
+#include "tree_transform.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace serialisation {
+
+using transform_networks::TransformNetwork;
+
+/** Binary format for trees and transform networks.
+ *
+ *  A file is a 32-byte header followed by a payload:
+ *  - header: magic "HCUB", format_version, content (tree or network),
+ *    4 reserved bytes, payload size and FNV-1a checksum of the payload
+ *    (both 64-bit);
+ *  - payload: 32-bit integers in native byte order,
+ *    strings are stored as their length followed by the characters,
+ *    padded to a multiple of 4 bytes.
+ *
+ *  Trees are stored as a list of nodes, children before parents.
+ *  A node is (value, nchildren, (keysize, key..., child id) for each child),
+ *  so that a subtree that appears many times is written once
+ *  and referenced by its id.
+ *  A network stores all its trees in a single list,
+ *  followed by its nodes (kind, input tree, output tree, level names
+ *  and the data specific to the kind), names and arcs.
+ *
+ *  Files are meant to be read on machines with the same endianness.
+ */
+constexpr std::uint32_t format_version = 1;
+
+class FormatError : public std::runtime_error {
+public:
+  template <class... Args>
+  FormatError(Args... args) : std::runtime_error(args...){};
+};
+
+std::string serialise(const KVTreePv2<NodeType> &tree);
+std::string serialise(TransformNetwork &network);
+
+/** The subtrees of the loaded trees are interned in the store of f,
+ *  the roots of the trees are distinct objects
+ *  exactly when they were in the saved data.
+ *  Both functions throw FormatError
+ *  when the data is truncated, corrupted or of the wrong kind. */
+KVTreePv2<NodeType> deserialise_tree(TreeFactory &f, //
+                                     const char *data, std::size_t size);
+/** The nodes are added to 'network', which should be empty.
+ *  The transformers in the network behave as the saved ones,
+ *  but they are not of the same type. */
+void deserialise_network(TreeFactory &f,            //
+                         const char *data, std::size_t size, //
+                         TransformNetwork &network);
+
+void save(const KVTreePv2<NodeType> &tree, const std::string &filename);
+void save(TransformNetwork &network, const std::string &filename);
+
+/** The file is mapped in memory and read in place,
+ *  without an intermediate copy. */
+KVTreePv2<NodeType> load_tree(TreeFactory &f, const std::string &filename);
+void load_network(TreeFactory &f,              //
+                  const std::string &filename, //
+                  TransformNetwork &network);
+
+} // namespace serialisation
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // SERIALISATION_H_
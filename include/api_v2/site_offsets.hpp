@@ -0,0 +1,59 @@
+#ifndef SITE_OFFSETS_H_
+#define SITE_OFFSETS_H_
+#include "transform_network.hpp"
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace site_offsets {
+
+using transform_networks::TransformNetwork;
+
+/** The number of children at each level,
+ *  throws std::invalid_argument if it is not the same
+ *  for all the nodes of a level. */
+vector<int> box_extents(const KVTreePv2<NodeType> &tree);
+
+/** The indices of the leaves (including padding), in depth-first order. */
+vector<vector<int>> leaf_indices(const KVTreePv2<NodeType> &tree);
+
+/** The sites of a lattice stored in a layout:
+ *  the offsets are the positions of the leaves of the layout
+ *  in depth-first order (i.e. in memory order),
+ *  the coordinates are the indices of the leaves of a box. */
+struct SiteOffsets {
+  vector<int> extents;          // of the box
+  vector<vector<int>> leaves;   // per offset, the index of the leaf
+  vector<vector<int>> coords;   // per offset, empty for padding
+  vector<int> offset_of_site;   // per lexicographic index, -1 if missing
+
+  int ndims() const;
+  int nsites() const;
+  int lex(const vector<int> &x) const;
+  bool inside(const vector<int> &x) const;
+  /** The offset of the site at x + disp, with periodic boundary conditions.
+   *  The site at offset must not be padding. */
+  int neighbour(int offset, const vector<int> &disp) const;
+};
+
+/** Maps the leaves of the output tree of end_node
+ *  to the leaves of the output tree of start_node, which must be a box.
+ *  Leaves that are mapped to no site, or outside of the box, are padding.
+ *  Sites that have many copies use the one with the smallest offset. */
+SiteOffsets make_site_offsets(TransformNetwork &network,          //
+                              const std::string &start_node_name, //
+                              const std::string &end_node_name);
+
+/** For each offset, the offsets of the nearest neighbours,
+ *  in the order (dimension 0, backward), (dimension 0, forward), ...
+ *  with periodic boundary conditions.
+ *  Padding offsets have themselves as neighbours. */
+vector<int> neighbour_table(const SiteOffsets &sites);
+
+} // namespace site_offsets
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // SITE_OFFSETS_H_
@@ -34,15 +34,33 @@ public:
   std::vector<std::string> operator[](const TransformerP &);
 
   std::set<std::string> nodenames() const;
-  std::vector<Arc> find_transformations(std::string node_name_start,
-                                        std::string node_name_end);
+  // In the order they were added.
+  const std::vector<TransformerP> &get_nodes() const;
+  std::vector<Arc> get_arcs(const TransformerP &) const;
+  // An arc, with the node it starts from.
+  // For INVERSE arcs, the transformer to invert is the source
+  // (the destination is the node the source was built from).
+  struct Step {
+    TransformerP source;
+    Arc arc;
+  };
+  // The path with the smallest estimated cost per index
+  // (see Transformer::estimated_cost).
+  std::vector<Step> find_transformations(std::string node_name_start,
+                                         std::string node_name_end);
 
   // Returns the transformer or its inverse
   // based on the type of the arc
-  static transformers::IndexTransformerP get_transformer(Arc a);
+  static transformers::IndexTransformerP get_transformer(const Step &step);
 
+  // The results are cached until a node is added.
   IndexTransformerP get_transform(const std::string &node_name_start,
                                   const std::string &node_name_end);
+  // Same as get_transform, evaluated on all the leaves at once
+  // (see transformers::FusedComposition).
+  std::shared_ptr<transformers::FusedComposition>
+  get_fused_transform(const std::string &node_name_start,
+                      const std::string &node_name_end);
 
 private:
   TransformerP
@@ -59,10 +77,15 @@ private:
   // the adjacency matrix
   std::map<TransformerP, std::set<Arc>> arcs;
 
-  std::tuple<bool, std::vector<TransformNetwork::Arc>>
-  _find_transform(const TransformerP node_start, //
-                  const TransformerP node_end,   //
-                  std::vector<TransformerP> visited_nodes);
+  std::vector<Step> find_path(const TransformerP &node_start,
+                              const TransformerP &node_end) const;
+  static int cost(const Step &);
+
+  std::map<std::pair<std::string, std::string>, IndexTransformerP>
+      transform_cache;
+  std::map<std::pair<std::string, std::string>,
+           std::shared_ptr<transformers::FusedComposition>>
+      fused_transform_cache;
 };
 
 bool operator<(const TransformNetwork::Arc &, //
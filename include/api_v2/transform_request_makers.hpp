@@ -81,6 +81,10 @@ TransformRequestP EONaive(std::string keylevel,       //
                           std::string new_level_name, //
                           std::string end_node_name = "");
 
+TransformRequestP SpaceFillingCurve(std::string keylevel, //
+                                    sfc::Curve curve,     //
+                                    std::string end_node_name = "");
+
 TransformRequestP Sum(std::string new_level_name,                //
                       const vector<TransformRequestP> &requests, //
                       std::string end_node_name = "");
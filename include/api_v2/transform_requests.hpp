@@ -3,9 +3,13 @@
 #include "geometry/geometry.hpp"
 #include "transformer.hpp"
 #include "tree_transform.hpp"
+#include <cstdint>
+#include <initializer_list>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <tuple>
+#include <utility>
 
 namespace hypercubes {
 namespace slow {
@@ -43,9 +47,71 @@ public:
                             TransformerP previous, //
                             TransformNetwork &network) const = 0;
   std::string get_end_node_name() const;
+  /** A text representation of the request, of its parameters
+   *  and of its end node name (including the sub-requests),
+   *  equal for requests that build the same nodes. */
+  virtual std::string canonical() const = 0;
+  /** Hash of canonical(), the same on every run and platform. */
+  std::uint64_t hash() const;
 };
 
 using TransformRequestP = std::shared_ptr<TransformRequest>;
+
+/* Helpers for TransformRequest::canonical().
+ * Strings are prefixed by their length, so that any character
+ * can appear in level and node names. */
+namespace canonical_form {
+inline void write(std::ostream &os, int x) { os << x; }
+inline void write(std::ostream &os, const std::string &s) {
+  os << s.size() << ':' << s;
+}
+inline void write(std::ostream &os, BoundaryCondition bc) {
+  os << static_cast<int>(bc);
+}
+inline void write(std::ostream &os, sfc::Curve c) { os << static_cast<int>(c); }
+template <class T> void write(std::ostream &os, const vector<T> &v) {
+  os << '[';
+  for (int i = 0; i < v.size(); ++i) {
+    if (i != 0)
+      os << ',';
+    write(os, v[i]);
+  }
+  os << ']';
+}
+template <class Tuple, std::size_t... Is>
+void write_tuple(std::ostream &os, const Tuple &t, std::index_sequence<Is...>) {
+  (void)std::initializer_list<int>{
+      (os << (Is == 0 ? "" : ","), write(os, std::get<Is>(t)), 0)...};
+}
+/* name(arg1,arg2,...;end_node_name) */
+template <class... Ts>
+std::string request(const std::string &name,           //
+                    const std::tuple<Ts...> &args,     //
+                    const std::string &end_node_name) {
+  std::stringstream ss;
+  ss << name << '(';
+  write_tuple(ss, args, std::index_sequence_for<Ts...>());
+  ss << ';';
+  write(ss, end_node_name);
+  ss << ')';
+  return ss.str();
+}
+std::string requests(const vector<TransformRequestP> &requests);
+} // namespace canonical_form
+
+/* The names of the transformers in canonical(),
+ * defined for the transformers used in the generic requests below. */
+template <class TransformerType> const char *request_name();
+template <> const char *request_name<transformers::Renumber>();
+template <> const char *request_name<transformers::QFull>();
+template <> const char *request_name<transformers::QSub>();
+template <> const char *request_name<transformers::HBB>();
+template <> const char *request_name<transformers::Flatten>();
+template <> const char *request_name<transformers::CollectLeaves>();
+template <> const char *request_name<transformers::LevelRemap>();
+template <> const char *request_name<transformers::LevelSwap>();
+template <> const char *request_name<transformers::EONaive>();
+template <> const char *request_name<transformers::SpaceFillingCurve>();
 /* Generic classes - Attempt at reducing the boilerplate. */
 
 template <typename TransformerType>
@@ -55,6 +121,11 @@ public:
   TransformRequestGeneric0Arg(std::string end_node_name = "")
       : TransformRequest(end_node_name){};
 
+  std::string canonical() const override {
+    return canonical_form::request(request_name<TransformerType>(),
+                                   std::tuple<>(), end_node_name);
+  }
+
   TransformerP join(TreeFactory &f,        //
                     TransformerP previous, //
                     TransformNetwork &_) const {
@@ -81,6 +152,11 @@ public:
   TransformRequestGeneric1Arg(Ts... args, std::string end_node_name = "")
       : TransformRequest(end_node_name), args(args...){};
 
+  std::string canonical() const override {
+    return canonical_form::request(request_name<TransformerType>(), args,
+                                   end_node_name);
+  }
+
   TransformerP join(TreeFactory &f,        //
                     TransformerP previous, //
                     TransformNetwork &_) const {
@@ -109,6 +185,11 @@ public:
   TransformRequestGeneric2Arg(Ts... args, std::string end_node_name = "")
       : TransformRequest(end_node_name), args(args...){};
 
+  std::string canonical() const override {
+    return canonical_form::request(request_name<TransformerType>(), args,
+                                   end_node_name);
+  }
+
   TransformerP join(TreeFactory &f,        //
                     TransformerP previous, //
                     TransformNetwork &_) const {
@@ -139,6 +220,11 @@ public:
   TransformRequestGeneric3Arg(Ts... args, std::string end_node_name = "")
       : TransformRequest(end_node_name), args(args...){};
 
+  std::string canonical() const override {
+    return canonical_form::request(request_name<TransformerType>(), args,
+                                   end_node_name);
+  }
+
   TransformerP join(TreeFactory &f,        //
                     TransformerP previous, //
                     TransformNetwork &_) const {
@@ -170,6 +256,11 @@ public:
   TransformRequestGeneric5Arg(Ts... args, std::string end_node_name = "")
       : TransformRequest(end_node_name), args(args...){};
 
+  std::string canonical() const override {
+    return canonical_form::request(request_name<TransformerType>(), args,
+                                   end_node_name);
+  }
+
   TransformerP join(TreeFactory &f,        //
                     TransformerP previous, //
                     TransformNetwork &_) const {
@@ -208,6 +299,7 @@ public:
   TransformerP join(TreeFactory &f,             //
                     TransformerP previous,      //
                     TransformNetwork &_) const; // must be 0
+  std::string canonical() const override;
 };
 
 using Renumber = TransformRequestGeneric0Arg<transformers::Renumber>;
@@ -254,9 +346,14 @@ using LevelSwap2 =
                                 vector<std::string>>; // reordered_level_names
 
 using EONaive = TransformRequestGeneric2Arg<transformers::EONaive,
-                                            std::string,  // keylevel
+                                            std::string, // keylevel
                                             std::string>; // new_level_name
 
+using SpaceFillingCurve =
+    TransformRequestGeneric2Arg<transformers::SpaceFillingCurve,
+                                std::string, // keylevel
+                                sfc::Curve>; // curve
+
 // TODO: Test
 class EOFix : public TransformRequest {
 private:
@@ -279,6 +376,7 @@ public:
   TransformerP join(TreeFactory &f,        //
                     TransformerP previous, //
                     TransformNetwork &n) const override;
+  std::string canonical() const override;
 };
 
 /** Represents a graph of the kind
@@ -301,6 +399,7 @@ public:
   TransformerP join(TreeFactory &f,                            //
                     TransformerP previous,                     //
                     TransformNetwork &network) const override; //
+  std::string canonical() const override;
 };
 
 /** Represents a graph of the kind
@@ -319,6 +418,7 @@ public:
   TransformerP join(TreeFactory &f,                            //
                     TransformerP previous,                     //
                     TransformNetwork &network) const override; //
+  std::string canonical() const override;
 };
 
 /* Represents a graph of the kind
@@ -339,6 +439,7 @@ public:
   TransformerP join(TreeFactory &f,                            //
                     TransformerP previous,                     //
                     TransformNetwork &network) const override; //
+  std::string canonical() const override;
 };
 
 /* This function is the top-level function
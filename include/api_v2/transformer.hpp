@@ -1,11 +1,13 @@
 #ifndef TRANSFORMER_H_
 #define TRANSFORMER_H_
+#include "compiled_tree.hpp"
 #include "geometry/geometry.hpp"
 #include "selectors/selectors.hpp"
 #include "tree_transform.hpp"
 #include "trees/kvtree_data_structure.hpp"
 #include "trees/kvtree_v2.hpp"
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -46,6 +48,71 @@ public:
   Composition(const std::vector<IndexTransformerP>);
 };
 
+/** A transformation evaluated once on all the leaves
+ *  of its input tree (for apply) and of its output tree (for inverse),
+ *  and stored as two one-to-many tables.
+ *  A lookup is then a walk down a compiled tree,
+ *  to find the number of the leaf, and a copy of the results.
+ *  As in Transformer, apply gives no results
+ *  for indices that are not leaves of the input tree,
+ *  while inverse throws KeyNotFoundError
+ *  for indices that are not leaves of the output tree.
+ *  The inverse is evaluated only on the leaves of the output tree
+ *  that are the image of some leaf of the input tree:
+ *  the other ones (padding, or halo leaves outside of the input)
+ *  have no results, and any exception thrown by transform
+ *  on the evaluated leaves is propagated. */
+class FusedComposition : public IIndexTransformer {
+public:
+  FusedComposition(const KVTreePv2<NodeType> &input_tree,  //
+                   const KVTreePv2<NodeType> &output_tree, //
+                   const IndexTransformerP &transform);
+  vector<Index> apply(const Index &) const;
+  vector<Index> inverse(const Index &) const;
+
+  /** Batch versions, with the same conventions
+   *  as the batch index_pushforward in compiled_tree.hpp:
+   *  'in' contains 'nindices' indices of length 'in_size' each,
+   *  the results for index i are
+   *  out[first_result[i]] ... out[first_result[i+1]-1]. */
+  void apply(const int *in,                    //
+             int nindices,                     //
+             int in_size,                      //
+             IndexList &out,                   //
+             vector<int> &first_result) const; //
+  void inverse(const int *in,                    //
+               int nindices,                     //
+               int in_size,                      //
+               IndexList &out,                   //
+               vector<int> &first_result) const; //
+
+private:
+  struct LeafTable {
+    CompiledKVTree tree;
+    // For each entry of tree.child_node,
+    // the number of the first leaf below it.
+    vector<int> first_leaf;
+    // The results for leaf l are
+    // images[first_image[l]] ... images[first_image[l+1]-1]
+    IndexList images;
+    vector<int> first_image{0};
+
+    LeafTable(const KVTreePv2<NodeType> &tree);
+    // -1 if the index is not a leaf
+    int leaf(const int *idx, int idx_size) const;
+  };
+  LeafTable forward;
+  LeafTable backward;
+
+  static void lookup(const LeafTable &table, //
+                     const int *in,          //
+                     int nindices,           //
+                     int in_size,            //
+                     bool throw_if_missing,  //
+                     IndexList &out,         //
+                     vector<int> &first_result);
+};
+
 class Transformer;
 using TransformerP = std::shared_ptr<Transformer>;
 class TreeTransformer;
@@ -87,6 +154,17 @@ public:
   Transformer(Args... args) : TreeTransformer(args...) {}
   virtual vector<Index> apply(const Index &) const;
   virtual vector<Index> inverse(const Index &) const;
+  /** Rough cost of apply and inverse on a single index,
+   *  used by TransformNetwork to choose between paths.
+   *  By default, a walk down the output tree, one step per level. */
+  virtual int estimated_cost() const;
+  /** Flat copy of output_tree,
+   * built the first time it is needed. */
+  const CompiledKVTree &compiled_output_tree() const;
+
+private:
+  mutable std::once_flag compiled_flag;
+  mutable CompiledKVTree compiled;
 };
 using TransformerP = std::shared_ptr<Transformer>;
 
@@ -97,6 +175,7 @@ public:
      vector<std::string> dimension_names);
   vector<Index> apply(const Index &) const;
   vector<Index> inverse(const Index &) const;
+  int estimated_cost() const;
 };
 
 struct Renumber : public Transformer {
@@ -193,6 +272,7 @@ struct LevelSwap : public Transformer {
 
   vector<Index> apply(const Index &) const;
   vector<Index> inverse(const Index &) const;
+  int estimated_cost() const;
 
 private:
   vector<int> permutation_apply;
@@ -210,6 +290,16 @@ public:
           std::string new_level_name);
 };
 
+/** Reorders the children at a (flattened) level
+ *  along a space filling curve,
+ *  using their keys as coordinates (see TreeFactory::sfc_reorder). */
+struct SpaceFillingCurve : public Transformer {
+  SpaceFillingCurve(TreeFactory &f,        //
+                    TransformerP previous, //
+                    std::string keylevel,  //
+                    sfc::Curve curve);
+};
+
 // TODO: test
 struct EOFix : public Transformer {
 private:
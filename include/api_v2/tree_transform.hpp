@@ -2,13 +2,20 @@
 #define TREE_TRANSFORM_H_
 #include "exceptions/exceptions.hpp"
 #include "geometry/geometry.hpp"
+#include "geometry/sfc.hpp"
 #include "selectors/bool_maybe.hpp"
 #include "selectors/selectors.hpp"
 #include "trees/kvtree_data_structure.hpp"
+#include "trees/kvtree_node_store.hpp"
 #include "trees/kvtree_v2.hpp"
+#include "trees/lazy_kvtree.hpp"
+#include "trees/memoisation/bounded_cache.hpp"
+#include "trees/memoisation/cache_stats.hpp"
+#include "utils/parallel.hpp"
 #include "utils/print_utils.hpp"
 #include "utils/utils.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <functional>
@@ -41,6 +48,12 @@ public:
 private:
   NodeType make_leaf();
   NodeType make_node();
+  /** The subtrees of all the trees produced by the factory
+   *  are interned in the store. */
+  KVTreePv2<NodeType> mtkv(const NodeType n,
+                           const decltype(KVTree<NodeType>::children) &v) {
+    return store.mtkv(n, v);
+  }
   KVTreePv2<NodeType> tree_product2(const KVTreePv2<NodeType> &t1,
                                     const KVTreePv2<NodeType> &t2);
   vector<int> sub_level_ordering(const vector<int> &level_ordering);
@@ -58,18 +71,26 @@ private:
   template <class F>
   KVTreePv2<NodeType> renumber_children(const KVTreePv2<NodeType> t, F f) {
     decltype(KVTree<NodeType>::children) children;
-    auto tchildren = t->children;
+    const auto &tchildren = t->children;
+    auto new_subtrees = tasks.map(tchildren.size(), [&](int i) {
+      return f(tchildren[i].second);
+    });
     children.reserve(tchildren.size());
     for (auto i = 0; i != tchildren.size(); ++i) {
-      children.push_back({{i}, f(tchildren[i].second)});
+      children.push_back({{i}, new_subtrees[i]});
     }
     return mtkv(t->n, children);
   }
 
+  // Independent subtrees are built in parallel using this.
+  TaskPool tasks;
+
   // Caches for memoisation
-  KVTreePv2<NodeType> _select_subtree(const KVTreePv2<NodeType> t, //
-                                      std::vector<int> idx_above,  //
+  template <class Tree>
+  KVTreePv2<NodeType> _select_subtree(const Tree &t,              //
+                                      std::vector<int> idx_above, //
                                       Predicate &p);
+  KVTreePv2<NodeType> materialise(const KVTreePv2<NodeType> &t) { return t; }
 
 public:
   // These are public only to expose it conveniently during the tests,
@@ -78,84 +99,94 @@ public:
   // and with which arguments.
   // TODO: determine whether it is really needed to have these public
   //       or not.
+  /** Identical subtrees are stored only once,
+   *  so the caches below are effectively keyed by structure. */
+  NodeStore<NodeType> store;
   struct Cache {
-    std::map<KVTreePv2<NodeType>, KVTreePv2<NodeType>> renumber;
-
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int,                 // level
-                        int,                 // nparts
-                        int,                 // halo
-                        int,                 // existing_halo
-                        BoundaryCondition>,  // bc
-             KVTreePv2<NodeType>>
+    ShardedCache<KVTreePv2<NodeType>, KVTreePv2<NodeType>> renumber;
+
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int,                 // level
+                            int,                 // nparts
+                            int,                 // halo
+                            int,                 // existing_halo
+                            BoundaryCondition>,  // bc
+                 KVTreePv2<NodeType>>
         qh;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int,                 // level
-                        int>,                // halosize
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int,                 // level
+                            int>,                // halosize
+                 KVTreePv2<NodeType>>
         bb;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int,                 // level
-                        int>,                // halosize
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int,                 // level
+                            int>,                // halosize
+                 KVTreePv2<NodeType>>
         hbb;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int,                 // levelstart
-                        int>,                // levelend
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int,                 // levelstart
+                            int>,                // levelend
+                 KVTreePv2<NodeType>>
         flatten;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int,                 // levelstart
-                        int>,                // padding
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int,                 // levelstart
+                            int>,                // padding
+                 KVTreePv2<NodeType>>
         collect_leaves;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int>,                // level
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int>,                // level
+                 KVTreePv2<NodeType>>
         eo_naive;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int,                 // level
-                        vector<int>>,        // index_map
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int,                 // level
+                            sfc::Curve>,         // curve
+                 KVTreePv2<NodeType>>
+        sfc_reorder;
+
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int,                 // level
+                            vector<int>>,        // index_map
+                 KVTreePv2<NodeType>>
         remap_level;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        vector<int>>,        // new_level_ordering
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            vector<int>>,        // new_level_ordering
+                 KVTreePv2<NodeType>>
         swap_levels;
 
     // THIS MIGHT NOT BE USEFUL AT ALL
-    std::map<std::tuple<KVTreePv2<NodeType>, // t
-                        int>,                // level
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // t
+                            int>,                // level
+                 KVTreePv2<NodeType>>
         bring_level_on_top;
 
-    std::map<std::tuple<KVTreePv2<NodeType>, // tree
-                        int,                 // level to collapse
-                        const vector<int>    // child key to replace
-                        >,
-             KVTreePv2<NodeType>>
+    ShardedCache<std::tuple<KVTreePv2<NodeType>, // tree
+                            int,                 // level to collapse
+                            const vector<int>    // child key to replace
+                            >,
+                 KVTreePv2<NodeType>>
         collapse_level;
   } cache;
   struct CallCounter {
     struct Counts {
-      int renumber = 0;
-      int qh = 0;
-      int bb = 0;
-      int hbb = 0;
-      int flatten = 0;
-      int collect_leaves = 0;
-      int eo_naive = 0;
-      int remap_level = 0;
-      int swap_levels = 0;
-      int bring_level_on_top = 0;
-      int collapse_level = 0;
+      std::atomic<int> renumber{0};
+      std::atomic<int> qh{0};
+      std::atomic<int> bb{0};
+      std::atomic<int> hbb{0};
+      std::atomic<int> flatten{0};
+      std::atomic<int> collect_leaves{0};
+      std::atomic<int> eo_naive{0};
+      std::atomic<int> sfc_reorder{0};
+      std::atomic<int> remap_level{0};
+      std::atomic<int> swap_levels{0};
+      std::atomic<int> bring_level_on_top{0};
+      std::atomic<int> collapse_level{0};
     } total, cached;
 
   } callcounter;
@@ -170,6 +201,21 @@ public:
                  const vector<int> &child_key_to_replace);
 
   void print_diagnostics();
+  /** Bounds the number of entries of each of the caches above,
+   *  separately: the budget is per cache and counts entries, not bytes,
+   *  so in total there are at most (number of caches) * budget entries.
+   *  The trees that an entry refers to are released with it,
+   *  unless they are still in use
+   *  (the store keeps only weak references to them).
+   *  0, the default, means no bound.
+   *  Entries that have not been used recently are evicted first. */
+  void set_cache_budget(std::size_t max_entries_per_cache);
+  /** All the methods can be called concurrently.
+   *  In addition, the recursive transformations
+   *  (e.g., tree_product, qh, hbb, eo_fix)
+   *  build independent subtrees in parallel using up to nthreads threads.
+   *  The default is 1 (no additional threads). */
+  void set_max_threads(int nthreads);
   KVTreePv2<NodeType> generate_flat_level(int size);
 
   /** Renumbers subtrees recursively.
@@ -323,6 +369,29 @@ public:
           const std::function<vector<vector<int>>(vector<int>)> &transform,
           const vector<int> &levels_reference);
 
+  /** The parity of the origin of the subtree t
+   *  at the level fixed by eo_fix, with indices idx_above,
+   *  i.e. the parity of the first site of its first child,
+   *  which eo_fix uses to decide whether to swap the children.
+   *  transform and levels_reference are the same as in eo_fix.
+   *  Throws std::invalid_argument if transform does not give
+   *  exactly one result for that site (e.g., for padding). */
+  static int eo_origin_parity(
+      const KVTreePv2<NodeType> t, const vector<int> &idx_above,
+      const std::function<vector<vector<int>>(vector<int>)> &transform,
+      const vector<int> &levels_reference);
+
+  /** Reorders the children of the nodes at the given level
+   * along a space filling curve.
+   * As in eo_naive, the keys of the children
+   * (e.g., the coordinates put together by flatten)
+   * are taken as the coordinates of the points,
+   * relative to their minimum in each node.
+   * All the keys in a node must have the same length.
+   * Uses recursion. */
+  KVTreePv2<NodeType> sfc_reorder(const KVTreePv2<NodeType> t, int level,
+                                  sfc::Curve curve);
+
   /** Remaps keys in a level, allowing duplications and deletions. */
   KVTreePv2<NodeType> remap_level(const KVTreePv2<NodeType> t, int level,
                                   vector<int> index_map);
@@ -331,6 +400,36 @@ public:
                                   const vector<int> &new_level_ordering);
 
   KVTreePv2<NodeType> select_subtree(const KVTreePv2<NodeType> t, Predicate &);
+
+  /** Lazy versions of generate_nd_tree, renumber_children,
+   *  qh, bb and hbb, with the same arguments and results.
+   *  The children of each node are generated
+   *  only when they are accessed (see LazyKVTree),
+   *  so that the parts of a large tree that are not visited
+   *  (e.g., the subdomains of the other MPI ranks) cost nothing.
+   *  They do not use the caches or the store,
+   *  and can be used after the factory is destroyed. */
+  static LazyKVTreeP<NodeType> lazy_nd_tree(std::vector<int> dimensions);
+  static LazyKVTreeP<NodeType>
+  lazy_renumber_children(const LazyKVTreeP<NodeType> &t);
+  static LazyKVTreeP<NodeType> lazy_qh(const LazyKVTreeP<NodeType> &t, //
+                                       int level,                      //
+                                       int nparts,                     //
+                                       int halo,                       //
+                                       int existing_halo,              //
+                                       BoundaryCondition bc);
+  static LazyKVTreeP<NodeType> lazy_bb(const LazyKVTreeP<NodeType> &t,
+                                       int level, int halo);
+  static LazyKVTreeP<NodeType> lazy_hbb(const LazyKVTreeP<NodeType> &t,
+                                        int level, int halo);
+
+  /** Generates all the nodes of a lazy tree,
+   *  interning them in the store. */
+  KVTreePv2<NodeType> materialise(const LazyKVTreeP<NodeType> &t);
+  /** Only the nodes needed to evaluate the predicate
+   *  and the selected subtrees are generated. */
+  KVTreePv2<NodeType> select_subtree(const LazyKVTreeP<NodeType> t,
+                                     Predicate &);
 };
 
 /** Where all these functions transform an input tree into an output tree,
@@ -338,9 +437,10 @@ public:
  * (that's why it's called 'pullback').
  * */
 
-template <class Value>
-vector<int> index_pullback(const KVTreePv2<Value> &tree,
-                           const vector<int> &in) {
+/* The index functions work on both KVTreePv2 and LazyKVTreeP trees
+ * (in the latter case, only the nodes on the path are generated). */
+template <class Tree>
+vector<int> index_pullback(const Tree &tree, const vector<int> &in) {
   vector<int> out;
   _index_pullback(tree, in, out);
   return out;
@@ -350,8 +450,8 @@ vector<int> index_pullback(const KVTreePv2<Value> &tree,
  * where padding creates some new leaves
  * that have no correspondence in the old tree.
  * In that case we return an empty vector.  */
-template <class Value>
-vector<vector<int>> index_pullback_safe(const KVTreePv2<Value> &tree,
+template <class Tree>
+vector<vector<int>> index_pullback_safe(const Tree &tree,
                                         const vector<int> &in) {
   vector<vector<int>> out;
   auto out_temp = index_pullback(tree, in);
@@ -369,32 +469,33 @@ static inline void throw_index_pullback_error(int key, int size) {
   throw KeyNotFoundError(ss.str());
 }
 
-template <class Value>
-void _index_pullback(const KVTreePv2<Value> &tree, //
-                     const vector<int> &in,        //
+template <class Tree>
+void _index_pullback(const Tree &tree,      //
+                     const vector<int> &in, //
                      vector<int> &out) {
   if (in.size() == 0)
     return;
 
+  const auto &tchildren = children(tree);
   int idx = in[0];
-  if (idx == TreeFactory::no_key or idx >= tree->children.size()) {
-    throw_index_pullback_error(idx, tree->children.size());
+  if (idx == TreeFactory::no_key or idx >= tchildren.size()) {
+    throw_index_pullback_error(idx, tchildren.size());
   }
 
   {
-    vector<int> key = tree->children[idx].first;
+    vector<int> key = tchildren[idx].first;
     std::copy(key.begin(), key.end(), //
               std::back_inserter(out));
   }
-  auto subtree = tree->children[idx].second;
+  auto subtree = tchildren[idx].second;
 
   _index_pullback(subtree, tail(in), out); // TCO, hopefully
 }
 /* This function checks the keys in the tree
  * and returns the index that matches that.
  * There might be more than one match */
-template <class Value>
-vector<vector<int>> index_pushforward(const KVTreePv2<Value> &tree,
+template <class Tree>
+vector<vector<int>> index_pushforward(const Tree &tree,
                                       const vector<int> &in) {
 
   vector<vector<int>> sub_results;
@@ -402,15 +503,16 @@ vector<vector<int>> index_pushforward(const KVTreePv2<Value> &tree,
   return sub_results;
 }
 
-template <class Value>
-void _index_pushforward(const KVTreePv2<Value> &tree, //
-                        const vector<int> &in,        //
-                        vector<int> &&result,         //
+template <class Tree>
+void _index_pushforward(const Tree &tree,      //
+                        const vector<int> &in, //
+                        vector<int> &&result,  //
                         vector<vector<int>> &all_results) {
   if (in.size() == 0)
     all_results.push_back(result);
   else {
-    int keylen = tree->children[0].first.size();
+    const auto &tchildren = children(tree);
+    int keylen = tchildren[0].first.size();
     vector<int> key;
     vector<int> other_indices;
     { // splitting 'in' in key and other_indices
@@ -422,15 +524,15 @@ void _index_pushforward(const KVTreePv2<Value> &tree, //
                 std::back_inserter(other_indices));
     }
 
-    const int matches = std::count_if(tree->children.begin(), //
-                                      tree->children.end(),   //
+    const int matches = std::count_if(tchildren.begin(), //
+                                      tchildren.end(),   //
                                       [key](auto c) { return c.first == key; });
 
     int match_count = 0;
-    for (auto c = tree->children.begin(); c != tree->children.end(); ++c) {
+    for (auto c = tchildren.begin(); c != tchildren.end(); ++c) {
       if (c->first == key) {
         match_count++;
-        int idx = (int)(c - tree->children.begin());
+        int idx = (int)(c - tchildren.begin());
         if (match_count < matches) { // need to create new result
           vector<int> result_copy;
           result_copy = vector<int>(result);
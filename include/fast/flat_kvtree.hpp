@@ -0,0 +1,86 @@
+#ifndef FAST_FLAT_KVTREE_H_
+#define FAST_FLAT_KVTREE_H_
+#include "geometry/geometry.hpp"
+#include "selectors/partition_predicates.hpp"
+#include "trees/partition_tree.hpp"
+#include "trees/partition_tree_allocations.hpp"
+
+namespace hypercubes {
+namespace fast {
+namespace internals {
+
+using slow::Indices;
+using slow::PartitionPredicate;
+using std::vector;
+
+/** A key-value tree of ints stored level by level,
+ *  in contiguous arrays instead of a TreeP<std::pair<int,int>>.
+ *  The nodes of each level are numbered from 0,
+ *  the children of node i of level l are the nodes
+ *  children[child_start[i]], ... children[child_start[i+1]-1]
+ *  of level l+1.
+ *  A node can be the child of many nodes,
+ *  so that subtrees that are shared in the TreeP version
+ *  (e.g., because of memoisation) are stored only once. */
+struct FlatKVTree {
+  struct Level {
+    vector<int> keys;
+    vector<int> values;
+    vector<int> child_start{0};
+    vector<int> children;
+
+    int size() const;
+    int nchildren(int node) const;
+  };
+  vector<Level> levels;
+
+  /** Appends a node to the given level and returns its number.
+   *  The children must have been added already to level+1. */
+  int add_node(int level, int key, int value, const vector<int> &children);
+};
+
+/** A node in a FlatKVTree. */
+struct NodeRef {
+  int level;
+  int node;
+};
+
+/** Follows the keys in idxs from the given node.
+ *  Throws KeyNotFoundError if a key is not found. */
+NodeRef find_node(const FlatKVTree &t, NodeRef root, const Indices &idxs);
+NodeRef find_node(const FlatKVTree &t, NodeRef root, const int *idxs,
+                  int nidxs);
+
+/** The sites of a partition tree (with value 1 in the leaves),
+ *  with the position of each child as key
+ *  (same as get_skeleton_tree). */
+FlatKVTree get_skeleton_tree(const slow::internals::PartitionTree &t);
+
+/** Same as slow::internals::prune_tree.
+ *  The predicate is called with the positions of the children
+ *  (not the keys), as in the slow version. */
+FlatKVTree prune_tree(const FlatKVTree &t, NodeRef root,
+                      const PartitionPredicate &predicate);
+
+/** Same as slow::internals::get_size_tree. */
+FlatKVTree get_size_tree(const FlatKVTree &skeleton_tree, NodeRef root);
+
+/** Same as slow::internals::get_offset_tree. */
+FlatKVTree get_offset_tree(const FlatKVTree &size_tree, NodeRef root);
+
+/** The indices of the leaf of an offset tree
+ *  with the given offset (minus shift).
+ *  Throws KeyNotFoundError if there is no such leaf. */
+Indices get_indices(const FlatKVTree &offset_tree, NodeRef root, int offset);
+
+/** Conversions from/to the slow tree representation.
+ *  Shared subtrees stay shared. */
+FlatKVTree from_kvtree(const slow::internals::KVTreeP<int> &t);
+slow::internals::KVTreeP<int> to_kvtree(const FlatKVTree &t, NodeRef root,
+                                        int value_shift = 0);
+
+} // namespace internals
+} // namespace fast
+} // namespace hypercubes
+
+#endif // FAST_FLAT_KVTREE_H_
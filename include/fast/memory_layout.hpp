@@ -0,0 +1,126 @@
+#ifndef FAST_MEMORY_LAYOUT_H_
+#define FAST_MEMORY_LAYOUT_H_
+#include "api/memory_layout.hpp"
+#include "fast/flat_kvtree.hpp"
+#include <memory>
+
+/* Same classes and methods as in api/memory_layout.hpp,
+ * with the skeleton, size and offset trees
+ * stored in per-level arrays (see fast/flat_kvtree.hpp).
+ * The results are the same as in the slow namespace,
+ * so that one can switch between the two with a typedef.
+ * Subtrees share the arrays with the whole tree,
+ * get_internal() builds the corresponding slow tree. */
+namespace hypercubes {
+namespace fast {
+
+using slow::Coordinates;
+using slow::Indices;
+using slow::PartitionPredicate;
+using slow::PartList;
+using slow::Sizes;
+using std::vector;
+
+class PartitionTree;
+class SkeletonTree;
+class SizeTree;
+class OffsetTree;
+
+class OffsetTree {
+private:
+  vector<std::string> level_names;
+  std::shared_ptr<const internals::FlatKVTree> offset_tree;
+  internals::NodeRef root;
+  int offset_shift;
+
+  OffsetTree(std::shared_ptr<const internals::FlatKVTree> _ot,
+             internals::NodeRef _root, int _offset_shift,
+             vector<std::string> &&_level_names);
+
+public:
+  OffsetTree(const SizeTree &);
+  vector<std::string> get_level_names() const;
+  // Careful: indices are assumed to be ordered properly.
+  int get_offset(const Indices &) const;
+  Indices get_indices(int) const;
+  /* Same as get_offset for many elements at once:
+   * the indices of element i are idxs[i*idx_size, (i+1)*idx_size). */
+  void get_offsets(const int *idxs, int nindices, int idx_size,
+                   int *offsets) const;
+  // Careful: indices are assumed to be ordered properly.
+  OffsetTree get_subtree(const Indices &idxs) const;
+  OffsetTree shift(int shift) const;
+  const slow::internals::KVTreeP<int> get_internal() const;
+};
+
+class SizeTree {
+private:
+  vector<std::string> level_names;
+  std::shared_ptr<const internals::FlatKVTree> size_tree;
+  internals::NodeRef root;
+
+  SizeTree(std::shared_ptr<const internals::FlatKVTree> _st,
+           internals::NodeRef _root, vector<std::string> &&_level_names);
+
+public:
+  SizeTree(const SkeletonTree &);
+  vector<std::string> get_level_names() const;
+  // Careful: indices are assumed to be ordered properly.
+  SizeTree get_subtree(const Indices &idxs) const;
+  // Careful: indices are assumed to be ordered properly.
+  int get_size(const Indices &idxs) const;
+  const slow::internals::KVTreeP<int> get_internal() const;
+  OffsetTree offset_tree() const;
+  friend OffsetTree::OffsetTree(const SizeTree &);
+};
+
+class SkeletonTree {
+private:
+  vector<std::string> level_names;
+  std::shared_ptr<const internals::FlatKVTree> skeleton_tree;
+  internals::NodeRef root;
+
+  SkeletonTree(std::shared_ptr<const internals::FlatKVTree> _st,
+               internals::NodeRef _root, vector<std::string> &&_ln);
+
+public:
+  SkeletonTree(const PartitionTree &pt);
+  vector<std::string> get_level_names() const;
+  // Goes through the slow tree representation.
+  SkeletonTree permute(const vector<std::string> &_permuted_level_names) const;
+  SkeletonTree prune(const PartitionPredicate &) const;
+  // Careful: indices are assumed to be ordered properly.
+  int get_nchildren(const Indices &) const;
+  // Careful: indices are assumed to be ordered properly.
+  SkeletonTree get_subtree(const Indices &idxs) const;
+  const slow::internals::KVTreeP<int> get_internal() const;
+  SizeTree size_tree() const;
+  friend SizeTree::SizeTree(const SkeletonTree &);
+};
+
+/* The partition tree is a tree of partitioning objects,
+ * which are shared with the slow implementation. */
+class PartitionTree {
+private:
+  slow::PartitionTree partition_tree;
+
+public:
+  PartitionTree(Sizes, PartList, vector<int> nonspatial_indices);
+  vector<std::string> get_level_names() const;
+  Sizes get_sizes() const;
+  Indices get_indices(const Coordinates &) const;
+  // Number of indices returned by get_indices.
+  int get_indices_size() const;
+  // See slow::PartitionTree::get_indices.
+  void get_indices(slow::partitioning::CoordinateBlock &, int *indices) const;
+  vector<std::pair<int, Indices>> get_indices_wg(const Coordinates &) const;
+  // Careful: indices are assumed to be ordered properly.
+  Coordinates get_coordinates(const Indices &) const;
+  SkeletonTree skeleton_tree() const;
+  const slow::internals::PartitionTree get_internal() const;
+};
+
+} // namespace fast
+} // namespace hypercubes
+
+#endif // FAST_MEMORY_LAYOUT_H_
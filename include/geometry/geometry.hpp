@@ -1,6 +1,7 @@
 #ifndef GEOMETRY_H_
 #define GEOMETRY_H_
 #include "int_vec_wrappers.hpp"
+#include "utils/hash_utils.hpp"
 #include <ostream>
 #include <vector>
 
@@ -42,6 +43,11 @@ using PartInfosD = vector<vector<PartInfo>>;
 
 bool operator<(PartInfo p1, PartInfo p2);
 bool operator==(PartInfo p1, PartInfo p2);
+inline std::size_t hash_value(PartInfo p) {
+  std::size_t seed = std::hash<int>()(p.size);
+  hash_combine(seed, std::hash<int>()(p.parity));
+  return seed;
+}
 bool operator==(IndexResult i1, IndexResult i2);
 
 Coordinates up(Coordinates coords, //
@@ -51,6 +51,7 @@ class Indices {
   INTVEC_BOILERPLATE(Indices, idxs)
 
   void push_back(int);
+  void pop_back();
   friend Indices append(int, const Indices &);
   friend Indices tail(const Indices &);
 };
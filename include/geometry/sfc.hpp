@@ -0,0 +1,40 @@
+#ifndef SFC_H_
+#define SFC_H_
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace hypercubes {
+namespace slow {
+/** Space filling curves.
+ *  Boxes whose extents are not powers of two
+ *  are embedded in the smallest enclosing box with power-of-two sides,
+ *  and their points are visited in the order of the curve in that box. */
+namespace sfc {
+
+using IntList = std::vector<int>;
+
+enum Curve { MORTON, HILBERT };
+std::ostream &operator<<(std::ostream &os, Curve c);
+
+/** Number of bits needed to represent the coordinates in [0,extent). */
+int bits_for(int extent);
+
+/** Position of the point x along the curve
+ *  in a box of side 2^bits in every dimension.
+ *  In the Morton order the last dimension is the fastest running one.
+ *  Throws if x.size() * bits does not fit in 64 bits. */
+std::uint64_t morton_key(const IntList &x, int bits);
+std::uint64_t hilbert_key(const IntList &x, int bits);
+std::uint64_t curve_key(Curve c, const IntList &x, int bits);
+
+/** The points of a box with the given sizes, in the order of the curve.
+ *  Points are given as lexicographic indices
+ *  (first dimension fastest, as in eo::lex_idx_to_coord). */
+IntList curve_order(const IntList &sizes, Curve c);
+
+} // namespace sfc
+} // namespace slow
+} // namespace hypercubes
+
+#endif // SFC_H_
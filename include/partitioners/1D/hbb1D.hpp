@@ -14,6 +14,7 @@ public:
   int max_idx_value() const;
   std::string comments() const;
   std::vector<IndexResult> coord_to_idxs(int relative_x) const;
+  void coord_to_real_idxs(int *x, int *idx, int n) const;
 
 private:
   int halo;
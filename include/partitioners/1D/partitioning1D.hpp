@@ -24,6 +24,10 @@ public:
   std::string get_name() const;
   virtual std::string comments() const = 0;
   virtual vector<IndexResult> coord_to_idxs(int relative_x) const = 0;
+  /** Batch version of coord_to_idxs for n points,
+   *  see IPartitioning::coord_to_real_idxs.
+   *  The coordinates in x are replaced by the rests. */
+  virtual void coord_to_real_idxs(int *x, int *idx, int n) const;
 
 protected:
   int size;
@@ -44,6 +44,15 @@ public:
                       });
   };
 
+  void coord_to_real_idxs(CoordinateBlock &coords, //
+                          int begin,               //
+                          int end,                 //
+                          int *idx) const {
+    wrapped.coord_to_real_idxs(coords.x[dimension].data() + begin, //
+                               idx + begin,                        //
+                               end - begin);
+  }
+
   const int dimension;
   int dimensionality() const { return spd.size(); };
 
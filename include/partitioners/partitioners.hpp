@@ -7,6 +7,7 @@
 #include "dimensionalise.hpp"
 #include "eo_partitioning.hpp"
 #include "partitioning.hpp"
+#include "sfc_partitioning.hpp"
 #include "site.hpp"
 #include <memory>
 #include <string>
@@ -38,6 +39,17 @@ private:
   hypercubes::slow::partitioning::EO *get(PartInfoD sp) const;
 };
 
+using DimFlags = hypercubes::slow::partitioning::SFC::DimFlags;
+class SFC : public IPartitioner {
+public:
+  SFC(std::string name, DimFlags dimflags, sfc::Curve curve);
+
+private:
+  DimFlags dimflags;
+  sfc::Curve curve;
+  hypercubes::slow::partitioning::SFC *get(PartInfoD sp) const;
+};
+
 class Site : public IPartitioner {
 public:
   Site();
@@ -91,6 +103,8 @@ namespace partitioner_makers {
 
 using CBFlags = hypercubes::slow::partitioning::EO::CBFlags;
 IPartRP EO(std::string name, CBFlags cbflags);
+using DimFlags = hypercubes::slow::partitioning::SFC::DimFlags;
+IPartRP SFC(std::string name, DimFlags dimflags, sfc::Curve curve);
 IPartRP Site();
 IPartRP QPeriodic(std::string name, int dimension, int nparts);
 IPartRP QOpen(std::string name, int dimension, int nparts);
@@ -8,6 +8,15 @@ namespace hypercubes {
 namespace slow {
 namespace partitioning {
 
+/** Coordinates of many points, in structure-of-arrays layout:
+ *  x[d][i] is the coordinate of point i in dimension d.
+ *  The batch functions replace the coordinates with the "rest",
+ *  and might add a dimension (see EO). */
+struct CoordinateBlock {
+  vector<vector<int>> x;
+  int size() const { return x.size() == 0 ? 0 : x[0].size(); }
+};
+
 class IPartitioning {
 public:
   virtual Coordinates idx_to_coords(int idx,
@@ -21,6 +30,16 @@ public:
   virtual std::string comments() const = 0;
   virtual vector<IndexResultD>
   coord_to_idxs(const Coordinates &coord) const = 0;
+  /** Batch version of coord_to_idxs, for the points in [begin,end).
+   *  Only the result that is not a ghost is computed:
+   *  its index is written in idx[i]
+   *  and the coordinates of point i in the block are replaced by the rest.
+   *  If there is no such result, idx[i] is set to -1.
+   *  The default implementation calls coord_to_idxs on each point. */
+  virtual void coord_to_real_idxs(CoordinateBlock &coords, //
+                                  int begin,               //
+                                  int end,                 //
+                                  int *idx) const;
   virtual int dimensionality() const = 0;
 };
 
@@ -0,0 +1,54 @@
+#ifndef SFC_PARTITIONING_H_
+#define SFC_PARTITIONING_H_
+#include "geometry/geometry.hpp"
+#include "geometry/sfc.hpp"
+#include "partitioning.hpp"
+#include <tuple>
+
+namespace hypercubes {
+namespace slow {
+namespace partitioning {
+
+/** Splits the selected dimensions into single sites,
+ *  numbered in the order of a space filling curve.
+ *  The other dimensions are left untouched.
+ *  The extents do not need to be powers of two (see sfc::curve_order). */
+class SFC : public IPartitioning {
+public:
+  using DimFlags = vector<bool>;
+
+  SFC(const PartInfoD &sp_, const DimFlags &dimflags_, sfc::Curve curve_,
+      const std::string &name_);
+  Coordinates idx_to_coords(int idx, const Coordinates &offset) const;
+  PartInfosD sub_partinfo_kinds() const;
+  int idx_to_partinfo_kind(int idx) const;
+  int max_idx_value() const;
+  std::string get_name() const;
+  std::string comments() const;
+  vector<IndexResultD> coord_to_idxs(const Coordinates &coord) const;
+  void coord_to_real_idxs(CoordinateBlock &coords, //
+                          int begin,               //
+                          int end,                 //
+                          int *idx) const;
+  int dimensionality() const;
+
+private:
+  const PartInfoD spd;
+  const DimFlags dimflags;
+  const sfc::Curve curve;
+  const std::string name;
+
+  vector<int> sizes, cumsizes; // of the selected dimensions
+  vector<int> order;           // curve position -> lexicographic index
+  vector<int> position;        // lexicographic index -> curve position
+  PartInfosD kinds;
+  vector<int> kind_of_idx;
+
+  void check_idx(int idx) const;
+  auto key() const { return std::make_tuple(spd, dimflags, curve, name); }
+};
+} // namespace partitioning
+} // namespace slow
+} // namespace hypercubes
+
+#endif // SFC_PARTITIONING_H_
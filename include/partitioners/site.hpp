@@ -20,6 +20,10 @@ public:
   std::string get_name() const;
   std::string comments() const;
   vector<IndexResultD> coord_to_idxs(const Coordinates &coord) const;
+  void coord_to_real_idxs(CoordinateBlock &coords, //
+                          int begin,               //
+                          int end,                 //
+                          int *idx) const;
   int dimensionality() const;
 
 private:
@@ -0,0 +1,73 @@
+#ifndef FLAT_OFFSET_TREE_H_
+#define FLAT_OFFSET_TREE_H_
+#include "geometry/geometry.hpp"
+#include "tree_data_structure.hpp"
+#include <utility>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+/** A flat, read-only copy of an offset tree
+ *  (a TreeP<pair<key, start offset>>, see get_offset_tree),
+ *  for lookups that do not allocate or search linearly.
+ *  Node 0 is the root, the children of node i are the entries
+ *  [child_start[i], child_start[i+1]) of keys and child_node,
+ *  offsets[i] is the start offset of node i.
+ *  When stride[i] > 0, the keys of the children of node i
+ *  are 0, 1, ... nchildren-1 and child k starts at
+ *  offsets[i] + k * stride[i], so that both directions
+ *  need no search (the offset is a dot product of keys and strides).
+ *  Otherwise (e.g., HBB levels or pruned trees)
+ *  a binary search is used.
+ *  When sites_in_leaves is true, the leaves are partitions
+ *  that contain several sites, and the last index
+ *  is the position of the site in the leaf
+ *  (as in get_offset and get_indices in partition_tree_allocations).
+ *  Otherwise the leaves are the sites (as in the OffsetTree class). */
+struct FlatOffsetTree {
+  vector<int> child_start;
+  vector<int> keys;
+  vector<int> child_node;
+  vector<int> offsets;
+  vector<int> stride;
+  vector<bool> sorted_keys;
+  bool sites_in_leaves = false;
+
+  int nnodes() const;
+  int nchildren(int node) const;
+};
+
+FlatOffsetTree flatten_offset_tree(const TreeP<std::pair<int, int>> &tree,
+                                   bool sites_in_leaves);
+
+/** Throws KeyNotFoundError if the indices are not in the tree.
+ *  Partial indices give the start offset of the subtree. */
+int get_offset(const FlatOffsetTree &tree, const int *idxs, int nidxs);
+int get_offset(const FlatOffsetTree &tree, const Indices &idxs);
+
+/** Batch version: the indices of element i are
+ *  idxs[i*idx_size, (i+1)*idx_size). */
+void get_offsets(const FlatOffsetTree &tree, //
+                 const int *idxs,            //
+                 int nindices,               //
+                 int idx_size,               //
+                 int *offsets);
+
+/** Throws KeyNotFoundError if the offset is not in the tree. */
+Indices get_indices(const FlatOffsetTree &tree, int offset);
+/** Same as above, in the subtree starting at 'node'
+ *  (offsets are still relative to the whole tree). */
+Indices get_indices(const FlatOffsetTree &tree, int node, int offset);
+
+/** The node reached from 'node' following the keys in idxs.
+ *  The last index is never a site in a leaf (see sites_in_leaves).
+ *  Throws KeyNotFoundError if the keys are not in the tree. */
+int find_node(const FlatOffsetTree &tree, int node, const int *idxs,
+              int nidxs);
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // FLAT_OFFSET_TREE_H_
@@ -311,6 +311,27 @@ Indices search_in_sorted_tree(const KVTreeP<SortableValue> &tree,
   return _search(tree, x, res, _search);
 }
 
+/* The keys along the path to each leaf, with the value of the leaf,
+ * in the order of the tree. */
+template <class Value>
+vector<std::pair<Indices, Value>> get_leaves_kv(const KVTreeP<Value> &tree) {
+  vector<std::pair<Indices, Value>> res;
+  vector<int> path;
+  auto _leaves = [&res, &path](const KVTreeP<Value> &t, auto frec) -> void {
+    if (t->children.size() == 0) {
+      res.push_back({Indices(path), t->n.second});
+      return;
+    }
+    for (const auto &c : t->children) {
+      path.push_back(c->n.first);
+      frec(c, frec);
+      path.pop_back();
+    }
+  };
+  _leaves(tree, _leaves);
+  return res;
+}
+
 } // namespace internals
 } // namespace slow
 } // namespace hypercubes
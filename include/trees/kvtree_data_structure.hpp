@@ -19,14 +19,22 @@ template <class> struct KVTree;
 template <class Node> using KVTreePv2 = shared_ptr<const KVTree<Node>>;
 
 template <class Node> struct KVTree {
+  using Children = vector<pair<const vector<int>, KVTreePv2<Node>>>;
   Node n;
-  vector<pair<const vector<int>, KVTreePv2<Node>>> children;
+  Children children;
   bool operator!=(const KVTree &other) const {
+    if (this == &other) // e.g., interned trees
+      return false;
     if (n != other.n)
       return true;
     if (children.size() != other.children.size())
       return true;
     for (int i = 0; i < children.size(); ++i) {
+      if (children[i].second == other.children[i].second) {
+        if (children[i].first != other.children[i].first)
+          return true;
+        continue; // shared subtree
+      }
       if (children[i].first != other.children[i].first or //
           (children[i].second == NULL and
            other.children[i].second != NULL) or //
@@ -0,0 +1,178 @@
+#ifndef KVTREE_NODE_STORE_H_
+#define KVTREE_NODE_STORE_H_
+#include "kvtree_data_structure.hpp"
+#include "utils/hash_utils.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+/** Hash-consing store for KVTree nodes.
+ *  The children of the nodes created through a store are interned:
+ *  structurally identical subtrees are stored only once
+ *  and are represented by the same pointer,
+ *  so that comparing them is a pointer comparison.
+ *  The node returned by mtkv is instead a new object,
+ *  as the identity of the root of a tree is meaningful
+ *  (e.g., in TransformNetwork). It is interned
+ *  only when it becomes a child of another node or when intern() is called,
+ *  and it becomes the canonical copy if there was none.
+ *  Each canonical node gets a 32-bit id, in order of interning
+ *  (children always have smaller ids than parents).
+ *  The store only keeps weak references to the canonical nodes:
+ *  a node is released as soon as no tree or cache refers to it
+ *  (so its memory is bounded by the caches of the TreeFactory),
+ *  and a structurally identical node created later
+ *  becomes a new canonical copy, with a new id.
+ *  The entries of the released nodes are dropped from time to time,
+ *  so that the size of the store stays proportional
+ *  to the number of live nodes.
+ *  All the methods are thread-safe. */
+template <class Node> class NodeStore {
+public:
+  using Id = std::uint32_t;
+  using Children = decltype(KVTree<Node>::children);
+
+  /** Same as the free function mtkv,
+   *  but with interned children. */
+  KVTreePv2<Node> mtkv(const Node n, const Children &children) {
+    Children canonical_children;
+    {
+      std::lock_guard<std::mutex> lock(m);
+      canonical_children = intern_children(children);
+    }
+    return internals::mtkv(n, std::move(canonical_children));
+  }
+
+  /** Returns the canonical copy of a tree,
+   *  which might have been created outside of the store. */
+  KVTreePv2<Node> intern(const KVTreePv2<Node> &t) {
+    std::lock_guard<std::mutex> lock(m);
+    return _intern(t);
+  }
+
+  Id id(const KVTreePv2<Node> &t) {
+    std::lock_guard<std::mutex> lock(m);
+    return ids.at(_intern(t).get());
+  }
+  /** nullptr if the node has been released. */
+  KVTreePv2<Node> operator[](Id i) {
+    std::lock_guard<std::mutex> lock(m);
+    auto it = nodes.find(i);
+    return it == nodes.end() ? nullptr : it->second.lock();
+  }
+  /** The number of live canonical nodes. */
+  int size() {
+    std::lock_guard<std::mutex> lock(m);
+    purge();
+    return nodes.size();
+  }
+
+private:
+  std::mutex m;
+  Id next_id = 0;
+  std::unordered_map<Id, std::weak_ptr<const KVTree<Node>>> nodes;
+  std::unordered_map<const KVTree<Node> *, Id> ids;
+  std::unordered_multimap<std::size_t, Id> ids_by_hash;
+  std::size_t ninterned_since_purge = 0;
+
+  // The private methods assume that the mutex is locked.
+
+  // The canonical node with the given id, nullptr if released.
+  KVTreePv2<Node> live(Id i) {
+    auto it = nodes.find(i);
+    return it == nodes.end() ? nullptr : it->second.lock();
+  }
+
+  // Drops the entries of the released nodes.
+  void purge() {
+    for (auto it = nodes.begin(); it != nodes.end();)
+      it = it->second.expired() ? nodes.erase(it) : std::next(it);
+    for (auto it = ids.begin(); it != ids.end();)
+      it = nodes.count(it->second) ? std::next(it) : ids.erase(it);
+    for (auto it = ids_by_hash.begin(); it != ids_by_hash.end();)
+      it = nodes.count(it->second) ? std::next(it) : ids_by_hash.erase(it);
+    ninterned_since_purge = 0;
+  }
+
+  KVTreePv2<Node> _intern(const KVTreePv2<Node> &t) {
+    if (not t)
+      return t;
+    {
+      // The address of a released node can be reused,
+      // so the node must still be alive.
+      auto it = ids.find(t.get());
+      if (it != ids.end() and live(it->second) == t)
+        return t;
+    }
+    Children children = intern_children(t->children);
+    bool children_canonical = true;
+    for (int i = 0; i < children.size(); ++i)
+      children_canonical = children_canonical and
+                           children[i].second == t->children[i].second;
+
+    std::size_t h = structural_hash(t->n, children);
+    auto range = ids_by_hash.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto candidate = live(it->second);
+      if (candidate and shallow_equal(*candidate, t->n, children))
+        return candidate;
+    }
+    if (ninterned_since_purge >= std::max<std::size_t>(nodes.size() / 2, 64))
+      purge();
+    ++ninterned_since_purge;
+    KVTreePv2<Node> res =
+        children_canonical // t can be the canonical copy
+            ? t
+            : internals::mtkv(t->n, std::move(children));
+    Id new_id = next_id++;
+    nodes[new_id] = res;
+    ids[res.get()] = new_id;
+    ids_by_hash.insert({h, new_id});
+    return res;
+  }
+
+  Children intern_children(const Children &children) {
+    Children res;
+    res.reserve(children.size());
+    for (const auto &c : children)
+      res.push_back({c.first, _intern(c.second)});
+    return res;
+  }
+
+  // Children must be canonical already,
+  // so that they can be hashed and compared by pointer.
+  static std::size_t structural_hash(const Node &n, const Children &children) {
+    std::size_t seed = hash_value(n);
+    for (const auto &c : children) {
+      hash_combine(seed, hash_value(c.first));
+      hash_combine(seed, hash_value(c.second.get()));
+    }
+    return seed;
+  }
+
+  static bool shallow_equal(const KVTree<Node> &t, //
+                            const Node &n,         //
+                            const Children &children) {
+    if (t.n != n or t.children.size() != children.size())
+      return false;
+    for (int i = 0; i < children.size(); ++i)
+      if (t.children[i].second != children[i].second or
+          t.children[i].first != children[i].first)
+        return false;
+    return true;
+  }
+};
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // KVTREE_NODE_STORE_H_
@@ -0,0 +1,79 @@
+#ifndef LAZY_KVTREE_H_
+#define LAZY_KVTREE_H_
+#include "kvtree_data_structure.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+template <class> struct LazyKVTree;
+template <class Node> using LazyKVTreeP = shared_ptr<const LazyKVTree<Node>>;
+
+/** Same as KVTree, but the children are produced by a generator
+ *  the first time they are accessed, and kept afterwards.
+ *  Subtrees that are never visited are never built.
+ *  Accessing the children is thread-safe. */
+template <class Node> struct LazyKVTree {
+  using Children = vector<pair<const vector<int>, LazyKVTreeP<Node>>>;
+  using Generator = std::function<Children()>;
+
+  const Node n;
+
+  LazyKVTree(Node _n, Generator _generator)
+      : n(_n), generator(std::move(_generator)) {}
+  LazyKVTree(Node _n, Children &&_children)
+      : n(_n), _children(std::move(_children)), _expanded(true) {
+    std::call_once(once, [] {});
+  }
+
+  const Children &children() const {
+    std::call_once(once, [this] {
+      _children = generator();
+      generator = nullptr; // releases what the generator holds
+      _expanded = true;
+    });
+    return _children;
+  }
+  bool expanded() const { return _expanded; }
+
+private:
+  mutable std::once_flag once;
+  mutable Children _children;
+  mutable Generator generator;
+  mutable std::atomic<bool> _expanded{false};
+};
+
+template <class Node>
+LazyKVTreeP<Node> mtlkv(const Node n,
+                        typename LazyKVTree<Node>::Generator generator) {
+  return std::make_shared<const LazyKVTree<Node>>(n, std::move(generator));
+}
+template <class Node>
+LazyKVTreeP<Node> mtlkv(const Node n,
+                        typename LazyKVTree<Node>::Children children) {
+  return std::make_shared<const LazyKVTree<Node>>(n, std::move(children));
+}
+
+/** Uniform access to the children of both kinds of trees,
+ *  so that the algorithms that only walk a tree
+ *  can be written once for both. */
+template <class Node>
+const typename KVTree<Node>::Children &children(const KVTreePv2<Node> &t) {
+  return t->children;
+}
+template <class Node>
+const typename LazyKVTree<Node>::Children &
+children(const LazyKVTreeP<Node> &t) {
+  return t->children();
+}
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // LAZY_KVTREE_H_
@@ -0,0 +1,214 @@
+#ifndef BOUNDED_CACHE_H_
+#define BOUNDED_CACHE_H_
+#include "utils/hash_utils.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+/** A hash map with an optional bound on the number of entries,
+ *  with generational eviction.
+ *  New entries go in the current generation.
+ *  When the current generation is full it becomes the old one,
+ *  and the entries in the previous old generation are dropped.
+ *  Entries found in the old generation are moved back
+ *  into the current one, so that entries that are used
+ *  survive as long as they are used.
+ *  With max_size == 0 (the default) there is no bound. */
+template <class Key, class Value> class BoundedCache {
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+
+  BoundedCache(std::size_t max_size = 0) : max_size(max_size) {}
+
+  /** Returns a pointer to the cached value, or nullptr.
+   *  The pointer is valid until the next call to insert(). */
+  const Value *find(const Key &key) {
+    auto it = current.find(key);
+    if (it != current.end())
+      return &it->second;
+    auto old_it = old.find(key);
+    if (old_it == old.end())
+      return nullptr;
+    Value v = std::move(old_it->second);
+    old.erase(old_it);
+    insert(key, std::move(v));
+    return &current.find(key)->second;
+  }
+
+  void insert(const Key &key, Value v) {
+    if (max_size != 0 and current.size() >= generation_size() and
+        current.find(key) == current.end()) {
+      nevicted += old.size();
+      old = std::move(current);
+      current.clear();
+      if (old.size() + generation_size() > max_size) { // no room for it
+        nevicted += old.size();
+        old.clear();
+      }
+    }
+    current[key] = std::move(v);
+  }
+
+  std::size_t size() const { return current.size() + old.size(); }
+  std::size_t evicted() const { return nevicted; }
+  void clear() {
+    current.clear();
+    old.clear();
+  }
+  /** A new bound applies from the next insertion. */
+  void set_max_size(std::size_t s) { max_size = s; }
+
+private:
+  std::size_t max_size;
+  std::size_t nevicted = 0;
+  std::unordered_map<Key, Value, Hash> current;
+  std::unordered_map<Key, Value, Hash> old;
+
+  std::size_t generation_size() const {
+    return max_size / 2 > 0 ? max_size / 2 : 1;
+  }
+};
+
+/** Thread-safe version of BoundedCache.
+ *  Keys are distributed over NSHARDS shards,
+ *  each protected by its own mutex,
+ *  so that threads working on different keys rarely contend.
+ *  The bound is global: the entries of the current generation
+ *  are counted across all the shards,
+ *  and when the count reaches half of the bound
+ *  all the shards start a new generation together. */
+template <class Key, class Value, int NSHARDS = 8> class ShardedCache {
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+
+  ShardedCache(std::size_t max_size = 0) : max_size(max_size) {}
+
+  /** Copies the cached value into 'out' if found. */
+  bool find(const Key &key, Value &out) {
+    auto &shard = get_shard(key);
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(shard.m);
+        auto it = shard.current.find(key);
+        if (it != shard.current.end()) {
+          out = it->second;
+          return true;
+        }
+        auto old_it = shard.old.find(key);
+        if (old_it == shard.old.end())
+          return false;
+        if (reserve()) { // moving it back into the current generation
+          out = old_it->second;
+          shard.current.emplace(key, std::move(old_it->second));
+          shard.old.erase(old_it);
+          return true;
+        }
+      }
+      new_generation();
+    }
+  }
+  /** Does not overwrite existing entries:
+   *  if another thread has inserted a value for the same key,
+   *  that value is returned. */
+  Value insert(const Key &key, const Value &v) {
+    Value existing;
+    if (find(key, existing))
+      return existing;
+    auto &shard = get_shard(key);
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(shard.m);
+        auto it = shard.current.find(key);
+        if (it != shard.current.end())
+          return it->second;
+        if (reserve()) {
+          shard.old.erase(key);
+          shard.current.emplace(key, v);
+          return v;
+        }
+      }
+      new_generation();
+    }
+  }
+
+  std::size_t size() {
+    std::size_t res = 0;
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> lock(shard.m);
+      res += shard.current.size() + shard.old.size();
+    }
+    return res;
+  }
+  std::size_t evicted() { return nevicted.load(); }
+  /** A new bound applies from the next insertion. */
+  void set_max_size(std::size_t s) { max_size = s; }
+
+private:
+  struct Shard {
+    std::mutex m;
+    std::unordered_map<Key, Value, Hash> current;
+    std::unordered_map<Key, Value, Hash> old;
+  };
+  std::array<Shard, NSHARDS> shards;
+  std::atomic<std::size_t> max_size;
+  std::atomic<std::size_t> ncurrent{0}; // entries in the current generation
+  std::atomic<std::size_t> nevicted{0};
+  std::mutex generation_mutex;
+
+  Shard &get_shard(const Key &key) { return shards[Hash()(key) % NSHARDS]; }
+
+  std::size_t generation_size() const {
+    return max_size / 2 > 0 ? max_size / 2 : 1;
+  }
+
+  // Takes a place in the current generation, if there is one left.
+  bool reserve() {
+    if (max_size == 0) {
+      ++ncurrent;
+      return true;
+    }
+    std::size_t n = ncurrent.load();
+    while (n < generation_size())
+      if (ncurrent.compare_exchange_weak(n, n + 1))
+        return true;
+    return false;
+  }
+
+  /** Must be called without holding any shard lock. */
+  void new_generation() {
+    std::lock_guard<std::mutex> lock(generation_mutex);
+    if (ncurrent.load() < generation_size())
+      return; // another thread has done it already
+    for (auto &shard : shards)
+      shard.m.lock();
+    std::size_t nold = 0;
+    for (auto &shard : shards) {
+      nevicted += shard.old.size();
+      shard.old = std::move(shard.current);
+      shard.current.clear();
+      nold += shard.old.size();
+    }
+    if (nold + generation_size() > max_size) // no room for it
+      for (auto &shard : shards) {
+        nevicted += shard.old.size();
+        shard.old.clear();
+      }
+    ncurrent = 0;
+    for (auto &shard : shards)
+      shard.m.unlock();
+  }
+};
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // BOUNDED_CACHE_H_
@@ -0,0 +1,59 @@
+#ifndef CACHE_STATS_H_
+#define CACHE_STATS_H_
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+/** Counters of a cache, as reported by the diagnostics. */
+struct CacheStats {
+  std::size_t size = 0;    // entries currently in the cache
+  std::size_t cached = 0;  // calls answered by the cache
+  std::size_t total = 0;   // all calls
+  std::size_t evicted = 0; // entries dropped because of the bound
+};
+
+/* Table with one line per cache,
+ * used by TreeFactory::print_diagnostics and by the Memoisers. */
+namespace cache_stats_table {
+constexpr int start_colsize = 20;
+constexpr int colsize = 15;
+
+inline void print_header(std::ostream &os) {
+  int len = start_colsize + 5 * colsize;
+  os << std::string(len, '+') << std::endl;
+  os << "CACHE COUNTS" << std::endl;
+  os << std::string(len, '+') << std::endl;
+  os << std::setw(start_colsize) << "TYPE"    //
+     << std::setw(colsize) << "Cache Size"    //
+     << std::setw(colsize) << "Calls: cached" //
+     << std::setw(colsize) << "Calls: total"  //
+     << std::setw(colsize) << "Cached/Total"  //
+     << std::setw(colsize) << "Evicted" << std::endl;
+}
+
+inline void print_line(std::ostream &os, const std::string &name,
+                       const CacheStats &s) {
+  os << std::setw(start_colsize) << name //
+     << std::setw(colsize) << s.size     //
+     << std::setw(colsize) << s.cached   //
+     << std::setw(colsize) << s.total    //
+     << std::setw(colsize)
+     << (s.total == 0 ? 0 : (float)s.cached / s.total) //
+     << std::setw(colsize) << s.evicted << std::endl;
+}
+
+inline void print_footer(std::ostream &os) {
+  os << std::string(4 * colsize, '+') << std::endl;
+}
+} // namespace cache_stats_table
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
+
+#endif // CACHE_STATS_H_
@@ -1,39 +1,133 @@
 #ifndef MEMOISATION_H_
 #define MEMOISATION_H_
+#include "bounded_cache.hpp"
+#include "cache_stats.hpp"
+#include <atomic>
+#include <cstddef>
 #include <functional>
-#include <map>
+#include <iostream>
+#include <string>
 #include <tuple>
 
 namespace hypercubes {
 namespace slow {
 namespace internals {
 
+/** Memoises a recursive function f,
+ *  which receives the memoised version of itself as first argument.
+ *  Results are kept in a hash map keyed by the arguments
+ *  (shared pointers are hashed by address),
+ *  optionally bounded (see BoundedCache).
+ *  Not thread-safe: see ShardedMemoiser and thread_local_memoiser. */
 template <class Out, class... Args> class Memoiser {
 private:
-  std::map<std::tuple<Args...>, Out> cache;
+  BoundedCache<std::tuple<Args...>, Out> cache;
   std::function<Out(std::function<Out(Args...)>, //
                     Args...)>
       f;
+  std::size_t ncached = 0;
+  std::size_t ntotal = 0;
 
 public:
-  template <class FF> Memoiser(FF _f) : f(_f){};
+  template <class FF>
+  Memoiser(FF _f, std::size_t max_size = 0) : cache(max_size), f(_f){};
   Out operator()(Args... input) { return memoised(input...); }
   Out memoised(Args... input) {
+    ++ntotal;
     auto input_key = std::make_tuple(input...);
-    if (cache.find(input_key) == cache.end()) {
-      auto out = f([this](Args... args) { return this->memoised(args...); }, //
-                   input...);
-      cache[input_key] = out;
-    } else {
+    if (const Out *cached = cache.find(input_key)) {
+      ++ncached;
+      return *cached;
     }
-    return cache[input_key];
+    auto out = f([this](Args... args) { return this->memoised(args...); }, //
+                 input...);
+    cache.insert(input_key, out);
+    return out;
   }
   Out nomemo(Args... input) {
     return f([this](Args... inpts) { return nomemo(inpts...); }, //
              input...);
   }
+
+  /** 0 means no bound. */
+  void set_max_size(std::size_t s) { cache.set_max_size(s); }
+  void clear() { cache.clear(); }
+  CacheStats stats() const {
+    CacheStats s;
+    s.size = cache.size();
+    s.cached = ncached;
+    s.total = ntotal;
+    s.evicted = cache.evicted();
+    return s;
+  }
+  /** Same format as TreeFactory::print_diagnostics. */
+  void print_diagnostics(const std::string &name,
+                         std::ostream &os = std::cout) const {
+    cache_stats_table::print_header(os);
+    cache_stats_table::print_line(os, name, stats());
+    cache_stats_table::print_footer(os);
+  }
+};
+
+/** Thread-safe version of Memoiser, based on ShardedCache.
+ *  Two threads asking for the same missing key
+ *  may both compute it, but they get the same result back. */
+template <class Out, class... Args> class ShardedMemoiser {
+private:
+  ShardedCache<std::tuple<Args...>, Out> cache;
+  std::function<Out(std::function<Out(Args...)>, //
+                    Args...)>
+      f;
+  std::atomic<std::size_t> ncached{0};
+  std::atomic<std::size_t> ntotal{0};
+
+public:
+  template <class FF>
+  ShardedMemoiser(FF _f, std::size_t max_size = 0) : cache(max_size), f(_f){};
+  Out operator()(Args... input) { return memoised(input...); }
+  Out memoised(Args... input) {
+    ++ntotal;
+    auto input_key = std::make_tuple(input...);
+    Out out;
+    if (cache.find(input_key, out)) {
+      ++ncached;
+      return out;
+    }
+    out = f([this](Args... args) { return this->memoised(args...); }, //
+            input...);
+    return cache.insert(input_key, out);
+  }
+  Out nomemo(Args... input) {
+    return f([this](Args... inpts) { return nomemo(inpts...); }, //
+             input...);
+  }
+
+  void set_max_size(std::size_t s) { cache.set_max_size(s); }
+  CacheStats stats() {
+    CacheStats s;
+    s.size = cache.size();
+    s.cached = ncached.load();
+    s.total = ntotal.load();
+    s.evicted = cache.evicted();
+    return s;
+  }
+  void print_diagnostics(const std::string &name,
+                         std::ostream &os = std::cout) {
+    cache_stats_table::print_header(os);
+    cache_stats_table::print_line(os, name, stats());
+    cache_stats_table::print_footer(os);
+  }
 };
 
+/** One instance of Memo per thread, kept between calls,
+ *  so that results are reused across calls without locking.
+ *  The keys keep their arguments alive:
+ *  bound the instance with set_max_size if it is used for long. */
+template <class Memo> Memo &thread_local_memoiser() {
+  thread_local Memo memo;
+  return memo;
+}
+
 } // namespace internals
 
 } // namespace slow
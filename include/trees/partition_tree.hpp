@@ -29,6 +29,19 @@ std::string tree_class_repr(const PartitionTree &t,    //
 Indices get_real_indices(const PartitionTree &t, //
                          const Coordinates &xs);
 
+/* Number of indices returned by get_real_indices. */
+int get_real_indices_size(const PartitionTree &t);
+
+/* Batch version of get_real_indices.
+ * The indices of point i are written in
+ * indices[i*nlevels, (i+1)*nlevels), where nlevels = get_real_indices_size(t).
+ * Points that do not belong to the tree get -1 in all the levels
+ * from the first one where they are not found.
+ * The coordinates in the block are overwritten. */
+void get_real_indices_batch(const PartitionTree &t, //
+                            partitioning::CoordinateBlock &xs,
+                            int *indices);
+
 struct GhostResult {
   int idx;
   bool cached_flag;
@@ -2,6 +2,7 @@
 #define SIZE_TREE_ITERATOR_H_
 #include "geometry/geometry.hpp"
 #include "tree.hpp"
+#include <iterator>
 
 namespace hypercubes {
 namespace slow {
@@ -12,6 +13,58 @@ Indices get_start_idxs(const SizeTree &sizetree);
 Indices next(const TreeP<std::pair<int, int>> &size_tree, const Indices &idxs);
 Indices get_end_idxs();
 
+/** Forward iterator over the indices of all the sites in a size tree,
+ *  in the same order as next().
+ *  The path from the root is kept as a stack of (node, child position)
+ *  frames, so that increments are amortised O(1)
+ *  and do not allocate once the stack has reached its maximum depth.
+ *  Jumps with += skip whole subtrees using their sizes.
+ *  The end iterator has get_end_idxs() as indices. */
+class SizeTreeIterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Indices;
+  using difference_type = int;
+  using pointer = const Indices *;
+  using reference = const Indices &;
+
+  SizeTreeIterator() = default; // end
+  explicit SizeTreeIterator(const SizeTree &size_tree);
+
+  const Indices &operator*() const { return idxs; }
+  const Indices *operator->() const { return &idxs; }
+  SizeTreeIterator &operator++() { return *this += 1; }
+  SizeTreeIterator operator++(int);
+  SizeTreeIterator &operator+=(int n);
+  bool operator==(const SizeTreeIterator &other) const {
+    return idxs == other.idxs;
+  }
+  bool operator!=(const SizeTreeIterator &other) const {
+    return not(*this == other);
+  }
+
+private:
+  using Node = const Tree<std::pair<int, int>> *;
+  struct Frame {
+    Node node;
+    int pos; // of the child in the path
+  };
+  SizeTree root;
+  vector<Frame> stack;
+  Node leaf = nullptr;
+  Indices idxs; // the keys of the children in the path, then the site
+
+  void descend(Node node, int n);
+};
+
+/* To iterate on all the sites of a size tree with a range-for loop. */
+struct SizeTreeSites {
+  SizeTree size_tree;
+  SizeTreeIterator begin() const { return SizeTreeIterator(size_tree); }
+  SizeTreeIterator end() const { return SizeTreeIterator(); }
+};
+SizeTreeSites sites(const SizeTree &size_tree);
+
 } // namespace internals
 } // namespace slow
 } // namespace hypercubes
@@ -0,0 +1,64 @@
+#ifndef FILE_UTILS_H_
+#define FILE_UTILS_H_
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hypercubes {
+namespace slow {
+
+/** Throws std::invalid_argument if the directory
+ *  does not exist and cannot be created. */
+inline void make_directory(const std::string &directory) {
+  if (mkdir(directory.c_str(), 0777) != 0 and errno != EEXIST)
+    throw std::invalid_argument("Cannot create the directory " + directory);
+}
+
+inline std::string host_name() {
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+  return host;
+}
+
+/** Unique among processes on different hosts sharing the directory. */
+inline std::string temporary_filename(const std::string &filename) {
+  std::stringstream ss;
+  ss << filename << ".tmp." << host_name() << "." << getpid() << "."
+     << std::random_device()();
+  return ss.str();
+}
+
+/** Calls write on a temporary file which is then renamed to filename,
+ *  so that readers find either no file or a complete one.
+ *  When many processes write the same file, the last rename wins.
+ *  Throws std::runtime_error (removing the temporary file)
+ *  if the file cannot be written; exceptions from write propagate. */
+template <class Write>
+void write_atomically(const std::string &filename, Write write) {
+  const std::string tmp = temporary_filename(filename);
+  try {
+    {
+      std::ofstream os(tmp, std::ios::binary);
+      write(os);
+      os.close();
+      if (not os)
+        throw std::runtime_error("Cannot write " + tmp);
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+      throw std::runtime_error("Cannot rename " + tmp);
+  } catch (...) {
+    std::remove(tmp.c_str());
+    throw;
+  }
+}
+
+} // namespace slow
+} // namespace hypercubes
+
+#endif // FILE_UTILS_H_
@@ -0,0 +1,72 @@
+#ifndef HASH_UTILS_H_
+#define HASH_UTILS_H_
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace hypercubes {
+namespace slow {
+
+// Same mixing as boost::hash_combine.
+inline void hash_combine(std::size_t &seed, std::size_t h) {
+  seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+template <class T> std::size_t hash_value(const T &v) {
+  return std::hash<T>()(v);
+}
+
+template <class T> std::size_t hash_value(const std::vector<T> &v) {
+  std::size_t seed = v.size();
+  for (const auto &x : v)
+    hash_combine(seed, hash_value(x));
+  return seed;
+}
+
+template <class T> std::size_t hash_value(const std::shared_ptr<T> &p) {
+  return std::hash<T *>()(p.get());
+}
+
+template <class... Ts> std::size_t hash_value(const std::tuple<Ts...> &t);
+
+template <class Tuple, std::size_t... Is>
+std::size_t _hash_tuple(const Tuple &t, std::index_sequence<Is...>) {
+  std::size_t seed = 0;
+  (void)std::initializer_list<int>{
+      (hash_combine(seed, hash_value(std::get<Is>(t))), 0)...};
+  return seed;
+}
+
+template <class... Ts> std::size_t hash_value(const std::tuple<Ts...> &t) {
+  return _hash_tuple(t, std::index_sequence_for<Ts...>());
+}
+
+/** Hash functor for std::unordered_map
+ *  with tuples, vectors and shared pointers (hashed by address) as keys. */
+struct Hash {
+  template <class T> std::size_t operator()(const T &v) const {
+    return hash_value(v);
+  }
+};
+
+/** 64-bit FNV-1a.
+ *  Unlike std::hash, it gives the same result on every run and platform,
+ *  so it can be used for data written to disk. */
+inline std::uint64_t fnv1a(const char *data, std::size_t size) {
+  std::uint64_t h = 14695981039346656037ull;
+  for (std::size_t i = 0; i < size; ++i) {
+    h ^= static_cast<unsigned char>(data[i]);
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+} // namespace slow
+} // namespace hypercubes
+
+#endif // HASH_UTILS_H_
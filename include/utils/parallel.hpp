@@ -0,0 +1,148 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hypercubes {
+namespace slow {
+
+/** Runs independent calls in parallel
+ *  on a persistent set of max_threads - 1 worker threads,
+ *  started on the first call to map() and reused by the next ones.
+ *  The calling thread takes part in the work:
+ *  the calls of a map() are claimed one at a time
+ *  by the caller and by the workers that are free,
+ *  so nested calls to map() (e.g., from recursive functions)
+ *  cannot deadlock: the caller can always run all the calls by itself. */
+class TaskPool {
+public:
+  TaskPool(int max_threads = 1) : max_threads(max_threads) {}
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+  ~TaskPool() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stop = true;
+    }
+    cv.notify_all();
+    for (auto &w : workers)
+      w.join();
+  }
+  /** Extra workers, if any, stay idle. */
+  void set_max_threads(int n) {
+    max_threads = n;
+    cv.notify_all();
+  }
+  int get_max_threads() const { return max_threads; }
+
+  /** Returns {f(0), ..., f(n-1)}.
+   *  If some calls throw, one of the exceptions is rethrown
+   *  after all the calls have ended. */
+  template <class F> auto map(int n, F f) -> std::vector<decltype(f(0))> {
+    using Out = decltype(f(0));
+    std::vector<Out> res(n);
+    const int nthreads = max_threads;
+    if (nthreads <= 1 or n <= 1) {
+      for (int i = 0; i < n; ++i)
+        res[i] = f(i);
+      return res;
+    }
+    start_workers(nthreads - 1);
+
+    auto batch = std::make_shared<Batch>(n);
+    batch->run_one = [&res, &f](int i) { res[i] = f(i); };
+    const int nhelpers = std::min(n - 1, nthreads - 1);
+    {
+      std::lock_guard<std::mutex> lock(m);
+      for (int h = 0; h < nhelpers; ++h)
+        queue.push_back([batch]() { batch->work(); });
+    }
+    if (nhelpers == 1)
+      cv.notify_one();
+    else
+      cv.notify_all();
+    batch->work();
+    batch->wait();
+    if (batch->error)
+      std::rethrow_exception(batch->error);
+    return res;
+  }
+
+private:
+  // The calls of a map(). Owned also by the queued jobs,
+  // which may run after the map() has returned (and do nothing).
+  struct Batch {
+    const int n;
+    std::atomic<int> next{0};
+    std::function<void(int)> run_one; // valid until all calls have ended
+    std::mutex m;
+    std::condition_variable cv;
+    int ndone = 0;
+    std::exception_ptr error;
+
+    Batch(int n) : n(n) {}
+    void work() {
+      for (int i = next++; i < n; i = next++) {
+        std::exception_ptr e;
+        try {
+          run_one(i);
+        } catch (...) {
+          e = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(m);
+        if (e and not error)
+          error = e;
+        if (++ndone == n)
+          cv.notify_all();
+      }
+    }
+    void wait() {
+      std::unique_lock<std::mutex> lock(m);
+      cv.wait(lock, [this] { return ndone == n; });
+    }
+  };
+
+  std::atomic<int> max_threads;
+  std::mutex m; // protects queue, workers and stop
+  std::condition_variable cv;
+  std::deque<std::function<void()>> queue;
+  std::vector<std::thread> workers;
+  bool stop = false;
+
+  void start_workers(int nworkers) {
+    std::lock_guard<std::mutex> lock(m);
+    while (workers.size() < nworkers) {
+      const int rank = workers.size();
+      workers.emplace_back([this, rank] { worker_loop(rank); });
+    }
+  }
+
+  void worker_loop(int rank) {
+    std::unique_lock<std::mutex> lock(m);
+    while (true) {
+      cv.wait(lock, [this, rank] {
+        return stop or (not queue.empty() and rank + 1 < max_threads);
+      });
+      if (stop)
+        return;
+      auto job = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+      job();
+      lock.lock();
+    }
+  }
+};
+
+} // namespace slow
+} // namespace hypercubes
+
+#endif // PARALLEL_H_
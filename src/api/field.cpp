@@ -0,0 +1,190 @@
+#include "api/field.hpp"
+#include "exceptions/exceptions.hpp"
+#include "trees/partition_tree_allocations.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <climits>
+#include <sstream>
+
+namespace hypercubes {
+namespace slow {
+
+using internals::KeyNotFoundError;
+
+FieldLayout::Data::Data(internals::FlatOffsetTree &&_tree, int size,
+                        vector<std::string> &&_level_names)
+    : tree(std::move(_tree)), end(tree.nnodes()),
+      level_names(std::move(_level_names)) {
+  // Nodes are numbered breadth-first (see flatten_offset_tree),
+  // so the end of a node is known before its children are visited.
+  end[0] = tree.offsets[0] + size;
+  for (int i = 0; i < tree.nnodes(); ++i) {
+    int cstart = tree.child_start[i];
+    int n = tree.nchildren(i);
+    bool leaf_parent = n > 0;
+    for (int k = 0; k < n; ++k) {
+      int c = tree.child_node[cstart + k];
+      end[c] = k + 1 < n ? tree.offsets[tree.child_node[cstart + k + 1]]
+                         : end[i];
+      leaf_parent = leaf_parent and tree.nchildren(c) == 0;
+    }
+    if (leaf_parent)
+      leaf_parents.push_back(i);
+  }
+  std::sort(leaf_parents.begin(), leaf_parents.end(), [this](int a, int b) {
+    return tree.offsets[a] < tree.offsets[b];
+  });
+}
+
+FieldLayout::FieldLayout(std::shared_ptr<const Data> _data, int _node,
+                         int _depth)
+    : data(_data), node(_node), depth(_depth) {}
+
+FieldLayout::FieldLayout(const SizeTree &size_tree)
+    : data(std::make_shared<Data>(
+          internals::flatten_offset_tree(
+              internals::get_offset_tree(size_tree.get_internal()), false),
+          size_tree.get_size({}), size_tree.get_level_names())) {}
+
+FieldLayout::FieldLayout(const SizeTree &size_tree,
+                         const PartitionTree &partition_tree)
+    : FieldLayout(size_tree) {
+  auto d = std::make_shared<Data>(*data);
+  auto matcher = get_level_matcher(partition_tree, size_tree);
+  d->coordinates_offset = [d = d.get(), partition_tree,
+                           matcher](const Coordinates &xs) mutable {
+    Indices idxs = matcher(partition_tree.get_indices(xs));
+    return internals::get_offset(d->tree, idxs);
+  };
+  data = d;
+}
+
+namespace {
+using internals::KVTreePv2;
+using internals::NodeType;
+using internals::TreeP;
+
+// Leaves are elements, keys are the positions of the children,
+// as in index_pullback.
+TreeP<std::pair<int, int>> size_tree_v2(const KVTreePv2<NodeType> &tree) {
+  auto _size_tree = [](const KVTreePv2<NodeType> &t, int key,
+                       auto f) -> TreeP<std::pair<int, int>> {
+    vector<TreeP<std::pair<int, int>>> children;
+    int size = t->n == NodeType::LEAF ? 1 : 0;
+    for (int i = 0; i < t->children.size(); ++i) {
+      auto c = f(t->children[i].second, i, f);
+      size += c->n.second;
+      children.push_back(c);
+    }
+    return internals::mt(std::make_pair(key, size), children);
+  };
+  return _size_tree(tree, 0, _size_tree);
+}
+} // namespace
+
+FieldLayout::FieldLayout(const KVTreePv2<NodeType> &tree,
+                         const vector<std::string> &level_names) {
+  auto size_tree = size_tree_v2(tree);
+  auto ln = level_names;
+  data = std::make_shared<Data>(
+      internals::flatten_offset_tree(internals::get_offset_tree(size_tree),
+                                     false),
+      size_tree->n.second, std::move(ln));
+}
+
+FieldLayout::FieldLayout(
+    internals::transform_networks::TransformNetwork &network,
+    const std::string &coordinates_node, const std::string &layout_node)
+    : FieldLayout(network[layout_node]->output_tree,
+                  network[layout_node]->output_levelnames) {
+  auto d = std::make_shared<Data>(*data);
+  auto transform = network.get_fused_transform(coordinates_node, layout_node);
+  d->coordinates_offset = [d = d.get(), transform](const Coordinates &xs) {
+    vector<int> idx(xs.begin(), xs.end());
+    int res = INT_MAX;
+    for (const auto &image : transform->apply(idx))
+      res = std::min(res, internals::get_offset(d->tree, image.data(),
+                                                image.size()));
+    if (res == INT_MAX)
+      throw KeyNotFoundError("Site not in the layout");
+    return res;
+  };
+  data = d;
+}
+
+vector<std::string> FieldLayout::get_level_names() const {
+  return tail(data->level_names, depth);
+}
+
+int FieldLayout::size() const { return data->end[node] - start(); }
+
+int FieldLayout::start() const { return data->tree.offsets[node]; }
+
+static std::invalid_argument invalid_indices(const KeyNotFoundError &e,
+                                             const vector<std::string> &ln) {
+  std::stringstream message;
+  message << e.what() << ", levels: ";
+  for (const auto &l : ln)
+    message << l << " ";
+  return std::invalid_argument(message.str());
+}
+
+int FieldLayout::get_offset(const Indices &idxs) const {
+  try {
+    vector<int> v(idxs.begin(), idxs.end());
+    int n = internals::find_node(data->tree, node, v.data(), v.size());
+    return data->tree.offsets[n] - start();
+  } catch (const KeyNotFoundError &e) {
+    throw invalid_indices(e, get_level_names());
+  }
+}
+
+int FieldLayout::get_offset(const Coordinates &xs) const {
+  if (not data->coordinates_offset)
+    throw std::invalid_argument("This layout has no coordinates");
+  int offset;
+  try {
+    offset = data->coordinates_offset(xs);
+  } catch (const KeyNotFoundError &e) {
+    throw invalid_indices(e, data->level_names);
+  }
+  if (offset < start() or offset >= data->end[node])
+    throw std::invalid_argument("Site not in the subtree");
+  return offset - start();
+}
+
+Indices FieldLayout::get_indices(int offset) const {
+  try {
+    return internals::get_indices(data->tree, node, offset + start());
+  } catch (const KeyNotFoundError &e) {
+    throw invalid_indices(e, get_level_names());
+  }
+}
+
+FieldLayout FieldLayout::get_subtree(const Indices &idxs) const {
+  try {
+    vector<int> v(idxs.begin(), idxs.end());
+    int n = internals::find_node(data->tree, node, v.data(), v.size());
+    return FieldLayout(data, n, depth + idxs.size());
+  } catch (const KeyNotFoundError &e) {
+    throw invalid_indices(e, get_level_names());
+  }
+}
+
+vector<std::pair<int, int>> FieldLayout::leaf_parent_blocks() const {
+  const auto &lp = data->leaf_parents;
+  auto by_offset = [this](int n, int offset) {
+    return data->tree.offsets[n] < offset;
+  };
+  auto first = std::lower_bound(lp.begin(), lp.end(), start(), by_offset);
+  auto last =
+      std::lower_bound(lp.begin(), lp.end(), data->end[node], by_offset);
+  vector<std::pair<int, int>> res;
+  for (auto it = first; it != last; ++it)
+    res.push_back({data->tree.offsets[*it] - start(), //
+                   data->end[*it] - data->tree.offsets[*it]});
+  return res;
+}
+
+} // namespace slow
+} // namespace hypercubes
@@ -0,0 +1,150 @@
+#include "api/halo_exchange.hpp"
+#include "selectors/partition_predicates.hpp"
+#include "trees/kvtree.hpp"
+#include <map>
+#include <tuple>
+
+namespace hypercubes {
+namespace slow {
+
+vector<Run> coalesce(const vector<int> &offsets) {
+  vector<Run> res;
+  for (int offset : offsets)
+    if (res.size() != 0 and
+        res.back().start + res.back().length == offset)
+      res.back().length++;
+    else
+      res.push_back({offset, 1});
+  return res;
+}
+
+int HaloExchangePlan::nsites() const {
+  int res = 0;
+  for (const auto &m : messages)
+    res += m.dst_offsets.size();
+  return res;
+}
+
+namespace {
+double contiguous_fraction(const vector<HaloMessage> &messages,
+                           vector<Run> HaloMessage::*runs) {
+  int contiguous = 0, total = 0;
+  for (const auto &m : messages)
+    for (const Run &r : m.*runs) {
+      total += r.length;
+      if (r.length > 1)
+        contiguous += r.length;
+    }
+  return total == 0 ? 1.0 : double(contiguous) / total;
+}
+
+OffsetTree rank_offset_tree(const PartitionTree &partition_tree, //
+                            const PartList &partitioners,        //
+                            const vector<int> &cart_mpi_rank) {
+  auto predicate = getp(selectors::mpi_rank, partitioners, cart_mpi_rank);
+  return partition_tree.skeleton_tree().prune(predicate).size_tree() //
+      .offset_tree();
+}
+} // namespace
+
+double HaloExchangePlan::pack_contiguous_fraction() const {
+  return contiguous_fraction(messages, &HaloMessage::pack_runs);
+}
+double HaloExchangePlan::unpack_contiguous_fraction() const {
+  return contiguous_fraction(messages, &HaloMessage::unpack_runs);
+}
+
+HaloExchangePlan make_halo_exchange_plan(const PartitionTree &partition_tree,
+                                         const PartList &partitioners,
+                                         const vector<BoundaryCondition> &bcs,
+                                         const vector<int> &cart_mpi_rank) {
+  Sizes sizes = partition_tree.get_sizes();
+  const int ndims = sizes.size();
+  const int nlevels = partition_tree.get_indices_size();
+  vector<int> mpi_levels;
+  vector<int> hbb_directions;
+  for (int i = 0; i < partitioners.size(); ++i) {
+    if (partitioners[i]->get_name().find("MPI") != std::string::npos)
+      mpi_levels.push_back(i);
+    auto hbb = std::dynamic_pointer_cast<partitioners::HBB>(partitioners[i]);
+    if (hbb)
+      hbb_directions.push_back(hbb->get_dimension());
+  }
+
+  // The ghost sites in the local layout,
+  // with the coordinates of the site they are a copy of.
+  struct Ghost {
+    int direction, side, dst_offset;
+  };
+  vector<Ghost> ghosts;
+  partitioning::CoordinateBlock block{vector<vector<int>>(ndims)};
+  OffsetTree local = rank_offset_tree(partition_tree, //
+                                      partitioners,   //
+                                      cart_mpi_rank);
+  // The skeleton tree is not permuted, so the keys are the indices.
+  for (const auto &leaf : internals::get_leaves_kv(local.get_internal())) {
+    const Indices &idxs = leaf.first;
+    Ghost g{-1, -1, leaf.second};
+    for (int d : hbb_directions) {
+      for (int side : {0, 4})
+        if (selectors::hbb_slice(idxs, partitioners, d, side) == BoolM::T)
+          g = Ghost{d, side, leaf.second};
+      if (g.direction != -1)
+        break;
+    }
+    if (g.direction == -1)
+      continue;
+    Coordinates xs = partition_tree.get_coordinates(idxs);
+    bool inside = true;
+    for (int d = 0; d < ndims; ++d) {
+      if (bcs[d] == BoundaryCondition::PERIODIC)
+        xs[d] = (xs[d] % sizes[d] + sizes[d]) % sizes[d];
+      else
+        inside = inside and 0 <= xs[d] and xs[d] < sizes[d];
+    }
+    if (not inside)
+      continue;
+    for (int d = 0; d < ndims; ++d)
+      block.x[d].push_back(xs[d]);
+    ghosts.push_back(g);
+  }
+
+  vector<int> real_indices(ghosts.size() * nlevels);
+  partition_tree.get_indices(block, real_indices.data());
+
+  std::map<vector<int>, OffsetTree> owner_trees;
+  std::map<std::tuple<int, int, vector<int>>, HaloMessage> messages;
+  for (int i = 0; i < ghosts.size(); ++i) {
+    Indices owner_idxs(real_indices.begin() + i * nlevels,
+                       real_indices.begin() + (i + 1) * nlevels);
+    vector<int> owner;
+    for (int l : mpi_levels)
+      owner.push_back(owner_idxs[l]);
+    auto owner_tree = owner_trees.find(owner);
+    if (owner_tree == owner_trees.end())
+      owner_tree = owner_trees
+                       .emplace(owner, rank_offset_tree(partition_tree, //
+                                                        partitioners,   //
+                                                        owner))
+                       .first;
+
+    const Ghost &g = ghosts[i];
+    HaloMessage &m = messages[std::make_tuple(g.direction, g.side, owner)];
+    m.direction = g.direction;
+    m.side = g.side;
+    m.neighbour = owner;
+    m.src_offsets.push_back(owner_tree->second.get_offset(owner_idxs));
+    m.dst_offsets.push_back(g.dst_offset);
+  }
+
+  HaloExchangePlan plan;
+  for (auto &m : messages) {
+    m.second.pack_runs = coalesce(m.second.src_offsets);
+    m.second.unpack_runs = coalesce(m.second.dst_offsets);
+    plan.messages.push_back(std::move(m.second));
+  }
+  return plan;
+}
+
+} // namespace slow
+} // namespace hypercubes
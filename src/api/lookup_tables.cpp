@@ -0,0 +1,214 @@
+#include "api/lookup_tables.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hypercubes {
+namespace slow {
+
+LookupTables::LookupTables(const PartitionTree &partition_tree,  //
+                           const OffsetTree &offset_tree,        //
+                           const vector<BoundaryCondition> &bcs, //
+                           const vector<int> &directions) {
+  Sizes sizes = partition_tree.get_sizes();
+  const int ndims = sizes.size();
+  const int ndirs = directions.size();
+  if (bcs.size() != ndims)
+    throw std::invalid_argument("One boundary condition per dimension needed.");
+
+  auto leaves = internals::get_leaves_kv(offset_tree.get_internal());
+  int64_t nsites = 1;
+  for (int s : sizes)
+    nsites *= s;
+  int noffsets = 0;
+  for (const auto &l : leaves)
+    noffsets = std::max(noffsets, l.second + 1);
+
+  buffer.assign(HEADER_SIZE + ndims + ndirs, 0);
+  buffer[MAGIC] = magic;
+  buffer[VERSION] = version;
+  buffer[NDIMS] = ndims;
+  buffer[NDIRS] = ndirs;
+  std::memcpy(buffer.data() + NSITES, &nsites, sizeof(nsites));
+  buffer[NOFFSETS] = noffsets;
+  std::copy(sizes.begin(), sizes.end(), buffer.begin() + HEADER_SIZE);
+  std::copy(directions.begin(), directions.end(),
+            buffer.begin() + HEADER_SIZE + ndims);
+  data = buffer.data();
+  const std::size_t start = tables_start() - data;
+  buffer.resize(nwords(), -1);
+  data = buffer.data();
+  int64_t *o2l = reinterpret_cast<int64_t *>(buffer.data() + start);
+  std::fill(o2l, o2l + noffsets, -1);
+  int32_t *c2o = buffer.data() + start + 2 * noffsets;
+  int32_t *neighbours = c2o + nsites;
+
+  // Coordinates of each leaf, folded in the lattice
+  // according to the boundary conditions.
+  // The leaf is the real copy of the site
+  // if its indices are the ones returned by get_indices.
+  auto matcher = get_level_matcher(offset_tree, partition_tree);
+  const int nlevels = partition_tree.get_indices_size();
+  partitioning::CoordinateBlock block{vector<vector<int>>(ndims)};
+  vector<Indices> leaf_indices;
+  vector<int> leaf_offsets;
+  for (const auto &l : leaves) {
+    Indices idxs = matcher(l.first);
+    Coordinates xs = partition_tree.get_coordinates(idxs);
+    bool inside = true;
+    for (int d = 0; d < ndims; ++d) {
+      if (bcs[d] == BoundaryCondition::PERIODIC)
+        xs[d] = (xs[d] % sizes[d] + sizes[d]) % sizes[d];
+      else
+        inside = inside and 0 <= xs[d] and xs[d] < sizes[d];
+    }
+    if (not inside)
+      continue;
+    for (int d = 0; d < ndims; ++d)
+      block.x[d].push_back(xs[d]);
+    leaf_indices.push_back(idxs);
+    leaf_offsets.push_back(l.second);
+  }
+  vector<vector<int>> coords = block.x; // overwritten by get_indices
+  vector<int> real_indices(leaf_offsets.size() * nlevels);
+  partition_tree.get_indices(block, real_indices.data());
+
+  for (int i = 0; i < leaf_offsets.size(); ++i) {
+    Coordinates xs(ndims);
+    for (int d = 0; d < ndims; ++d)
+      xs[d] = coords[d][i];
+    int64_t lex = lex_index(xs);
+    o2l[leaf_offsets[i]] = lex;
+    if (std::equal(leaf_indices[i].begin(), leaf_indices[i].end(),
+                   real_indices.begin() + i * nlevels))
+      c2o[lex] = leaf_offsets[i];
+  }
+
+  for (int offset = 0; offset < noffsets; ++offset) {
+    int64_t lex = o2l[offset];
+    if (lex == -1 or c2o[lex] != offset)
+      continue;
+    Coordinates xs = lex_coordinates(lex);
+    for (int i = 0; i < ndirs; ++i) {
+      Coordinates xup = slow::up(xs, sizes, bcs, directions[i]);
+      Coordinates xdown = slow::down(xs, sizes, bcs, directions[i]);
+      if (xup.size() != 0)
+        neighbours[i * noffsets + offset] = c2o[lex_index(xup)];
+      if (xdown.size() != 0)
+        neighbours[(ndirs + i) * noffsets + offset] = c2o[lex_index(xdown)];
+    }
+  }
+}
+
+LookupTables::LookupTables(LookupTables &&other)
+    : buffer(std::move(other.buffer)), data(other.data),
+      mapped_size(other.mapped_size) {
+  other.data = nullptr;
+  other.mapped_size = 0;
+}
+
+LookupTables &LookupTables::operator=(LookupTables &&other) {
+  std::swap(buffer, other.buffer);
+  std::swap(data, other.data);
+  std::swap(mapped_size, other.mapped_size);
+  return *this;
+}
+
+LookupTables::~LookupTables() {
+  if (mapped_size != 0)
+    munmap(const_cast<int32_t *>(data), mapped_size);
+}
+
+void LookupTables::write(const std::string &filename) const {
+  std::ofstream out(filename, std::ios::binary);
+  std::size_t nbytes = nwords() * sizeof(int32_t);
+  out.write(reinterpret_cast<const char *>(data), nbytes);
+  if (not out)
+    throw std::runtime_error("Could not write lookup tables to " + filename);
+}
+
+LookupTables LookupTables::map(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    throw std::runtime_error("Could not open " + filename);
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    throw std::runtime_error("Could not stat " + filename);
+  }
+  std::size_t size = st.st_size;
+  void *p = size < HEADER_SIZE * sizeof(int32_t)
+                ? MAP_FAILED
+                : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    throw std::runtime_error("Could not map " + filename);
+
+  LookupTables res;
+  res.data = static_cast<const int32_t *>(p);
+  res.mapped_size = size;
+  if (res.data[MAGIC] != magic or res.data[VERSION] != version)
+    throw std::runtime_error(filename + " is not a lookup table file " +
+                             "of version " + std::to_string(version));
+  if (size != res.nwords() * sizeof(int32_t))
+    throw std::runtime_error(filename + " has the wrong size");
+  return res;
+}
+
+Sizes LookupTables::sizes() const {
+  return Sizes(data + HEADER_SIZE, data + HEADER_SIZE + data[NDIMS]);
+}
+vector<int> LookupTables::directions() const {
+  const int32_t *start = data + HEADER_SIZE + data[NDIMS];
+  return vector<int>(start, start + data[NDIRS]);
+}
+int64_t LookupTables::nsites() const {
+  int64_t res;
+  std::memcpy(&res, data + NSITES, sizeof(res));
+  return res;
+}
+int LookupTables::noffsets() const { return data[NOFFSETS]; }
+const int32_t *LookupTables::tables_start() const {
+  return data + (HEADER_SIZE + data[NDIMS] + data[NDIRS] + 1) / 2 * 2;
+}
+std::size_t LookupTables::nwords() const {
+  return (tables_start() - data) + nsites() +
+         (std::size_t)(2 + 2 * data[NDIRS]) * noffsets();
+}
+const int64_t *LookupTables::offset_to_lex() const {
+  return reinterpret_cast<const int64_t *>(tables_start());
+}
+const int32_t *LookupTables::coord_to_offset() const {
+  return tables_start() + 2 * noffsets();
+}
+const int32_t *LookupTables::up(int i) const {
+  return coord_to_offset() + nsites() + (int64_t)i * noffsets();
+}
+const int32_t *LookupTables::down(int i) const {
+  return coord_to_offset() + nsites() + (int64_t)(data[NDIRS] + i) * noffsets();
+}
+
+int64_t LookupTables::lex_index(const Coordinates &xs) const {
+  const int32_t *s = data + HEADER_SIZE;
+  int64_t res = 0;
+  for (int d = data[NDIMS] - 1; d >= 0; --d)
+    res = res * s[d] + xs[d];
+  return res;
+}
+Coordinates LookupTables::lex_coordinates(int64_t lex) const {
+  const int32_t *s = data + HEADER_SIZE;
+  Coordinates res(data[NDIMS]);
+  for (int d = 0; d < res.size(); ++d) {
+    res[d] = lex % s[d];
+    lex /= s[d];
+  }
+  return res;
+}
+
+} // namespace slow
+} // namespace hypercubes
@@ -7,6 +7,7 @@
 #include "trees/partition_tree_allocations.hpp"
 #include "trees/tree.hpp"
 #include <iostream> // DEBUG
+#include <mutex>
 #include <stdexcept>
 
 /******************
@@ -25,9 +26,18 @@ vector<std::string> PartitionTree::get_level_names() const {
   return internals::get_partitioners_names(partitioners_list);
 }
 
+Sizes PartitionTree::get_sizes() const { return sizes; }
+
 Indices PartitionTree::get_indices(const Coordinates &coords) const {
   return internals::get_real_indices(partition_tree, coords);
 };
+int PartitionTree::get_indices_size() const {
+  return internals::get_real_indices_size(partition_tree);
+}
+void PartitionTree::get_indices(partitioning::CoordinateBlock &coords,
+                                int *indices) const {
+  internals::get_real_indices_batch(partition_tree, coords, indices);
+}
 vector<std::pair<int, Indices>>
 PartitionTree::get_indices_wg(const Coordinates &coords) const {
 
@@ -164,9 +174,15 @@ const internals::KVTreeP<int> OffsetTree::get_internal() const {
   return offset_tree;
 }
 
+struct OffsetTree::LazyFlatOffsetTree {
+  std::once_flag built;
+  internals::FlatOffsetTree flat;
+};
+
 OffsetTree::OffsetTree(const SizeTree &size_tree)
-    : offset_tree(internals::get_offset_tree(size_tree.size_tree)),
-      level_names(size_tree.level_names) {}
+    : level_names(size_tree.level_names),
+      offset_tree(internals::get_offset_tree(size_tree.size_tree)),
+      lazy_flat_offset_tree(std::make_shared<LazyFlatOffsetTree>()) {}
 vector<std::string> OffsetTree::get_level_names() const { return level_names; }
 
 OffsetTree OffsetTree::get_subtree(const Indices &idxs) const {
@@ -182,11 +198,20 @@ OffsetTree OffsetTree::get_subtree(const Indices &idxs) const {
 }
 
 OffsetTree::OffsetTree(internals::KVTreeP<int> &&st, vector<std::string> &&ln)
-    : offset_tree(st), level_names(ln) {}
+    : level_names(ln), offset_tree(st),
+      lazy_flat_offset_tree(std::make_shared<LazyFlatOffsetTree>()) {}
+
+const internals::FlatOffsetTree &OffsetTree::flat_offset_tree() const {
+  auto &lazy = *lazy_flat_offset_tree;
+  std::call_once(lazy.built, [this, &lazy]() {
+    lazy.flat = internals::flatten_offset_tree(offset_tree, false);
+  });
+  return lazy.flat;
+}
 
 int OffsetTree::get_offset(const Indices &idxs) const {
   try {
-    return get_subtree(idxs).offset_tree->n.second;
+    return internals::get_offset(flat_offset_tree(), idxs);
   } catch (internals::KeyNotFoundError &e) {
     std::cout << "Indices invalid: " << std::endl;
     std::cout << idxs << std::endl;
@@ -201,5 +226,16 @@ OffsetTree OffsetTree::shift(int shift) const {
   return OffsetTree(std::move(shifted_tree), std::move(ln));
 }
 Indices OffsetTree::get_indices(int offset) const {
-  return internals::search_in_sorted_tree(offset_tree, offset);
+  return internals::get_indices(flat_offset_tree(), offset);
+}
+void OffsetTree::get_offsets(const int *idxs, int nindices, int idx_size,
+                             int *offsets) const {
+  try {
+    internals::get_offsets(flat_offset_tree(), idxs, nindices, idx_size,
+                           offsets);
+  } catch (internals::KeyNotFoundError &e) {
+    std::cout << "Indices invalid: " << std::endl;
+    std::cout << level_names << std::endl;
+    throw std::invalid_argument(e.what());
+  }
 }
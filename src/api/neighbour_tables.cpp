@@ -0,0 +1,152 @@
+#include "api/neighbour_tables.hpp"
+#include "trees/partition_tree.hpp"
+#include "utils/parallel.hpp"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace hypercubes {
+namespace slow {
+
+namespace {
+
+// the offsets of the leaves, by their indices in the partition tree
+using LocalOffsets = std::map<vector<int>, int>;
+
+struct Copy {
+  int offset;
+  int prefix;  // length of the common prefix with the indices of the site
+  int ncached; // number of ghost levels
+};
+
+/* The copy of the site at coordinates xs, relative to the node t,
+ * closest to the site with indices site.
+ * path contains the indices of t,
+ * the first prefix of them being the same as in site. */
+Copy nearest_copy(const internals::PartitionTree &t, //
+                  const Coordinates &xs,             //
+                  vector<int> &path,                 //
+                  const Indices &site,               //
+                  int prefix,                        //
+                  const LocalOffsets &local) {
+  if (t->children.size() == 0) {
+    auto it = local.find(path);
+    return Copy{it == local.end() ? -1 : it->second, prefix, 0};
+  }
+  const int level = path.size();
+  Copy best{-1, 0, 0};
+  auto visit = [&](const IndexResultD &idr, int child_prefix) {
+    path.push_back(idr.idx);
+    Copy c = nearest_copy(t->children[idr.idx], idr.rest, path, site,
+                          child_prefix, local);
+    path.pop_back();
+    c.ncached += idr.cached_flag;
+    if (c.offset != -1 and
+        (best.offset == -1 or c.prefix > best.prefix or
+         (c.prefix == best.prefix and c.ncached < best.ncached)))
+      best = c;
+  };
+  vector<IndexResultD> idrs = t->n->coord_to_idxs(xs);
+  const bool on_site_branch = prefix == level;
+  if (on_site_branch) {
+    for (const auto &idr : idrs)
+      if (idr.idx == site[level])
+        visit(idr, level + 1);
+    // any copy here is closer than the ones in the other branches
+    if (best.offset != -1)
+      return best;
+  }
+  for (const auto &idr : idrs)
+    if (not on_site_branch or idr.idx != site[level])
+      visit(idr, prefix);
+  return best;
+}
+
+} // namespace
+
+NeighbourTables::NeighbourTables(const PartitionTree &partition_tree,  //
+                                 const OffsetTree &offset_tree,        //
+                                 const vector<BoundaryCondition> &bcs, //
+                                 const vector<int> &directions,        //
+                                 int nthreads)
+    : dirs(directions), n(0) {
+  Sizes sizes = partition_tree.get_sizes();
+  const int ndims = sizes.size();
+  const int ndirs = directions.size();
+  if (bcs.size() != ndims)
+    throw std::invalid_argument("One boundary condition per dimension needed.");
+
+  auto leaves = internals::get_leaves_kv(offset_tree.get_internal());
+  auto matcher = get_level_matcher(offset_tree, partition_tree);
+  LocalOffsets local;
+  vector<Indices> leaf_indices;
+  for (const auto &l : leaves) {
+    n = std::max(n, l.second + 1);
+    leaf_indices.push_back(matcher(l.first));
+    local[vector<int>(leaf_indices.back().begin(),
+                      leaf_indices.back().end())] = l.second;
+  }
+  iup.assign(ndirs * n, -1);
+  idn.assign(ndirs * n, -1);
+
+  // The leaves are in depth-first order,
+  // so the children of a leaf-parent are consecutive.
+  vector<int> parent_starts;
+  for (int i = 0; i < leaves.size(); ++i) {
+    const Indices &key = leaves[i].first;
+    const Indices &previous = i == 0 ? key : leaves[i - 1].first;
+    if (i == 0 or key.size() != previous.size() or
+        not std::equal(key.begin(), key.end() - 1, previous.begin()))
+      parent_starts.push_back(i);
+  }
+  parent_starts.push_back(leaves.size());
+  const int nparents = parent_starts.size() - 1;
+
+  const auto tree = partition_tree.get_internal();
+  auto neighbour = [&](const Coordinates &xs, const Indices &site) {
+    if (xs.size() == 0)
+      return -1;
+    vector<int> path;
+    return nearest_copy(tree, xs, path, site, 0, local).offset;
+  };
+  auto fill = [&](int first_parent, int end_parent) {
+    for (int i = parent_starts[first_parent]; i < parent_starts[end_parent];
+         ++i) {
+      const Indices &site = leaf_indices[i];
+      const int offset = leaves[i].second;
+      Coordinates xs = partition_tree.get_coordinates(site);
+      bool inside = true;
+      for (int d = 0; d < ndims; ++d) {
+        if (bcs[d] == BoundaryCondition::PERIODIC)
+          xs[d] = (xs[d] % sizes[d] + sizes[d]) % sizes[d];
+        else
+          inside = inside and 0 <= xs[d] and xs[d] < sizes[d];
+      }
+      if (not inside)
+        continue;
+      for (int j = 0; j < ndirs; ++j) {
+        iup[j * n + offset] =
+            neighbour(slow::up(xs, sizes, bcs, directions[j]), site);
+        idn[j * n + offset] =
+            neighbour(slow::down(xs, sizes, bcs, directions[j]), site);
+      }
+    }
+  };
+
+  TaskPool pool(nthreads);
+  const int nchunks = std::max(1, std::min(nthreads, nparents));
+  pool.map(nchunks, [&](int c) {
+    fill((long)nparents * c / nchunks, (long)nparents * (c + 1) / nchunks);
+    return 0;
+  });
+}
+
+vector<int> NeighbourTables::directions() const { return dirs; }
+int NeighbourTables::noffsets() const { return n; }
+const int32_t *NeighbourTables::up(int i) const { return iup.data() + i * n; }
+const int32_t *NeighbourTables::down(int i) const {
+  return idn.data() + i * n;
+}
+
+} // namespace slow
+} // namespace hypercubes
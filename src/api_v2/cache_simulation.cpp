@@ -0,0 +1,217 @@
+#include "api_v2/cache_simulation.hpp"
+#include "api_v2/site_offsets.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace cache_simulation {
+
+SetAssociativeCache::SetAssociativeCache(std::size_t size_bytes, //
+                                         int line_bytes,         //
+                                         int ways)
+    : ways(ways), nsets(ways > 0 and line_bytes > 0
+                            ? size_bytes / line_bytes / ways
+                            : 0) {
+  if (nsets <= 0)
+    throw std::invalid_argument(
+        "The cache must contain at least a set of lines.");
+  tags.resize(nsets * ways);
+  nvalid.resize(nsets, 0);
+}
+
+bool SetAssociativeCache::access(long line) {
+  long set = line % nsets;
+  long *t = tags.data() + set * ways;
+  int n = nvalid[set];
+  int pos = std::find(t, t + n, line) - t;
+  bool hit = pos < n;
+  if (not hit) {
+    ++misses;
+    if (n < ways)
+      ++nvalid[set];
+    pos = std::min(n, ways - 1); // the least recently used is dropped
+  }
+  std::move_backward(t, t + pos, t + pos + 1);
+  t[0] = line;
+  return hit;
+}
+
+long SetAssociativeCache::get_misses() const { return misses; }
+
+ReuseDistance::ReuseDistance(long naccesses) : fenwick(naccesses + 1, 0) {}
+
+void ReuseDistance::add(long t, int value) {
+  for (long i = t + 1; i < fenwick.size(); i += i & -i)
+    fenwick[i] += value;
+}
+
+long ReuseDistance::count_after(long t) const {
+  auto prefix = [this](long t) { // in [0, t]
+    long res = 0;
+    for (long i = t + 1; i > 0; i -= i & -i)
+      res += fenwick[i];
+    return res;
+  };
+  return prefix(time - 1) - prefix(t);
+}
+
+long ReuseDistance::access(long line) {
+  if (time + 1 >= fenwick.size())
+    throw std::out_of_range("More accesses than declared.");
+  long res = -1;
+  auto it = last_access.find(line);
+  if (it != last_access.end()) {
+    res = count_after(it->second);
+    add(it->second, -1);
+    it->second = time;
+  } else
+    last_access[line] = time;
+  add(time, 1);
+  ++time;
+  return res;
+}
+
+namespace {
+vector<vector<int>> nearest_neighbours(int ndims) {
+  vector<vector<int>> res{vector<int>(ndims, 0)};
+  for (int d = 0; d < ndims; ++d)
+    for (int dir : {-1, 1}) {
+      res.push_back(vector<int>(ndims, 0));
+      res.back()[d] = dir;
+    }
+  return res;
+}
+
+int histogram_bin(long distance) {
+  if (distance < 0)
+    return 0;
+  int bin = 1;
+  for (; distance > 0; distance /= 2)
+    ++bin;
+  return bin;
+}
+} // namespace
+
+Report simulate(TransformNetwork &network,          //
+                const std::string &start_node_name, //
+                const std::string &end_node_name,   //
+                const Options &options) {
+  const auto sites =
+      site_offsets::make_site_offsets(network, start_node_name, end_node_name);
+  const int ndims = sites.ndims();
+  const auto end = network[end_node_name];
+  const auto &leaves = sites.leaves;
+  const auto stencil =
+      options.stencil.empty() ? nearest_neighbours(ndims) : options.stencil;
+  for (const auto &disp : stencil)
+    if (disp.size() != ndims)
+      throw std::invalid_argument("The displacements must have " +
+                                  std::to_string(ndims) + " components.");
+
+  Report res;
+  res.levels.push_back(LevelStats{"(site)"});
+  std::size_t depth = 0;
+  for (const auto &l : leaves)
+    depth = std::max(depth, l.size());
+  for (int l = 0; l < depth; ++l)
+    res.levels.push_back(LevelStats{l < end->output_levelnames.size()
+                                        ? end->output_levelnames[l]
+                                        : "level " + std::to_string(l)});
+
+  // The stream of the cache lines read,
+  // with the level responsible for each read
+  vector<long> lines;
+  vector<int> line_levels;
+  for (int o = 0; o < leaves.size(); ++o) {
+    if (sites.coords[o].empty())
+      continue;
+    ++res.nsites;
+    for (const auto &disp : stencil) {
+      int other = sites.neighbour(o, disp);
+      int level = 0;
+      if (other != o) {
+        const auto &a = leaves[o], &b = leaves[other];
+        auto first_difference =
+            std::mismatch(a.begin(), a.begin() + std::min(a.size(), b.size()),
+                          b.begin())
+                .first -
+            a.begin();
+        level = 1 + std::min<long>(first_difference, depth - 1);
+      }
+      long first = (long)other * options.site_bytes / options.line_bytes;
+      long last =
+          ((long)(other + 1) * options.site_bytes - 1) / options.line_bytes;
+      for (long line = first; line <= last; ++line) {
+        lines.push_back(line);
+        line_levels.push_back(level);
+      }
+    }
+  }
+
+  vector<SetAssociativeCache> caches;
+  for (const auto &c : options.caches) {
+    caches.emplace_back(c.size_bytes, options.line_bytes, c.ways);
+    res.cache_names.push_back(c.name);
+  }
+  res.misses.resize(caches.size(), 0);
+  for (auto &l : res.levels)
+    l.misses.resize(caches.size(), 0);
+  ReuseDistance reuse(lines.size());
+  res.accesses = lines.size();
+  for (long i = 0; i < lines.size(); ++i) {
+    int bin = histogram_bin(reuse.access(lines[i]));
+    if (res.reuse_histogram.size() <= bin)
+      res.reuse_histogram.resize(bin + 1, 0);
+    ++res.reuse_histogram[bin];
+    auto &level = res.levels[line_levels[i]];
+    ++level.accesses;
+    for (int c = 0; c < caches.size(); ++c) {
+      if (caches[c].access(lines[i]))
+        break;
+      ++res.misses[c];
+      ++level.misses[c];
+    }
+  }
+  return res;
+}
+
+void print(std::ostream &os, const Report &report) {
+  const double n = std::max(1, report.nsites);
+  os << "sites: " << report.nsites << ", per site:" << std::endl;
+  os << std::left << std::setw(20) << "level" << std::right << std::setw(10)
+     << "lines";
+  for (const auto &name : report.cache_names)
+    os << std::setw(10) << name + " miss";
+  os << std::endl << std::fixed << std::setprecision(3);
+  auto line = [&](const std::string &name, long accesses,
+                  const vector<long> &misses) {
+    os << std::left << std::setw(20) << name << std::right << std::setw(10)
+       << accesses / n;
+    for (long m : misses)
+      os << std::setw(10) << m / n;
+    os << std::endl;
+  };
+  for (const auto &l : report.levels)
+    line(l.level_name, l.accesses, l.misses);
+  line("total", report.accesses, report.misses);
+
+  os << "reuse distance (lines)   fraction" << std::endl;
+  for (int bin = 0; bin < report.reuse_histogram.size(); ++bin) {
+    std::string range =
+        bin == 0   ? "first access"
+        : bin == 1 ? "0"
+                   : "[" + std::to_string(1l << (bin - 2)) + ", " +
+                         std::to_string(1l << (bin - 1)) + ")";
+    os << std::left << std::setw(25) << range << std::right
+       << (double)report.reuse_histogram[bin] / std::max(1l, report.accesses)
+       << std::endl;
+  }
+}
+
+} // namespace cache_simulation
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
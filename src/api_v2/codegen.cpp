@@ -0,0 +1,472 @@
+#include "api_v2/codegen.hpp"
+#include "exceptions/exceptions.hpp"
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace codegen {
+
+int AffineRegion::volume() const {
+  int res = 1;
+  for (int d = 0; d < lo.size(); ++d)
+    res *= hi[d] - lo[d];
+  return res;
+}
+
+namespace {
+
+/* The number of children at each level,
+ * throws if it is not the same for all the nodes of a level. */
+vector<int> box_extents(const KVTreePv2<NodeType> &tree) {
+  vector<int> extents;
+  std::function<void(const KVTreePv2<NodeType> &, int)> visit =
+      [&](const KVTreePv2<NodeType> &t, int level) {
+        int n = t->children.size();
+        if (n == 0 and level == extents.size())
+          return;
+        if (level == extents.size())
+          extents.push_back(n);
+        if (extents[level] != n)
+          throw std::invalid_argument("The start tree is not a box.");
+        for (const auto &c : t->children)
+          visit(c.second, level + 1);
+      };
+  visit(tree, 0);
+  return extents;
+}
+
+/* The indices of the leaves (including padding), in depth-first order. */
+vector<vector<int>> leaf_indices(const KVTreePv2<NodeType> &tree) {
+  vector<vector<int>> res;
+  vector<int> idx;
+  std::function<void(const KVTreePv2<NodeType> &)> visit =
+      [&](const KVTreePv2<NodeType> &t) {
+        if (not t or t->children.size() == 0) {
+          res.push_back(idx);
+          return;
+        }
+        for (int i = 0; i < t->children.size(); ++i) {
+          idx.push_back(i);
+          visit(t->children[i].second);
+          idx.pop_back();
+        }
+      };
+  visit(tree);
+  return res;
+}
+
+/* Coordinates in a box, the first dimension being the slowest. */
+struct Box {
+  vector<int> lo;
+  vector<int> hi;
+
+  int volume() const {
+    int res = 1;
+    for (int d = 0; d < lo.size(); ++d)
+      res *= hi[d] - lo[d];
+    return res;
+  }
+  // calls f(x) for all x in the box, until f returns false
+  template <class F> bool for_each(F f) const {
+    vector<int> x = lo;
+    for (int i = 0; i < volume(); ++i) {
+      if (not f(x))
+        return false;
+      for (int d = x.size() - 1; d >= 0; --d) {
+        if (++x[d] < hi[d])
+          break;
+        x[d] = lo[d];
+      }
+    }
+    return true;
+  }
+};
+
+class RegionFitter {
+public:
+  RegionFitter(const vector<int> &_extents, const vector<int> &_offsets,
+               IndexFunctions &_res)
+      : extents(_extents), offsets(_offsets), res(_res) {}
+
+  void fit(const Box &box) {
+    int f0 = F(box.lo);
+    vector<int> strides(extents.size(), 0);
+    for (int d = 0; d < extents.size(); ++d)
+      if (box.hi[d] - box.lo[d] > 1)
+        strides[d] = F(shifted(box.lo, d, 1)) - f0;
+    auto affine = [&](const vector<int> &x) {
+      int expected = f0;
+      for (int d = 0; d < x.size(); ++d)
+        expected += strides[d] * (x[d] - box.lo[d]);
+      return F(x) == expected;
+    };
+    vector<int> failing;
+    if (box.for_each([&](const vector<int> &x) {
+          if (affine(x))
+            return true;
+          failing = x;
+          return false;
+        })) {
+      if (box.volume() == 1)
+        res.irregular_coords.push_back({box.lo, f0});
+      else
+        res.regions.push_back({box.lo, box.hi, f0, strides});
+      return;
+    }
+    // Cutting where the function stops being affine
+    // along a line starting from the corner,
+    // or where it is not affine in the box.
+    for (int d = 0; d < extents.size(); ++d)
+      for (int t = 2; t < box.hi[d] - box.lo[d]; ++t)
+        if (not affine(shifted(box.lo, d, t)))
+          return cut(box, d, box.lo[d] + t);
+    for (int d = 0; d < extents.size(); ++d)
+      if (failing[d] > box.lo[d])
+        return cut(box, d, failing[d]);
+  }
+
+private:
+  const vector<int> &extents;
+  const vector<int> &offsets;
+  IndexFunctions &res;
+
+  int F(const vector<int> &x) const {
+    int i = 0;
+    for (int d = 0; d < x.size(); ++d)
+      i = i * extents[d] + x[d];
+    return offsets[i];
+  }
+  static vector<int> shifted(vector<int> x, int d, int t) {
+    x[d] += t;
+    return x;
+  }
+  void cut(const Box &box, int d, int position) {
+    Box first = box, second = box;
+    first.hi[d] = position;
+    second.lo[d] = position;
+    fit(first);
+    fit(second);
+  }
+};
+
+/* See OffsetSegment. */
+void fit_segments(const vector<vector<int>> &coords, IndexFunctions &res) {
+  const int N = coords.size();
+  auto block_matches = [&](int start, int ref, int len,
+                           const vector<int> &shift) {
+    for (int j = 0; j < len; ++j) {
+      if (coords[start + j].size() == 0)
+        return false;
+      for (int d = 0; d < shift.size(); ++d)
+        if (coords[start + j][d] != coords[ref + j][d] + shift[d])
+          return false;
+    }
+    return true;
+  };
+  int o = 0;
+  while (o < N) {
+    if (coords[o].size() == 0) {
+      ++o;
+      continue;
+    }
+    OffsetSegment s{o, 1, coords[o], {}, {}};
+    while (o + s.length < N and coords[o + s.length].size() != 0) {
+      vector<int> step = coords[o + s.length];
+      for (int d = 0; d < step.size(); ++d)
+        step[d] -= s.base[d];
+      int E = 1;
+      vector<int> shift = step;
+      while (o + (E + 1) * s.length <= N and
+             block_matches(o + E * s.length, o, s.length, shift)) {
+        ++E;
+        for (int d = 0; d < step.size(); ++d)
+          shift[d] += step[d];
+      }
+      if (E == 1)
+        break;
+      s.steps.push_back(step);
+      s.extents.push_back(E);
+      s.length *= E;
+    }
+    if (s.length == 1)
+      res.irregular_offsets.push_back({o, s.base});
+    else
+      res.segments.push_back(s);
+    o += s.length;
+  }
+}
+
+bool in_lattice(const vector<int> &extents, const int *x) {
+  for (int d = 0; d < extents.size(); ++d)
+    if (x[d] < 0 or extents[d] <= x[d])
+      return false;
+  return true;
+}
+
+} // namespace
+
+IndexFunctions analyse(TransformNetwork &network,            //
+                       const std::string &start_node_name, //
+                       const std::string &end_node_name) {
+  IndexFunctions res;
+  res.start_node_name = start_node_name;
+  res.end_node_name = end_node_name;
+  res.extents = box_extents(network[start_node_name]->output_tree);
+  auto leaves = leaf_indices(network[end_node_name]->output_tree);
+  res.noffsets = leaves.size();
+  std::map<vector<int>, int> leaf_offsets;
+  for (int o = 0; o < leaves.size(); ++o)
+    leaf_offsets[leaves[o]] = o;
+
+  auto transform = network.get_transform(start_node_name, end_node_name);
+  const int ndims = res.extents.size();
+  Box lattice{vector<int>(ndims, 0), res.extents};
+  vector<int> offsets;
+  lattice.for_each([&](const vector<int> &x) {
+    int offset = -1;
+    for (const auto &out : transform->apply(x)) {
+      auto it = leaf_offsets.find(out);
+      if (it != leaf_offsets.end() and (offset == -1 or it->second < offset))
+        offset = it->second;
+    }
+    offsets.push_back(offset);
+    return true;
+  });
+  RegionFitter(res.extents, offsets, res).fit(lattice);
+
+  vector<vector<int>> coords(res.noffsets);
+  for (int o = 0; o < res.noffsets; ++o) {
+    vector<vector<int>> ins;
+    try {
+      ins = transform->inverse(leaves[o]);
+    } catch (const KeyNotFoundError &) {
+      continue; // padding
+    }
+    if (ins.size() != 0 and ins[0].size() == ndims and
+        in_lattice(res.extents, ins[0].data()))
+      coords[o] = ins[0];
+  }
+  fit_segments(coords, res);
+
+  // The largest regions are checked first
+  std::stable_sort(res.regions.begin(), res.regions.end(),
+                   [](const AffineRegion &a, const AffineRegion &b) {
+                     return a.volume() > b.volume();
+                   });
+  std::stable_sort(res.segments.begin(), res.segments.end(),
+                   [](const OffsetSegment &a, const OffsetSegment &b) {
+                     return a.length > b.length;
+                   });
+  return res;
+}
+
+int coords_to_offset(const IndexFunctions &f, const int *x) {
+  if (not in_lattice(f.extents, x))
+    return -1;
+  const int ndims = f.extents.size();
+  for (const auto &r : f.regions) {
+    bool inside = true;
+    for (int d = 0; d < ndims; ++d)
+      inside = inside and r.lo[d] <= x[d] and x[d] < r.hi[d];
+    if (inside) {
+      int offset = r.offset0;
+      for (int d = 0; d < ndims; ++d)
+        offset += r.strides[d] * (x[d] - r.lo[d]);
+      return offset;
+    }
+  }
+  for (const auto &e : f.irregular_coords)
+    if (std::equal(e.first.begin(), e.first.end(), x))
+      return e.second;
+  return -1;
+}
+
+bool offset_to_coords(const IndexFunctions &f, int offset, int *x) {
+  const int ndims = f.extents.size();
+  for (const auto &s : f.segments)
+    if (s.start <= offset and offset < s.start + s.length) {
+      int r = offset - s.start;
+      int radix = 1;
+      std::copy(s.base.begin(), s.base.end(), x);
+      for (int k = 0; k < s.extents.size(); ++k) {
+        int m = r / radix % s.extents[k];
+        for (int d = 0; d < ndims; ++d)
+          x[d] += s.steps[k][d] * m;
+        radix *= s.extents[k];
+      }
+      return true;
+    }
+  for (const auto &e : f.irregular_offsets)
+    if (e.first == offset) {
+      std::copy(e.second.begin(), e.second.end(), x);
+      return true;
+    }
+  return false;
+}
+
+namespace {
+/* "c + a * x[0] + b * x[1]", without the zero terms. */
+std::string affine_expression(int c, const vector<int> &coefficients,
+                              const vector<std::string> &variables) {
+  std::stringstream ss;
+  ss << c;
+  for (int i = 0; i < coefficients.size(); ++i) {
+    if (coefficients[i] == 0)
+      continue;
+    ss << (coefficients[i] < 0 ? " - " : " + ");
+    if (std::abs(coefficients[i]) != 1)
+      ss << std::abs(coefficients[i]) << " * ";
+    ss << variables[i];
+  }
+  return ss.str();
+}
+
+std::string int_list(const vector<int> &v) {
+  std::stringstream ss;
+  ss << "{";
+  for (int i = 0; i < v.size(); ++i)
+    ss << (i == 0 ? "" : ", ") << v[i];
+  ss << "}";
+  return ss.str();
+}
+} // namespace
+
+std::string generate_header(const IndexFunctions &f,
+                            const std::string &namespace_name) {
+  const int ndims = f.extents.size();
+  std::string guard;
+  for (char c : namespace_name)
+    guard += std::isalnum(c) ? std::toupper(c) : '_';
+  guard += "_H_";
+  vector<std::string> xs;
+  for (int d = 0; d < ndims; ++d)
+    xs.push_back("x[" + std::to_string(d) + "]");
+
+  std::stringstream ss;
+  ss << "// Generated by hypercubes::slow::internals::codegen::generate_header\n"
+     << "// from \"" << f.start_node_name << "\" to \"" << f.end_node_name
+     << "\".\n"
+     << "#ifndef " << guard << "\n"
+     << "#define " << guard << "\n\n"
+     << "namespace " << namespace_name << " {\n\n"
+     << "constexpr int ndims = " << ndims << ";\n"
+     << "constexpr int extents[ndims] = " << int_list(f.extents) << ";\n"
+     << "constexpr int noffsets = " << f.noffsets << ";\n\n";
+
+  ss << "namespace detail {\n";
+  ss << "constexpr int nirregular_coords = " << f.irregular_coords.size()
+     << ";\n";
+  if (f.irregular_coords.size() != 0) {
+    ss << "constexpr int irregular_coords[][ndims + 1] = {\n";
+    for (const auto &e : f.irregular_coords) {
+      vector<int> row = e.first;
+      row.push_back(e.second);
+      ss << "    " << int_list(row) << ",\n";
+    }
+    ss << "};\n";
+  }
+  ss << "constexpr int nirregular_offsets = " << f.irregular_offsets.size()
+     << ";\n";
+  if (f.irregular_offsets.size() != 0) {
+    ss << "constexpr int irregular_offsets[][ndims + 1] = {\n";
+    for (const auto &e : f.irregular_offsets) {
+      vector<int> row{e.first};
+      row.insert(row.end(), e.second.begin(), e.second.end());
+      ss << "    " << int_list(row) << ",\n";
+    }
+    ss << "};\n";
+  }
+  ss << "} // namespace detail\n\n";
+
+  // coords_to_offset
+  ss << "/* The offset of the site with coordinates x,\n"
+     << " * -1 if x is out of the lattice. */\n"
+     << "constexpr inline int coords_to_offset(const int *x) {\n"
+     << "  for (int d = 0; d < ndims; ++d)\n"
+     << "    if (x[d] < 0 or extents[d] <= x[d])\n"
+     << "      return -1;\n";
+  for (const auto &r : f.regions) {
+    vector<std::string> conditions;
+    for (int d = 0; d < ndims; ++d) {
+      if (r.lo[d] != 0)
+        conditions.push_back(std::to_string(r.lo[d]) + " <= " + xs[d]);
+      if (r.hi[d] != f.extents[d])
+        conditions.push_back(xs[d] + " < " + std::to_string(r.hi[d]));
+    }
+    int c = r.offset0;
+    for (int d = 0; d < ndims; ++d)
+      c -= r.strides[d] * r.lo[d];
+    std::string indent = "  ";
+    if (conditions.size() != 0) {
+      ss << "  if (";
+      for (int i = 0; i < conditions.size(); ++i)
+        ss << (i == 0 ? "" : " and ") << conditions[i];
+      ss << ")\n";
+      indent = "    ";
+    }
+    ss << indent << "return " << affine_expression(c, r.strides, xs) << ";\n";
+  }
+  if (f.irregular_coords.size() != 0)
+    ss << "  for (int i = 0; i < detail::nirregular_coords; ++i) {\n"
+       << "    bool found = true;\n"
+       << "    for (int d = 0; d < ndims; ++d)\n"
+       << "      found = found and detail::irregular_coords[i][d] == x[d];\n"
+       << "    if (found)\n"
+       << "      return detail::irregular_coords[i][ndims];\n"
+       << "  }\n";
+  ss << "  return -1;\n"
+     << "}\n\n";
+
+  // offset_to_coords
+  ss << "/* Writes the coordinates of the site at the given offset in x,\n"
+     << " * returns false for padding and out-of-range offsets. */\n"
+     << "constexpr inline bool offset_to_coords(int offset, int *x) {\n";
+  for (const auto &s : f.segments) {
+    ss << "  if (" << s.start << " <= offset and offset < "
+       << s.start + s.length << ") {\n"
+       << "    const int r = offset - " << s.start << ";\n";
+    vector<std::string> digits;
+    int radix = 1;
+    for (int k = 0; k < s.extents.size(); ++k) {
+      std::string digit = radix == 1 ? "r" : "r / " + std::to_string(radix);
+      if (k != s.extents.size() - 1)
+        digit = "(" + digit + " % " + std::to_string(s.extents[k]) + ")";
+      else if (radix != 1)
+        digit = "(" + digit + ")";
+      digits.push_back(digit);
+      radix *= s.extents[k];
+    }
+    for (int d = 0; d < ndims; ++d) {
+      vector<int> coefficients;
+      for (const auto &step : s.steps)
+        coefficients.push_back(step[d]);
+      ss << "    " << xs[d] << " = "
+         << affine_expression(s.base[d], coefficients, digits) << ";\n";
+    }
+    ss << "    return true;\n"
+       << "  }\n";
+  }
+  if (f.irregular_offsets.size() != 0)
+    ss << "  for (int i = 0; i < detail::nirregular_offsets; ++i)\n"
+       << "    if (detail::irregular_offsets[i][0] == offset) {\n"
+       << "      for (int d = 0; d < ndims; ++d)\n"
+       << "        x[d] = detail::irregular_offsets[i][d + 1];\n"
+       << "      return true;\n"
+       << "    }\n";
+  ss << "  return false;\n"
+     << "}\n\n"
+     << "} // namespace " << namespace_name << "\n\n"
+     << "#endif // " << guard << "\n";
+  return ss.str();
+}
+
+} // namespace codegen
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
@@ -0,0 +1,158 @@
+#include "api_v2/compiled_tree.hpp"
+#include "api_v2/tree_transform.hpp"
+#include <algorithm>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+int IndexList::size() const { return offsets.size() - 1; }
+void IndexList::clear() {
+  data.clear();
+  offsets.resize(1);
+}
+void IndexList::push_back(const vector<int> &idx) {
+  std::copy(idx.begin(), idx.end(), std::back_inserter(data));
+  offsets.push_back(data.size());
+}
+vector<int> IndexList::operator[](int i) const {
+  return vector<int>(data.begin() + offsets[i], data.begin() + offsets[i + 1]);
+}
+
+int CompiledKVTree::nnodes() const { return child_start.size() - 1; }
+int CompiledKVTree::nchildren(int node) const {
+  return child_start[node + 1] - child_start[node];
+}
+
+void index_pullback(const CompiledKVTree &tree, //
+                    const int *in,              //
+                    int in_size,                //
+                    vector<int> &out) {
+  int node = tree.root;
+  for (int i = 0; i < in_size; ++i) {
+    int idx = in[i];
+    int nchildren = tree.nchildren(node);
+    // negative values (including no_key) are caught here too
+    if ((unsigned)idx >= (unsigned)nchildren)
+      throw_index_pullback_error(idx, nchildren);
+    int c = tree.child_start[node] + idx;
+    for (int k = tree.key_start[c]; k < tree.key_start[c + 1]; ++k)
+      out.push_back(tree.keys[k]);
+    node = tree.child_node[c];
+  }
+}
+
+bool index_pullback_safe(const CompiledKVTree &tree, //
+                         const int *in,              //
+                         int in_size,                //
+                         vector<int> &out) {
+  int old_size = out.size();
+  index_pullback(tree, in, in_size, out);
+  if (std::find(out.begin() + old_size, out.end(), TreeFactory::no_key) !=
+      out.end()) {
+    out.resize(old_size);
+    return false;
+  }
+  return true;
+}
+
+namespace {
+/* The index being built is always kept
+ * at the end of out.data, after the last complete result.
+ * When a result is complete, its end is recorded in out.offsets
+ * and the prefix it shares with the next result is copied again. */
+void _index_pushforward(const CompiledKVTree &tree, //
+                        int node,                   //
+                        const int *in,              //
+                        int in_size,                //
+                        int depth,                  //
+                        IndexList &out) {
+  if (in_size == 0) {
+    out.offsets.push_back(out.data.size());
+    return;
+  }
+  if (node == -1)
+    return;
+  int cstart = tree.child_start[node];
+  int nchildren = tree.nchildren(node);
+  if (nchildren == 0)
+    return;
+
+  auto prepare_prefix = [&out, depth]() {
+    int committed = out.offsets.back();
+    if (out.data.size() == committed and depth > 0) {
+      // A result has just been completed, copying its prefix
+      int prev_start = out.offsets[out.size() - 1];
+      for (int k = 0; k < depth; ++k) {
+        int v = out.data[prev_start + k];
+        out.data.push_back(v);
+      }
+    } else
+      out.data.resize(committed + depth);
+  };
+
+  int keylen = tree.key_start[cstart + 1] - tree.key_start[cstart];
+  if (keylen > in_size)
+    return;
+  if (tree.direct[node]) {
+    int idx = in[0];
+    if ((unsigned)idx < (unsigned)nchildren) {
+      prepare_prefix();
+      out.data.push_back(idx);
+      _index_pushforward(tree, tree.child_node[cstart + idx], //
+                         in + 1, in_size - 1, depth + 1, out);
+    }
+    return;
+  }
+  for (int i = 0; i < nchildren; ++i) {
+    int c = cstart + i;
+    int kstart = tree.key_start[c];
+    int kend = tree.key_start[c + 1];
+    if (kend - kstart == keylen and
+        std::equal(in, in + keylen, tree.keys.begin() + kstart)) {
+      prepare_prefix();
+      out.data.push_back(i);
+      _index_pushforward(tree, tree.child_node[c],     //
+                         in + keylen, in_size - keylen, //
+                         depth + 1, out);
+    }
+  }
+}
+} // namespace
+
+void index_pushforward(const CompiledKVTree &tree, //
+                       const int *in,              //
+                       int in_size,                //
+                       IndexList &out) {
+  _index_pushforward(tree, tree.root, in, in_size, 0, out);
+  // removing partial results that led nowhere
+  out.data.resize(out.offsets.back());
+}
+
+void index_pullback(const CompiledKVTree &tree, //
+                    const int *in,              //
+                    int nindices,               //
+                    int in_size,                //
+                    IndexList &out) {
+  for (int i = 0; i < nindices; ++i) {
+    index_pullback(tree, in + i * in_size, in_size, out.data);
+    out.offsets.push_back(out.data.size());
+  }
+}
+
+void index_pushforward(const CompiledKVTree &tree, //
+                       const int *in,              //
+                       int nindices,               //
+                       int in_size,                //
+                       IndexList &out,             //
+                       vector<int> &first_result) {
+  first_result.push_back(out.size());
+  for (int i = 0; i < nindices; ++i) {
+    index_pushforward(tree, in + i * in_size, in_size, out);
+    first_result.push_back(out.size());
+  }
+}
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
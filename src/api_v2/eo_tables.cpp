@@ -0,0 +1,123 @@
+#include "api_v2/eo_tables.hpp"
+#include "api_v2/site_offsets.hpp"
+#include <functional>
+#include <stdexcept>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace eo_tables {
+
+int ParityTables::nsites(int parity) const { return offsets[parity].size(); }
+const int32_t *ParityTables::up(int parity, int i) const {
+  return iup[parity].data() + i * nsites(parity);
+}
+const int32_t *ParityTables::down(int parity, int i) const {
+  return idn[parity].data() + i * nsites(parity);
+}
+
+ParityTables make_parity_tables(TransformNetwork &network,          //
+                                const std::string &start_node_name, //
+                                const std::string &end_node_name,   //
+                                const std::string &eo_level_name,   //
+                                const vector<std::string> &levels_reference) {
+  const auto start = network[start_node_name];
+  const auto sites =
+      site_offsets::make_site_offsets(network, start_node_name, end_node_name);
+  vector<int> reference_levels;
+  for (const auto &name : levels_reference)
+    reference_levels.push_back(start->find_level(name));
+  const auto end = network[end_node_name];
+  const int eo_level = end->find_level(eo_level_name);
+  auto to_start = network.get_fused_transform(end_node_name, start_node_name);
+  auto transform = [&to_start](vector<int> idx) {
+    return to_start->apply(idx);
+  };
+
+  ParityTables res;
+  res.directions = levels_reference;
+
+  // The EO subtree of each leaf, in depth-first order.
+  vector<int> leaf_subtrees;
+  {
+    vector<int> idx;
+    int subtree = -1;
+    std::function<void(const KVTreePv2<NodeType> &)> visit =
+        [&](const KVTreePv2<NodeType> &t) {
+          if (not t or t->children.size() == 0) {
+            leaf_subtrees.push_back(idx.size() > eo_level ? subtree : -1);
+            return;
+          }
+          if (idx.size() == eo_level) {
+            res.subtrees.push_back(EOSubtree{
+                idx, TreeFactory::eo_origin_parity(t, idx, transform,
+                                                   reference_levels)});
+            subtree = res.subtrees.size() - 1;
+          }
+          for (int i = 0; i < t->children.size(); ++i) {
+            idx.push_back(i);
+            visit(t->children[i].second);
+            idx.pop_back();
+          }
+        };
+    visit(end->output_tree);
+  }
+
+  const auto &leaves = sites.leaves;
+  vector<int> parities(leaves.size(), -1);
+  vector<int> cb_offsets(leaves.size(), -1);
+  for (int o = 0; o < leaves.size(); ++o) {
+    const auto &x = sites.coords[o];
+    if (x.empty())
+      continue; // padding
+    if (sites.offset_of_site[sites.lex(x)] != o)
+      continue; // another copy
+    if (leaf_subtrees[o] == -1)
+      throw std::invalid_argument("The level " + eo_level_name +
+                                  " is below some leaves.");
+    int sum = 0;
+    for (int l : reference_levels)
+      sum += x[l];
+    const int parity =
+        (leaves[o][eo_level] + res.subtrees[leaf_subtrees[o]].origin_parity) %
+        2;
+    if (parity != sum % 2)
+      throw std::invalid_argument("The parities at the level " +
+                                  eo_level_name +
+                                  " do not match the coordinates.");
+    parities[o] = parity;
+    cb_offsets[o] = res.offsets[parity].size();
+    res.offsets[parity].push_back(o);
+  }
+
+  const int ndirs = reference_levels.size();
+  for (int p : {0, 1}) {
+    const int n = res.nsites(p);
+    res.iup[p].resize(ndirs * n);
+    res.idn[p].resize(ndirs * n);
+    for (int i = 0; i < ndirs; ++i) {
+      const int d = reference_levels[i];
+      vector<int> disp(sites.ndims(), 0);
+      for (int s = 0; s < n; ++s) {
+        for (int dir : {-1, 1}) {
+          disp[d] = dir;
+          const int other = sites.neighbour(res.offsets[p][s], disp);
+          disp[d] = 0;
+          if (other == -1)
+            throw std::invalid_argument("Some sites are not in the layout.");
+          if (parities[other] == p)
+            throw std::invalid_argument(
+                "Neighbours in direction " + levels_reference[i] +
+                " have the same parity.");
+          (dir == 1 ? res.iup : res.idn)[p][i * n + s] = cb_offsets[other];
+        }
+      }
+    }
+  }
+  return res;
+}
+
+} // namespace eo_tables
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
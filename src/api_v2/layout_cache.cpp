@@ -0,0 +1,124 @@
+#include "api_v2/layout_cache.hpp"
+#include "api_v2/serialisation.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/hash_utils.hpp"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace transform_requests {
+
+std::uint64_t hash(const vector<TransformRequestP> &requests) {
+  std::string c = canonical_form::requests(requests);
+  return fnv1a(c.data(), c.size());
+}
+
+LayoutCache::LayoutCache(const std::string &directory)
+    : directory(directory) {
+  make_directory(directory);
+}
+
+std::string
+LayoutCache::filename(const vector<TransformRequestP> &requests) const {
+  std::stringstream ss;
+  ss << directory << "/" << std::hex << std::setfill('0') << std::setw(16)
+     << hash(requests) << ".v" << std::dec << serialisation::format_version
+     << ".hcub";
+  return ss.str();
+}
+
+const LayoutCache::Stats &LayoutCache::get_stats() const { return stats; }
+
+namespace {
+/* A cache file starts with the canonical form of the requests,
+ * so that a file of other requests with the same hash is detected:
+ * "HCLK", 4 zero bytes, the size of the key (64-bit), the key,
+ * padded to a multiple of 8 bytes, then the saved network. */
+const char key_magic[4] = {'H', 'C', 'L', 'K'};
+const std::size_t key_header_size = 16;
+
+struct KeyMismatch {};
+
+void save_entry(TransformNetwork &network, //
+                const std::string &key,    //
+                std::ostream &out) {
+  std::string data(key_magic, sizeof(key_magic));
+  data.append(4, '\0');
+  std::uint64_t key_size = key.size();
+  data.append(reinterpret_cast<const char *>(&key_size), sizeof(key_size));
+  data += key;
+  data.append((8 - data.size() % 8) % 8, '\0');
+  data += serialisation::serialise(network);
+  out.write(data.data(), data.size());
+}
+
+/* Throws KeyMismatch if the file is for other requests. */
+void load_entry(TreeFactory &f,              //
+                const std::string &key,      //
+                const std::string &filename, //
+                TransformNetwork &network) {
+  std::ifstream in(filename, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  if (not in.good() and not in.eof())
+    throw std::runtime_error("Cannot read " + filename);
+  std::uint64_t key_size;
+  if (data.size() < key_header_size or
+      data.compare(0, sizeof(key_magic), key_magic, sizeof(key_magic)) != 0)
+    throw serialisation::FormatError(filename + " is not a cache file.");
+  std::memcpy(&key_size, data.data() + 8, sizeof(key_size));
+  if (key_size > data.size() - key_header_size)
+    throw serialisation::FormatError(filename + " is truncated.");
+  if (data.compare(key_header_size, key_size, key) != 0)
+    throw KeyMismatch();
+  std::size_t start = (key_header_size + key_size + 7) / 8 * 8;
+  if (start > data.size())
+    throw serialisation::FormatError(filename + " is truncated.");
+  serialisation::deserialise_network(f, data.data() + start,
+                                     data.size() - start, network);
+}
+} // namespace
+
+LayoutCache::Result
+LayoutCache::build(TreeFactory &f,            //
+                   TransformNetwork &network, //
+                   const vector<TransformRequestP> &requests) {
+  std::string name = filename(requests);
+  std::string key = canonical_form::requests(requests);
+  if (access(name.c_str(), R_OK) == 0) {
+    try {
+      TransformNetwork loaded;
+      load_entry(f, key, name, loaded);
+      network = loaded;
+      ++stats.hits;
+      return HIT;
+    } catch (const KeyMismatch &) {
+      // other requests with the same hash
+      ++stats.collisions;
+    } catch (const std::exception &) {
+      // e.g., the file is corrupted or has been removed meanwhile
+      ++stats.invalid;
+    }
+  }
+  ++stats.misses;
+  Build(f, network, requests);
+
+  try {
+    write_atomically(name,
+                     [&](std::ostream &out) { save_entry(network, key, out); });
+  } catch (const std::exception &) {
+    ++stats.write_failures;
+  }
+  return MISS;
+}
+
+} // namespace transform_requests
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
@@ -0,0 +1,383 @@
+#include "api_v2/layout_tuner.hpp"
+#include "api_v2/cache_simulation.hpp"
+#include "api_v2/site_offsets.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/hash_utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace layout_tuning {
+
+const Candidate &TuningResult::winner() const {
+  return measurements.at(best).candidate;
+}
+
+vector<std::string> dimension_names(int ndims) {
+  const vector<std::string> names{"X", "Y", "Z", "T"};
+  vector<std::string> res;
+  for (int d = 0; d < ndims; ++d)
+    res.push_back(d < names.size() ? names[d] : "D" + std::to_string(d));
+  return res;
+}
+
+namespace {
+Candidate make_candidate(const vector<int> &sizes, //
+                         int block_size,           // 0: unblocked
+                         const vector<int> &order, //
+                         bool eo) {
+  using namespace trms;
+  auto names = dimension_names(sizes.size());
+  vector<int> blocks(sizes);
+  vector<TransformRequestP> chain;
+  for (int d = 0; d < sizes.size(); ++d)
+    if (block_size > 0 and block_size < sizes[d] and
+        sizes[d] % block_size == 0) {
+      blocks[d] = block_size;
+      chain.push_back(QSub(names[d], sizes[d] / block_size, //
+                           "B" + names[d], 0, 0));
+    }
+  bool blocked = not chain.empty();
+  if (blocked)
+    chain.push_back(Renumber());
+
+  vector<std::string> levels;
+  if (blocked)
+    for (int d : order)
+      if (blocks[d] != sizes[d])
+        levels.push_back("B" + names[d]);
+  for (int d : order)
+    levels.push_back(names[d]);
+  chain.push_back(LevelSwap(levels));
+  chain.push_back(Flatten(names[order.front()], names[order.back()], "S"));
+
+  if (eo)
+    chain.push_back(EONaive("S", "EO"));
+
+  std::stringstream name;
+  name << "b";
+  for (int d = 0; d < sizes.size(); ++d)
+    name << (d == 0 ? "" : "x") << blocks[d];
+  name << "/";
+  for (int d : order)
+    name << names[d];
+  name << (eo ? "/eo" : "");
+
+  return Candidate{name.str(),
+                   {Id(sizes, names, "root"), TreeComposition(chain, "layout")}};
+}
+} // namespace
+
+vector<Candidate> enumerate_candidates(const vector<int> &sizes,
+                                       const TunerOptions &options) {
+  if (sizes.empty())
+    throw std::invalid_argument("The lattice must have at least a dimension.");
+  auto orders = options.dimension_orders;
+  if (orders.empty()) {
+    vector<int> natural(sizes.size());
+    std::iota(natural.begin(), natural.end(), 0);
+    orders.push_back(natural);
+    if (sizes.size() > 1)
+      orders.push_back(vector<int>(natural.rbegin(), natural.rend()));
+  }
+  for (const auto &order : orders) {
+    vector<int> sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+    for (int d = 0; d < sizes.size(); ++d)
+      if (sorted.size() != sizes.size() or sorted[d] != d)
+        throw std::invalid_argument(
+            "Dimension orders must be permutations of the dimensions.");
+  }
+  vector<int> block_sizes{0};
+  block_sizes.insert(block_sizes.end(), options.block_sizes.begin(),
+                     options.block_sizes.end());
+
+  vector<Candidate> res;
+  std::set<std::string> names;
+  auto add = [&](const Candidate &c) {
+    if (names.insert(c.name).second)
+      res.push_back(c);
+  };
+  for (int b : block_sizes) {
+    bool even_origins = true;
+    for (int size : sizes)
+      if (b > 0 and b < size and size % b == 0)
+        even_origins = even_origins and b % 2 == 0;
+    for (const auto &order : orders) {
+      add(make_candidate(sizes, b, order, false));
+      if (options.try_eo and even_origins)
+        add(make_candidate(sizes, b, order, true));
+    }
+  }
+  return res;
+}
+
+vector<int> neighbour_table(TreeFactory &f, const Candidate &candidate) {
+  transform_networks::TransformNetwork network;
+  transform_requests::Build(f, network, candidate.requests);
+  return site_offsets::neighbour_table(
+      site_offsets::make_site_offsets(network, "root", "layout"));
+}
+
+double estimated_cost(const vector<int> &neighbours, //
+                      int ndims,                     //
+                      const TunerOptions &options) {
+  const int nn = 2 * ndims;
+  const int noffsets = neighbours.size() / nn;
+  const long site_bytes = options.site_doubles * sizeof(double);
+  const long line_bytes = options.line_bytes;
+  cache_simulation::SetAssociativeCache cache(options.cache_bytes, //
+                                              options.line_bytes,  //
+                                              options.cache_ways);
+  // 'out' is stored after 'in'
+  const long out_start = (noffsets * site_bytes + line_bytes - 1) / line_bytes;
+  auto access = [&](long first_line, int offset) {
+    long first = offset * site_bytes / line_bytes;
+    long last = ((offset + 1) * site_bytes - 1) / line_bytes;
+    for (long line = first; line <= last; ++line)
+      cache.access(first_line + line);
+  };
+  for (int o = 0; o < noffsets; ++o) {
+    for (int i = 0; i < nn; ++i)
+      access(0, neighbours[nn * o + i]);
+    access(out_start, o);
+  }
+  return noffsets == 0 ? 0 : (double)cache.get_misses() / noffsets;
+}
+
+void stencil_sweep(const vector<int> &neighbours, //
+                   int nn,                        //
+                   int site_doubles,              //
+                   const double *in,              //
+                   double *out) {
+  const int noffsets = neighbours.size() / nn;
+  const int sd = site_doubles;
+  for (int o = 0; o < noffsets; ++o) {
+    double *res = out + o * sd;
+    std::fill(res, res + sd, 0.0);
+    for (int i = 0; i < nn; ++i) {
+      const double *nb = in + neighbours[nn * o + i] * sd;
+      for (int c = 0; c < sd; ++c)
+        res[c] += nb[c];
+    }
+  }
+}
+
+double measure_stencil(const vector<int> &neighbours, //
+                       int ndims,                     //
+                       const TunerOptions &options) {
+  const int nn = 2 * ndims;
+  const int noffsets = neighbours.size() / nn;
+  const int sd = options.site_doubles;
+  vector<double> in(noffsets * sd, 1.0), out(noffsets * sd);
+  auto sweep = [&]() {
+    stencil_sweep(neighbours, nn, sd, in.data(), out.data());
+    // so that the sweep is not optimised away
+    volatile double sink = out[noffsets * sd / 2];
+    (void)sink;
+  };
+  sweep(); // warm-up
+  double best = std::numeric_limits<double>::max();
+  for (int r = 0; r < std::max(1, options.repetitions); ++r) {
+    auto start = std::chrono::steady_clock::now();
+    sweep();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+namespace {
+int fastest(const vector<Measurement> &measurements) {
+  int best = -1;
+  for (int i = 0; i < measurements.size(); ++i)
+    if (measurements[i].seconds >= 0 and
+        (best == -1 or
+         measurements[i].seconds < measurements[best].seconds))
+      best = i;
+  if (best == -1)
+    throw std::invalid_argument("No candidate has been measured.");
+  return best;
+}
+} // namespace
+
+TuningResult tune(TreeFactory &f,           //
+                  const vector<int> &sizes, //
+                  const TunerOptions &options) {
+  auto candidates = enumerate_candidates(sizes, options);
+  const int nmeasured = std::min<int>(std::max(1, options.keep), //
+                                      candidates.size());
+  // Only the tables of the nmeasured cheapest candidates so far are kept:
+  // 'kept' is a heap with the most expensive one (the last one, if equal)
+  // on top, which is dropped when a cheaper candidate is found.
+  vector<vector<int>> tables(candidates.size());
+  vector<double> costs;
+  vector<std::pair<double, int>> kept;
+  for (int c = 0; c < candidates.size(); ++c) {
+    tables[c] = neighbour_table(f, candidates[c]);
+    costs.push_back(estimated_cost(tables[c], sizes.size(), options));
+    kept.push_back({costs[c], c});
+    std::push_heap(kept.begin(), kept.end());
+    if (kept.size() > nmeasured) {
+      std::pop_heap(kept.begin(), kept.end());
+      tables[kept.back().second] = vector<int>();
+      kept.pop_back();
+    }
+  }
+  vector<int> order(candidates.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int a, int b) { return costs[a] < costs[b]; });
+  TuningResult res;
+  for (int i = 0; i < order.size(); ++i) {
+    const int c = order[i];
+    double seconds = -1;
+    if (i < nmeasured)
+      seconds = measure_stencil(tables[c], sizes.size(), options);
+    res.measurements.push_back({candidates[c], costs[c], seconds});
+    tables[c] = vector<int>(); // not needed anymore
+  }
+  res.best = fastest(res.measurements);
+  return res;
+}
+
+void print(std::ostream &os, const TuningResult &result) {
+  os << std::left << std::setw(32) << "candidate" << std::right
+     << std::setw(14) << "misses/site" << std::setw(14) << "time (ms)"
+     << std::endl;
+  for (int i = 0; i < result.measurements.size(); ++i) {
+    const auto &m = result.measurements[i];
+    os << std::left << std::setw(32) << m.candidate.name << std::right
+       << std::setw(14) << std::fixed << std::setprecision(3) << m.cost
+       << std::setw(14);
+    if (m.seconds >= 0)
+      os << m.seconds * 1e3;
+    else
+      os << "-";
+    os << (i == result.best ? "  <-" : "") << std::endl;
+  }
+  os << "winner: " << result.winner().name << std::endl
+     << transform_requests::canonical_form::requests(result.winner().requests)
+     << std::endl;
+}
+
+namespace {
+/* Everything the result depends on. */
+std::string tuning_key(const vector<int> &sizes,
+                       const TunerOptions &options) {
+  using transform_requests::canonical_form::write;
+  std::stringstream ss;
+  write(ss, sizes);
+  ss << ';';
+  write(ss, options.block_sizes);
+  ss << ';';
+  write(ss, options.dimension_orders);
+  ss << ';' << options.try_eo << ';' << options.site_doubles << ';'
+     << options.cache_bytes << ';' << options.cache_ways << ';'
+     << options.line_bytes << ';' << options.keep << ';'
+     << options.repetitions << ';';
+  write(ss, host_name());
+  ss << ';' << std::thread::hardware_concurrency();
+  return ss.str();
+}
+
+const char *file_header = "hypercubes-tuning 2";
+
+bool read_result(const std::string &filename, //
+                 const vector<int> &sizes,    //
+                 const TunerOptions &options, //
+                 TuningResult &result) {
+  std::ifstream is(filename);
+  std::string header;
+  if (not std::getline(is, header) or header != file_header)
+    return false;
+  // The file of other options with the same hash
+  std::size_t key_size;
+  if (not(is >> key_size) or is.get() != ':')
+    return false;
+  std::string key(key_size, '\0');
+  if (not is.read(&key[0], key_size) or key != tuning_key(sizes, options))
+    return false;
+  std::map<std::string, Candidate> candidates;
+  for (const auto &c : enumerate_candidates(sizes, options))
+    candidates[c.name] = c;
+  int n;
+  if (not(is >> n) or n <= 0)
+    return false;
+  TuningResult res;
+  for (int i = 0; i < n; ++i) {
+    std::string name;
+    double cost, seconds;
+    if (not(is >> name >> cost >> seconds) or candidates.count(name) == 0)
+      return false;
+    res.measurements.push_back({candidates[name], cost, seconds});
+  }
+  try {
+    res.best = fastest(res.measurements);
+  } catch (const std::invalid_argument &) {
+    return false;
+  }
+  result = res;
+  return true;
+}
+
+void write_result(const std::string &filename, //
+                  const std::string &key,      //
+                  const TuningResult &result) {
+  write_atomically(filename, [&](std::ostream &os) {
+    os << file_header << '\n' << key.size() << ':' << key << '\n';
+    os << result.measurements.size() << '\n';
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+    for (const auto &m : result.measurements)
+      os << m.candidate.name << ' ' << m.cost << ' ' << m.seconds << '\n';
+  });
+}
+} // namespace
+
+TuningCache::TuningCache(const std::string &directory)
+    : directory(directory) {
+  make_directory(directory);
+}
+
+std::string TuningCache::filename(const vector<int> &sizes,
+                                  const TunerOptions &options) const {
+  std::string key = tuning_key(sizes, options);
+  std::stringstream ss;
+  ss << directory << "/" << std::hex << std::setfill('0') << std::setw(16)
+     << fnv1a(key.data(), key.size()) << ".tuning";
+  return ss.str();
+}
+
+TuningCache::Result TuningCache::tune(TreeFactory &f,              //
+                                      const vector<int> &sizes,    //
+                                      const TunerOptions &options, //
+                                      TuningResult &result) {
+  std::string name = filename(sizes, options);
+  if (read_result(name, sizes, options, result))
+    return HIT;
+  result = layout_tuning::tune(f, sizes, options);
+  try {
+    write_result(name, tuning_key(sizes, options), result);
+  } catch (const std::exception &) {
+  }
+  return MISS;
+}
+
+} // namespace layout_tuning
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
@@ -0,0 +1,487 @@
+#include "api_v2/serialisation.hpp"
+#include "api_v2/compiled_tree.hpp"
+#include "api_v2/transformer.hpp"
+#include "trees/level_swap.hpp"
+#include "utils/hash_utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace serialisation {
+
+using transformers::Transformer;
+using transformers::TransformerP;
+using Index = vector<int>;
+
+namespace {
+
+enum Content : std::uint32_t { TREE = 1, NETWORK = 2 };
+
+/* How the transformers compute apply and inverse. */
+enum Kind : std::int32_t {
+  PUSHFORWARD,   // pushforward and pullback on the output tree
+  IDENTITY,      // Id
+  PULLBACK_SAFE, // QFull, CollectLeaves: padding has no inverse
+  PERMUTATION,   // LevelSwap
+};
+
+struct Header {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t content;
+  std::uint32_t reserved;
+  std::uint64_t payload_size;
+  std::uint64_t checksum;
+};
+static_assert(sizeof(Header) == 32, "Unexpected padding in Header");
+const char magic[4] = {'H', 'C', 'U', 'B'};
+
+struct Buffer {
+  std::string data;
+
+  void write(std::int32_t x) {
+    data.append(reinterpret_cast<const char *>(&x), sizeof(x));
+  }
+  void write(const vector<int> &v) {
+    write(v.size());
+    for (int x : v)
+      write(x);
+  }
+  void write(const std::string &s) {
+    write(s.size());
+    data.append(s);
+    data.append((4 - s.size() % 4) % 4, '\0');
+  }
+  void write(const vector<std::string> &v) {
+    write(v.size());
+    for (const auto &s : v)
+      write(s);
+  }
+};
+
+class Writer : public Buffer {
+public:
+  /* Adds the nodes not added yet to the tree section,
+   * returns the id of the root. */
+  int add_tree(const KVTreePv2<NodeType> &t) {
+    auto it = ids.find(t.get());
+    if (it != ids.end())
+      return it->second;
+    vector<int> children;
+    for (const auto &c : t->children)
+      children.push_back(add_tree(c.second));
+    nodes.write(static_cast<std::int32_t>(t->n));
+    nodes.write(t->children.size());
+    for (int i = 0; i < t->children.size(); ++i) {
+      nodes.write(t->children[i].first);
+      nodes.write(children[i]);
+    }
+    int id = ids.size();
+    ids[t.get()] = id;
+    return id;
+  }
+  void write_tree_section() {
+    write(ids.size());
+    data.append(nodes.data);
+  }
+
+  std::string file(Content content) const {
+    Header h;
+    std::memcpy(h.magic, magic, 4);
+    h.version = format_version;
+    h.content = content;
+    h.reserved = 0;
+    h.payload_size = data.size();
+    h.checksum = fnv1a(data.data(), data.size());
+    return std::string(reinterpret_cast<const char *>(&h), sizeof(h)) + data;
+  }
+
+private:
+  std::map<const KVTree<NodeType> *, int> ids;
+  Buffer nodes;
+};
+
+class Reader {
+public:
+  Reader(const char *data, std::size_t size, Content content) {
+    if (size < sizeof(Header))
+      throw FormatError("Data too short for the header.");
+    Header h;
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, magic, 4) != 0)
+      throw FormatError("Not a hypercubes file.");
+    if (h.version != format_version)
+      throw FormatError("Unsupported format version " +
+                        std::to_string(h.version) + ".");
+    if (h.content != content)
+      throw FormatError("Unexpected content.");
+    if (h.payload_size != size - sizeof(Header))
+      throw FormatError("Payload size does not match.");
+    ptr = data + sizeof(Header);
+    end = data + size;
+    if (fnv1a(ptr, h.payload_size) != h.checksum)
+      throw FormatError("Checksum does not match.");
+  }
+
+  std::int32_t read_int() {
+    if (end - ptr < sizeof(std::int32_t))
+      throw FormatError("Unexpected end of data.");
+    std::int32_t x;
+    std::memcpy(&x, ptr, sizeof(x));
+    ptr += sizeof(x);
+    return x;
+  }
+  int read_size() {
+    int n = read_int();
+    if (n < 0 or n > end - ptr)
+      throw FormatError("Invalid size.");
+    return n;
+  }
+  int read_id(int nids) {
+    int id = read_int();
+    if (id < 0 or id >= nids)
+      throw FormatError("Invalid id.");
+    return id;
+  }
+  vector<int> read_ints() {
+    vector<int> res(read_size());
+    for (auto &x : res)
+      x = read_int();
+    return res;
+  }
+  std::string read_string() {
+    int n = read_size();
+    int padded = n + (4 - n % 4) % 4;
+    if (end - ptr < padded)
+      throw FormatError("Unexpected end of data.");
+    std::string res(ptr, n);
+    ptr += padded;
+    return res;
+  }
+  vector<std::string> read_strings() {
+    vector<std::string> res(read_size());
+    for (auto &s : res)
+      s = read_string();
+    return res;
+  }
+
+  vector<KVTreePv2<NodeType>> read_tree_section(TreeFactory &f) {
+    vector<KVTreePv2<NodeType>> nodes(read_size());
+    for (int i = 0; i < nodes.size(); ++i) {
+      int value = read_int();
+      if (value != NODE and value != LEAF)
+        throw FormatError("Invalid node value.");
+      int nchildren = read_size();
+      decltype(KVTree<NodeType>::children) children;
+      children.reserve(nchildren);
+      for (int c = 0; c < nchildren; ++c) {
+        auto key = read_ints();
+        children.push_back({key, nodes[read_id(i)]});
+      }
+      nodes[i] = f.store.mtkv(static_cast<NodeType>(value), children);
+    }
+    return nodes;
+  }
+
+  void check_end() const {
+    if (ptr != end)
+      throw FormatError("Unexpected data at the end.");
+  }
+
+private:
+  const char *ptr;
+  const char *end;
+};
+
+/* A transformer with given trees,
+ * that behaves as the kind of transformer it was saved from. */
+class Loaded : public Transformer {
+public:
+  Loaded(KVTreePv2<NodeType> input_output_tree, //
+         const vector<std::string> &output_levelnames)
+      : Transformer(input_output_tree, output_levelnames), kind(IDENTITY) {}
+  Loaded(TransformerP previous,                        //
+         KVTreePv2<NodeType> output_tree,              //
+         const vector<std::string> &output_levelnames, //
+         Kind kind,                                    //
+         const vector<int> &permutation_apply,         //
+         const vector<int> &permutation_inverse)
+      : Transformer(previous, output_tree, output_levelnames), //
+        kind(kind),                                            //
+        permutation_apply(permutation_apply),                  //
+        permutation_inverse(permutation_inverse) {}
+
+  vector<Index> apply(const Index &in) const {
+    switch (kind) {
+    case IDENTITY:
+      return {in};
+    case PERMUTATION:
+      return {apply_permutation(permutation_apply, in)};
+    default:
+      return Transformer::apply(in);
+    }
+  }
+  vector<Index> inverse(const Index &in) const {
+    switch (kind) {
+    case IDENTITY:
+      return {in};
+    case PERMUTATION:
+      return {apply_permutation(permutation_inverse, in)};
+    case PULLBACK_SAFE: {
+      vector<Index> res(1);
+      if (not index_pullback_safe(compiled_output_tree(), in.data(), in.size(),
+                                  res[0]))
+        res.clear();
+      return res;
+    }
+    default:
+      return Transformer::inverse(in);
+    }
+  }
+  int estimated_cost() const {
+    if (kind == IDENTITY or kind == PERMUTATION)
+      return 1;
+    return Transformer::estimated_cost();
+  }
+
+  const Kind kind;
+
+private:
+  const vector<int> permutation_apply;
+  const vector<int> permutation_inverse;
+};
+
+/* The permutation p such that t->apply(in) == apply_permutation(p, in) */
+vector<int> level_permutation(const TransformerP &t, bool inverse) {
+  vector<int> iota(t->output_levelnames.size());
+  std::iota(iota.begin(), iota.end(), 0);
+  auto moved = inverse ? t->inverse(iota)[0] : t->apply(iota)[0];
+  vector<int> res(moved.size());
+  for (int i = 0; i < moved.size(); ++i)
+    res[moved[i]] = i;
+  return res;
+}
+
+Kind find_kind(const TransformerP &t) {
+  if (auto loaded = dynamic_cast<const Loaded *>(t.get()))
+    return loaded->kind;
+  if (dynamic_cast<const transformers::Id *>(t.get()))
+    return IDENTITY;
+  if (dynamic_cast<const transformers::QFull *>(t.get()) or
+      dynamic_cast<const transformers::CollectLeaves *>(t.get()))
+    return PULLBACK_SAFE;
+  if (dynamic_cast<const transformers::LevelSwap *>(t.get()))
+    return PERMUTATION;
+  if (dynamic_cast<const transformers::TreeComposition *>(t.get()))
+    throw std::invalid_argument("TreeComposition nodes cannot be saved.");
+  return PUSHFORWARD;
+}
+
+class MappedFile {
+public:
+  const char *data;
+  std::size_t size;
+
+  MappedFile(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+      throw std::runtime_error("Cannot open " + filename);
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      close(fd);
+      throw std::runtime_error("Cannot stat " + filename);
+    }
+    size = st.st_size;
+    void *addr = size == 0 ? nullptr
+                           : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+      throw std::runtime_error("Cannot map " + filename);
+    data = static_cast<const char *>(addr);
+  }
+  ~MappedFile() {
+    if (data != nullptr)
+      munmap(const_cast<char *>(data), size);
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+};
+
+void write_file(const std::string &content, const std::string &filename) {
+  std::ofstream out(filename, std::ios::binary);
+  out.write(content.data(), content.size());
+  if (not out)
+    throw std::runtime_error("Cannot write " + filename);
+}
+
+} // namespace
+
+std::string serialise(const KVTreePv2<NodeType> &tree) {
+  Writer w;
+  int root = w.add_tree(tree);
+  w.write_tree_section();
+  w.write(root);
+  return w.file(TREE);
+}
+
+std::string serialise(TransformNetwork &network) {
+  const auto &nodes = network.get_nodes();
+  Writer w;
+  vector<std::pair<int, int>> tree_ids; // input, output
+  for (const auto &t : nodes)
+    tree_ids.push_back({w.add_tree(t->input_tree), //
+                        w.add_tree(t->output_tree)});
+  w.write_tree_section();
+
+  w.write(nodes.size());
+  for (int i = 0; i < nodes.size(); ++i) {
+    Kind kind = find_kind(nodes[i]);
+    w.write(kind);
+    w.write(tree_ids[i].first);
+    w.write(tree_ids[i].second);
+    w.write(nodes[i]->output_levelnames);
+    if (kind == PERMUTATION) {
+      w.write(level_permutation(nodes[i], false));
+      w.write(level_permutation(nodes[i], true));
+    }
+  }
+
+  auto node_id = [&nodes](const TransformerP &t) {
+    return std::find(nodes.begin(), nodes.end(), t) - nodes.begin();
+  };
+  vector<std::pair<std::string, int>> names;
+  for (const auto &name : network.nodenames())
+    names.push_back({name, node_id(network[name])});
+  w.write(names.size());
+  for (const auto &n : names) {
+    w.write(n.first);
+    w.write(n.second);
+  }
+
+  vector<std::tuple<int, int, int>> arcs;
+  for (const auto &t : nodes)
+    for (const auto &a : network.get_arcs(t))
+      arcs.push_back({node_id(t), node_id(a.destination), a.type});
+  // Arcs are ordered by pointer in the network
+  std::sort(arcs.begin(), arcs.end());
+  w.write(arcs.size());
+  for (const auto &a : arcs) {
+    w.write(std::get<0>(a));
+    w.write(std::get<1>(a));
+    w.write(std::get<2>(a));
+  }
+  return w.file(NETWORK);
+}
+
+KVTreePv2<NodeType> deserialise_tree(TreeFactory &f, //
+                                     const char *data, std::size_t size) {
+  Reader r(data, size, TREE);
+  auto nodes = r.read_tree_section(f);
+  auto root = nodes[r.read_id(nodes.size())];
+  r.check_end();
+  return root;
+}
+
+void deserialise_network(TreeFactory &f,                    //
+                         const char *data, std::size_t size, //
+                         TransformNetwork &network) {
+  Reader r(data, size, NETWORK);
+  auto trees = r.read_tree_section(f);
+
+  vector<TransformerP> nodes(r.read_size());
+  for (int i = 0; i < nodes.size(); ++i) {
+    int kind = r.read_int();
+    if (kind < PUSHFORWARD or kind > PERMUTATION)
+      throw FormatError("Invalid transformer kind.");
+    auto input_tree = trees[r.read_id(trees.size())];
+    auto output_tree = trees[r.read_id(trees.size())];
+    auto levelnames = r.read_strings();
+    vector<int> permutation_apply, permutation_inverse;
+    if (kind == PERMUTATION) {
+      permutation_apply = r.read_ints();
+      permutation_inverse = r.read_ints();
+    }
+    if (kind == IDENTITY) {
+      nodes[i] = std::make_shared<Loaded>(output_tree, levelnames);
+      continue;
+    }
+    auto previous = std::find_if(nodes.begin(), nodes.begin() + i,
+                                 [&input_tree](const TransformerP &t) {
+                                   return t->output_tree == input_tree;
+                                 });
+    if (previous == nodes.begin() + i)
+      throw FormatError("Input tree not found.");
+    nodes[i] = std::make_shared<Loaded>(*previous, output_tree, levelnames,
+                                        static_cast<Kind>(kind),
+                                        permutation_apply, permutation_inverse);
+  }
+
+  std::map<int, vector<std::string>> names;
+  int nnames = r.read_size();
+  for (int i = 0; i < nnames; ++i) {
+    auto name = r.read_string();
+    names[r.read_id(nodes.size())].push_back(name);
+  }
+  // Arcs are rebuilt by TransformNetwork::add_node,
+  // the saved ones are only checked.
+  std::set<std::tuple<int, int, int>> arcs;
+  int narcs = r.read_size();
+  for (int i = 0; i < narcs; ++i) {
+    int source = r.read_id(nodes.size());
+    int destination = r.read_id(nodes.size());
+    int type = r.read_int();
+    arcs.insert({source, destination, type});
+  }
+  r.check_end();
+
+  for (int i = 0; i < nodes.size(); ++i) {
+    const auto &node_names = names[i];
+    network.add_node(nodes[i], node_names.size() ? node_names[0] : "");
+    for (int j = 1; j < node_names.size(); ++j)
+      network.add_node(nodes[i], node_names[j]);
+  }
+  std::set<std::tuple<int, int, int>> rebuilt_arcs;
+  for (int i = 0; i < nodes.size(); ++i)
+    for (const auto &a : network.get_arcs(nodes[i]))
+      rebuilt_arcs.insert(
+          {i,
+           std::find(nodes.begin(), nodes.end(), a.destination) -
+               nodes.begin(),
+           a.type});
+  if (arcs != rebuilt_arcs)
+    throw FormatError("The arcs do not match the trees.");
+}
+
+void save(const KVTreePv2<NodeType> &tree, const std::string &filename) {
+  write_file(serialise(tree), filename);
+}
+void save(TransformNetwork &network, const std::string &filename) {
+  write_file(serialise(network), filename);
+}
+
+KVTreePv2<NodeType> load_tree(TreeFactory &f, const std::string &filename) {
+  MappedFile file(filename);
+  return deserialise_tree(f, file.data, file.size);
+}
+void load_network(TreeFactory &f,              //
+                  const std::string &filename, //
+                  TransformNetwork &network) {
+  MappedFile file(filename);
+  deserialise_network(f, file.data, file.size, network);
+}
+
+} // namespace serialisation
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
@@ -0,0 +1,123 @@
+#include "api_v2/site_offsets.hpp"
+#include <functional>
+#include <stdexcept>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+namespace site_offsets {
+
+vector<int> box_extents(const KVTreePv2<NodeType> &tree) {
+  vector<int> extents;
+  std::function<void(const KVTreePv2<NodeType> &, int)> visit =
+      [&](const KVTreePv2<NodeType> &t, int level) {
+        int n = t->children.size();
+        if (n == 0 and level == extents.size())
+          return;
+        if (level == extents.size())
+          extents.push_back(n);
+        if (extents[level] != n)
+          throw std::invalid_argument("The start tree is not a box.");
+        for (const auto &c : t->children)
+          visit(c.second, level + 1);
+      };
+  visit(tree, 0);
+  return extents;
+}
+
+vector<vector<int>> leaf_indices(const KVTreePv2<NodeType> &tree) {
+  vector<vector<int>> res;
+  vector<int> idx;
+  std::function<void(const KVTreePv2<NodeType> &)> visit =
+      [&](const KVTreePv2<NodeType> &t) {
+        if (not t or t->children.size() == 0) {
+          res.push_back(idx);
+          return;
+        }
+        for (int i = 0; i < t->children.size(); ++i) {
+          idx.push_back(i);
+          visit(t->children[i].second);
+          idx.pop_back();
+        }
+      };
+  visit(tree);
+  return res;
+}
+
+int SiteOffsets::ndims() const { return extents.size(); }
+
+int SiteOffsets::nsites() const { return offset_of_site.size(); }
+
+int SiteOffsets::lex(const vector<int> &x) const {
+  int i = 0;
+  for (int d = 0; d < ndims(); ++d)
+    i = i * extents[d] + x[d];
+  return i;
+}
+
+bool SiteOffsets::inside(const vector<int> &x) const {
+  if (x.size() != ndims())
+    return false;
+  for (int d = 0; d < ndims(); ++d)
+    if (x[d] < 0 or x[d] >= extents[d])
+      return false;
+  return true;
+}
+
+int SiteOffsets::neighbour(int offset, const vector<int> &disp) const {
+  vector<int> x(coords[offset]);
+  for (int d = 0; d < ndims(); ++d)
+    x[d] = ((x[d] + disp[d]) % extents[d] + extents[d]) % extents[d];
+  return offset_of_site[lex(x)];
+}
+
+SiteOffsets make_site_offsets(TransformNetwork &network,          //
+                              const std::string &start_node_name, //
+                              const std::string &end_node_name) {
+  SiteOffsets res;
+  res.extents = box_extents(network[start_node_name]->output_tree);
+  res.leaves = leaf_indices(network[end_node_name]->output_tree);
+  auto to_start = network.get_fused_transform(end_node_name, start_node_name);
+
+  int nsites = 1;
+  for (int e : res.extents)
+    nsites *= e;
+  res.coords.resize(res.leaves.size());
+  res.offset_of_site.resize(nsites, -1);
+  for (int o = 0; o < res.leaves.size(); ++o) {
+    auto xs = to_start->apply(res.leaves[o]);
+    if (xs.empty() or not res.inside(xs[0]))
+      continue; // padding
+    res.coords[o] = xs[0];
+    if (res.offset_of_site[res.lex(xs[0])] == -1)
+      res.offset_of_site[res.lex(xs[0])] = o;
+  }
+  return res;
+}
+
+vector<int> neighbour_table(const SiteOffsets &sites) {
+  const int ndims = sites.ndims();
+  const int noffsets = sites.coords.size();
+  vector<int> res;
+  res.reserve(noffsets * 2 * ndims);
+  vector<int> disp(ndims, 0);
+  for (int o = 0; o < noffsets; ++o) {
+    if (sites.coords[o].empty()) {
+      // padding: no neighbours to read
+      res.insert(res.end(), 2 * ndims, o);
+      continue;
+    }
+    for (int d = 0; d < ndims; ++d)
+      for (int dir : {-1, 1}) {
+        disp[d] = dir;
+        res.push_back(sites.neighbour(o, disp));
+        disp[d] = 0;
+      }
+  }
+  return res;
+}
+
+} // namespace site_offsets
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
@@ -2,8 +2,11 @@
 #include "api_v2/transform_requests.hpp"
 #include "api_v2/transformer.hpp"
 #include "trees/kvtree_data_structure.hpp"
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <numeric>
+#include <queue>
 #include <stdexcept>
 namespace hypercubes {
 namespace slow {
@@ -42,6 +45,8 @@ TransformerP TransformNetwork::search_transformers_with_same_output_tree(
 void TransformNetwork::add_node(TransformerP new_node, std::string name) {
   if (new_node == 0)
     return; // e.g., "Fork" case
+  transform_cache.clear();
+  fused_transform_cache.clear();
   if (find_node(name) != 0)
     throw std::invalid_argument("Name already taken.");
   TransformerP transformer_with_same_output_tree =
@@ -104,6 +109,16 @@ std::set<std::string> TransformNetwork::nodenames() const {
     result.insert(kv.first);
   return result;
 }
+const std::vector<TransformerP> &TransformNetwork::get_nodes() const {
+  return nodes;
+}
+std::vector<TransformNetwork::Arc>
+TransformNetwork::get_arcs(const TransformerP &t) const {
+  auto it = arcs.find(t);
+  if (it == arcs.end())
+    return {};
+  return std::vector<Arc>(it->second.begin(), it->second.end());
+}
 
 bool operator<(const TransformNetwork::Arc &a, //
                const TransformNetwork::Arc &b) {
@@ -112,64 +127,112 @@ bool operator<(const TransformNetwork::Arc &a, //
   return ta < tb;
 }
 
-std::vector<TransformNetwork::Arc>
+std::vector<TransformNetwork::Step>
 TransformNetwork::find_transformations(std::string node_name_start,
                                        std::string node_name_end) {
-  const auto node_start = find_node(node_name_start);
-  const auto node_end = find_node(node_name_end);
-  bool found;
-  std::vector<TransformNetwork::Arc> res;
+  return find_path(find_node(node_name_start), //
+                   find_node(node_name_end));
+}
 
-  std::vector<TransformerP> visited_nodes{};
-  std::tie(found, res) = _find_transform(node_start, node_end, visited_nodes);
-  return res;
+int TransformNetwork::cost(const Step &step) {
+  if (step.arc.type == INVERSE)
+    return step.source->estimated_cost();
+  return step.arc.destination->estimated_cost();
 }
-std::tuple<bool, std::vector<TransformNetwork::Arc>>
-TransformNetwork::_find_transform(const TransformerP node_start, //
-                                  const TransformerP node_end,   //
-                                  std::vector<TransformerP> visited_nodes) {
-  if (node_start == node_end)
-    return std::make_tuple(true, //
-                           std::vector<TransformNetwork::Arc>{});
 
-  visited_nodes.push_back(node_start);
-  for (auto arc : arcs[node_start]) {
-    auto node = arc.destination;
-    if (std::find(visited_nodes.begin(), // Node is not already visited
-                  visited_nodes.end(),   //
-                  node) == visited_nodes.end()) {
-      bool found;
-      std::vector<TransformNetwork::Arc> res;
-      std::tie(found, res) = _find_transform(node, node_end, visited_nodes);
-      if (found) {
-        return std::make_tuple(true, append(arc, res));
+// Dijkstra's algorithm, on the estimated cost first
+// and the number of arcs second.
+// Returns an empty path if there is no path.
+std::vector<TransformNetwork::Step>
+TransformNetwork::find_path(const TransformerP &node_start,
+                            const TransformerP &node_end) const {
+  if (not node_start or not node_end or node_start == node_end)
+    return {};
+  using Distance = std::pair<int, int>; // cost, number of arcs
+  std::map<TransformerP, int> index;
+  for (int i = 0; i < nodes.size(); ++i)
+    index[nodes[i]] = i;
+  const Distance infinity{std::numeric_limits<int>::max(), 0};
+  std::vector<Distance> distance(nodes.size(), infinity);
+  std::vector<Step> previous(nodes.size());
+  std::vector<bool> done(nodes.size(), false);
+  std::priority_queue<std::pair<Distance, int>,
+                      std::vector<std::pair<Distance, int>>,
+                      std::greater<std::pair<Distance, int>>>
+      queue;
+  distance[index.at(node_start)] = {0, 0};
+  queue.push({{0, 0}, index.at(node_start)});
+  while (not queue.empty()) {
+    int i = queue.top().second;
+    queue.pop();
+    if (done[i])
+      continue;
+    done[i] = true;
+    if (nodes[i] == node_end)
+      break;
+    for (const auto &arc : arcs.at(nodes[i])) {
+      Step step{nodes[i], arc};
+      int j = index.at(arc.destination);
+      Distance d{distance[i].first + cost(step), distance[i].second + 1};
+      if (d < distance[j]) {
+        distance[j] = d;
+        previous[j] = step;
+        queue.push({d, j});
       }
     }
   }
-  return std::make_tuple(false, //
-                         std::vector<TransformNetwork::Arc>{});
+  int i = index.at(node_end);
+  if (not done[i])
+    return {};
+  std::vector<Step> path;
+  for (; nodes[i] != node_start; i = index.at(previous[i].source))
+    path.push_back(previous[i]);
+  std::reverse(path.begin(), path.end());
+  return path;
 }
 
-transformers::IndexTransformerP TransformNetwork::get_transformer(Arc a) {
-  switch (a.type) {
+transformers::IndexTransformerP
+TransformNetwork::get_transformer(const Step &step) {
+  switch (step.arc.type) {
   case DIRECT:
-    return a.destination;
+    return step.arc.destination;
   case INVERSE:
-    return std::make_shared<transformers::Inverse>(a.destination);
+    // The arc points back to the node the source was built from.
+    return std::make_shared<transformers::Inverse>(step.source);
   }
+  throw std::invalid_argument("Unknown arc type.");
 }
 transformers::IndexTransformerP
 TransformNetwork::get_transform(const std::string &node_name_start,
                                 const std::string &node_name_end) {
+  auto key = std::make_pair(node_name_start, node_name_end);
+  auto cached = transform_cache.find(key);
+  if (cached != transform_cache.end())
+    return cached->second;
 
-  auto arcs = find_transformations(node_name_start, //
-                                   node_name_end);
+  auto steps = find_path(find_node(node_name_start), //
+                         find_node(node_name_end));
   vector<transformers::IndexTransformerP> transformers;
-  std::transform(arcs.begin(),                     //
-                 arcs.end(),                       //
-                 std::back_inserter(transformers), //
-                 [](auto arc) { return get_transformer(arc); });
-  return std::make_shared<transformers::Composition>(transformers);
+  for (const auto &step : steps)
+    transformers.push_back(get_transformer(step));
+  auto res = std::make_shared<transformers::Composition>(transformers);
+  transform_cache[key] = res;
+  return res;
+}
+
+std::shared_ptr<transformers::FusedComposition>
+TransformNetwork::get_fused_transform(const std::string &node_name_start,
+                                      const std::string &node_name_end) {
+  auto key = std::make_pair(node_name_start, node_name_end);
+  auto cached = fused_transform_cache.find(key);
+  if (cached != fused_transform_cache.end())
+    return cached->second;
+  auto res = std::make_shared<transformers::FusedComposition>(
+      (*this)[node_name_start]->output_tree, //
+      (*this)[node_name_end]->output_tree,   //
+      get_transform(node_name_start, node_name_end));
+  fused_transform_cache[key] = res;
+  return res;
 }
 } // namespace transform_networks
 } // namespace internals
@@ -113,6 +113,15 @@ TransformRequestP EONaive(std::string keylevel,       //
                                                        end_node_name);
 }
 
+TransformRequestP SpaceFillingCurve(std::string keylevel, //
+                                    sfc::Curve curve,     //
+                                    std::string end_node_name) {
+  return std::make_shared<transform_requests::SpaceFillingCurve>(
+      keylevel, //
+      curve,    //
+      end_node_name);
+}
+
 TransformRequestP Sum(std::string new_level_name,                //
                       const vector<TransformRequestP> &requests, //
                       std::string end_node_name) {
@@ -2,6 +2,7 @@
 #include "api_v2/transform_network.hpp"
 #include "api_v2/transformer.hpp"
 #include "api_v2/tree_transform.hpp"
+#include "utils/hash_utils.hpp"
 #include <iostream>
 #include <stdexcept>
 
@@ -16,6 +17,47 @@ std::string TransformRequest::get_end_node_name() const {
   return end_node_name;
 }
 
+std::uint64_t TransformRequest::hash() const {
+  std::string c = canonical();
+  return fnv1a(c.data(), c.size());
+}
+
+namespace canonical_form {
+std::string requests(const vector<TransformRequestP> &requests) {
+  std::stringstream ss;
+  ss << '{';
+  for (int i = 0; i < requests.size(); ++i)
+    ss << (i == 0 ? "" : ",") << requests[i]->canonical();
+  ss << '}';
+  return ss.str();
+}
+} // namespace canonical_form
+
+template <> const char *request_name<transformers::Renumber>() {
+  return "Renumber";
+}
+template <> const char *request_name<transformers::QFull>() { return "QFull"; }
+template <> const char *request_name<transformers::QSub>() { return "QSub"; }
+template <> const char *request_name<transformers::HBB>() { return "HBB"; }
+template <> const char *request_name<transformers::Flatten>() {
+  return "Flatten";
+}
+template <> const char *request_name<transformers::CollectLeaves>() {
+  return "CollectLeaves";
+}
+template <> const char *request_name<transformers::LevelRemap>() {
+  return "LevelRemap";
+}
+template <> const char *request_name<transformers::LevelSwap>() {
+  return "LevelSwap";
+}
+template <> const char *request_name<transformers::EONaive>() {
+  return "EONaive";
+}
+template <> const char *request_name<transformers::SpaceFillingCurve>() {
+  return "SpaceFillingCurve";
+}
+
 Id::Id(vector<int> dimensions,              //
        vector<std::string> dimension_names, //
        std::string node_name)
@@ -34,6 +76,12 @@ TransformerP Id::join(TreeFactory &f,        //
                                             dimensions,       //
                                             dimension_names); //
 }
+std::string Id::canonical() const {
+  return canonical_form::request("Id",                             //
+                                 std::make_tuple(dimensions,       //
+                                                 dimension_names), //
+                                 end_node_name);
+}
 
 EOFix::EOFix(const std::string &level_name,                    //
              const std::string &origin,                        //
@@ -72,6 +120,14 @@ TransformerP EOFix::join(TreeFactory &f,        //
                                                transform,  //
                                                levels_reference_int);
 }
+std::string EOFix::canonical() const {
+  return canonical_form::request("EOFix",
+                                 std::make_tuple(level_name,    //
+                                                 origin,        //
+                                                 previous_name, //
+                                                 levels_reference),
+                                 end_node_name);
+}
 
 Sum::Sum(std::string new_level_name,                //
          const vector<TransformRequestP> &requests, //
@@ -101,6 +157,12 @@ TransformerP Sum::join(TreeFactory &f,        //
   // the caller will add this node to the network.
   return res;
 }
+std::string Sum::canonical() const {
+  return canonical_form::request("Sum", //
+                                 std::make_tuple(new_level_name),
+                                 end_node_name) +
+         canonical_form::requests(requests);
+}
 
 Fork::Fork(const vector<TransformRequestP> &requests)
     : TransformRequest(""), //
@@ -120,6 +182,10 @@ TransformerP Fork::join(TreeFactory &f,        //
 
   return 0;
 }
+std::string Fork::canonical() const {
+  return canonical_form::request("Fork", std::tuple<>(), end_node_name) +
+         canonical_form::requests(requests);
+}
 
 TreeComposition::TreeComposition(const vector<TransformRequestP> &requests,
                                  std::string end_node_name)
@@ -150,6 +216,11 @@ TransformerP TreeComposition::join(TreeFactory &f,        //
   };
   return last;
 }
+std::string TreeComposition::canonical() const {
+  return canonical_form::request("TreeComposition", std::tuple<>(),
+                                 end_node_name) +
+         canonical_form::requests(requests);
+}
 
 void Build(TreeFactory &f,            //
            TransformNetwork &network, //
@@ -20,6 +20,154 @@ vector<Index> Inverse::apply(const Index &idx) const {
 vector<Index> Inverse::inverse(const Index &idx) const {
   return wrapped->apply(idx);
 }
+
+FusedComposition::LeafTable::LeafTable(const KVTreePv2<NodeType> &t)
+    : tree(compile(t)), first_leaf(tree.child_node.size()) {
+  // Post-order, memoised: shared nodes are counted once.
+  vector<int> nleaves(tree.nnodes(), -1);
+  auto _count = [&](int node, auto &count) -> int {
+    if (node == -1)
+      return 1;
+    if (nleaves[node] != -1)
+      return nleaves[node];
+    int n = tree.nchildren(node) == 0;
+    for (int c = tree.child_start[node]; c < tree.child_start[node + 1]; ++c) {
+      first_leaf[c] = n;
+      n += count(tree.child_node[c], count);
+    }
+    return nleaves[node] = n;
+  };
+  _count(tree.root, _count);
+}
+
+int FusedComposition::LeafTable::leaf(const int *idx, int idx_size) const {
+  int node = tree.root;
+  int res = 0;
+  for (int i = 0; i < idx_size; ++i) {
+    if (node == -1 or (unsigned)idx[i] >= (unsigned)tree.nchildren(node))
+      return -1;
+    int c = tree.child_start[node] + idx[i];
+    res += first_leaf[c];
+    node = tree.child_node[c];
+  }
+  if (node != -1 and tree.nchildren(node) != 0)
+    return -1;
+  return res;
+}
+
+namespace {
+/* Calls f on the positional indices of all the leaves, in order. */
+template <class F> void for_each_leaf(const CompiledKVTree &tree, F f) {
+  Index idx;
+  auto _visit = [&](int node, auto &visit) -> void {
+    if (node == -1 or tree.nchildren(node) == 0) {
+      f(idx);
+      return;
+    }
+    for (int i = 0; i < tree.nchildren(node); ++i) {
+      idx.push_back(i);
+      visit(tree.child_node[tree.child_start[node] + i], visit);
+      idx.pop_back();
+    }
+  };
+  _visit(tree.root, _visit);
+}
+} // namespace
+
+FusedComposition::FusedComposition(const KVTreePv2<NodeType> &input_tree,  //
+                                   const KVTreePv2<NodeType> &output_tree, //
+                                   const IndexTransformerP &transform)
+    : forward(input_tree), backward(output_tree) {
+  for_each_leaf(forward.tree, [&](const Index &in) {
+    for (const auto &out : transform->apply(in))
+      forward.images.push_back(out);
+    forward.first_image.push_back(forward.images.size());
+  });
+  // The leaves of the output tree that are not the image
+  // of any leaf of the input tree are padding leaves
+  // or halo leaves outside of the input (e.g., with open boundaries):
+  // they have no inverse, and transform->inverse may throw on them.
+  vector<bool> has_preimage;
+  const auto &images = forward.images;
+  for (int i = 0; i < images.size(); ++i) {
+    int l = backward.leaf(images.data.data() + images.offsets[i],
+                          images.offsets[i + 1] - images.offsets[i]);
+    if (l == -1)
+      continue;
+    if (l >= has_preimage.size())
+      has_preimage.resize(l + 1, false);
+    has_preimage[l] = true;
+  }
+  int l = 0;
+  for_each_leaf(backward.tree, [&](const Index &out) {
+    if (l < has_preimage.size() and has_preimage[l])
+      for (const auto &in : transform->inverse(out))
+        backward.images.push_back(in);
+    backward.first_image.push_back(backward.images.size());
+    ++l;
+  });
+}
+
+void FusedComposition::lookup(const LeafTable &table, //
+                              const int *in,          //
+                              int nindices,           //
+                              int in_size,            //
+                              bool throw_if_missing,  //
+                              IndexList &out,         //
+                              vector<int> &first_result) {
+  first_result.push_back(out.size());
+  for (int i = 0; i < nindices; ++i) {
+    const int *idx = in + i * in_size;
+    int l = table.leaf(idx, in_size);
+    if (l == -1 and throw_if_missing)
+      throw KeyNotFoundError("Index not found in the output tree.");
+    if (l != -1) {
+      const auto &images = table.images;
+      int start = images.offsets[table.first_image[l]];
+      int end = images.offsets[table.first_image[l + 1]];
+      int shift = out.data.size() - start;
+      out.data.insert(out.data.end(), images.data.begin() + start,
+                      images.data.begin() + end);
+      for (int r = table.first_image[l]; r < table.first_image[l + 1]; ++r)
+        out.offsets.push_back(images.offsets[r + 1] + shift);
+    }
+    first_result.push_back(out.size());
+  }
+}
+
+vector<Index> FusedComposition::apply(const Index &in) const {
+  IndexList out;
+  vector<int> first_result;
+  apply(in.data(), 1, in.size(), out, first_result);
+  vector<Index> res;
+  for (int i = 0; i < out.size(); ++i)
+    res.push_back(out[i]);
+  return res;
+}
+vector<Index> FusedComposition::inverse(const Index &in) const {
+  IndexList out;
+  vector<int> first_result;
+  inverse(in.data(), 1, in.size(), out, first_result);
+  vector<Index> res;
+  for (int i = 0; i < out.size(); ++i)
+    res.push_back(out[i]);
+  return res;
+}
+void FusedComposition::apply(const int *in,   //
+                             int nindices,    //
+                             int in_size,     //
+                             IndexList &out,  //
+                             vector<int> &first_result) const {
+  lookup(forward, in, nindices, in_size, false, out, first_result);
+}
+void FusedComposition::inverse(const int *in,  //
+                               int nindices,   //
+                               int in_size,    //
+                               IndexList &out, //
+                               vector<int> &first_result) const {
+  lookup(backward, in, nindices, in_size, true, out, first_result);
+}
+
 int TreeTransformer::find_level(const std::string &key) const {
   auto found_it = std::find(output_levelnames.begin(), //
                             output_levelnames.end(), key);
@@ -130,11 +278,36 @@ bool TreeTransformer::check_names_different() {
 }
 
 vector<Index> Transformer::apply(const Index &in) const {
-  return index_pushforward(output_tree, in);
+  IndexList out;
+  index_pushforward(compiled_output_tree(), in.data(), in.size(), out);
+  vector<Index> res;
+  res.reserve(out.size());
+  for (int i = 0; i < out.size(); ++i)
+    res.push_back(out[i]);
+  return res;
 }
 
 vector<Index> Transformer::inverse(const Index &in) const {
-  return vector<Index>{index_pullback(output_tree, in)};
+  vector<Index> res(1);
+  index_pullback(compiled_output_tree(), in.data(), in.size(), res[0]);
+  return res;
+}
+
+int Transformer::estimated_cost() const { return output_levelnames.size(); }
+
+const CompiledKVTree &Transformer::compiled_output_tree() const {
+  std::call_once(compiled_flag, [this]() { compiled = compile(output_tree); });
+  return compiled;
+}
+
+/* Padding leaves have no correspondence in the input tree,
+ * see index_pullback_safe in tree_transform.hpp. */
+static vector<Index> compiled_pullback_safe(const CompiledKVTree &tree,
+                                            const Index &in) {
+  vector<Index> res(1);
+  if (not index_pullback_safe(tree, in.data(), in.size(), res[0]))
+    res.clear();
+  return res;
 }
 
 Id::Id(TreeFactory &f, vector<int> dimensions,
@@ -150,6 +323,7 @@ Id::Id(TreeFactory &f, vector<int> dimensions,
 vector<Index> Id::apply(const Index &idx) const { return vector<Index>{idx}; }
 // TODO: range checks.
 vector<Index> Id::inverse(const Index &idx) const { return vector<Index>{idx}; }
+int Id::estimated_cost() const { return 1; }
 
 Renumber::Renumber(TreeFactory &f, //
                    TransformerP previous)
@@ -174,7 +348,7 @@ QFull::QFull(TreeFactory &f,        //
                                          level)) {}
 
 vector<Index> QFull::inverse(const Index &in) const {
-  return index_pullback_safe(output_tree, in);
+  return compiled_pullback_safe(compiled_output_tree(), in);
 }
 
 QSub::QSub(TreeFactory &f,        //
@@ -233,8 +407,7 @@ CollectLeaves::CollectLeaves(TreeFactory &f,             //
 
 {}
 vector<Index> CollectLeaves::inverse(const Index &in) const {
-
-  return index_pullback_safe(output_tree, in);
+  return compiled_pullback_safe(compiled_output_tree(), in);
 }
 
 LevelRemap::LevelRemap(TreeFactory &f,        //
@@ -332,6 +505,7 @@ vector<Index> LevelSwap::apply(const Index &in) const {
 vector<Index> LevelSwap::inverse(const Index &in) const {
   return {apply_permutation(permutation_inverse, in)};
 }
+int LevelSwap::estimated_cost() const { return 1; }
 
 EONaive::EONaive(TreeFactory &f,        //
                  TransformerP previous, //
@@ -342,6 +516,16 @@ EONaive::EONaive(TreeFactory &f,        //
           f.eo_naive(previous->output_tree, previous->find_level(keylevel)),
           previous->emplace_name(newname, keylevel)) {}
 
+SpaceFillingCurve::SpaceFillingCurve(TreeFactory &f,        //
+                                     TransformerP previous, //
+                                     std::string keylevel,  //
+                                     sfc::Curve curve)
+    : Transformer(previous,
+                  f.sfc_reorder(previous->output_tree,          //
+                                previous->find_level(keylevel), //
+                                curve),
+                  previous->output_levelnames) {}
+
 // TODO:
 // - SubTree selection with predicates
 // - EO (non-naive)
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream> // DEBUG
+#include <limits>
 #include <numeric>
 
 namespace hypercubes {
@@ -20,13 +21,13 @@ KVTreePv2<NodeType> TreeFactory::tree_product2(const KVTreePv2<NodeType> &t1,
     return t2;
   } else {
     decltype(KVTree<NodeType>::children) children;
-    children.reserve(t1->children.size());
-    std::transform(t1->children.begin(), //
-                   t1->children.end(),   //
-                   std::back_inserter(children), [t2, this](auto c) {
-                     return mp(c.first, //
-                               tree_product2(c.second, t2));
-                   });
+    const auto &t1children = t1->children;
+    auto new_subtrees = tasks.map(t1children.size(), [&](int i) {
+      return tree_product2(t1children[i].second, t2);
+    });
+    children.reserve(t1children.size());
+    for (int i = 0; i < t1children.size(); ++i)
+      children.push_back({t1children[i].first, new_subtrees[i]});
     return mtkv(t1->n, children);
   }
 }
@@ -42,18 +43,24 @@ vector<int> TreeFactory::sub_level_ordering(const vector<int> &level_ordering) {
   }
   return res;
 }
-void TreeFactory::partition_children_into_subtrees(
-    decltype(KVTree<NodeType>::children) &children, //
-    const vector<int> &starts, // starts do not have to coincide
-    const vector<int> &ends,   // with ends.
-    const decltype(KVTree<NodeType>::children) &t_children,
-    BoundaryCondition bc) {
+namespace {
+/* Shared by the eager and lazy level splitting functions.
+ * 'renumber' is applied to the grandchildren that are kept,
+ * 'make_node' builds a node from its children. */
+template <class Children, class Renumber, class MakeNode>
+void partition_children(Children &children,         //
+                        const vector<int> &starts,  //
+                        const vector<int> &ends,    //
+                        const Children &t_children, //
+                        BoundaryCondition bc,       //
+                        Renumber renumber,          //
+                        MakeNode make_node) {
 
   children.reserve(ends.size());
   for (int child = 0; child < ends.size(); child++) {
     int i_grandchildren_start = starts[child];
     int i_grandchildren_end = ends[child];
-    decltype(KVTree<NodeType>::children) grandchildren;
+    Children grandchildren;
     // TODO: assert size is > 0.
     int grandchildren_size = i_grandchildren_end - i_grandchildren_start;
     grandchildren.reserve(grandchildren_size);
@@ -69,17 +76,15 @@ void TreeFactory::partition_children_into_subtrees(
         else if (i_sanitised >= t_children.size())
           i_sanitised -= t_children.size();
 
-        grandchildren.push_back(
-            {{i_sanitised}, //
-             renumber_children(t_children[i_sanitised].second)});
+        grandchildren.push_back({{i_sanitised}, //
+                                 renumber(t_children[i_sanitised].second)});
 
       } else if (bc == BoundaryCondition::OPEN) {
         if (0 <= i_sanitised and i_sanitised < t_children.size())
-          grandchildren.push_back(
-              {{i_sanitised}, //
-               renumber_children(t_children[i_sanitised].second)});
+          grandchildren.push_back({{i_sanitised}, //
+                                   renumber(t_children[i_sanitised].second)});
         else // add empty node instead
-          grandchildren.push_back({{no_key},
+          grandchildren.push_back({{TreeFactory::no_key},
                                    // just to put something in
                                    // TODO: check that this is ok.
                                    //       Unsatisfactory.
@@ -90,8 +95,57 @@ void TreeFactory::partition_children_into_subtrees(
     if (grandchildren.size() > 0)
       children.push_back(
           {{}, // The new level has no correspondence in the old tree
-           mtkv(make_node(), grandchildren)});
+           make_node(std::move(grandchildren))});
+  }
+}
+
+void qh_limits(int size, int nparts, int halo, int existing_halo, //
+               vector<int> &starts, vector<int> &ends) {
+  float quotient = (float)(size - 2 * existing_halo) / nparts;
+  starts.reserve(nparts);
+  ends.reserve(nparts);
+  for (int child = 0; child < nparts; child++) {
+    int start = std::round(child * quotient) + existing_halo - halo;
+    int end = std::round((child + 1) * quotient) + existing_halo + halo;
+
+    starts.push_back(start);
+    ends.push_back(end);
+  }
+}
+
+vector<int> bb_limits(int size, int halo) {
+  return {0,           //
+          halo,        //
+          size - halo, //
+          size};
+}
+
+vector<int> hbb_limits(int size_with_halo, int halo) {
+  int size = size_with_halo - 2 * halo;
+  if (size <= 2 * halo) {
+    throw std::invalid_argument("HBB: the halo does not fit in the domain!");
   }
+  return {0,                  //
+          halo,               //
+          2 * halo,           //
+          halo + size - halo, //
+          halo + size,        //
+          halo + size + halo};
+}
+} // namespace
+
+void TreeFactory::partition_children_into_subtrees(
+    decltype(KVTree<NodeType>::children) &children, //
+    const vector<int> &starts, // starts do not have to coincide
+    const vector<int> &ends,   // with ends.
+    const decltype(KVTree<NodeType>::children) &t_children,
+    BoundaryCondition bc) {
+  partition_children(
+      children, starts, ends, t_children, bc,
+      [this](const KVTreePv2<NodeType> &t) { return renumber_children(t); },
+      [this](KVTree<NodeType>::Children &&grandchildren) {
+        return mtkv(make_node(), grandchildren);
+      });
 }
 KVTreePv2<NodeType>
 TreeFactory::bring_level_on_top(const KVTreePv2<NodeType> tree,
@@ -121,58 +175,47 @@ TreeFactory::collapse_level(const KVTreePv2<NodeType> &tree, //
                             int level_to_collapse,           //
                             const vector<int> &child_key_to_replace) {
   callcounter.total.collapse_level++;
-  if (cache.collapse_level.find(
-          {tree, level_to_collapse, child_key_to_replace}) ==
-      cache.collapse_level.end()) {
-    KVTreePv2<NodeType> res = 0; // TODO: are there better ways?
-    if (level_to_collapse == 0) {
-      for (auto c : tree->children) {
-        if (c.first == child_key_to_replace)
-          res = c.second;
-      }
-    } else {
-      decltype(KVTree<NodeType>::children) children;
-      children.reserve(tree->children.size());
-      for (auto ktree : tree->children) {
-        const vector<int> k = ktree.first;
-        KVTreePv2<NodeType> v = collapse_level(
-            ktree.second, level_to_collapse - 1, child_key_to_replace);
-        if (v != NULL) // TODO: are there better ways?
-          children.push_back({k, v});
-      }
-      res = mtkv(tree->n, children);
-    }
-    cache.collapse_level[{tree, level_to_collapse, child_key_to_replace}] = res;
-  } else
+  const decltype(cache.collapse_level)::key_type key{store.intern(tree), //
+                                                     level_to_collapse,  //
+                                                     child_key_to_replace};
+  KVTreePv2<NodeType> cached;
+  if (cache.collapse_level.find(key, cached)) {
     callcounter.cached.collapse_level++;
-  return cache.collapse_level[{tree, level_to_collapse, child_key_to_replace}];
+    return cached;
+  }
+  KVTreePv2<NodeType> res = 0; // TODO: are there better ways?
+  if (level_to_collapse == 0) {
+    for (auto c : tree->children) {
+      if (c.first == child_key_to_replace)
+        res = c.second;
+    }
+  } else {
+    decltype(KVTree<NodeType>::children) children;
+    children.reserve(tree->children.size());
+    for (auto ktree : tree->children) {
+      const vector<int> k = ktree.first;
+      KVTreePv2<NodeType> v = collapse_level(
+          ktree.second, level_to_collapse - 1, child_key_to_replace);
+      if (v != NULL) // TODO: are there better ways?
+        children.push_back({k, v});
+    }
+    res = mtkv(tree->n, children);
+  }
+  return cache.collapse_level.insert(key, res);
 }
 
 void TreeFactory::print_diagnostics() {
-  int start_colsize = 20;
-  int colsize = 15;
-  int len = start_colsize + 4 * colsize;
-  std::cout << std::string(len, '+') << std::endl;
-  // std::cout.width(4 * colsize);
-  std::cout << "CACHE COUNTS" << std::endl;
-  std::cout << std::string(len, '+') << std::endl;
-  std::cout << std::setw(start_colsize) << "TYPE"    //
-            << std::setw(colsize) << "Cache Size"    //
-            << std::setw(colsize) << "Calls: cached" //
-            << std::setw(colsize) << "Calls: total"  //
-            << std::setw(colsize) << "Cached/Total" << std::endl;
-
-#define PRINTLINE(FUNC_TYPE)                                      /**/         \
-  std::cout << std::setw(start_colsize) << #FUNC_TYPE             /**/         \
-            << std::setw(colsize) << cache.FUNC_TYPE.size()       /**/         \
-            << std::setw(colsize) << callcounter.cached.FUNC_TYPE /**/         \
-            << std::setw(colsize) << callcounter.total.FUNC_TYPE  /**/         \
-            << std::setw(colsize)                                              \
-            << (callcounter.total.FUNC_TYPE == 0                               \
-                    ? 0                                                        \
-                    : (float)callcounter.cached.FUNC_TYPE /                    \
-                          callcounter.total.FUNC_TYPE)                         \
-            << std::endl;
+  cache_stats_table::print_header(std::cout);
+
+#define PRINTLINE(FUNC_TYPE)                                                   \
+  {                                                                            \
+    CacheStats s;                                                              \
+    s.size = cache.FUNC_TYPE.size();                                           \
+    s.cached = callcounter.cached.FUNC_TYPE.load();                            \
+    s.total = callcounter.total.FUNC_TYPE.load();                              \
+    s.evicted = cache.FUNC_TYPE.evicted();                                     \
+    cache_stats_table::print_line(std::cout, #FUNC_TYPE, s);                   \
+  }
 
   PRINTLINE(renumber)
   PRINTLINE(qh)
@@ -181,13 +224,33 @@ void TreeFactory::print_diagnostics() {
   PRINTLINE(flatten)
   PRINTLINE(collect_leaves)
   PRINTLINE(eo_naive)
+  PRINTLINE(sfc_reorder)
   PRINTLINE(remap_level)
   PRINTLINE(swap_levels)
   PRINTLINE(bring_level_on_top)
   PRINTLINE(collapse_level)
 
 #undef PRINTLINE
-  std::cout << std::string(4 * colsize, '+') << std::endl;
+  cache_stats_table::print_footer(std::cout);
+}
+
+void TreeFactory::set_cache_budget(std::size_t max_entries_per_cache) {
+  cache.renumber.set_max_size(max_entries_per_cache);
+  cache.qh.set_max_size(max_entries_per_cache);
+  cache.bb.set_max_size(max_entries_per_cache);
+  cache.hbb.set_max_size(max_entries_per_cache);
+  cache.flatten.set_max_size(max_entries_per_cache);
+  cache.collect_leaves.set_max_size(max_entries_per_cache);
+  cache.eo_naive.set_max_size(max_entries_per_cache);
+  cache.sfc_reorder.set_max_size(max_entries_per_cache);
+  cache.remap_level.set_max_size(max_entries_per_cache);
+  cache.swap_levels.set_max_size(max_entries_per_cache);
+  cache.bring_level_on_top.set_max_size(max_entries_per_cache);
+  cache.collapse_level.set_max_size(max_entries_per_cache);
+}
+
+void TreeFactory::set_max_threads(int nthreads) {
+  tasks.set_max_threads(nthreads);
 }
 
 KVTreePv2<NodeType> TreeFactory::generate_flat_level(int size) {
@@ -203,19 +266,18 @@ KVTreePv2<NodeType> TreeFactory::generate_flat_level(int size) {
 KVTreePv2<NodeType>
 TreeFactory::renumber_children(const KVTreePv2<NodeType> t) {
   callcounter.total.renumber++;
-  if (cache.renumber.find(t) == cache.renumber.end()) {
-    decltype(KVTree<NodeType>::children) children;
-    auto tchildren = t->children;
-    children.reserve(tchildren.size());
-    for (auto i = 0; i != tchildren.size(); ++i) {
-      children.push_back({{i}, renumber_children(tchildren[i].second)});
-    }
-    auto res = mtkv(t->n, children);
-    cache.renumber[t] = res;
-    cache.renumber[res] = res; // It is idempotent
-  } else
+  const auto key = store.intern(t);
+  KVTreePv2<NodeType> cached;
+  if (cache.renumber.find(key, cached)) {
     callcounter.cached.renumber++;
-  return cache.renumber[t];
+    return cached;
+  }
+  auto res = cache.renumber.insert(
+      key, renumber_children(t, [this](auto subtree) {
+        return renumber_children(subtree);
+      }));
+  cache.renumber.insert(store.intern(res), res); // It is idempotent
+  return res;
 }
 KVTreePv2<NodeType>
 TreeFactory::tree_product(const vector<KVTreePv2<NodeType>> &trees) {
@@ -273,136 +335,125 @@ KVTreePv2<NodeType> TreeFactory::qh(KVTreePv2<NodeType> t, //
   // the hierarchy.
   // This can be managed at the TransformRequestMaker level, though.
   callcounter.total.qh++;
-  if (cache.qh.find({t, level, nparts, halo, existing_halo, bc}) ==
-      cache.qh.end()) {
-
-    KVTreePv2<NodeType> res;
-    decltype(KVTree<NodeType>::children) children;
-    int size = t->children.size();
-    if (level == 0) {
-      float quotient = (float)(size - 2 * existing_halo) / nparts;
-      vector<int> starts, ends;
-      starts.reserve(nparts);
-      ends.reserve(nparts);
-      for (int child = 0; child < nparts; child++) {
-        int start = std::round(child * quotient) + existing_halo - halo;
-        int end = std::round((child + 1) * quotient) + existing_halo + halo;
-
-        starts.push_back(start);
-        ends.push_back(end);
-      }
-      partition_children_into_subtrees(children, starts, ends, t->children, bc);
-      res = mtkv(make_node(), children);
-    } else {
-      res = renumber_children(
-          t, [this, level, nparts, halo, existing_halo, bc](auto subtree) {
-            return qh(subtree, level - 1, nparts, halo, existing_halo, bc);
-          });
-    }
-    cache.qh[{t, level, nparts, halo, existing_halo, bc}] = res;
-  } else
+  const decltype(cache.qh)::key_type key{store.intern(t), //
+                                         level,           //
+                                         nparts,          //
+                                         halo,            //
+                                         existing_halo,   //
+                                         bc};
+  KVTreePv2<NodeType> cached;
+  if (cache.qh.find(key, cached)) {
     callcounter.cached.qh++;
-  return cache.qh[{t, level, nparts, halo, existing_halo, bc}];
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  decltype(KVTree<NodeType>::children) children;
+  int size = t->children.size();
+  if (level == 0) {
+    vector<int> starts, ends;
+    qh_limits(size, nparts, halo, existing_halo, starts, ends);
+    partition_children_into_subtrees(children, starts, ends, t->children, bc);
+    res = mtkv(make_node(), children);
+  } else {
+    res = renumber_children(
+        t, [this, level, nparts, halo, existing_halo, bc](auto subtree) {
+          return qh(subtree, level - 1, nparts, halo, existing_halo, bc);
+        });
+  }
+  return cache.qh.insert(key, res);
 }
 
 KVTreePv2<NodeType> TreeFactory::bb(KVTreePv2<NodeType> t, int level,
                                     int halo) {
 
   callcounter.total.bb++;
-  if (cache.bb.find({t, level, halo}) == cache.bb.end()) {
-
-    KVTreePv2<NodeType> res;
-    decltype(KVTree<NodeType>::children) children;
-    int size = t->children.size();
-    if (level == 0) {
-      std::vector<int> limits = {0,           //
-                                 halo,        //
-                                 size - halo, //
-                                 size};
-      auto starts = limits; // except the last...
-      auto ends = tail(limits);
-      partition_children_into_subtrees(children, starts, ends, t->children);
-      res = mtkv(make_node(), children);
-    } else {
-      res = renumber_children(t, [this, level, halo](auto subtree) {
-        return bb(subtree, level - 1, halo);
-      });
-    }
-    cache.bb[{t, level, halo}] = res;
-  } else
+  const decltype(cache.bb)::key_type key{store.intern(t), level, halo};
+  KVTreePv2<NodeType> cached;
+  if (cache.bb.find(key, cached)) {
     callcounter.cached.bb++;
-  return cache.bb[{t, level, halo}];
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  decltype(KVTree<NodeType>::children) children;
+  int size = t->children.size();
+  if (level == 0) {
+    std::vector<int> limits = bb_limits(size, halo);
+    auto starts = limits; // except the last...
+    auto ends = tail(limits);
+    partition_children_into_subtrees(children, starts, ends, t->children);
+    res = mtkv(make_node(), children);
+  } else {
+    res = renumber_children(t, [this, level, halo](auto subtree) {
+      return bb(subtree, level - 1, halo);
+    });
+  }
+  return cache.bb.insert(key, res);
 }
 KVTreePv2<NodeType> TreeFactory::hbb(KVTreePv2<NodeType> t, int level,
                                      int halo) {
   callcounter.total.hbb++;
-  if (cache.hbb.find({t, level, halo}) == cache.hbb.end()) {
-
-    KVTreePv2<NodeType> res;
-    if (level == 0) {
-      decltype(KVTree<NodeType>::children) children;
-      int size = t->children.size() - 2 * halo;
-      if (size <= 2 * halo) {
-        throw std::invalid_argument(
-            "HBB: the halo does not fit in the domain!");
-      }
-      std::vector<int> limits = {0,                  //
-                                 halo,               //
-                                 2 * halo,           //
-                                 halo + size - halo, //
-                                 halo + size,        //
-                                 halo + size + halo};
-      auto starts = limits; // except the last...
-      auto ends = tail(limits);
-      partition_children_into_subtrees(children, starts, ends, t->children);
-      res = mtkv(make_node(), children);
-    } else {
-      res = renumber_children(t, [this, level, halo](auto subtree) {
-        return hbb(subtree, level - 1, halo);
-      });
-    }
-    cache.hbb[{t, level, halo}] = res;
-  } else
+  const decltype(cache.hbb)::key_type key{store.intern(t), level, halo};
+  KVTreePv2<NodeType> cached;
+  if (cache.hbb.find(key, cached)) {
     callcounter.cached.hbb++;
-  return cache.hbb[{t, level, halo}];
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  if (level == 0) {
+    decltype(KVTree<NodeType>::children) children;
+    std::vector<int> limits = hbb_limits(t->children.size(), halo);
+    auto starts = limits; // except the last...
+    auto ends = tail(limits);
+    partition_children_into_subtrees(children, starts, ends, t->children);
+    res = mtkv(make_node(), children);
+  } else {
+    res = renumber_children(t, [this, level, halo](auto subtree) {
+      return hbb(subtree, level - 1, halo);
+    });
+  }
+  return cache.hbb.insert(key, res);
 }
 
 KVTreePv2<NodeType> TreeFactory::flatten(KVTreePv2<NodeType> t, //
                                          int levelstart,        //
                                          int levelend) {
   callcounter.total.flatten++;
-  if (cache.flatten.find({t, levelstart, levelend}) == cache.flatten.end()) {
-    KVTreePv2<NodeType> res;
-    decltype(KVTree<NodeType>::children) children;
-    if (levelstart == 0) {
-      if (levelend > 1) {
-        for (auto i = 0; i != t->children.size(); ++i) {
-          auto tchild = flatten(t->children[i].second, 0, levelend - 1);
-          if (tchild)
-            for (auto grandchild : tchild->children) {
-              auto keys = append(i, grandchild.first);
-              if (grandchild.second)
-                children.push_back({keys, grandchild.second});
-            }
-        }
-      } else {
-        for (auto i = 0; i != t->children.size(); ++i) {
-          auto tchild = t->children[i].second;
-          children.push_back({{i}, tchild});
-        }
+  const decltype(cache.flatten)::key_type key{store.intern(t), //
+                                              levelstart,      //
+                                              levelend};
+  KVTreePv2<NodeType> cached;
+  if (cache.flatten.find(key, cached)) {
+    callcounter.cached.flatten++;
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  decltype(KVTree<NodeType>::children) children;
+  if (levelstart == 0) {
+    if (levelend > 1) {
+      for (auto i = 0; i != t->children.size(); ++i) {
+        auto tchild = flatten(t->children[i].second, 0, levelend - 1);
+        if (tchild)
+          for (auto grandchild : tchild->children) {
+            auto keys = append(i, grandchild.first);
+            if (grandchild.second)
+              children.push_back({keys, grandchild.second});
+          }
       }
-      res = mtkv(make_node(), children);
     } else {
-      res = renumber_children(t, //
-                              [this, levelstart, levelend](auto subtree) {
-                                return flatten(subtree, levelstart - 1,
-                                               levelend - 1);
-                              });
+      for (auto i = 0; i != t->children.size(); ++i) {
+        auto tchild = t->children[i].second;
+        children.push_back({{i}, tchild});
+      }
     }
-    cache.flatten[{t, levelstart, levelend}] = res;
-  } else
-    callcounter.cached.flatten++;
-  return cache.flatten[{t, levelstart, levelend}];
+    res = mtkv(make_node(), children);
+  } else {
+    res = renumber_children(t, //
+                            [this, levelstart, levelend](auto subtree) {
+                              return flatten(subtree, levelstart - 1,
+                                             levelend - 1);
+                            });
+  }
+  return cache.flatten.insert(key, res);
 }
 
 KVTreePv2<NodeType> TreeFactory::collect_leaves(KVTreePv2<NodeType> t, //
@@ -410,81 +461,141 @@ KVTreePv2<NodeType> TreeFactory::collect_leaves(KVTreePv2<NodeType> t, //
                                                 int pad_to) {
 
   callcounter.total.collect_leaves++;
-  if (cache.collect_leaves.find({t, levelstart, pad_to}) ==
-      cache.collect_leaves.end()) {
-    KVTreePv2<NodeType> res;
-    decltype(KVTree<NodeType>::children) children;
-    if (levelstart <= 0) {
-      if (t->n != make_leaf()) {
-        for (auto i = 0; i != t->children.size(); ++i) {
-          auto tchild = collect_leaves(t->children[i].second, //
-                                       levelstart - 1,        //
-                                       pad_to);
-          for (auto grandchild : tchild->children) {
-            auto keys = append(i, grandchild.first);
-            children.push_back({keys, grandchild.second});
-          }
+  const decltype(cache.collect_leaves)::key_type key{store.intern(t), //
+                                                     levelstart,      //
+                                                     pad_to};
+  KVTreePv2<NodeType> cached;
+  if (cache.collect_leaves.find(key, cached)) {
+    callcounter.cached.collect_leaves++;
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  decltype(KVTree<NodeType>::children) children;
+  if (levelstart <= 0) {
+    if (t->n != make_leaf()) {
+      for (auto i = 0; i != t->children.size(); ++i) {
+        auto tchild = collect_leaves(t->children[i].second, //
+                                     levelstart - 1,        //
+                                     pad_to);
+        for (auto grandchild : tchild->children) {
+          auto keys = append(i, grandchild.first);
+          children.push_back({keys, grandchild.second});
         }
-      } else {
-        children.push_back({{}, t});
-      }
-      if (levelstart == 0) {
-        auto leaf = mtkv(make_leaf(), {});
-        // TODO: This may cause problems
-        //                    V
-        int keylen = children[0].first.size();
-        std::vector<int> key(keylen, no_key);
-        children.reserve(pad_to);
-        while (children.size() < pad_to)
-          children.push_back({key, leaf});
       }
-      res = mtkv(make_node(), children);
     } else {
-      res = renumber_children(t,           //
-                              [this,       //
-                               levelstart, //
-                               pad_to](auto subtree) {
-                                return collect_leaves(subtree,        //
-                                                      levelstart - 1, //
-                                                      pad_to);
-                              });
+      children.push_back({{}, t});
     }
-    cache.collect_leaves[{t, levelstart, pad_to}] = res;
-  } else
-    callcounter.cached.collect_leaves++;
-  return cache.collect_leaves[{t, levelstart, pad_to}];
+    if (levelstart == 0) {
+      auto leaf = mtkv(make_leaf(), {});
+      // TODO: This may cause problems
+      //                    V
+      int keylen = children[0].first.size();
+      std::vector<int> key(keylen, no_key);
+      children.reserve(pad_to);
+      while (children.size() < pad_to)
+        children.push_back({key, leaf});
+    }
+    res = mtkv(make_node(), children);
+  } else {
+    res = renumber_children(t,           //
+                            [this,       //
+                             levelstart, //
+                             pad_to](auto subtree) {
+                              return collect_leaves(subtree,        //
+                                                    levelstart - 1, //
+                                                    pad_to);
+                            });
+  }
+  return cache.collect_leaves.insert(key, res);
 }
 
 KVTreePv2<NodeType> TreeFactory::eo_naive(const KVTreePv2<NodeType> t,
                                           int level) {
   callcounter.total.eo_naive++;
-  if (cache.eo_naive.find({t, level}) == cache.eo_naive.end()) {
+  const decltype(cache.eo_naive)::key_type key{store.intern(t), level};
+  KVTreePv2<NodeType> cached;
+  if (cache.eo_naive.find(key, cached)) {
+    callcounter.cached.eo_naive++;
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  decltype(KVTree<NodeType>::children) children;
+  if (level == 0) {
+    children.reserve(2);
+    decltype(children) E, O;
+    decltype(children) EO[2] = {E, O};
+    for (auto i = 0; i < t->children.size(); ++i) {
+      auto keys = t->children[i].first;
+      EO[std::accumulate(keys.begin(), keys.end(), 0) % 2].push_back(
+          {{i}, t->children[i].second});
+    }
+    for (auto eo : EO) {
+      if (eo.size() > 0)
+        children.push_back({{}, mtkv(make_node(), eo)});
+    }
+    res = mtkv(make_node(), children);
+  } else {
+    res = renumber_children(
+        t, //
+        [this, level](auto subtree) { return eo_naive(subtree, level - 1); });
+  }
+  return cache.eo_naive.insert(key, res);
+}
 
-    KVTreePv2<NodeType> res;
-    decltype(KVTree<NodeType>::children) children;
-    if (level == 0) {
-      children.reserve(2);
-      decltype(children) E, O;
-      decltype(children) EO[2] = {E, O};
-      for (auto i = 0; i < t->children.size(); ++i) {
-        auto keys = t->children[i].first;
-        EO[std::accumulate(keys.begin(), keys.end(), 0) % 2].push_back(
-            {{i}, t->children[i].second});
-      }
-      for (auto eo : EO) {
-        if (eo.size() > 0)
-          children.push_back({{}, mtkv(make_node(), eo)});
+KVTreePv2<NodeType> TreeFactory::sfc_reorder(const KVTreePv2<NodeType> t,
+                                             int level, sfc::Curve curve) {
+  callcounter.total.sfc_reorder++;
+  const decltype(cache.sfc_reorder)::key_type key{store.intern(t), level,
+                                                  curve};
+  KVTreePv2<NodeType> cached;
+  if (cache.sfc_reorder.find(key, cached)) {
+    callcounter.cached.sfc_reorder++;
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  if (level == 0) {
+    int nchildren = t->children.size();
+    int ndims = nchildren == 0 ? 0 : t->children[0].first.size();
+    vector<int> mins(ndims, std::numeric_limits<int>::max());
+    vector<int> maxs(ndims, std::numeric_limits<int>::min());
+    for (const auto &c : t->children) {
+      if (c.first.size() != ndims)
+        throw std::invalid_argument(
+            "sfc_reorder: keys of different lengths in the same node.");
+      for (int d = 0; d < ndims; ++d) {
+        mins[d] = std::min(mins[d], c.first[d]);
+        maxs[d] = std::max(maxs[d], c.first[d]);
       }
-      res = mtkv(make_node(), children);
-    } else {
-      res = renumber_children(
-          t, //
-          [this, level](auto subtree) { return eo_naive(subtree, level - 1); });
     }
-    cache.eo_naive[{t, level}] = res;
-  } else
-    callcounter.cached.eo_naive++;
-  return cache.eo_naive[{t, level}];
+    int bits = 0;
+    for (int d = 0; d < ndims; ++d)
+      bits = std::max(bits, sfc::bits_for(maxs[d] - mins[d] + 1));
+
+    vector<std::uint64_t> curve_keys;
+    curve_keys.reserve(nchildren);
+    for (const auto &c : t->children) {
+      vector<int> x(ndims);
+      for (int d = 0; d < ndims; ++d)
+        x[d] = c.first[d] - mins[d];
+      curve_keys.push_back(sfc::curve_key(curve, x, bits));
+    }
+    vector<int> order(nchildren);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&curve_keys](int a, int b) {
+      return curve_keys[a] < curve_keys[b];
+    });
+
+    decltype(KVTree<NodeType>::children) children;
+    children.reserve(nchildren);
+    for (int i : order)
+      children.push_back({{i}, renumber_children(t->children[i].second)});
+    res = mtkv(t->n, children);
+  } else {
+    res = renumber_children(t, [this, level, curve](auto subtree) {
+      return sfc_reorder(subtree, level - 1, curve);
+    });
+  }
+  return cache.sfc_reorder.insert(key, res);
 }
 
 KVTreePv2<NodeType> TreeFactory::eo_fix(
@@ -502,32 +613,21 @@ KVTreePv2<NodeType> TreeFactory::_eo_fix(
   decltype(KVTree<NodeType>::children) children;
 
   if (level > 0) {
-    for (auto i = 0; i < t->children.size(); ++i) {
+    auto new_subtrees = tasks.map(t->children.size(), [&](int i) {
       vector<int> idx_above_new = append(idx_above, i);
-      children.push_back({{i},
-                          _eo_fix(t->children[i].second, //
-                                  level - 1,             //
-                                  idx_above_new,         //
-                                  transform,             //
-                                  levels_reference)});
-    }
+      return _eo_fix(t->children[i].second, //
+                     level - 1,             //
+                     idx_above_new,         //
+                     transform,             //
+                     levels_reference);
+    });
+    for (auto i = 0; i < t->children.size(); ++i)
+      children.push_back({{i}, new_subtrees[i]});
     return mtkv(t->n, children);
   } else {
     // TODO: assert t->children.size() == 2;
-    // Testing only the parity of the first element.
-    auto idx = idx_above;
-    idx.push_back(0);
-    // TODO: find how deep the tree is
-    int depth = get_depth(t->children[0].second, make_leaf());
-    idx.insert(idx.end(), depth, 0);
-    // TODO: assert that there is only one result
-    //       from the transformation,
-    //       or that all the results are the same.
-    auto original_idx = transform(idx)[0];
-    int sum = 0;
-    for (int level : levels_reference)
-      sum += original_idx[level];
-    int first_subtree_parity = sum % 2;
+    int first_subtree_parity =
+        eo_origin_parity(t, idx_above, transform, levels_reference);
     if (first_subtree_parity == 0)
       return renumber_children(t);
     else { // we need to swap the parities
@@ -538,31 +638,56 @@ KVTreePv2<NodeType> TreeFactory::_eo_fix(
   }
 }
 
+int TreeFactory::eo_origin_parity(
+    const KVTreePv2<NodeType> t, const vector<int> &idx_above,
+    const std::function<vector<vector<int>>(vector<int>)> &transform,
+    const vector<int> &levels_reference) {
+  // Testing only the parity of the first element.
+  auto idx = idx_above;
+  idx.push_back(0);
+  int depth = get_depth(t->children[0].second, LEAF);
+  idx.insert(idx.end(), depth, 0);
+  auto results = transform(idx);
+  if (results.size() != 1)
+    throw std::invalid_argument(
+        "The first site of the subtree must be mapped to exactly one site, "
+        "it is mapped to " +
+        std::to_string(results.size()) + ".");
+  const auto &original_idx = results[0];
+  int sum = 0;
+  for (int level : levels_reference)
+    sum += original_idx[level];
+  return sum % 2;
+}
+
 KVTreePv2<NodeType> TreeFactory::remap_level(const KVTreePv2<NodeType> t,
                                              int level, vector<int> index_map) {
 
   callcounter.total.remap_level++;
-  if (cache.remap_level.find({t, level, index_map}) ==
-      cache.remap_level.end()) {
-    KVTreePv2<NodeType> res;
-    decltype(KVTree<NodeType>::children) children;
-    children.reserve(t->children.size());
-    if (level == 0) {
-      for (int key : index_map) {
-        auto c = t->children[key];
-        children.push_back({{key}, renumber_children(c.second)});
-      }
-
-      res = mtkv(t->n, children);
-    } else {
-      res = renumber_children(t, [this, level, index_map](auto subtree) {
-        return remap_level(subtree, level - 1, index_map);
-      });
-    }
-    cache.remap_level[{t, level, index_map}] = res;
-  } else
+  const decltype(cache.remap_level)::key_type key{store.intern(t), //
+                                                  level,           //
+                                                  index_map};
+  KVTreePv2<NodeType> cached;
+  if (cache.remap_level.find(key, cached)) {
     callcounter.cached.remap_level++;
-  return cache.remap_level[{t, level, index_map}];
+    return cached;
+  }
+  KVTreePv2<NodeType> res;
+  decltype(KVTree<NodeType>::children) children;
+  children.reserve(t->children.size());
+  if (level == 0) {
+    for (int key : index_map) {
+      auto c = t->children[key];
+      children.push_back({{key}, renumber_children(c.second)});
+    }
+
+    res = mtkv(t->n, children);
+  } else {
+    res = renumber_children(t, [this, level, index_map](auto subtree) {
+      return remap_level(subtree, level - 1, index_map);
+    });
+  }
+  return cache.remap_level.insert(key, res);
 }
 
 KVTreePv2<NodeType>
@@ -570,36 +695,35 @@ TreeFactory::swap_levels(const KVTreePv2<NodeType> t,
                          const vector<int> &new_level_ordering) {
 
   callcounter.total.swap_levels++;
-  if (cache.swap_levels.find({t, new_level_ordering}) ==
-      cache.swap_levels.end()) {
-
-    KVTreePv2<NodeType> res;
-    if (new_level_ordering.size() == 0)
-      res = t;
-    else {
-      int next_level = new_level_ordering[0];
-      auto new_t = bring_level_on_top(t, next_level);
-      if (new_t == 0)
-        return 0;
-
-      auto sub_new_level_ordering = sub_level_ordering(new_level_ordering);
-
-      decltype(t->children) new_children;
-      new_children.reserve(t->children.size());
-      for (const auto &c : new_t->children) {
-        auto new_child = swap_levels(c.second, sub_new_level_ordering);
-        if (new_child != 0)
-          new_children.push_back({c.first, new_child});
-      }
-
-      res = mtkv(new_t->n, new_children);
-    }
-    cache.swap_levels[{t, new_level_ordering}] = res;
-  } else {
+  const decltype(cache.swap_levels)::key_type key{store.intern(t), //
+                                                  new_level_ordering};
+  KVTreePv2<NodeType> cached;
+  if (cache.swap_levels.find(key, cached)) {
     callcounter.cached.swap_levels++;
+    return cached;
   }
+  KVTreePv2<NodeType> res;
+  if (new_level_ordering.size() == 0)
+    res = t;
+  else {
+    int next_level = new_level_ordering[0];
+    auto new_t = bring_level_on_top(t, next_level);
+    if (new_t == 0)
+      return 0;
+
+    auto sub_new_level_ordering = sub_level_ordering(new_level_ordering);
+
+    decltype(t->children) new_children;
+    new_children.reserve(t->children.size());
+    for (const auto &c : new_t->children) {
+      auto new_child = swap_levels(c.second, sub_new_level_ordering);
+      if (new_child != 0)
+        new_children.push_back({c.first, new_child});
+    }
 
-  return cache.swap_levels[{t, new_level_ordering}];
+    res = mtkv(new_t->n, new_children);
+  }
+  return cache.swap_levels.insert(key, res);
 }
 
 KVTreePv2<NodeType> TreeFactory::select_subtree(const KVTreePv2<NodeType> t,
@@ -607,18 +731,26 @@ KVTreePv2<NodeType> TreeFactory::select_subtree(const KVTreePv2<NodeType> t,
   return _select_subtree(t, {}, p);
 };
 
-KVTreePv2<NodeType> TreeFactory::_select_subtree(const KVTreePv2<NodeType> t, //
-                                                 std::vector<int> idx_above,  //
+KVTreePv2<NodeType>
+TreeFactory::select_subtree(const LazyKVTreeP<NodeType> t,
+                            TreeFactory::Predicate &p) {
+  return _select_subtree(t, {}, p);
+};
+
+template <class Tree>
+KVTreePv2<NodeType> TreeFactory::_select_subtree(const Tree &t,              //
+                                                 std::vector<int> idx_above, //
                                                  TreeFactory::Predicate &p) {
   auto node = t->n;
-  decltype(t->children) new_children;
+  KVTree<NodeType>::Children new_children;
+  const auto &tchildren = children(t);
   int i = 0;
-  for (auto c = t->children.begin(); c != t->children.end(); c++) {
+  for (auto c = tchildren.begin(); c != tchildren.end(); c++) {
     auto idx = idx_above;
     idx.push_back(i);
     switch (p(idx)) {
     case BoolM::T:
-      new_children.push_back({{i}, renumber_children(c->second)});
+      new_children.push_back({{i}, renumber_children(materialise(c->second))});
       break;
     case BoolM::M: {
       auto new_child = _select_subtree(c->second, //
@@ -636,6 +768,159 @@ KVTreePv2<NodeType> TreeFactory::_select_subtree(const KVTreePv2<NodeType> t, //
   return mtkv(node, new_children);
 }
 
+/**************
+ * LAZY TREES *
+ **************/
+namespace {
+using LazyChildren = LazyKVTree<NodeType>::Children;
+using LazyGenerator = LazyKVTree<NodeType>::Generator;
+
+/* Wraps f so that it is called only once on subtrees that are shared
+ * (e.g., the children of a lazy_nd_tree node),
+ * and the results are shared as well.
+ * Without this, the lazy trees would have no sharing at all. */
+template <class F> auto sharing(F f) {
+  using Done = std::map<const LazyKVTree<NodeType> *, LazyKVTreeP<NodeType>>;
+  auto done = std::make_shared<Done>();
+  return [f, done](const LazyKVTreeP<NodeType> &t) {
+    auto it = done->find(t.get());
+    if (it == done->end())
+      it = done->emplace(t.get(), f(t)).first;
+    return it->second;
+  };
+}
+
+/* Same as TreeFactory::renumber_children(t, f). */
+template <class F>
+LazyKVTreeP<NodeType> lazy_renumber_children(const LazyKVTreeP<NodeType> &t,
+                                             F f) {
+  return mtlkv(t->n, LazyGenerator([t, f] {
+                 const auto &tchildren = t->children();
+                 auto shared_f = sharing(f);
+                 LazyChildren res;
+                 res.reserve(tchildren.size());
+                 for (int i = 0; i < tchildren.size(); ++i)
+                   res.push_back({{i}, shared_f(tchildren[i].second)});
+                 return res;
+               }));
+}
+
+/* The level 0 case of the splitting functions.
+ * 'limits' gives the starts and ends of the parts
+ * from the number of children of t. */
+template <class Limits>
+LazyKVTreeP<NodeType> lazy_split(const LazyKVTreeP<NodeType> &t, //
+                                 Limits limits,                  //
+                                 BoundaryCondition bc) {
+  return mtlkv(NODE, LazyGenerator([t, limits, bc] {
+                 const auto &tchildren = t->children();
+                 vector<int> starts, ends;
+                 limits(tchildren.size(), starts, ends);
+                 LazyChildren res;
+                 partition_children(
+                     res, starts, ends, tchildren, bc,
+                     sharing(TreeFactory::lazy_renumber_children),
+                     [](LazyChildren &&grandchildren) {
+                       return mtlkv(NODE, std::move(grandchildren));
+                     });
+                 return res;
+               }));
+}
+} // namespace
+
+LazyKVTreeP<NodeType> TreeFactory::lazy_nd_tree(std::vector<int> dimensions) {
+  if (dimensions.size() == 0)
+    return mtlkv(LEAF, LazyChildren{});
+  int size = dimensions[0];
+  auto sub_dimensions = tail(dimensions);
+  return mtlkv(NODE, LazyGenerator([size, sub_dimensions] {
+                 // The same subtree for all the children,
+                 // as in generate_nd_tree
+                 auto subtree = lazy_nd_tree(sub_dimensions);
+                 LazyChildren res;
+                 res.reserve(size);
+                 for (int i = 0; i < size; ++i)
+                   res.push_back({{i}, subtree});
+                 return res;
+               }));
+}
+
+LazyKVTreeP<NodeType>
+TreeFactory::lazy_renumber_children(const LazyKVTreeP<NodeType> &t) {
+  return internals::lazy_renumber_children(
+      t, [](const LazyKVTreeP<NodeType> &subtree) {
+        return lazy_renumber_children(subtree);
+      });
+}
+
+LazyKVTreeP<NodeType> TreeFactory::lazy_qh(const LazyKVTreeP<NodeType> &t, //
+                                           int level,                      //
+                                           int nparts,                     //
+                                           int halo,                       //
+                                           int existing_halo,              //
+                                           BoundaryCondition bc) {
+  if (level == 0)
+    return lazy_split(
+        t,
+        [nparts, halo, existing_halo](int size, vector<int> &starts,
+                                      vector<int> &ends) {
+          qh_limits(size, nparts, halo, existing_halo, starts, ends);
+        },
+        bc);
+  return internals::lazy_renumber_children(
+      t, [level, nparts, halo, existing_halo,
+          bc](const LazyKVTreeP<NodeType> &subtree) {
+        return lazy_qh(subtree, level - 1, nparts, halo, existing_halo, bc);
+      });
+}
+
+LazyKVTreeP<NodeType> TreeFactory::lazy_bb(const LazyKVTreeP<NodeType> &t,
+                                           int level, int halo) {
+  if (level == 0)
+    return lazy_split(
+        t,
+        [halo](int size, vector<int> &starts, vector<int> &ends) {
+          starts = bb_limits(size, halo);
+          ends = tail(starts);
+        },
+        BoundaryCondition::OPEN);
+  return internals::lazy_renumber_children(
+      t, [level, halo](const LazyKVTreeP<NodeType> &subtree) {
+        return lazy_bb(subtree, level - 1, halo);
+      });
+}
+
+LazyKVTreeP<NodeType> TreeFactory::lazy_hbb(const LazyKVTreeP<NodeType> &t,
+                                            int level, int halo) {
+  if (level == 0)
+    return lazy_split(
+        t,
+        [halo](int size, vector<int> &starts, vector<int> &ends) {
+          starts = hbb_limits(size, halo);
+          ends = tail(starts);
+        },
+        BoundaryCondition::OPEN);
+  return internals::lazy_renumber_children(
+      t, [level, halo](const LazyKVTreeP<NodeType> &subtree) {
+        return lazy_hbb(subtree, level - 1, halo);
+      });
+}
+
+KVTreePv2<NodeType> TreeFactory::materialise(const LazyKVTreeP<NodeType> &t) {
+  std::map<const LazyKVTree<NodeType> *, KVTreePv2<NodeType>> done;
+  auto _materialise = [this, &done](const LazyKVTreeP<NodeType> &t,
+                                    auto f) -> KVTreePv2<NodeType> {
+    auto it = done.find(t.get());
+    if (it != done.end())
+      return it->second;
+    KVTree<NodeType>::Children children;
+    for (const auto &c : t->children())
+      children.push_back({c.first, f(c.second, f)});
+    return done[t.get()] = mtkv(t->n, children);
+  };
+  return _materialise(t, _materialise);
+}
+
 } // namespace internals
 } // namespace slow
 
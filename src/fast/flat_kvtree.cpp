@@ -0,0 +1,283 @@
+#include "fast/flat_kvtree.hpp"
+#include "exceptions/exceptions.hpp"
+#include "selectors/bool_maybe.hpp"
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+namespace hypercubes {
+namespace fast {
+namespace internals {
+
+using slow::BoolM;
+using slow::internals::KeyNotFoundError;
+using slow::internals::KVTreeP;
+
+int FlatKVTree::Level::size() const { return keys.size(); }
+int FlatKVTree::Level::nchildren(int node) const {
+  return child_start[node + 1] - child_start[node];
+}
+
+int FlatKVTree::add_node(int level, int key, int value,
+                         const vector<int> &children) {
+  if (levels.size() <= level)
+    levels.resize(level + 1);
+  Level &l = levels[level];
+  l.keys.push_back(key);
+  l.values.push_back(value);
+  l.children.insert(l.children.end(), children.begin(), children.end());
+  l.child_start.push_back(l.children.size());
+  return l.size() - 1;
+}
+
+namespace {
+template <class Idxs>
+NodeRef _find_node(const FlatKVTree &t, NodeRef n, const Idxs &idxs,
+                   int nidxs) {
+  for (int i = 0; i < nidxs; ++i) {
+    const auto &level = t.levels[n.level];
+    const auto &next = t.levels[n.level + 1];
+    int key = idxs[i];
+    int cstart = level.child_start[n.node];
+    int nc = level.nchildren(n.node);
+    int c = -1;
+    // Fast path: keys are usually the positions of the children.
+    if (0 <= key and key < nc and next.keys[level.children[cstart + key]] == key)
+      c = level.children[cstart + key];
+    else
+      for (int j = cstart; j < cstart + nc; ++j)
+        if (next.keys[level.children[j]] == key) {
+          c = level.children[j];
+          break;
+        }
+    if (c == -1) {
+      std::stringstream message;
+      message << "child_idx = " << key << " not found in keys:";
+      for (int j = cstart; j < cstart + nc; ++j)
+        message << " " << next.keys[level.children[j]];
+      throw KeyNotFoundError(message.str());
+    }
+    n = NodeRef{n.level + 1, c};
+  }
+  return n;
+}
+} // namespace
+
+NodeRef find_node(const FlatKVTree &t, NodeRef root, const Indices &idxs) {
+  return _find_node(t, root, idxs, idxs.size());
+}
+NodeRef find_node(const FlatKVTree &t, NodeRef root, const int *idxs,
+                  int nidxs) {
+  return _find_node(t, root, idxs, nidxs);
+}
+
+FlatKVTree get_skeleton_tree(const slow::internals::PartitionTree &t) {
+  using PT = slow::internals::PartitionTree;
+  FlatKVTree res;
+  // The partition tree is memoised, (partitioning, key) pairs
+  // that appear many times are stored only once.
+  vector<std::map<std::pair<const void *, int>, int>> done;
+  auto _skeleton = [&](const PT &pt, int level, int key, auto &f) -> int {
+    if (done.size() <= level)
+      done.resize(level + 1);
+    auto it = done[level].find({pt.get(), key});
+    if (it != done[level].end())
+      return it->second;
+    vector<int> children;
+    for (int i = 0; i < pt->children.size(); ++i)
+      children.push_back(f(pt->children[i], level + 1, i, f));
+    int node = res.add_node(level, key, pt->n->is_leaf() ? 1 : 0, children);
+    done[level][{pt.get(), key}] = node;
+    return node;
+  };
+  _skeleton(t, 0, 0, _skeleton);
+  return res;
+}
+
+FlatKVTree prune_tree(const FlatKVTree &t, NodeRef root,
+                      const PartitionPredicate &predicate) {
+  FlatKVTree res;
+  // Subtrees that are kept whole are copied only once.
+  vector<std::unordered_map<int, int>> copied(t.levels.size());
+  auto _copy = [&](NodeRef n, auto &f) -> int {
+    auto it = copied[n.level].find(n.node);
+    if (it != copied[n.level].end())
+      return it->second;
+    const auto &level = t.levels[n.level];
+    vector<int> children;
+    for (int j = level.child_start[n.node]; j < level.child_start[n.node + 1];
+         ++j)
+      children.push_back(f(NodeRef{n.level + 1, level.children[j]}, f));
+    int node = res.add_node(n.level - root.level, level.keys[n.node],
+                            level.values[n.node], children);
+    copied[n.level][n.node] = node;
+    return node;
+  };
+  Indices idxs;
+  auto _prune = [&](NodeRef n, auto &f) -> int {
+    const auto &level = t.levels[n.level];
+    int cstart = level.child_start[n.node];
+    vector<int> children;
+    for (int i = 0; i < level.nchildren(n.node); ++i) {
+      NodeRef c{n.level + 1, level.children[cstart + i]};
+      idxs.push_back(i);
+      switch (predicate(idxs)) {
+      case BoolM::T:
+        children.push_back(_copy(c, _copy));
+        break;
+      case BoolM::M:
+        children.push_back(f(c, f));
+        break;
+      default:
+        break;
+      }
+      idxs.pop_back();
+    }
+    return res.add_node(n.level - root.level, level.keys[n.node],
+                        level.values[n.node], children);
+  };
+  _prune(root, _prune);
+  return res;
+}
+
+FlatKVTree get_size_tree(const FlatKVTree &skeleton_tree, NodeRef root) {
+  const auto &t = skeleton_tree;
+  FlatKVTree res;
+  // The size of a shared subtree is computed only once.
+  vector<std::unordered_map<int, int>> done(t.levels.size());
+  auto _size = [&](NodeRef n, auto &f) -> int {
+    auto it = done[n.level].find(n.node);
+    if (it != done[n.level].end())
+      return it->second;
+    const auto &level = t.levels[n.level];
+    vector<int> children;
+    int nodesize = 0;
+    if (level.nchildren(n.node) != 0)
+      for (int j = level.child_start[n.node];
+           j < level.child_start[n.node + 1]; ++j) {
+        int c = f(NodeRef{n.level + 1, level.children[j]}, f);
+        int csize = res.levels[n.level - root.level + 1].values[c];
+        if (csize != 0) {
+          children.push_back(c);
+          nodesize += csize;
+        }
+      }
+    else
+      nodesize = level.values[n.node];
+    int node = res.add_node(n.level - root.level, level.keys[n.node],
+                            nodesize, children);
+    done[n.level][n.node] = node;
+    return node;
+  };
+  _size(root, _size);
+  return res;
+}
+
+FlatKVTree get_offset_tree(const FlatKVTree &size_tree, NodeRef root) {
+  const auto &t = size_tree;
+  FlatKVTree res;
+  auto _offset = [&](NodeRef n, int start, auto &f) -> int {
+    const auto &level = t.levels[n.level];
+    vector<int> children;
+    int idx_so_far = start;
+    for (int j = level.child_start[n.node]; j < level.child_start[n.node + 1];
+         ++j) {
+      NodeRef c{n.level + 1, level.children[j]};
+      children.push_back(f(c, idx_so_far, f));
+      idx_so_far += t.levels[c.level].values[c.node];
+    }
+    return res.add_node(n.level - root.level, level.keys[n.node], start,
+                        children);
+  };
+  _offset(root, 0, _offset);
+  return res;
+}
+
+Indices get_indices(const FlatKVTree &offset_tree, NodeRef n, int offset) {
+  const auto &t = offset_tree;
+  Indices res;
+  while (t.levels[n.level].nchildren(n.node) != 0) {
+    const auto &level = t.levels[n.level];
+    const auto &next = t.levels[n.level + 1];
+    int cstart = level.child_start[n.node];
+    int nc = level.nchildren(n.node);
+    int c0 = level.children[cstart];
+    int pos;
+    // In trees built by get_offset_tree
+    // the children of a node are consecutive in the next level.
+    if (level.children[cstart + nc - 1] == c0 + nc - 1) {
+      const int *values = next.values.data() + c0;
+      if (nc <= 8) // a linear search is faster for few children
+        for (pos = nc - 1; pos >= 0 and values[pos] > offset; --pos)
+          ;
+      else
+        pos = std::upper_bound(values, values + nc, offset) - values - 1;
+    } else {
+      auto first = level.children.begin() + cstart;
+      pos = std::upper_bound(first, first + nc, offset,
+                             [&next](int offset, int c) {
+                               return offset < next.values[c];
+                             }) -
+            first - 1;
+    }
+    if (pos < 0) {
+      std::stringstream message;
+      message << "Not found: " << offset << " < " << next.values[c0];
+      throw KeyNotFoundError(message.str());
+    }
+    n = NodeRef{n.level + 1, level.children[cstart + pos]};
+    res.push_back(next.keys[n.node]);
+  }
+  if (t.levels[n.level].values[n.node] != offset) {
+    std::stringstream message;
+    message << "Not found: " << offset
+            << " != " << t.levels[n.level].values[n.node];
+    throw KeyNotFoundError(message.str());
+  }
+  return res;
+}
+
+FlatKVTree from_kvtree(const KVTreeP<int> &t) {
+  FlatKVTree res;
+  vector<std::unordered_map<const void *, int>> done;
+  auto _from = [&](const KVTreeP<int> &t, int level, auto &f) -> int {
+    if (done.size() <= level)
+      done.resize(level + 1);
+    auto it = done[level].find(t.get());
+    if (it != done[level].end())
+      return it->second;
+    vector<int> children;
+    for (const auto &c : t->children)
+      children.push_back(f(c, level + 1, f));
+    int node = res.add_node(level, t->n.first, t->n.second, children);
+    done[level][t.get()] = node;
+    return node;
+  };
+  _from(t, 0, _from);
+  return res;
+}
+
+KVTreeP<int> to_kvtree(const FlatKVTree &t, NodeRef root, int value_shift) {
+  vector<std::unordered_map<int, KVTreeP<int>>> done(t.levels.size());
+  auto _to = [&](NodeRef n, auto &f) -> KVTreeP<int> {
+    auto it = done[n.level].find(n.node);
+    if (it != done[n.level].end())
+      return it->second;
+    const auto &level = t.levels[n.level];
+    vector<KVTreeP<int>> children;
+    for (int j = level.child_start[n.node]; j < level.child_start[n.node + 1];
+         ++j)
+      children.push_back(f(NodeRef{n.level + 1, level.children[j]}, f));
+    auto res = slow::internals::mt(
+        std::make_pair(level.keys[n.node], level.values[n.node] + value_shift),
+        children);
+    done[n.level][n.node] = res;
+    return res;
+  };
+  return _to(root, _to);
+}
+
+} // namespace internals
+} // namespace fast
+} // namespace hypercubes
@@ -0,0 +1,186 @@
+#include "fast/memory_layout.hpp"
+#include "exceptions/exceptions.hpp"
+#include "trees/kvtree.hpp"
+#include "trees/level_swap.hpp"
+#include <sstream>
+#include <stdexcept>
+
+using namespace hypercubes::fast;
+using hypercubes::slow::tail;
+using hypercubes::slow::internals::KeyNotFoundError;
+using hypercubes::slow::internals::KVTreeP;
+using internals::FlatKVTree;
+using internals::NodeRef;
+
+namespace {
+NodeRef find_node(const FlatKVTree &t, NodeRef root, const Indices &idxs,
+                  const vector<std::string> &level_names) {
+  try {
+    return internals::find_node(t, root, idxs);
+  } catch (KeyNotFoundError &e) {
+    std::stringstream ss;
+    ss << e.what() << "\nIndices invalid: " << idxs << level_names;
+    throw std::invalid_argument(ss.str());
+  }
+}
+} // namespace
+
+/******************
+ * PARTITION TREE *
+ ******************/
+PartitionTree::PartitionTree(Sizes sizes, PartList partitioners,
+                             vector<int> nonspatial_dimensions)
+    : partition_tree(sizes, partitioners, nonspatial_dimensions) {}
+
+vector<std::string> PartitionTree::get_level_names() const {
+  return partition_tree.get_level_names();
+}
+Sizes PartitionTree::get_sizes() const { return partition_tree.get_sizes(); }
+Indices PartitionTree::get_indices(const Coordinates &coords) const {
+  return partition_tree.get_indices(coords);
+}
+int PartitionTree::get_indices_size() const {
+  return partition_tree.get_indices_size();
+}
+void PartitionTree::get_indices(slow::partitioning::CoordinateBlock &coords,
+                                int *indices) const {
+  partition_tree.get_indices(coords, indices);
+}
+vector<std::pair<int, Indices>>
+PartitionTree::get_indices_wg(const Coordinates &coords) const {
+  return partition_tree.get_indices_wg(coords);
+}
+Coordinates PartitionTree::get_coordinates(const Indices &idxs) const {
+  return partition_tree.get_coordinates(idxs);
+}
+const hypercubes::slow::internals::PartitionTree
+PartitionTree::get_internal() const {
+  return partition_tree.get_internal();
+}
+SkeletonTree PartitionTree::skeleton_tree() const {
+  return SkeletonTree(*this);
+}
+
+/*****************
+ * SKELETON TREE *
+ *****************/
+SkeletonTree::SkeletonTree(std::shared_ptr<const FlatKVTree> st, NodeRef r,
+                           vector<std::string> &&ln)
+    : level_names(ln), skeleton_tree(st), root(r) {}
+
+SkeletonTree::SkeletonTree(const PartitionTree &pt)
+    : level_names(pt.get_level_names()),
+      skeleton_tree(std::make_shared<const FlatKVTree>(
+          internals::get_skeleton_tree(pt.get_internal()))),
+      root{0, 0} {}
+
+vector<std::string> SkeletonTree::get_level_names() const {
+  return level_names;
+}
+
+SkeletonTree SkeletonTree::prune(const PartitionPredicate &predicate) const {
+  auto pruned_tree = std::make_shared<const FlatKVTree>(
+      internals::prune_tree(*skeleton_tree, root, predicate));
+  auto pruned_level_names = level_names;
+  return SkeletonTree(pruned_tree, {0, 0}, std::move(pruned_level_names));
+}
+SkeletonTree
+SkeletonTree::permute(const vector<std::string> &permuted_level_names) const {
+  try {
+    auto permuted_tree = slow::internals::swap_levels(
+        get_internal(), //
+        slow::internals::find_permutation(permuted_level_names, level_names));
+    vector<std::string> _pmlcp = permuted_level_names;
+    return SkeletonTree(std::make_shared<const FlatKVTree>(
+                            internals::from_kvtree(permuted_tree)),
+                        {0, 0}, std::move(_pmlcp));
+  } catch (const KeyNotFoundError &e) {
+    std::stringstream ss;
+    ss << e.what() << "\nError in swapping levels in the tree: "
+       << level_names << "->" << permuted_level_names;
+    throw std::invalid_argument(ss.str());
+  }
+}
+SkeletonTree SkeletonTree::get_subtree(const Indices &idxs) const {
+  NodeRef subtree = find_node(*skeleton_tree, root, idxs, level_names);
+  return SkeletonTree(skeleton_tree, subtree, tail(level_names, idxs.size()));
+}
+int SkeletonTree::get_nchildren(const Indices &idxs) const {
+  NodeRef n = find_node(*skeleton_tree, root, idxs, level_names);
+  return skeleton_tree->levels[n.level].nchildren(n.node);
+}
+const KVTreeP<int> SkeletonTree::get_internal() const {
+  return internals::to_kvtree(*skeleton_tree, root);
+}
+SizeTree SkeletonTree::size_tree() const { return SizeTree(*this); }
+
+/************
+ * SizeTree *
+ ************/
+SizeTree::SizeTree(std::shared_ptr<const FlatKVTree> st, NodeRef r,
+                   vector<std::string> &&ln)
+    : level_names(ln), size_tree(st), root(r) {}
+SizeTree::SizeTree(const SkeletonTree &skeleton_tree)
+    : level_names(skeleton_tree.level_names),
+      size_tree(std::make_shared<const FlatKVTree>(internals::get_size_tree(
+          *skeleton_tree.skeleton_tree, skeleton_tree.root))),
+      root{0, 0} {}
+vector<std::string> SizeTree::get_level_names() const { return level_names; }
+const KVTreeP<int> SizeTree::get_internal() const {
+  return internals::to_kvtree(*size_tree, root);
+}
+SizeTree SizeTree::get_subtree(const Indices &idxs) const {
+  NodeRef subtree = find_node(*size_tree, root, idxs, level_names);
+  return SizeTree(size_tree, subtree, tail(level_names, idxs.size()));
+}
+int SizeTree::get_size(const Indices &idxs) const {
+  NodeRef n = find_node(*size_tree, root, idxs, level_names);
+  return size_tree->levels[n.level].values[n.node];
+}
+OffsetTree SizeTree::offset_tree() const { return OffsetTree(*this); }
+
+/**************
+ * OffsetTree *
+ **************/
+OffsetTree::OffsetTree(std::shared_ptr<const FlatKVTree> ot, NodeRef r,
+                       int _offset_shift, vector<std::string> &&ln)
+    : level_names(ln), offset_tree(ot), root(r), offset_shift(_offset_shift) {}
+OffsetTree::OffsetTree(const SizeTree &size_tree)
+    : level_names(size_tree.level_names),
+      offset_tree(std::make_shared<const FlatKVTree>(
+          internals::get_offset_tree(*size_tree.size_tree, size_tree.root))),
+      root{0, 0}, offset_shift(0) {}
+vector<std::string> OffsetTree::get_level_names() const { return level_names; }
+const KVTreeP<int> OffsetTree::get_internal() const {
+  return internals::to_kvtree(*offset_tree, root, offset_shift);
+}
+OffsetTree OffsetTree::get_subtree(const Indices &idxs) const {
+  NodeRef subtree = find_node(*offset_tree, root, idxs, level_names);
+  return OffsetTree(offset_tree, subtree, offset_shift,
+                    tail(level_names, idxs.size()));
+}
+int OffsetTree::get_offset(const Indices &idxs) const {
+  NodeRef n = find_node(*offset_tree, root, idxs, level_names);
+  return offset_tree->levels[n.level].values[n.node] + offset_shift;
+}
+void OffsetTree::get_offsets(const int *idxs, int nindices, int idx_size,
+                             int *offsets) const {
+  try {
+    for (int i = 0; i < nindices; ++i) {
+      NodeRef n = internals::find_node(*offset_tree, root, //
+                                       idxs + i * idx_size, idx_size);
+      offsets[i] = offset_tree->levels[n.level].values[n.node] + offset_shift;
+    }
+  } catch (KeyNotFoundError &e) {
+    std::stringstream ss;
+    ss << e.what() << "\nIndices invalid for levels " << level_names;
+    throw std::invalid_argument(ss.str());
+  }
+}
+OffsetTree OffsetTree::shift(int shift) const {
+  auto ln = level_names;
+  return OffsetTree(offset_tree, root, offset_shift + shift, std::move(ln));
+}
+Indices OffsetTree::get_indices(int offset) const {
+  return internals::get_indices(*offset_tree, root, offset - offset_shift);
+}
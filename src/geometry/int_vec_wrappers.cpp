@@ -34,6 +34,7 @@ INTVEC_BOILERPLATE(Indices, idxs);
 #undef INTVEC_BOILERPLATE
 
 void Indices::push_back(int idx) { idxs.push_back(idx); }
+void Indices::pop_back() { idxs.pop_back(); }
 
 Indices append(Indices idxs, int idx) {
   idxs.push_back(idx);
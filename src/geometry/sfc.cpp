@@ -0,0 +1,111 @@
+#include "geometry/sfc.hpp"
+#include "geometry/eo.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace hypercubes {
+namespace slow {
+namespace sfc {
+
+std::ostream &operator<<(std::ostream &os, Curve c) {
+  return os << (c == MORTON ? "MORTON" : "HILBERT");
+}
+
+int bits_for(int extent) {
+  int bits = 0;
+  while ((1 << bits) < extent)
+    ++bits;
+  return bits;
+}
+
+namespace {
+void check_key_size(const IntList &x, int bits) {
+  if (x.size() * bits > 64)
+    throw std::invalid_argument(
+        "Space filling curve: " + std::to_string(x.size()) + " dimensions of " +
+        std::to_string(bits) + " bits do not fit in a 64 bit key.");
+}
+
+/* The bits of the coordinates, from the most significant one,
+ * one dimension after the other. */
+std::uint64_t interleave(const vector<std::uint32_t> &x, int bits) {
+  std::uint64_t key = 0;
+  for (int bit = bits - 1; bit >= 0; --bit)
+    for (auto xi : x)
+      key = (key << 1) | ((xi >> bit) & 1);
+  return key;
+}
+} // namespace
+
+std::uint64_t morton_key(const IntList &x, int bits) {
+  check_key_size(x, bits);
+  return interleave(vector<std::uint32_t>(x.begin(), x.end()), bits);
+}
+
+/* J. Skilling, "Programming the Hilbert curve",
+ * AIP Conf. Proc. 707, 381 (2004).
+ * The coordinates are transformed in place
+ * into the "transposed" Hilbert index, which is then interleaved. */
+std::uint64_t hilbert_key(const IntList &_x, int bits) {
+  check_key_size(_x, bits);
+  if (bits == 0)
+    return 0;
+  vector<std::uint32_t> x(_x.begin(), _x.end());
+  const int n = x.size();
+  const std::uint32_t M = 1u << (bits - 1);
+  // Inverse undo
+  for (std::uint32_t Q = M; Q > 1; Q >>= 1) {
+    std::uint32_t P = Q - 1;
+    for (int i = 0; i < n; ++i)
+      if (x[i] & Q)
+        x[0] ^= P;
+      else {
+        std::uint32_t t = (x[0] ^ x[i]) & P;
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+  }
+  // Gray encode
+  for (int i = 1; i < n; ++i)
+    x[i] ^= x[i - 1];
+  std::uint32_t t = 0;
+  for (std::uint32_t Q = M; Q > 1; Q >>= 1)
+    if (x[n - 1] & Q)
+      t ^= Q - 1;
+  for (int i = 0; i < n; ++i)
+    x[i] ^= t;
+  return interleave(x, bits);
+}
+
+std::uint64_t curve_key(Curve c, const IntList &x, int bits) {
+  switch (c) {
+  case MORTON:
+    return morton_key(x, bits);
+  case HILBERT:
+    return hilbert_key(x, bits);
+  }
+  throw std::invalid_argument("Unknown space filling curve.");
+}
+
+IntList curve_order(const IntList &sizes, Curve c) {
+  int bits = 0;
+  for (int s : sizes)
+    bits = std::max(bits, bits_for(s));
+  int nsites = std::accumulate(sizes.begin(), sizes.end(), 1,
+                               [](int a, int b) { return a * b; });
+  vector<std::uint64_t> keys(nsites);
+  for (int i = 0; i < nsites; ++i)
+    keys[i] = curve_key(c, eo::lex_idx_to_coord(i, sizes), bits);
+
+  IntList res(nsites);
+  std::iota(res.begin(), res.end(), 0);
+  std::sort(res.begin(), res.end(),
+            [&keys](int a, int b) { return keys[a] < keys[b]; });
+  return res;
+}
+
+} // namespace sfc
+} // namespace slow
+} // namespace hypercubes
@@ -24,6 +24,17 @@ std::vector<IndexResult> HBB1D::coord_to_idxs(int relative_x) const {
     }
   return std::vector<IndexResult>();
 }
+void HBB1D::coord_to_real_idxs(int *x, int *idx, int n) const {
+  const int l1 = halo, l2 = size - halo;
+  for (int i = 0; i < n; ++i) {
+    int xi = x[i];
+    int j = (xi >= 0) + (xi >= l1) + (xi >= l2) + (xi >= size);
+    int start = j == 0 ? -halo : j == 1 ? 0 : j == 2 ? l1 : j == 3 ? l2 : size;
+    bool inside = -halo <= xi and xi < size + halo;
+    idx[i] = inside ? j : -1;
+    x[i] = inside ? xi - start : xi;
+  }
+}
 } // namespace partitioning
 } // namespace slow
 } // namespace hypercubes
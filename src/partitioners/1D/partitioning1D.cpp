@@ -57,6 +57,20 @@ int Partitioning1D::idx_to_partinfo_kind(int idx) const {
 }
 std::string Partitioning1D::get_name() const { return name; }
 
+void Partitioning1D::coord_to_real_idxs(int *x, int *idx, int n) const {
+  for (int i = 0; i < n; ++i) {
+    auto idrs = coord_to_idxs(x[i]);
+    auto real = std::find_if(idrs.begin(), idrs.end(),
+                             [](IndexResult r) { return not r.cached_flag; });
+    if (real == idrs.end())
+      idx[i] = -1;
+    else {
+      idx[i] = real->idx;
+      x[i] = real->rest;
+    }
+  }
+}
+
 } // namespace partitioning
 } // namespace slow
 } // namespace hypercubes
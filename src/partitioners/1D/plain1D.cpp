@@ -28,6 +28,14 @@ std::vector<IndexResult> Plain1D::coord_to_idxs(int relative_x) const {
   else
     return std::vector<IndexResult>();
 };
+void Plain1D::coord_to_real_idxs(int *x, int *idx, int n) const {
+  for (int i = 0; i < n; ++i) {
+    int xi = x[i];
+    bool inside = 0 <= xi and xi < size;
+    idx[i] = inside ? xi : -1;
+    x[i] = inside ? 0 : xi;
+  }
+}
 
 } // namespace partitioning
 } // namespace slow
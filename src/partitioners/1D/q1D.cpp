@@ -59,6 +59,24 @@ std::vector<IndexResult> Q1DBase::coord_to_idxs(int relative_x) const {
   return res;
 }
 
+// Branch-free, so that the loop can be vectorised.
+// Gives the same real index and rest as coord_to_idxs,
+// also outside of [0,size) (with periodic boundary conditions
+// the index wraps around), or -1 if there is no real index.
+void Q1DBase::coord_to_real_idxs(int *x, int *idx, int n) const {
+  const bool periodic = bc() == BoundaryCondition::PERIODIC;
+  const int extra = size - nparts * quotient;
+  for (int i = 0; i < n; ++i) {
+    int xi = x[i];
+    int q = xi / quotient; // as real_idx in coord_to_idxs
+    int m = (q % nparts + nparts) % nparts;
+    int f = (q - m) / nparts;
+    bool has_real = periodic or (0 <= q and q < nparts);
+    idx[i] = has_real ? m : -1;
+    x[i] = has_real ? xi - (q * quotient + extra * f) : xi;
+  }
+}
+
 int Q1DBase::max_idx_value() const { return nparts; }
 int Q1DBase::idx_to_coord(int idx, int offset) const {
   return quotient * idx + offset;
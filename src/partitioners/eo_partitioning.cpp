@@ -133,6 +133,34 @@ vector<IndexResultD> EO::coord_to_idxs(const Coordinates &coord) const {
   return vector<IndexResultD>{{eo_idx, Coordinates(_rests), false}};
 }
 
+void EO::coord_to_real_idxs(CoordinateBlock &coords, //
+                            int begin,               //
+                            int end,                 //
+                            int *idx) const {
+  const int ndims = cbflags.size();
+  if (coords.x.size() == ndims) // adding the idxh dimension
+    coords.x.push_back(vector<int>(coords.size()));
+  int *idxh = coords.x[ndims].data();
+  std::fill(idxh + begin, idxh + end, 0);
+  std::fill(idx + begin, idx + end, static_cast<int>(origin_parity));
+  int cbdim = 0;
+  for (int d = 0; d < ndims; ++d) {
+    if (not cbflags[d])
+      continue;
+    int *x = coords.x[d].data();
+    int cumsize = cumcbsizes[cbdim++];
+    for (int i = begin; i < end; ++i) {
+      idxh[i] += x[i] * cumsize;
+      idx[i] += x[i];
+      x[i] = 0;
+    }
+  }
+  for (int i = begin; i < end; ++i) {
+    idxh[i] /= 2;
+    idx[i] %= 2;
+  }
+}
+
 int EO::dimensionality() const { return spd.size(); }
 
 } // namespace partitioning
@@ -9,6 +9,8 @@ using partitioning::Dimensionalise;
 IPartitioner::IPartitioner(std::string name_) : name(name_) {}
 EO::EO(std::string name_, hypercubes::slow::partitioning::EO::CBFlags cbflags_)
     : IPartitioner(name_), cbflags(cbflags_) {}
+SFC::SFC(std::string name_, DimFlags dimflags_, sfc::Curve curve_)
+    : IPartitioner(name_), dimflags(dimflags_), curve(curve_) {}
 Site::Site() : IPartitioner("Site") {}
 QPeriodic::QPeriodic(std::string name_, int dimension_, int nparts_)
     : IPartitioner(name_), dimension(dimension_), nparts(nparts_) {}
@@ -31,6 +33,10 @@ class partitioning::EO *EO::get(PartInfos sp) const {
   return new partitioning::EO(sp, cbflags, name);
 }
 
+class partitioning::SFC *SFC::get(PartInfoD sp) const {
+  return new partitioning::SFC(sp, dimflags, curve, name);
+}
+
 class partitioning::Site *Site::get(PartInfos sp) const {
   return new partitioning::Site(sp);
 }
@@ -57,6 +63,9 @@ using CBFlags = hypercubes::slow::partitioning::EO::CBFlags;
 IPartRP EO(std::string name, CBFlags cbflags) {
   return std::make_shared<partitioners::EO>(name, cbflags);
 };
+IPartRP SFC(std::string name, DimFlags dimflags, sfc::Curve curve) {
+  return std::make_shared<partitioners::SFC>(name, dimflags, curve);
+};
 IPartRP Site() { //
   return std::make_shared<partitioners::Site>();
 };
@@ -13,6 +13,32 @@ Sizes IPartitioning::idx_to_sizes(int idx) const {
                       return sp.size;
                     });
 };
+
+void IPartitioning::coord_to_real_idxs(CoordinateBlock &coords, //
+                                       int begin,               //
+                                       int end,                 //
+                                       int *idx) const {
+  int npoints = coords.size();
+  Coordinates coord(coords.x.size());
+  for (int i = begin; i < end; ++i) {
+    for (int d = 0; d < coord.size(); ++d)
+      coord[d] = coords.x[d][i];
+    auto idrs = coord_to_idxs(coord);
+    auto real = std::find_if(idrs.begin(), idrs.end(),
+                             [](const IndexResultD &r) { //
+                               return not r.cached_flag;
+                             });
+    if (real == idrs.end()) {
+      idx[i] = -1;
+      continue;
+    }
+    idx[i] = real->idx;
+    while (coords.x.size() < real->rest.size())
+      coords.x.push_back(vector<int>(npoints));
+    for (int d = 0; d < real->rest.size(); ++d)
+      coords.x[d][i] = real->rest[d];
+  }
+}
 } // namespace partitioning
 } // namespace slow
 } // namespace hypercubes
@@ -0,0 +1,140 @@
+#include "partitioners/sfc_partitioning.hpp"
+#include "geometry/eo.hpp"
+#include "utils/tuple_printer.hpp"
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+namespace hypercubes {
+namespace slow {
+namespace partitioning {
+
+SFC::SFC(const PartInfoD &sp_, const SFC::DimFlags &dimflags_,
+         sfc::Curve curve_, const std::string &name_)
+    : spd(sp_), dimflags(dimflags_), curve(curve_), name(name_) {
+  if (spd.size() != dimflags.size())
+    throw std::invalid_argument(
+        name + ": Lengths of sp and dimflags must be the same. " +
+        "they are instead, respectively, " + std::to_string(spd.size()) +
+        " and " + std::to_string(dimflags.size()));
+
+  for (int i = 0; i < dimflags.size(); ++i)
+    if (dimflags[i])
+      sizes.push_back(spd[i].size);
+  cumsizes = eo::get_cumsizes(sizes);
+  order = sfc::curve_order(sizes, curve);
+  position.resize(order.size());
+  for (int idx = 0; idx < order.size(); ++idx)
+    position[order[idx]] = idx;
+
+  // Each site keeps the parity of its position, as in Partitioning1D
+  std::set<PartInfoD> kinds_set;
+  vector<PartInfoD> site_kinds;
+  site_kinds.reserve(order.size());
+  for (int idx = 0; idx < order.size(); ++idx) {
+    auto x = eo::lex_idx_to_coord(order[idx], sizes);
+    PartInfoD kind = spd;
+    int seldim = 0;
+    for (int i = 0; i < dimflags.size(); ++i)
+      if (dimflags[i]) {
+        Parity p = spd[i].parity == Parity::NONE
+                       ? Parity::NONE
+                       : static_cast<Parity>((spd[i].parity + x[seldim]) % 2);
+        kind[i] = PartInfo{1, p};
+        seldim++;
+      }
+    kinds_set.insert(kind);
+    site_kinds.push_back(kind);
+  }
+  kinds = PartInfosD(kinds_set.begin(), kinds_set.end());
+  kind_of_idx.reserve(order.size());
+  for (const auto &kind : site_kinds)
+    kind_of_idx.push_back(
+        std::lower_bound(kinds.begin(), kinds.end(), kind) - kinds.begin());
+}
+
+void SFC::check_idx(int idx) const {
+  if (idx < 0 or idx >= max_idx_value())
+    throw std::invalid_argument(name + ": idx=" + std::to_string(idx) +
+                                ", not in range [0," +
+                                std::to_string(max_idx_value()) + ")");
+}
+
+Coordinates SFC::idx_to_coords(int idx, const Coordinates &offset) const {
+  check_idx(idx);
+  if (dimensionality() != offset.size())
+    throw std::invalid_argument(name + ": The length of offset must be " +
+                                std::to_string(dimensionality()) +
+                                ", it is instead " +
+                                std::to_string(offset.size()));
+  auto x = eo::lex_idx_to_coord(order[idx], sizes);
+  Coordinates res(offset);
+  int seldim = 0;
+  for (int i = 0; i < dimflags.size(); ++i)
+    if (dimflags[i]) {
+      if (offset[i] != 0)
+        throw std::invalid_argument(name +
+                                    ": Offset must be zero in the dimensions "
+                                    "of the curve.");
+      res[i] = x[seldim++];
+    }
+  return res;
+}
+PartInfosD SFC::sub_partinfo_kinds() const { return kinds; }
+int SFC::idx_to_partinfo_kind(int idx) const {
+  check_idx(idx);
+  return kind_of_idx[idx];
+}
+int SFC::max_idx_value() const { return order.size(); }
+std::string SFC::get_name() const { return name; }
+std::string SFC::comments() const { return tuple_to_str(key()); }
+
+vector<IndexResultD> SFC::coord_to_idxs(const Coordinates &coord) const {
+  vector<int> x;
+  vector<int> rest(coord.begin(), coord.end());
+  for (int i = 0; i < dimflags.size(); ++i)
+    if (dimflags[i]) {
+      if (coord[i] < 0 or coord[i] >= spd[i].size)
+        return vector<IndexResultD>();
+      x.push_back(coord[i]);
+      rest[i] = 0;
+    }
+  int idx = position[eo::lex_coord_to_idx(x, cumsizes)];
+  return vector<IndexResultD>{{idx, Coordinates(rest), false}};
+}
+
+void SFC::coord_to_real_idxs(CoordinateBlock &coords, //
+                             int begin,               //
+                             int end,                 //
+                             int *idx) const {
+  std::fill(idx + begin, idx + end, 0);
+  vector<bool> inside(end - begin, true);
+  int seldim = 0;
+  for (int d = 0; d < dimflags.size(); ++d) {
+    if (not dimflags[d])
+      continue;
+    const int *x = coords.x[d].data();
+    int size = spd[d].size;
+    int cumsize = cumsizes[seldim++];
+    for (int i = begin; i < end; ++i) {
+      inside[i - begin] = inside[i - begin] and 0 <= x[i] and x[i] < size;
+      idx[i] += x[i] * cumsize;
+    }
+  }
+  for (int i = begin; i < end; ++i) {
+    if (not inside[i - begin]) {
+      idx[i] = -1;
+      continue;
+    }
+    idx[i] = position[idx[i]];
+    for (int d = 0; d < dimflags.size(); ++d)
+      if (dimflags[d])
+        coords.x[d][i] = 0;
+  }
+}
+
+int SFC::dimensionality() const { return spd.size(); }
+
+} // namespace partitioning
+} // namespace slow
+} // namespace hypercubes
@@ -1,4 +1,5 @@
 #include "partitioners/site.hpp"
+#include <algorithm>
 #include <exception>
 #include <stdexcept>
 
@@ -34,6 +35,14 @@ std::string Site::comments() const { return ""; }
 vector<IndexResultD> Site::coord_to_idxs(const Coordinates &coord) const {
   return {{0, Coordinates(dimensionality(), 0), false}};
 };
+void Site::coord_to_real_idxs(CoordinateBlock &coords, //
+                              int begin,               //
+                              int end,                 //
+                              int *idx) const {
+  std::fill(idx + begin, idx + end, 0);
+  for (auto &x : coords.x)
+    std::fill(x.begin() + begin, x.begin() + end, 0);
+}
 int Site::dimensionality() const { return dimension; }
 
 } // namespace partitioning
@@ -0,0 +1,159 @@
+#include "trees/flat_offset_tree.hpp"
+#include "exceptions/exceptions.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace hypercubes {
+namespace slow {
+namespace internals {
+
+int FlatOffsetTree::nnodes() const { return offsets.size(); }
+int FlatOffsetTree::nchildren(int node) const {
+  return child_start[node + 1] - child_start[node];
+}
+
+FlatOffsetTree flatten_offset_tree(const TreeP<std::pair<int, int>> &tree,
+                                   bool sites_in_leaves) {
+  FlatOffsetTree res;
+  res.sites_in_leaves = sites_in_leaves;
+  // Nodes are numbered breadth-first,
+  // so that the children of a node have consecutive ids
+  // and their offsets are contiguous (and sorted) in res.offsets.
+  vector<const Tree<std::pair<int, int>> *> nodes{tree.get()};
+  for (int i = 0; i < nodes.size(); ++i) {
+    const auto *t = nodes[i];
+    const auto &children = t->children;
+    int start = t->n.second;
+    int n = children.size();
+    res.child_start.push_back(res.child_node.size());
+    res.offsets.push_back(start);
+
+    int stride = n > 1 ? children[1]->n.second - children[0]->n.second : 1;
+    bool regular = n > 0 and stride > 0;
+    bool sorted = true;
+    for (int k = 0; k < n; ++k) {
+      const auto &c = children[k];
+      regular = regular and c->n.first == k and
+                c->n.second == start + k * stride;
+      sorted = sorted and (k == 0 or children[k - 1]->n.first < c->n.first);
+      res.keys.push_back(c->n.first);
+      res.child_node.push_back(nodes.size());
+      nodes.push_back(c.get());
+    }
+    res.stride.push_back(regular ? stride : 0);
+    res.sorted_keys.push_back(sorted);
+  }
+  res.child_start.push_back(res.child_node.size());
+  return res;
+}
+
+static void throw_key_not_found(const int *idxs, int nidxs, int i) {
+  std::stringstream message;
+  message << "Key " << idxs[i] << " at position " << i
+          << " not found, indices: ";
+  for (int j = 0; j < nidxs; ++j)
+    message << idxs[j] << " ";
+  throw KeyNotFoundError(message.str());
+}
+
+// The position of the child of 'node' with the given key
+// in keys and child_node, or -1.
+static int find_child(const FlatOffsetTree &tree, int node, int key) {
+  int cstart = tree.child_start[node];
+  int n = tree.nchildren(node);
+  if (tree.stride[node] > 0)
+    return (unsigned)key < (unsigned)n ? cstart + key : -1;
+  auto begin = tree.keys.begin() + cstart;
+  auto end = begin + n;
+  auto it = tree.sorted_keys[node] ? std::lower_bound(begin, end, key)
+                                   : std::find(begin, end, key);
+  if (it == end or *it != key)
+    return -1;
+  return it - tree.keys.begin();
+}
+
+int get_offset(const FlatOffsetTree &tree, const int *idxs, int nidxs) {
+  int node = 0;
+  for (int i = 0; i < nidxs; ++i) {
+    int key = idxs[i];
+    if (tree.nchildren(node) == 0) {
+      if (tree.sites_in_leaves and i == nidxs - 1 and key >= 0)
+        return tree.offsets[node] + key;
+      throw_key_not_found(idxs, nidxs, i);
+    }
+    int c = find_child(tree, node, key);
+    if (c == -1)
+      throw_key_not_found(idxs, nidxs, i);
+    node = tree.child_node[c];
+  }
+  return tree.offsets[node];
+}
+
+int find_node(const FlatOffsetTree &tree, int node, const int *idxs,
+              int nidxs) {
+  for (int i = 0; i < nidxs; ++i) {
+    int c = tree.nchildren(node) == 0 ? -1 : find_child(tree, node, idxs[i]);
+    if (c == -1)
+      throw_key_not_found(idxs, nidxs, i);
+    node = tree.child_node[c];
+  }
+  return node;
+}
+
+int get_offset(const FlatOffsetTree &tree, const Indices &idxs) {
+  vector<int> v(idxs.begin(), idxs.end());
+  return get_offset(tree, v.data(), v.size());
+}
+
+void get_offsets(const FlatOffsetTree &tree, //
+                 const int *idxs,            //
+                 int nindices,               //
+                 int idx_size,               //
+                 int *offsets) {
+  for (int i = 0; i < nindices; ++i)
+    offsets[i] = get_offset(tree, idxs + i * idx_size, idx_size);
+}
+
+Indices get_indices(const FlatOffsetTree &tree, int offset) {
+  return get_indices(tree, 0, offset);
+}
+
+Indices get_indices(const FlatOffsetTree &tree, int node, int offset) {
+  Indices res;
+  if (offset < tree.offsets[node]) {
+    std::stringstream message;
+    message << "Not found: " << offset << " < " << tree.offsets[node];
+    throw KeyNotFoundError(message.str());
+  }
+  while (tree.nchildren(node) != 0) {
+    int cstart = tree.child_start[node];
+    int n = tree.nchildren(node);
+    int pos;
+    if (tree.stride[node] > 0)
+      pos = std::min((offset - tree.offsets[node]) / tree.stride[node], n - 1);
+    else {
+      // last child starting at or before offset
+      auto first = tree.offsets.begin() + tree.child_node[cstart];
+      pos = std::upper_bound(first, first + n, offset) - first - 1;
+      if (pos < 0) {
+        std::stringstream message;
+        message << "Not found: " << offset << " < " << *first;
+        throw KeyNotFoundError(message.str());
+      }
+    }
+    res.push_back(tree.keys[cstart + pos]);
+    node = tree.child_node[cstart + pos];
+  }
+  if (tree.sites_in_leaves)
+    res.push_back(offset - tree.offsets[node]);
+  else if (tree.offsets[node] != offset) {
+    std::stringstream message;
+    message << "Not found: " << offset << " != " << tree.offsets[node];
+    throw KeyNotFoundError(message.str());
+  }
+  return res;
+}
+
+} // namespace internals
+} // namespace slow
+} // namespace hypercubes
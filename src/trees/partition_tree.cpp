@@ -3,6 +3,7 @@
 #include "trees/tree.hpp"
 #include "utils/utils.hpp"
 #include <functional>
+#include <algorithm>
 #include <set>
 
 namespace hypercubes {
@@ -113,6 +114,93 @@ Indices get_real_indices(const PartitionTree &t, const Coordinates &xs) {
     };
 }
 
+int get_real_indices_size(const PartitionTree &t) {
+  int res = 1;
+  for (auto c = t; c->children.size() != 0 and
+                   c->children[0]->n->get_name() != "Site";
+       c = c->children[0])
+    res++;
+  return res;
+}
+
+namespace {
+struct BatchState {
+  partitioning::CoordinateBlock &xs;
+  int *indices;
+  int nlevels;
+  vector<int> point_ids; // original position of each point in the block
+  vector<int> idx;
+  vector<int> scratch;
+  vector<int> offsets;
+};
+
+/* Computes the index at this level for the points in [begin,end),
+ * then sorts them by index (counting sort, stable)
+ * so that the points going to each child are contiguous. */
+void _get_real_indices_batch(const PartitionTree &t, //
+                             int level,              //
+                             int begin,              //
+                             int end,                //
+                             BatchState &s) {
+  t->n->coord_to_real_idxs(s.xs, begin, end, s.idx.data());
+  for (int i = begin; i < end; ++i)
+    s.indices[s.point_ids[i] * s.nlevels + level] = s.idx[i];
+  if (level + 1 == s.nlevels)
+    return;
+
+  int nchildren = t->children.size();
+  vector<int> &offsets = s.offsets;
+  offsets.assign(nchildren + 2, 0); // bucket 0 is for the missing points
+  for (int i = begin; i < end; ++i)
+    offsets[s.idx[i] + 2]++;
+  offsets[0] = begin;
+  for (int b = 1; b < offsets.size(); ++b)
+    offsets[b] += offsets[b - 1];
+  // offsets[b+1] is now the start of bucket b
+  vector<int> dest(end - begin);
+  for (int i = begin; i < end; ++i)
+    dest[i - begin] = offsets[s.idx[i] + 1]++;
+  // offsets[b] is now the start of bucket b
+
+  auto permute = [&](vector<int> &v) {
+    for (int i = begin; i < end; ++i)
+      s.scratch[dest[i - begin]] = v[i];
+    std::copy(s.scratch.begin() + begin, s.scratch.begin() + end,
+              v.begin() + begin);
+  };
+  for (auto &x : s.xs.x)
+    permute(x);
+  permute(s.point_ids);
+
+  for (int i = begin; i < offsets[0]; ++i)
+    for (int l = level + 1; l < s.nlevels; ++l)
+      s.indices[s.point_ids[i] * s.nlevels + l] = -1;
+
+  vector<int> child_starts(offsets.begin(), offsets.begin() + nchildren + 1);
+  for (int c = 0; c < nchildren; ++c)
+    if (child_starts[c] < child_starts[c + 1])
+      _get_real_indices_batch(t->children[c], level + 1, //
+                              child_starts[c], child_starts[c + 1], s);
+}
+} // namespace
+
+void get_real_indices_batch(const PartitionTree &t,            //
+                            partitioning::CoordinateBlock &xs, //
+                            int *indices) {
+  int npoints = xs.size();
+  BatchState s{xs,
+               indices,
+               get_real_indices_size(t),
+               vector<int>(npoints),
+               vector<int>(npoints),
+               vector<int>(npoints),
+               {}};
+  for (int i = 0; i < npoints; ++i)
+    s.point_ids[i] = i;
+  if (npoints != 0)
+    _get_real_indices_batch(t, 0, 0, npoints, s);
+}
+
 TreeP<GhostResult> get_indices_tree_with_ghosts(const PartitionTree &t,
                                                 const Coordinates &xs) {
 
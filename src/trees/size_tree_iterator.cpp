@@ -57,6 +57,64 @@ Indices next(const SizeTree &size_tree, const Indices &idxs) {
 
 Indices get_end_idxs() { return Indices{}; }
 
+SizeTreeIterator::SizeTreeIterator(const SizeTree &size_tree)
+    : root(size_tree) {
+  if (root->n.second != 0)
+    descend(root.get(), 0);
+}
+
+SizeTreeIterator SizeTreeIterator::operator++(int) {
+  SizeTreeIterator res = *this;
+  ++*this;
+  return res;
+}
+
+// Goes to the n-th site in the subtree rooted at node.
+void SizeTreeIterator::descend(Node node, int n) {
+  while (node->children.size() != 0) {
+    int pos = 0;
+    while (n >= node->children[pos]->n.second)
+      n -= node->children[pos++]->n.second;
+    stack.push_back({node, pos});
+    idxs.push_back(node->children[pos]->n.first);
+    node = node->children[pos].get();
+  }
+  leaf = node;
+  idxs.push_back(n);
+}
+
+SizeTreeIterator &SizeTreeIterator::operator+=(int n) {
+  int site = idxs[idxs.size() - 1] + n;
+  int leaf_size = leaf->n.second;
+  if (site < leaf_size) {
+    idxs[idxs.size() - 1] = site;
+    return *this;
+  }
+  n = site - leaf_size; // from the start of the next subtree
+  idxs.pop_back();
+  while (stack.size() != 0) {
+    Frame &f = stack.back();
+    idxs.pop_back();
+    const auto &children = f.node->children;
+    for (++f.pos; f.pos < children.size(); ++f.pos) {
+      int size = children[f.pos]->n.second;
+      if (n < size) {
+        idxs.push_back(children[f.pos]->n.first);
+        descend(children[f.pos].get(), n);
+        return *this;
+      }
+      n -= size;
+    }
+    stack.pop_back();
+  }
+  leaf = nullptr; // end
+  return *this;
+}
+
+SizeTreeSites sites(const SizeTree &size_tree) {
+  return SizeTreeSites{size_tree};
+}
+
 } // namespace internals
 } // namespace slow
 } // namespace hypercubes
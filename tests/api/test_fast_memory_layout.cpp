@@ -0,0 +1,99 @@
+#include <boost/test/unit_test.hpp>
+
+#include "fast/memory_layout.hpp"
+#include "fixtures2D.hpp"
+
+using namespace hypercubes::slow;
+namespace fast = hypercubes::fast;
+
+/* The same trees as in GridLike2DOffset,
+ * with the fast implementation. */
+struct FastGridLike2D : public GridLike2DOffset {
+  fast::PartitionTree fast_partition_tree;
+  fast::SkeletonTree fast_skeleton_tree_unfiltered;
+  fast::SkeletonTree fast_skeleton_tree;
+  fast::SizeTree fast_size_tree;
+  fast::OffsetTree fast_offset_tree;
+  FastGridLike2D()
+      : GridLike2DOffset(),
+        fast_partition_tree(sizes, partitioners, nonspatial_dimensions),
+        fast_skeleton_tree_unfiltered(fast_partition_tree.skeleton_tree()),
+        fast_skeleton_tree(fast_skeleton_tree_unfiltered.prune(predicate)),
+        fast_size_tree(fast_skeleton_tree.size_tree()),
+        fast_offset_tree(fast_size_tree.offset_tree()) {}
+};
+
+BOOST_AUTO_TEST_SUITE(test_fast_memory_layout)
+
+BOOST_FIXTURE_TEST_CASE(test_fast_trees_same_as_slow, FastGridLike2D) {
+  BOOST_TEST(*fast_skeleton_tree_unfiltered.get_internal() ==
+             *skeleton_tree_unfiltered.get_internal());
+  BOOST_TEST(*fast_skeleton_tree.get_internal() ==
+             *skeleton_tree.get_internal());
+  BOOST_TEST(*fast_size_tree.get_internal() == *size_tree.get_internal());
+  BOOST_TEST(*fast_offset_tree.get_internal() == *offset_tree.get_internal());
+  BOOST_TEST(fast_offset_tree.get_level_names() ==
+             offset_tree.get_level_names());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fast_queries_same_as_slow, FastGridLike2D) {
+  auto leaves = internals::get_leaves_kv(offset_tree.get_internal());
+  vector<int> idxs;
+  for (const auto &leaf : leaves) {
+    BOOST_TEST(fast_offset_tree.get_offset(leaf.first) == leaf.second);
+    BOOST_TEST(fast_offset_tree.get_indices(leaf.second) == leaf.first);
+    idxs.insert(idxs.end(), leaf.first.begin(), leaf.first.end());
+  }
+  int idx_size = leaves[0].first.size();
+  vector<int> offsets(leaves.size());
+  fast_offset_tree.get_offsets(idxs.data(), leaves.size(), idx_size,
+                               offsets.data());
+  for (int i = 0; i < leaves.size(); ++i)
+    BOOST_TEST(offsets[i] == leaves[i].second);
+
+  Indices partial{2, 1, 0, 1};
+  BOOST_TEST(fast_size_tree.get_size(partial) == size_tree.get_size(partial));
+  BOOST_TEST(fast_skeleton_tree.get_nchildren(partial) ==
+             skeleton_tree.get_nchildren(partial));
+  BOOST_CHECK_THROW(fast_skeleton_tree.get_nchildren(Indices{0}),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(fast_offset_tree.get_offset(Indices{0}),
+                    std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fast_subtree_shift_same_as_slow, FastGridLike2D) {
+  Indices idxs{2, 1, 0, 1, 2};
+  auto subtree = offset_tree.get_subtree(idxs);
+  auto fast_subtree = fast_offset_tree.get_subtree(idxs);
+  BOOST_TEST(*fast_subtree.get_internal() == *subtree.get_internal());
+  BOOST_TEST(fast_subtree.get_level_names() == subtree.get_level_names());
+
+  int main_offset = subtree.get_offset({});
+  auto shifted = subtree.shift(-main_offset);
+  auto fast_shifted = fast_subtree.shift(-main_offset);
+  BOOST_TEST(*fast_shifted.get_internal() == *shifted.get_internal());
+  for (int offset = 0; offset < 9; ++offset) {
+    Indices i = shifted.get_indices(offset);
+    BOOST_TEST(fast_shifted.get_indices(offset) == i);
+    BOOST_TEST(fast_shifted.get_offset(i) == offset);
+  }
+
+  BOOST_TEST(*fast_size_tree.get_subtree(idxs).get_internal() ==
+             *size_tree.get_subtree(idxs).get_internal());
+  BOOST_TEST(*fast_skeleton_tree.get_subtree(idxs).get_internal() ==
+             *skeleton_tree.get_subtree(idxs).get_internal());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fast_permute_same_as_slow, FastGridLike2D) {
+  vector<std::string> permuted_level_names{
+      "MPI X", "MPI Y",  "EO",       "Local-matrow", "Halo X",
+      "Halo Y", "Extra", "Vector X", "Vector Y",     "Site",
+  };
+  auto permuted = skeleton_tree.permute(permuted_level_names);
+  auto fast_permuted = fast_skeleton_tree.permute(permuted_level_names);
+  BOOST_TEST(*fast_permuted.get_internal() == *permuted.get_internal());
+  BOOST_TEST(*fast_permuted.size_tree().offset_tree().get_internal() ==
+             *permuted.size_tree().offset_tree().get_internal());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,113 @@
+#include "../api_v2/codegen_fixtures.hpp"
+#include "api/field.hpp"
+#include "fixtures2D.hpp"
+#include "trees/partition_tree_allocations.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+
+using namespace hypercubes::slow;
+
+BOOST_AUTO_TEST_SUITE(test_field)
+
+BOOST_FIXTURE_TEST_CASE(test_field_layout_same_as_offset_tree,
+                        GridLike2DOffset) {
+  FieldLayout layout(size_tree);
+  BOOST_TEST(layout.size() == size_tree.get_size({}));
+  BOOST_TEST(layout.get_level_names() == size_tree.get_level_names());
+  for (const auto &leaf :
+       internals::get_leaves_kv(offset_tree.get_internal())) {
+    BOOST_TEST(layout.get_offset(leaf.first) == leaf.second);
+    BOOST_TEST(layout.get_indices(leaf.second) == leaf.first);
+  }
+  Indices partial{2, 1, 0, 1};
+  auto sublayout = layout.get_subtree(partial);
+  BOOST_TEST(sublayout.start() == offset_tree.get_offset(partial));
+  BOOST_TEST(sublayout.size() == size_tree.get_size(partial));
+  BOOST_TEST(sublayout.get_level_names() ==
+             size_tree.get_subtree(partial).get_level_names());
+  BOOST_CHECK_THROW(layout.get_offset(Indices{0}), std::invalid_argument);
+  BOOST_CHECK_THROW(layout.get_offset(Coordinates{0, 0, 0}),
+                    std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_field_access, GridLike2DOffset) {
+  Field<int> field{FieldLayout(size_tree, partition_tree)};
+  BOOST_TEST(reinterpret_cast<std::uintptr_t>(field.begin()) % 64 == 0);
+  for (int offset = 0; offset < field.size(); ++offset) {
+    BOOST_TEST(field[offset] == 0);
+    field[offset] = offset;
+  }
+  for (int offset = 0; offset < field.size(); offset += 7)
+    BOOST_TEST(field(offset_tree.get_indices(offset)) == offset);
+
+  auto matcher = get_level_matcher(partition_tree, offset_tree);
+  for (Coordinates xs : {Coordinates{24, 12, 0}, //
+                         Coordinates{35, 23, 2}, //
+                         Coordinates{30, 20, 1}}) {
+    Indices idxs = matcher(partition_tree.get_indices(xs));
+    BOOST_TEST(field(xs) == offset_tree.get_offset(idxs));
+  }
+  // not in the local domain
+  BOOST_CHECK_THROW(field(Coordinates{0, 0, 0}), std::invalid_argument);
+
+  Indices partial{2, 1, 0, 1};
+  auto view = field.view(partial);
+  int start = offset_tree.get_offset(partial);
+  BOOST_TEST(view.size() == size_tree.get_size(partial));
+  for (int i = 0; i < view.size(); ++i)
+    BOOST_TEST(view[i] == start + i);
+  Indices idxs = offset_tree.get_indices(start + 3);
+  Indices rest(idxs.begin() + partial.size(), idxs.end());
+  BOOST_TEST(view(rest) == start + 3);
+  BOOST_TEST(view.view(Indices{0})[0] ==
+             field.view(Indices{2, 1, 0, 1, 0})[0]);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_field_leaf_parent_blocks, GridLike2DOffset) {
+  Field<double> field{FieldLayout(size_tree)};
+  auto blocks = field.leaf_parent_blocks();
+  // All the leaves are at the same depth,
+  // so the blocks cover the whole field.
+  const double *next = field.begin();
+  for (const auto &b : blocks) {
+    BOOST_TEST(b.begin() == next);
+    next = b.end();
+  }
+  BOOST_TEST(next == field.end());
+
+  Indices partial{2, 1, 0, 1};
+  auto view = field.view(partial);
+  auto view_blocks = view.leaf_parent_blocks();
+  BOOST_TEST(view_blocks.size() > 0);
+  BOOST_TEST(view_blocks.front().begin() == view.begin());
+  BOOST_TEST(view_blocks.back().end() == view.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_field_from_network,
+                        codegen_fixtures::BuildFork1) {
+  FieldLayout layout(n, "root", "vector");
+  BOOST_TEST(layout.get_level_names() == n["vector"]->output_levelnames);
+
+  // The vectors created by CollectLeaves, padded to 8 sites,
+  // are aligned to 64 bytes.
+  Field<double> field(layout);
+  auto blocks = field.leaf_parent_blocks();
+  BOOST_TEST(blocks.size() > 0);
+  for (const auto &b : blocks) {
+    BOOST_TEST(b.size == 8);
+    BOOST_TEST(reinterpret_cast<std::uintptr_t>(b.begin()) % 64 == 0);
+  }
+  BOOST_TEST(blocks.size() * 8 == field.size());
+
+  auto to_root = n.get_transform("vector", "root");
+  for (int x = 0; x < 12; ++x)
+    for (int y = 0; y < 12; ++y) {
+      int offset = layout.get_offset(Coordinates{x, y});
+      Indices idxs = layout.get_indices(offset);
+      vector<int> idx(idxs.begin(), idxs.end());
+      vector<vector<int>> expected{{x, y}};
+      BOOST_TEST(to_root->apply(idx) == expected);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
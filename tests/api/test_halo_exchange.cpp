@@ -0,0 +1,55 @@
+#include <boost/test/unit_test.hpp>
+
+#include "api/halo_exchange.hpp"
+#include "api/lookup_tables.hpp"
+#include "fixtures2D.hpp"
+
+using namespace hypercubes::slow;
+
+BOOST_AUTO_TEST_SUITE(test_halo_exchange)
+
+BOOST_AUTO_TEST_CASE(test_coalesce) {
+  vector<int> offsets{3, 4, 5, 9, 11, 12, 2};
+  vector<Run> exp{{3, 3}, {9, 1}, {11, 2}, {2, 1}};
+  BOOST_TEST((coalesce(offsets) == exp));
+  BOOST_TEST(coalesce({}).size() == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_halo_exchange_plan, GridLike2DOffset) {
+  vector<BoundaryCondition> bcs{BoundaryCondition::PERIODIC,
+                                BoundaryCondition::PERIODIC,
+                                BoundaryCondition::OPEN};
+  vector<int> rank{2, 1};
+  auto plan = make_halo_exchange_plan(partition_tree, partitioners, bcs, rank);
+
+  // 2x2 vector partitions of 6x6 sites, with a halo of 1
+  BOOST_TEST(plan.nsites() == (16 * 16 - 12 * 12) * 3);
+
+  // Checking the offsets using the lookup tables of each rank
+  LookupTables local(partition_tree, offset_tree, bcs, {});
+  for (const auto &m : plan.messages) {
+    BOOST_TEST((m.side == 0 or m.side == 4));
+    BOOST_TEST((m.direction == X or m.direction == Y));
+    auto predicate = getp(selectors::mpi_rank, partitioners, m.neighbour);
+    auto neighbour_offsets = partition_tree.skeleton_tree()
+                                 .prune(predicate)
+                                 .size_tree()
+                                 .offset_tree();
+    LookupTables neighbour(partition_tree, neighbour_offsets, bcs, {});
+    for (int i = 0; i < m.src_offsets.size(); ++i) {
+      int lex = neighbour.offset_to_lex()[m.src_offsets[i]];
+      BOOST_TEST(neighbour.coord_to_offset()[lex] == m.src_offsets[i]);
+      BOOST_TEST(local.offset_to_lex()[m.dst_offsets[i]] == lex);
+    }
+    int packed = 0;
+    for (const auto &r : m.pack_runs)
+      packed += r.length;
+    BOOST_TEST(packed == m.src_offsets.size());
+  }
+  BOOST_TEST(plan.pack_contiguous_fraction() > 0);
+  BOOST_TEST(plan.pack_contiguous_fraction() <= 1);
+  BOOST_TEST(plan.unpack_contiguous_fraction() > 0);
+  BOOST_TEST(plan.unpack_contiguous_fraction() <= 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
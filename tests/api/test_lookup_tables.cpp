@@ -0,0 +1,126 @@
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <set>
+
+#include "api/lookup_tables.hpp"
+#include "fixtures1D.hpp"
+#include "fixtures2D.hpp"
+
+using namespace hypercubes::slow;
+
+BOOST_AUTO_TEST_SUITE(test_lookup_tables)
+
+BOOST_FIXTURE_TEST_CASE(test_lookup_tables_offsets, GridLike2DOffset) {
+  vector<BoundaryCondition> bcs{BoundaryCondition::PERIODIC,
+                                BoundaryCondition::PERIODIC,
+                                BoundaryCondition::OPEN};
+  LookupTables tables(partition_tree, offset_tree, bcs, {X, Y});
+  auto matcher = get_level_matcher(partition_tree, offset_tree);
+
+  int nlocal = 0;
+  for (int64_t lex = 0; lex < tables.nsites(); ++lex) {
+    int offset = tables.coord_to_offset()[lex];
+    if (offset == -1)
+      continue;
+    nlocal++;
+    Coordinates xs = tables.lex_coordinates(lex);
+    Indices idxs = partition_tree.get_indices(xs);
+    BOOST_TEST(offset == offset_tree.get_offset(matcher(idxs)));
+    BOOST_TEST(tables.offset_to_lex()[offset] == lex);
+  }
+  // rank (2,1) has 12x12 sites with 3 matrix rows
+  BOOST_TEST(nlocal == 12 * 12 * 3);
+  // each of the 2x2 vector partitions has a halo of 1
+  BOOST_TEST(tables.noffsets() == 16 * 16 * 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_lookup_tables_neighbours, GridLike2DOffset) {
+  vector<BoundaryCondition> bcs{BoundaryCondition::PERIODIC,
+                                BoundaryCondition::PERIODIC,
+                                BoundaryCondition::OPEN};
+  LookupTables tables(partition_tree, offset_tree, bcs, {X, Y});
+  for (int i = 0; i < 2; ++i)
+    for (int offset = 0; offset < tables.noffsets(); ++offset) {
+      int64_t lex = tables.offset_to_lex()[offset];
+      int up = tables.up(i)[offset];
+      if (lex == -1 or tables.coord_to_offset()[lex] != offset) {
+        BOOST_TEST(up == -1); // ghost
+        continue;
+      }
+      Coordinates xs = tables.lex_coordinates(lex);
+      Coordinates xup = hypercubes::slow::up(xs, sizes, bcs, i);
+      BOOST_TEST(up == tables.coord_to_offset()[tables.lex_index(xup)]);
+      if (up != -1)
+        BOOST_TEST(tables.down(i)[up] == offset);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_lookup_tables_ignore_halo_copies,
+                        GridLike2DOffset) {
+  vector<BoundaryCondition> bcs{BoundaryCondition::PERIODIC,
+                                BoundaryCondition::PERIODIC,
+                                BoundaryCondition::OPEN};
+  LookupTables tables(partition_tree, offset_tree, bcs, {X, Y});
+  std::set<int64_t> copies; // sites with a (real or ghost) copy here
+  for (int offset = 0; offset < tables.noffsets(); ++offset)
+    copies.insert(tables.offset_to_lex()[offset]);
+  for (int i = 0; i < 2; ++i) {
+    int nremote = 0;
+    for (int offset = 0; offset < tables.noffsets(); ++offset) {
+      int64_t lex = tables.offset_to_lex()[offset];
+      if (lex == -1 or tables.coord_to_offset()[lex] != offset)
+        continue;
+      Coordinates xs = tables.lex_coordinates(lex);
+      int64_t lex_up = tables.lex_index(hypercubes::slow::up(xs, sizes, bcs, i));
+      if (tables.coord_to_offset()[lex_up] != -1)
+        continue;
+      // the real copy is on another rank, a ghost copy is in the halo
+      BOOST_TEST(copies.count(lex_up) == 1);
+      BOOST_TEST(tables.up(i)[offset] == -1);
+      nremote++;
+    }
+    // a side of the 12x12 sites of the rank, with 3 matrix rows
+    BOOST_TEST(nremote == 12 * 3);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_lookup_tables_file_roundtrip, GridLike1DOffset) {
+  vector<BoundaryCondition> bcs{BoundaryCondition::PERIODIC,
+                                BoundaryCondition::OPEN};
+  LookupTables tables(partition_tree, offset_tree, bcs, {X});
+  std::string filename = "test_lookup_tables.bin";
+  tables.write(filename);
+  {
+    LookupTables mapped = LookupTables::map(filename);
+    BOOST_TEST(mapped.sizes() == tables.sizes());
+    BOOST_TEST(mapped.directions() == tables.directions());
+    BOOST_TEST(mapped.nsites() == tables.nsites());
+    BOOST_TEST(mapped.noffsets() == tables.noffsets());
+    BOOST_TEST(std::equal(tables.coord_to_offset(),
+                          tables.coord_to_offset() + tables.nsites(),
+                          mapped.coord_to_offset()));
+    BOOST_TEST(std::equal(tables.offset_to_lex(),
+                          tables.offset_to_lex() + tables.noffsets(),
+                          mapped.offset_to_lex()));
+    BOOST_TEST(std::equal(tables.up(0), tables.up(0) + tables.noffsets(),
+                          mapped.up(0)));
+    BOOST_TEST(std::equal(tables.down(0), tables.down(0) + tables.noffsets(),
+                          mapped.down(0)));
+  }
+  std::remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_lookup_tables_map_wrong_file) {
+  std::string filename = "test_lookup_tables_wrong.bin";
+  {
+    std::ofstream out(filename, std::ios::binary);
+    out << "this is not a lookup table file";
+  }
+  BOOST_CHECK_THROW(LookupTables::map(filename), std::runtime_error);
+  std::remove(filename.c_str());
+  BOOST_CHECK_THROW(LookupTables::map(filename), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
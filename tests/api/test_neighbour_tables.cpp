@@ -0,0 +1,125 @@
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <map>
+
+#include "api/lookup_tables.hpp"
+#include "api/neighbour_tables.hpp"
+#include "fixtures2D.hpp"
+
+using namespace hypercubes::slow;
+
+BOOST_AUTO_TEST_SUITE(test_neighbour_tables)
+
+namespace {
+/* The reference: get_coordinates + up/down + get_indices_wg + get_offset
+ * for each site and direction. */
+int slow_neighbour(const PartitionTree &partition_tree,
+                   const std::map<vector<int>, int> &local, //
+                   const Indices &site,                 //
+                   const Coordinates &xs) {
+  if (xs.size() == 0)
+    return -1;
+  int res = -1, best_prefix = -1, best_ncached = 0;
+  for (const auto &copy : partition_tree.get_indices_wg(xs)) {
+    auto it =
+        local.find(vector<int>(copy.second.begin(), copy.second.end()));
+    if (it == local.end())
+      continue;
+    int prefix = std::mismatch(site.begin(), site.end(), copy.second.begin())
+                     .first -
+                 site.begin();
+    if (prefix > best_prefix or
+        (prefix == best_prefix and copy.first < best_ncached)) {
+      res = it->second;
+      best_prefix = prefix;
+      best_ncached = copy.first;
+    }
+  }
+  return res;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(test_neighbour_tables_vs_slow_path, GridLike2DOffset) {
+  vector<BoundaryCondition> bcs{BoundaryCondition::PERIODIC,
+                                BoundaryCondition::PERIODIC,
+                                BoundaryCondition::OPEN};
+  NeighbourTables tables(partition_tree, offset_tree, bcs, {X, Y}, 4);
+  NeighbourTables serial(partition_tree, offset_tree, bcs, {X, Y});
+  BOOST_TEST(tables.noffsets() == 16 * 16 * 3);
+  BOOST_TEST(tables.directions() == (vector<int>{X, Y}));
+
+  auto matcher = get_level_matcher(offset_tree, partition_tree);
+  std::map<vector<int>, int> local;
+  for (const auto &l : internals::get_leaves_kv(offset_tree.get_internal()))
+  {
+    Indices idxs = matcher(l.first);
+    local[vector<int>(idxs.begin(), idxs.end())] = l.second;
+  }
+
+  int nchecked = 0;
+  for (const auto &l : local) {
+    Indices site(l.first);
+    const int offset = l.second;
+    Coordinates xs = partition_tree.get_coordinates(site);
+    for (int d : {X, Y})
+      xs[d] = (xs[d] + sizes[d]) % sizes[d];
+    for (int i = 0; i < 2; ++i) {
+      int up = slow_neighbour(partition_tree, local, site,
+                              hypercubes::slow::up(xs, sizes, bcs, i));
+      int down = slow_neighbour(partition_tree, local, site,
+                                hypercubes::slow::down(xs, sizes, bcs, i));
+      BOOST_TEST(tables.up(i)[offset] == up);
+      BOOST_TEST(tables.down(i)[offset] == down);
+      BOOST_TEST(serial.up(i)[offset] == up);
+      BOOST_TEST(serial.down(i)[offset] == down);
+      nchecked += up != -1;
+    }
+  }
+  BOOST_TEST(nchecked > 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_neighbour_tables_read_own_halo,
+                        GridLike2DOffset) {
+  vector<BoundaryCondition> bcs{BoundaryCondition::PERIODIC,
+                                BoundaryCondition::PERIODIC,
+                                BoundaryCondition::OPEN};
+  NeighbourTables tables(partition_tree, offset_tree, bcs, {X, Y});
+  LookupTables lookup(partition_tree, offset_tree, bcs, {X, Y});
+  const int vector_levels = 4; // MPI X, MPI Y, Vector X, Vector Y
+  int nghosts = 0;
+  for (int i = 0; i < 2; ++i)
+    for (int offset = 0; offset < lookup.noffsets(); ++offset) {
+      int64_t lex = lookup.offset_to_lex()[offset];
+      if (lex == -1 or lookup.coord_to_offset()[lex] != offset)
+        continue; // ghost
+      Coordinates xs = lookup.lex_coordinates(lex);
+      for (int dir : {-1, 1}) {
+        int neighbour = (dir == 1 ? tables.up(i) : tables.down(i))[offset];
+        int real = (dir == 1 ? lookup.up(i) : lookup.down(i))[offset];
+        Coordinates xn = dir == 1 ? hypercubes::slow::up(xs, sizes, bcs, i)
+                                  : hypercubes::slow::down(xs, sizes, bcs, i);
+        // every real site has all its neighbours, in its own partition
+        BOOST_TEST_REQUIRE(neighbour != -1);
+        Indices a = offset_tree.get_indices(offset);
+        Indices b = offset_tree.get_indices(neighbour);
+        BOOST_TEST((Indices(a.begin(), a.begin() + vector_levels) ==
+                    Indices(b.begin(), b.begin() + vector_levels)));
+        BOOST_TEST(lookup.offset_to_lex()[neighbour] == lookup.lex_index(xn));
+        // the real copy is used only inside the partition
+        nghosts += neighbour != real;
+      }
+    }
+  // each of the 2x2 vector partitions of 6x6 sites reads 4*6 ghosts,
+  // with 3 matrix rows, including the ones from the other MPI ranks
+  // (that are not in the lookup tables)
+  BOOST_TEST(nghosts == 4 * 4 * 6 * 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_neighbour_tables_throws_on_wrong_bcs) {
+  GridLike2DOffset f;
+  BOOST_CHECK_THROW(NeighbourTables(f.partition_tree, f.offset_tree,
+                                    {BoundaryCondition::PERIODIC}, {0}),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
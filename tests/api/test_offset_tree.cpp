@@ -96,6 +96,31 @@ BOOST_FIXTURE_TEST_CASE(test_offset_get_indices_roundtrip_many,
     BOOST_TEST(offset == offset_roundtrip);
   };
 }
+BOOST_FIXTURE_TEST_CASE(test_offset_get_offset_vs_tree_search,
+                        GridLike2DOffset) {
+  auto tree = offset_tree.get_internal();
+  auto leaves = internals::get_leaves_kv(tree);
+  vector<int> idxs;
+  for (const auto &leaf : leaves) {
+    BOOST_TEST(offset_tree.get_offset(leaf.first) == leaf.second);
+    BOOST_TEST(offset_tree.get_indices(leaf.second) == leaf.first);
+    BOOST_TEST(internals::search_in_sorted_tree(tree, leaf.second) ==
+               leaf.first);
+    idxs.insert(idxs.end(), leaf.first.begin(), leaf.first.end());
+  }
+  int idx_size = leaves[0].first.size();
+  vector<int> offsets(leaves.size());
+  offset_tree.get_offsets(idxs.data(), leaves.size(), idx_size,
+                          offsets.data());
+  for (int i = 0; i < leaves.size(); ++i)
+    BOOST_TEST(offsets[i] == leaves[i].second);
+}
+BOOST_FIXTURE_TEST_CASE(test_offset_get_offset_invalid, GridLike2DOffset) {
+  // MPI rank 0 along X is not in the tree
+  BOOST_CHECK_THROW(offset_tree.get_offset({0, 1, 0, 1, 2, 2, 0, 2, 0}),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(offset_tree.get_indices(-1), std::invalid_argument);
+}
 BOOST_FIXTURE_TEST_CASE(test_get_subtree_level_names, GridLike1DOffset) {
   BOOST_TEST(offset_tree.get_subtree({2, 0, 2}).get_level_names() ==
              vector<std::string>({"EO", "Local-matrow", "Extra", "Site"}));
@@ -43,4 +43,67 @@ BOOST_FIXTURE_TEST_CASE(test_get_partitioners_name, GridLikeBase1D) {
                                   "Local-matrow", "Extra", "Site"}));
 }
 
+
+/* Checks the batch get_indices against the pointwise version,
+ * point by point. */
+void check_get_indices_batch(const PartitionTree &partition_tree,
+                             const vector<Coordinates> &points) {
+  int ndims = points[0].size();
+  partitioning::CoordinateBlock block{vector<vector<int>>(ndims)};
+  for (const auto &xs : points)
+    for (int d = 0; d < ndims; ++d)
+      block.x[d].push_back(xs[d]);
+
+  int nlevels = partition_tree.get_indices_size();
+  vector<int> indices(points.size() * nlevels);
+  partition_tree.get_indices(block, indices.data());
+  for (int i = 0; i < points.size(); ++i) {
+    Indices exp = partition_tree.get_indices(points[i]);
+    BOOST_TEST(exp.size() == nlevels);
+    BOOST_TEST(exp == Indices(indices.begin() + i * nlevels,
+                              indices.begin() + (i + 1) * nlevels));
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_get_indices_batch_1D, GridLikeBase1D) {
+  vector<Coordinates> points;
+  for (int x = 0; x < sizes[X]; ++x)
+    for (int m = 0; m < sizes[MATROW]; ++m)
+      points.push_back({x, m});
+  check_get_indices_batch(partition_tree, points);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_get_indices_batch_4D, GridLikeBase) {
+  vector<Coordinates> points;
+  unsigned seed = 12345;
+  for (int i = 0; i < 2000; ++i) {
+    Coordinates xs(sizes.size());
+    for (int d = 0; d < sizes.size(); ++d) {
+      seed = seed * 1103515245 + 12345;
+      xs[d] = (seed >> 16) % sizes[d];
+    }
+    points.push_back(xs);
+  }
+  check_get_indices_batch(partition_tree, points);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_get_indices_batch_outside, GridLikeBase1D) {
+  // Outside of [0,48) the periodic MPI X level wraps around,
+  // as in the per-coordinate lookup.
+  check_get_indices_batch(partition_tree,
+                          {{-1, 0}, {5, 1}, {48, 2}, {-13, 0}, {60, 1}, {95, 2}});
+}
+
+BOOST_FIXTURE_TEST_CASE(test_get_indices_batch_no_real_index, GridLikeBase1D) {
+  // -7 is in the MPI X partition 0 (as -7 / 12 == 0),
+  // but in no Vector X partition (the open one, -7 / 6 == -1)
+  partitioning::CoordinateBlock block{{{-7}, {0}}};
+  int nlevels = partition_tree.get_indices_size();
+  vector<int> indices(nlevels);
+  partition_tree.get_indices(block, indices.data());
+  BOOST_TEST(indices[0] == 0);
+  for (int l = 1; l < nlevels; ++l)
+    BOOST_TEST(indices[l] == -1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,60 @@
+#ifndef CODEGEN_FIXTURES_H_
+#define CODEGEN_FIXTURES_H_
+#include "api_v2/transform_network.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include "geometry/geometry.hpp"
+
+namespace codegen_fixtures {
+using namespace hypercubes::slow::internals;
+using hypercubes::slow::BoundaryCondition;
+using transform_networks::TransformNetwork;
+using transform_requests::Build;
+using namespace trms;
+
+/* Same as BuildFork1 in test_transform_network.cpp,
+ * with a branch that also flattens and renumbers the sites
+ * and one that collects the leaves with padding. */
+struct BuildFork1 {
+  TreeFactory f;
+  TransformNetwork n;
+  BuildFork1() {
+    Build(f, n,
+          {
+              Id({12, 12},   //
+                 {"X", "Y"}, //
+                 "root"),    //
+              TreeComposition(
+                  {QFull("X", 2, "MPI X", 1, BoundaryCondition::OPEN), //
+                   QFull("Y", 2, "MPI Y", 1, BoundaryCondition::OPEN), //
+                   Renumber(),
+                   LevelSwap({"MPI X", "MPI Y", //
+                              "X", "Y"})},
+                  "domain decomposition"),
+
+              Fork({TreeComposition({HBB("X", 1, "BB X", "bbx"), //
+                                     HBB("Y", 1, "BB Y", "bby"), //
+                                     Renumber(),                 //
+                                     LevelSwap({"BB X", "X",     //
+                                                "BB Y", "Y"},    //
+                                               {"BB X", "BB Y",  //
+                                                "X", "Y"},
+                                               "vector level swap"),
+                                     Flatten("X", "Y", "XY"),
+                                     EONaive("XY", "EO")},
+                                    "mpi-border-bulk"),
+                    TreeComposition({QSub("X", 2, "Vec X", 1, 1, "vecX"), //
+                                     QSub("Y", 2, "Vec Y", 1, 1, "vecY"), //
+                                     Renumber(),                          //
+                                     LevelSwap({"Vec X", "X",             //
+                                                "Vec Y", "Y"},            //
+                                               {"X", "Y",                 //
+                                                "Vec X", "Vec Y"}),
+                                     CollectLeaves("Vec X", "Vec XY", 8)},
+                                    "vector")}) //
+          });
+  }
+};
+
+} // namespace codegen_fixtures
+
+#endif // CODEGEN_FIXTURES_H_
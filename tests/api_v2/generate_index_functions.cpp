@@ -0,0 +1,23 @@
+/* Writes the generated index functions
+ * for the "vector" and "mpi-border-bulk" nodes of BuildFork1
+ * in the directory given as the first argument,
+ * so that test_codegen can check that they compile
+ * and agree with the transformations. */
+#include "api_v2/codegen.hpp"
+#include "codegen_fixtures.hpp"
+#include <fstream>
+
+using namespace hypercubes::slow::internals::codegen;
+
+int main(int argc, char **argv) {
+  if (argc != 2)
+    return 1;
+  std::string directory(argv[1]);
+  codegen_fixtures::BuildFork1 fork1;
+  std::ofstream(directory + "/fork1_vector.hpp")
+      << generate_header(analyse(fork1.n, "root", "vector"), "fork1_vector");
+  std::ofstream(directory + "/fork1_mpi_border_bulk.hpp")
+      << generate_header(analyse(fork1.n, "root", "mpi-border-bulk"),
+                         "fork1_mpi_border_bulk");
+  return 0;
+}
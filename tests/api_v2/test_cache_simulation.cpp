@@ -0,0 +1,92 @@
+#include "api_v2/cache_simulation.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using namespace hypercubes::slow::internals;
+using namespace cache_simulation;
+using namespace trms;
+using transform_requests::Build;
+
+BOOST_AUTO_TEST_SUITE(test_cache_simulation)
+
+BOOST_AUTO_TEST_CASE(test_set_associative_lru) {
+  // 2 sets of 2 lines
+  SetAssociativeCache cache(4, 1, 2);
+  BOOST_TEST(not cache.access(0));
+  BOOST_TEST(not cache.access(2));
+  BOOST_TEST(not cache.access(1)); // other set
+  BOOST_TEST(cache.access(0));
+  BOOST_TEST(not cache.access(4)); // 2 is dropped
+  BOOST_TEST(cache.access(0));
+  BOOST_TEST(not cache.access(2));
+  BOOST_TEST(cache.access(1));
+  BOOST_TEST(cache.get_misses() == 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_set_associative_throws) {
+  BOOST_CHECK_THROW(SetAssociativeCache(64, 64, 2), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_reuse_distance) {
+  ReuseDistance rd(6);
+  vector<long> distances;
+  for (long line : {10, 11, 12, 10, 11, 11})
+    distances.push_back(rd.access(line));
+  BOOST_TEST(distances == (vector<long>{-1, -1, -1, 2, 2, 0}));
+  BOOST_CHECK_THROW(rd.access(10), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(test_simulate_1D) {
+  TreeFactory f;
+  TransformNetwork n;
+  Build(f, n, {Id({16}, {"X"}, "root")});
+  Options options;
+  options.site_bytes = options.line_bytes;
+  auto report = simulate(n, "root", "root", options);
+  BOOST_TEST(report.nsites == 16);
+  BOOST_TEST(report.accesses == 3 * 16);
+  // everything fits in L1
+  BOOST_TEST(report.misses == (vector<long>{16, 16, 16}));
+  BOOST_TEST(report.reuse_histogram[0] == 16);
+  BOOST_TEST_REQUIRE(report.levels.size() == 2);
+  BOOST_TEST(report.levels[0].level_name == "(site)");
+  BOOST_TEST(report.levels[0].accesses == 16);
+  BOOST_TEST(report.levels[1].level_name == "X");
+  BOOST_TEST(report.levels[1].accesses == 32);
+}
+
+BOOST_AUTO_TEST_CASE(test_simulate_levels) {
+  TreeFactory f;
+  TransformNetwork n;
+  Build(f, n,
+        {Id({8}, {"X"}, "root"),
+         TreeComposition({QSub("X", 2, "BX", 0, 0), Renumber()}, "blocked")});
+  Options options;
+  options.site_bytes = options.line_bytes;
+  options.stencil = {{-1}, {1}};
+  auto report = simulate(n, "root", "blocked", options);
+  BOOST_TEST_REQUIRE(report.levels.size() == 3);
+  BOOST_TEST(report.levels[1].level_name == "BX");
+  BOOST_TEST(report.levels[2].level_name == "X");
+  // each block of 4 sites has 2 neighbours in the other block
+  BOOST_TEST(report.levels[0].accesses == 0);
+  BOOST_TEST(report.levels[1].accesses == 4);
+  BOOST_TEST(report.levels[2].accesses == 12);
+
+  std::stringstream ss;
+  print(ss, report);
+  BOOST_TEST(ss.str().find("BX") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_simulate_throws_on_wrong_stencil) {
+  TreeFactory f;
+  TransformNetwork n;
+  Build(f, n, {Id({4, 4}, {"X", "Y"}, "root")});
+  Options options;
+  options.stencil = {{1}};
+  BOOST_CHECK_THROW(simulate(n, "root", "root", options),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+#include "api_v2/codegen.hpp"
+#include "codegen_fixtures.hpp"
+#include "fork1_mpi_border_bulk.hpp"
+#include "fork1_vector.hpp"
+#include <boost/test/unit_test.hpp>
+#include <set>
+
+using namespace hypercubes::slow::internals;
+using namespace codegen;
+
+namespace {
+/* The index of each leaf of the output tree of the node, in depth-first
+ * order. */
+vector<vector<int>> leaves(TransformNetwork &n, const std::string &node) {
+  vector<vector<int>> res;
+  vector<int> idx;
+  auto _leaves = [&](const KVTreePv2<NodeType> &t, auto &f) -> void {
+    if (not t or t->children.size() == 0) {
+      res.push_back(idx);
+      return;
+    }
+    for (int i = 0; i < t->children.size(); ++i) {
+      idx.push_back(i);
+      f(t->children[i].second, f);
+      idx.pop_back();
+    }
+  };
+  _leaves(n[node]->output_tree, _leaves);
+  return res;
+}
+
+/* Checks the generated functions against the transformation:
+ * - every site is mapped to the first of its copies,
+ * - every leaf that is not padding is mapped to a site
+ *   whose copies include the leaf. */
+template <class CoordsToOffset, class OffsetToCoords>
+void check_against_transform(TransformNetwork &n,          //
+                             const std::string &end,       //
+                             const vector<int> &extents,   //
+                             int noffsets,                 //
+                             CoordsToOffset coords_to_offset, //
+                             OffsetToCoords offset_to_coords) {
+  auto transform = n.get_transform("root", end);
+  auto end_leaves = leaves(n, end);
+  BOOST_TEST(noffsets == end_leaves.size());
+  std::set<int> padding;
+  for (int o = 0; o < end_leaves.size(); ++o)
+    padding.insert(o);
+  for (int x = 0; x < extents[0]; ++x)
+    for (int y = 0; y < extents[1]; ++y) {
+      vector<int> xy{x, y};
+      int offset = coords_to_offset(xy.data());
+      int first_copy = noffsets;
+      for (const auto &out : transform->apply(xy))
+        for (int o = 0; o < end_leaves.size(); ++o)
+          if (end_leaves[o] == out) {
+            first_copy = std::min(first_copy, o);
+            padding.erase(o);
+          }
+      BOOST_TEST(offset == first_copy);
+      vector<int> back(2, -1);
+      BOOST_TEST(offset_to_coords(offset, back.data()));
+      BOOST_TEST(back == xy);
+    }
+  for (int o = 0; o < noffsets; ++o) {
+    vector<int> xy(2, -1);
+    bool found = offset_to_coords(o, xy.data());
+    BOOST_TEST(found == (padding.count(o) == 0));
+    if (found) {
+      auto outs = transform->apply(xy);
+      BOOST_TEST((std::find(outs.begin(), outs.end(), end_leaves[o]) !=
+                  outs.end()));
+    }
+  }
+  vector<int> outside{extents[0], 0};
+  BOOST_TEST(coords_to_offset(outside.data()) == -1);
+  vector<int> xy(2);
+  BOOST_TEST(not offset_to_coords(noffsets, xy.data()));
+  BOOST_TEST(not offset_to_coords(-1, xy.data()));
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(test_codegen)
+
+BOOST_FIXTURE_TEST_CASE(test_analyse, codegen_fixtures::BuildFork1) {
+  for (std::string end : {"domain decomposition", "mpi-border-bulk", //
+                          "vector"}) {
+    auto f = analyse(n, "root", end);
+    check_against_transform(
+        n, end, f.extents, f.noffsets,
+        [&f](const int *x) { return coords_to_offset(f, x); },
+        [&f](int o, int *x) { return offset_to_coords(f, o, x); });
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_regions_are_few, codegen_fixtures::BuildFork1) {
+  // Without halos and padding the whole lattice
+  // is covered by a handful of affine pieces.
+  auto f = analyse(n, "root", "domain decomposition");
+  BOOST_TEST(f.extents == vector<int>({12, 12}));
+  BOOST_TEST(f.irregular_offsets.size() == 0);
+  BOOST_TEST(f.irregular_coords.size() == 0);
+  BOOST_TEST(f.regions.size() <= 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_not_a_box) {
+  codegen_fixtures::BuildFork1 fork1;
+  BOOST_CHECK_THROW(analyse(fork1.n, "mpi-border-bulk", "root"),
+                    std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_generated_headers, codegen_fixtures::BuildFork1) {
+  BOOST_TEST(fork1_vector::ndims == 2);
+  check_against_transform(
+      n, "vector", {fork1_vector::extents[0], fork1_vector::extents[1]},
+      fork1_vector::noffsets, fork1_vector::coords_to_offset,
+      fork1_vector::offset_to_coords);
+  check_against_transform(
+      n, "mpi-border-bulk",
+      {fork1_mpi_border_bulk::extents[0], fork1_mpi_border_bulk::extents[1]},
+      fork1_mpi_border_bulk::noffsets, fork1_mpi_border_bulk::coords_to_offset,
+      fork1_mpi_border_bulk::offset_to_coords);
+
+  // The generated functions can be evaluated at compile time.
+  constexpr int origin[2] = {0, 0};
+  static_assert(fork1_vector::coords_to_offset(origin) >= 0, "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,154 @@
+#include "api_v2/compiled_tree.hpp"
+#include "api_v2/transformer.hpp"
+#include "api_v2/tree_transform.hpp"
+#include "exceptions/exceptions.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace hypercubes::slow::internals;
+using hypercubes::slow::BoundaryCondition;
+
+/* All the indices (full and partial)
+ * that can be built walking the tree. */
+template <class Value>
+void _all_indices(const KVTreePv2<Value> &t, vector<int> &idx,
+                  vector<vector<int>> &res) {
+  res.push_back(idx);
+  if (not t)
+    return;
+  for (int i = 0; i < t->children.size(); ++i) {
+    idx.push_back(i);
+    _all_indices(t->children[i].second, idx, res);
+    idx.pop_back();
+  }
+}
+
+template <class Value>
+vector<vector<int>> all_indices(const KVTreePv2<Value> &t) {
+  vector<vector<int>> res;
+  vector<int> idx;
+  _all_indices(t, idx, res);
+  return res;
+}
+
+/* Checks that the compiled tree gives the same answers
+ * as the slow functions, for every index in the tree. */
+void check_same_as_slow(const KVTreePv2<NodeType> &t) {
+  auto ct = compile(t);
+  for (const auto &idx : all_indices(t)) {
+    vector<int> out;
+    index_pullback(ct, idx.data(), idx.size(), out);
+    auto out_exp = index_pullback(t, idx);
+    BOOST_TEST(out == out_exp);
+
+    vector<int> out_safe;
+    bool found = index_pullback_safe(ct, idx.data(), idx.size(), out_safe);
+    auto out_safe_exp = index_pullback_safe(t, idx);
+    BOOST_TEST(found == (out_safe_exp.size() == 1));
+    if (found)
+      BOOST_TEST(out_safe == out_safe_exp[0]);
+    else
+      BOOST_TEST(out_safe.size() == 0);
+
+    IndexList pushed;
+    index_pushforward(ct, out.data(), out.size(), pushed);
+    auto pushed_exp = index_pushforward(t, out);
+    BOOST_TEST(pushed.size() == pushed_exp.size());
+    for (int i = 0; i < pushed.size(); ++i)
+      BOOST_TEST(pushed[i] == pushed_exp[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(test_compiled_tree)
+
+BOOST_AUTO_TEST_CASE(test_compile_shares_nodes) {
+  TreeFactory f;
+  auto t = f.generate_nd_tree({2, 3, 4});
+  auto ct = compile(t);
+  // one node per level, plus the leaf
+  BOOST_TEST(ct.nnodes() == 4);
+  BOOST_TEST(ct.nchildren(ct.root) == 2);
+  BOOST_TEST((bool)ct.direct[ct.root]);
+}
+
+BOOST_AUTO_TEST_CASE(test_compiled_nd_tree) {
+  TreeFactory f;
+  check_same_as_slow(f.generate_nd_tree({2, 3, 4}));
+}
+
+BOOST_AUTO_TEST_CASE(test_compiled_qh_halo_periodic) {
+  TreeFactory f;
+  auto t = f.generate_nd_tree({6, 5});
+  check_same_as_slow(f.qh(t, 0, 3, 1, 0, BoundaryCondition::PERIODIC));
+}
+
+BOOST_AUTO_TEST_CASE(test_compiled_qh_halo_open) {
+  TreeFactory f;
+  auto t = f.generate_nd_tree({6, 5});
+  check_same_as_slow(f.qh(t, 1, 2, 1, 0, BoundaryCondition::OPEN));
+}
+
+BOOST_AUTO_TEST_CASE(test_compiled_flatten) {
+  TreeFactory f;
+  auto t0 = f.generate_nd_tree({2, 4, 4});
+  auto t1 = f.qh(t0, 1, 2, 0, 0, BoundaryCondition::OPEN);
+  check_same_as_slow(f.flatten(t1, 1, 3));
+}
+
+BOOST_AUTO_TEST_CASE(test_compiled_collect_leaves_padding) {
+  TreeFactory f;
+  auto t = f.generate_nd_tree({2, 2, 3});
+  check_same_as_slow(f.collect_leaves(t, 1, 8));
+}
+
+BOOST_AUTO_TEST_CASE(test_compiled_pullback_throws) {
+  TreeFactory f;
+  auto ct = compile(f.generate_nd_tree({2, 4, 4}));
+  vector<int> out;
+  vector<int> over{1, 4, 3};
+  BOOST_CHECK_THROW(index_pullback(ct, over.data(), over.size(), out),
+                    KeyNotFoundError);
+  vector<int> negative{1, 1, -1};
+  BOOST_CHECK_THROW(index_pullback(ct, negative.data(), negative.size(), out),
+                    KeyNotFoundError);
+}
+
+BOOST_AUTO_TEST_CASE(test_compiled_batch) {
+  TreeFactory f;
+  auto t = f.qh(f.generate_nd_tree({6}), 0, 3, 1, 0,
+                BoundaryCondition::PERIODIC);
+  auto ct = compile(t);
+
+  vector<int> in{0, 1, 5};
+  IndexList out;
+  vector<int> first_result;
+  index_pushforward(ct, in.data(), in.size(), 1, out, first_result);
+  BOOST_TEST(first_result.size() == in.size() + 1);
+  for (int i = 0; i < in.size(); ++i) {
+    auto exp = index_pushforward(t, {in[i]});
+    BOOST_TEST(first_result[i + 1] - first_result[i] == exp.size());
+    for (int j = 0; j < exp.size(); ++j)
+      BOOST_TEST(out[first_result[i] + j] == exp[j]);
+  }
+
+  IndexList back;
+  index_pullback(ct, out.data.data(), out.size(), 2, back);
+  for (int i = 0; i < in.size(); ++i)
+    for (int j = first_result[i]; j < first_result[i + 1]; ++j)
+      BOOST_TEST(back[j] == vector<int>{in[i]});
+}
+
+BOOST_AUTO_TEST_CASE(test_transformer_uses_compiled_tree) {
+  TreeFactory f;
+  using namespace transformers;
+  auto id = std::make_shared<Id>(f, vector<int>{6, 5}, //
+                                 vector<std::string>{"X", "Y"});
+  auto q = std::make_shared<QFull>(f, id, "X", 3, "MPI X", 1,
+                                   BoundaryCondition::OPEN);
+  for (const auto &idx : all_indices(q->output_tree)) {
+    BOOST_TEST(q->inverse(idx) == index_pullback_safe(q->output_tree, idx));
+    auto back = index_pullback(q->output_tree, idx);
+    BOOST_TEST(q->apply(back) == index_pushforward(q->output_tree, back));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
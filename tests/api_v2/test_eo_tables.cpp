@@ -0,0 +1,102 @@
+#include "api_v2/eo_tables.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace hypercubes::slow::internals;
+using namespace eo_tables;
+using namespace trms;
+using transform_requests::Build;
+
+BOOST_AUTO_TEST_SUITE(test_eo_tables)
+
+namespace {
+/* Checks that the neighbours have the right coordinates. */
+void check_neighbours(TransformNetwork &n, const std::string &layout,
+                      const ParityTables &tables, int L) {
+  auto to_root = n.get_fused_transform(layout, "root");
+  vector<vector<int>> leaves;
+  std::function<void(const KVTreePv2<NodeType> &, vector<int>)> visit =
+      [&](const KVTreePv2<NodeType> &t, vector<int> idx) {
+        if (t->children.size() == 0)
+          leaves.push_back(idx);
+        for (int i = 0; i < t->children.size(); ++i) {
+          idx.push_back(i);
+          visit(t->children[i].second, idx);
+          idx.pop_back();
+        }
+      };
+  visit(n[layout]->output_tree, {});
+  auto coords = [&](int parity, int site) {
+    return to_root->apply(leaves[tables.offsets[parity][site]])[0];
+  };
+  for (int p : {0, 1})
+    for (int i = 0; i < 2; ++i)
+      for (int s = 0; s < tables.nsites(p); ++s) {
+        auto x = coords(p, s);
+        auto xup = coords(1 - p, tables.up(p, i)[s]);
+        auto xdn = coords(1 - p, tables.down(p, i)[s]);
+        BOOST_TEST(xup[i] == (x[i] + 1) % L);
+        BOOST_TEST(xdn[i] == (x[i] + L - 1) % L);
+        BOOST_TEST(xup[1 - i] == x[1 - i]);
+        BOOST_TEST(tables.down(1 - p, i)[tables.up(p, i)[s]] == s);
+      }
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_parity_tables_flat) {
+  TreeFactory f;
+  TransformNetwork n;
+  Build(f, n,
+        {Id({4, 4}, {"X", "Y"}, "root"),
+         TreeComposition({Flatten("X", "Y", "XY"), EONaive("XY", "EO")},
+                         "eo")});
+  auto tables = make_parity_tables(n, "root", "eo", "EO", {"X", "Y"});
+  BOOST_TEST(tables.directions == (vector<std::string>{"X", "Y"}));
+  BOOST_TEST_REQUIRE(tables.subtrees.size() == 1);
+  BOOST_TEST(tables.subtrees[0].origin_parity == 0);
+  BOOST_TEST_REQUIRE(tables.nsites(0) == 8);
+  BOOST_TEST_REQUIRE(tables.nsites(1) == 8);
+  // the EO level is on top: the checkerboards are contiguous
+  for (int p : {0, 1})
+    for (int s = 0; s < 8; ++s)
+      BOOST_TEST(tables.offsets[p][s] == 8 * p + s);
+  check_neighbours(n, "eo", tables, 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_parity_tables_blocked_origin_parities) {
+  TreeFactory f;
+  TransformNetwork n;
+  // 2x2 blocks of 3x3 sites, the origins of 2 of them are odd
+  Build(f, n,
+        {Id({6, 6}, {"X", "Y"}, "root"),
+         TreeComposition({QSub("X", 2, "BX", 0, 0), //
+                          QSub("Y", 2, "BY", 0, 0), //
+                          Renumber(),               //
+                          LevelSwap({"BX", "BY", "X", "Y"}),
+                          Flatten("X", "Y", "XY"), //
+                          EONaive("XY", "EO")},
+                         "blocked")});
+  auto tables = make_parity_tables(n, "root", "blocked", "EO", {"X", "Y"});
+  BOOST_TEST_REQUIRE(tables.subtrees.size() == 4);
+  vector<int> origin_parities;
+  for (const auto &s : tables.subtrees)
+    origin_parities.push_back(s.origin_parity);
+  BOOST_TEST(origin_parities == (vector<int>{0, 1, 1, 0}));
+  BOOST_TEST(tables.subtrees[1].idx == (vector<int>{0, 1}));
+  BOOST_TEST(tables.nsites(0) == 18);
+  BOOST_TEST(tables.nsites(1) == 18);
+  check_neighbours(n, "blocked", tables, 6);
+}
+
+BOOST_AUTO_TEST_CASE(test_parity_tables_throws_on_odd_extent) {
+  TreeFactory f;
+  TransformNetwork n;
+  Build(f, n,
+        {Id({3, 4}, {"X", "Y"}, "root"),
+         TreeComposition({Flatten("X", "Y", "XY"), EONaive("XY", "EO")},
+                         "eo")});
+  BOOST_CHECK_THROW(make_parity_tables(n, "root", "eo", "EO", {"X", "Y"}),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
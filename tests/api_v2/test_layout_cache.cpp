@@ -0,0 +1,164 @@
+#include "api_v2/layout_cache.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <thread>
+
+using namespace hypercubes::slow::internals;
+using hypercubes::slow::BoundaryCondition;
+using transform_networks::TransformNetwork;
+using transform_requests::LayoutCache;
+using namespace trms;
+
+namespace {
+vector<TransformRequestP> fork1_requests() {
+  return {Id({12, 12}, {"X", "Y"}, "root"),
+          TreeComposition(
+              {QFull("X", 2, "MPI X", 1, BoundaryCondition::OPEN), //
+               QFull("Y", 2, "MPI Y", 1, BoundaryCondition::OPEN), //
+               Renumber(),
+               LevelSwap({"MPI X", "MPI Y", "X", "Y"})},
+              "domain decomposition"),
+          Fork({TreeComposition({HBB("X", 1, "BB X"), //
+                                 Flatten("X", "Y", "XY"),
+                                 EONaive("XY", "EO")},
+                                "eo"),
+                TreeComposition({QSub("X", 2, "Vec X", 1, 1),
+                                 CollectLeaves("Vec X", "Vec XY", 8)},
+                                "vector")})};
+}
+
+vector<std::string> files_in(const std::string &directory) {
+  vector<std::string> res;
+  DIR *d = opendir(directory.c_str());
+  if (d == nullptr)
+    return res;
+  while (auto e = readdir(d))
+    if (e->d_name[0] != '.')
+      res.push_back(e->d_name);
+  closedir(d);
+  return res;
+}
+
+void remove_directory(const std::string &directory) {
+  for (const auto &f : files_in(directory))
+    std::remove((directory + "/" + f).c_str());
+  std::remove(directory.c_str());
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(test_layout_cache)
+
+BOOST_AUTO_TEST_CASE(test_canonical_form) {
+  auto q = QFull("X", 2, "MPI X", 1, BoundaryCondition::OPEN, "q");
+  BOOST_TEST(q->canonical() == "QFull(1:X,2,5:MPI X,1,1;1:q)");
+  BOOST_TEST(Renumber()->canonical() == "Renumber(;0:)");
+  BOOST_TEST(Id({4, 4}, {"X", "Y"})->canonical() ==
+             "Id([4,4],[1:X,1:Y];0:)");
+  BOOST_TEST(LevelSwap({"X", "Y"})->canonical() == "LevelSwap([1:X,1:Y];0:)");
+
+  auto same = QFull("X", 2, "MPI X", 1, BoundaryCondition::OPEN, "q");
+  auto other_bc = QFull("X", 2, "MPI X", 1, BoundaryCondition::PERIODIC, "q");
+  auto other_name = QFull("X", 2, "MPI X", 1, BoundaryCondition::OPEN, "r");
+  BOOST_TEST(q->hash() == same->hash());
+  BOOST_TEST(q->hash() != other_bc->hash());
+  BOOST_TEST(q->hash() != other_name->hash());
+
+  BOOST_TEST(transform_requests::hash(fork1_requests()) ==
+             transform_requests::hash(fork1_requests()));
+  auto requests = fork1_requests();
+  requests.pop_back();
+  BOOST_TEST(transform_requests::hash(requests) !=
+             transform_requests::hash(fork1_requests()));
+}
+
+BOOST_AUTO_TEST_CASE(test_hit_and_miss) {
+  std::string directory = "test_layout_cache_dir";
+  remove_directory(directory);
+  LayoutCache cache(directory);
+  auto requests = fork1_requests();
+
+  TreeFactory f;
+  TransformNetwork built;
+  BOOST_TEST(cache.build(f, built, requests) == LayoutCache::MISS);
+  BOOST_TEST(files_in(directory).size() == 1);
+
+  TreeFactory g;
+  TransformNetwork loaded;
+  BOOST_TEST(cache.build(g, loaded, requests) == LayoutCache::HIT);
+  BOOST_TEST(loaded.nodenames() == built.nodenames());
+  for (const auto &name : built.nodenames())
+    BOOST_TEST(*loaded[name]->output_tree == *built[name]->output_tree);
+  auto t = built.get_transform("root", "vector");
+  auto loaded_t = loaded.get_transform("root", "vector");
+  BOOST_TEST(loaded_t->apply({3, 5}) == t->apply({3, 5}));
+
+  // A corrupted file is rebuilt
+  {
+    std::ofstream out(cache.filename(requests), std::ios::binary);
+    out << "garbage";
+  }
+  TransformNetwork rebuilt;
+  BOOST_TEST(cache.build(f, rebuilt, requests) == LayoutCache::MISS);
+  TransformNetwork reloaded;
+  BOOST_TEST(cache.build(f, reloaded, requests) == LayoutCache::HIT);
+
+  auto stats = cache.get_stats();
+  BOOST_TEST(stats.hits == 2);
+  BOOST_TEST(stats.misses == 2);
+  BOOST_TEST(stats.invalid == 1);
+  BOOST_TEST(stats.write_failures == 0);
+  remove_directory(directory);
+}
+
+BOOST_AUTO_TEST_CASE(test_hash_collision) {
+  std::string directory = "test_layout_cache_collision_dir";
+  remove_directory(directory);
+  LayoutCache cache(directory);
+  auto requests = fork1_requests();
+  auto other_requests = fork1_requests();
+  other_requests.pop_back();
+
+  TreeFactory f;
+  TransformNetwork built;
+  BOOST_TEST(cache.build(f, built, requests) == LayoutCache::MISS);
+  // The file of the other requests, as if they had the same hash
+  BOOST_TEST(std::rename(cache.filename(requests).c_str(),
+                         cache.filename(other_requests).c_str()) == 0);
+  TransformNetwork other;
+  BOOST_TEST(cache.build(f, other, other_requests) == LayoutCache::MISS);
+  BOOST_TEST((other.nodenames() != built.nodenames()));
+  BOOST_TEST(cache.get_stats().collisions == 1);
+  BOOST_TEST(cache.get_stats().invalid == 0);
+  TransformNetwork reloaded;
+  BOOST_TEST(cache.build(f, reloaded, other_requests) == LayoutCache::HIT);
+  BOOST_TEST(reloaded.nodenames() == other.nodenames());
+  remove_directory(directory);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_writers) {
+  std::string directory = "test_layout_cache_concurrent_dir";
+  remove_directory(directory);
+  auto requests = fork1_requests();
+  vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i)
+    threads.emplace_back([&]() {
+      LayoutCache cache(directory);
+      TreeFactory f;
+      TransformNetwork n;
+      cache.build(f, n, requests);
+    });
+  for (auto &t : threads)
+    t.join();
+  // No temporary files are left, and the file is complete.
+  BOOST_TEST(files_in(directory).size() == 1);
+  LayoutCache cache(directory);
+  TreeFactory f;
+  TransformNetwork n;
+  BOOST_TEST(cache.build(f, n, requests) == LayoutCache::HIT);
+  remove_directory(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
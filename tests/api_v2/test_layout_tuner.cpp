@@ -0,0 +1,160 @@
+#include "api_v2/layout_tuner.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <set>
+#include <sstream>
+
+using namespace hypercubes::slow::internals;
+using namespace layout_tuning;
+
+namespace {
+TunerOptions quick_options() {
+  TunerOptions options;
+  options.block_sizes = {2, 4};
+  options.keep = 2;
+  options.repetitions = 1;
+  return options;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(test_layout_tuner)
+
+BOOST_AUTO_TEST_CASE(test_enumerate_candidates) {
+  auto candidates = enumerate_candidates({8, 4}, quick_options());
+  std::set<std::string> names;
+  for (const auto &c : candidates)
+    names.insert(c.name);
+  BOOST_TEST(names.size() == candidates.size());
+  // b4 on Y is the unblocked layout
+  std::set<std::string> expected{"b8x4/XY",    "b8x4/XY/eo", "b8x4/YX",
+                                 "b8x4/YX/eo", "b2x2/XY",    "b2x2/XY/eo",
+                                 "b2x2/YX",    "b2x2/YX/eo", "b4x4/XY",
+                                 "b4x4/XY/eo", "b4x4/YX",    "b4x4/YX/eo"};
+  BOOST_TEST(names == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_enumerate_candidates_throws) {
+  auto options = quick_options();
+  options.dimension_orders = {{0, 0}};
+  BOOST_CHECK_THROW(enumerate_candidates({8, 4}, options),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_neighbour_tables) {
+  TreeFactory f;
+  vector<int> sizes{8, 4};
+  for (const auto &c : enumerate_candidates(sizes, quick_options())) {
+    auto nb = neighbour_table(f, c);
+    BOOST_TEST_REQUIRE(nb.size() == 8 * 4 * 4);
+    for (int o = 0; o < 8 * 4; ++o)
+      for (int d = 0; d < 2; ++d) {
+        int down = nb[4 * o + 2 * d];
+        int up = nb[4 * o + 2 * d + 1];
+        BOOST_TEST(nb[4 * down + 2 * d + 1] == o);
+        BOOST_TEST(nb[4 * up + 2 * d] == o);
+      }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_estimated_cost) {
+  TunerOptions options;
+  options.site_doubles = 8; // a line per site
+  options.cache_bytes = 64 * 4;
+  options.cache_ways = 4;
+  // a 1x16 lattice, in order
+  vector<int> nb;
+  for (int o = 0; o < 16; ++o)
+    nb.insert(nb.end(), {o, o, (o + 15) % 16, (o + 1) % 16});
+  // each line of 'in' and 'out' is loaded once, except for
+  // the sites 15 and 0, read again by the sites 14 and 15
+  BOOST_TEST(estimated_cost(nb, 2, options) == 34.0 / 16);
+  // all the lines fit in the cache
+  options.cache_bytes = 64 * 64;
+  BOOST_TEST(estimated_cost(nb, 2, options) == 2.0);
+
+  // the same lattice, with the site 5*o % 16 at offset o:
+  // neighbours are never in the cache
+  options.cache_bytes = 64 * 4;
+  vector<int> offset(16), strided;
+  for (int o = 0; o < 16; ++o)
+    offset[5 * o % 16] = o;
+  for (int o = 0; o < 16; ++o)
+    strided.insert(strided.end(), {o, o, offset[(5 * o + 15) % 16],
+                                   offset[(5 * o + 1) % 16]});
+  BOOST_TEST(estimated_cost(strided, 2, options) == 4.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_tune) {
+  TreeFactory f;
+  auto options = quick_options();
+  auto result = tune(f, {8, 8}, options);
+  BOOST_TEST(result.measurements.size() ==
+             enumerate_candidates({8, 8}, options).size());
+  int nmeasured = 0;
+  for (int i = 0; i < result.measurements.size(); ++i) {
+    const auto &m = result.measurements[i];
+    if (i > 0)
+      BOOST_TEST(result.measurements[i - 1].cost <= m.cost);
+    if (m.seconds >= 0) {
+      ++nmeasured;
+      BOOST_TEST(result.measurements[result.best].seconds <= m.seconds);
+    }
+  }
+  BOOST_TEST(nmeasured == 2);
+  // the best one has been measured, and is the fastest
+  BOOST_TEST(result.measurements[result.best].seconds >= 0);
+  std::stringstream ss;
+  print(ss, result);
+  BOOST_TEST(ss.str().find("winner: " + result.winner().name) !=
+             std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_tuning_cache) {
+  std::string directory = "test_layout_tuner_dir";
+  TuningCache cache(directory);
+  auto options = quick_options();
+  std::remove(cache.filename({8, 8}, options).c_str());
+
+  TreeFactory f;
+  TuningResult first, second;
+  BOOST_TEST(cache.tune(f, {8, 8}, options, first) == TuningCache::MISS);
+  BOOST_TEST(cache.tune(f, {8, 8}, options, second) == TuningCache::HIT);
+  BOOST_TEST(second.winner().name == first.winner().name);
+  BOOST_TEST(second.measurements[second.best].seconds ==
+             first.measurements[first.best].seconds);
+  BOOST_TEST(
+      transform_requests::canonical_form::requests(second.winner().requests) ==
+      transform_requests::canonical_form::requests(first.winner().requests));
+
+  options.keep = 3;
+  BOOST_TEST(cache.filename({8, 8}, options) !=
+             cache.filename({8, 8}, quick_options()));
+
+  std::remove(cache.filename({8, 8}, quick_options()).c_str());
+  std::remove(directory.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_tuning_cache_hash_collision) {
+  std::string directory = "test_layout_tuner_collision_dir";
+  TuningCache cache(directory);
+  auto options = quick_options(), other = quick_options();
+  other.block_sizes = {2};
+  std::remove(cache.filename({8, 8}, options).c_str());
+  std::remove(cache.filename({8, 8}, other).c_str());
+
+  TreeFactory f;
+  TuningResult result;
+  BOOST_TEST(cache.tune(f, {8, 8}, other, result) == TuningCache::MISS);
+  // as if the options had the same hash
+  BOOST_TEST(std::rename(cache.filename({8, 8}, other).c_str(),
+                         cache.filename({8, 8}, options).c_str()) == 0);
+  BOOST_TEST(cache.tune(f, {8, 8}, options, result) == TuningCache::MISS);
+  BOOST_TEST(result.measurements.size() ==
+             enumerate_candidates({8, 8}, options).size());
+  BOOST_TEST(cache.tune(f, {8, 8}, options, result) == TuningCache::HIT);
+
+  std::remove(cache.filename({8, 8}, options).c_str());
+  std::remove(directory.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,91 @@
+#include "api_v2/serialisation.hpp"
+#include "codegen_fixtures.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+
+using namespace hypercubes::slow::internals;
+using namespace serialisation;
+
+BOOST_AUTO_TEST_SUITE(test_serialisation)
+
+BOOST_AUTO_TEST_CASE(test_tree_roundtrip_keeps_sharing) {
+  TreeFactory f;
+  auto tree = f.generate_nd_tree({3, 4, 5});
+  auto data = serialise(tree);
+  // leaf, row of 5, plane of 4x5, root
+  BOOST_TEST(data.size() < 400);
+
+  TreeFactory g;
+  auto loaded = deserialise_tree(g, data.data(), data.size());
+  BOOST_TEST(*loaded == *tree);
+  BOOST_TEST(loaded->children[0].second == loaded->children[2].second);
+  BOOST_CHECK(serialise(loaded) == data);
+}
+
+BOOST_AUTO_TEST_CASE(test_tree_file_roundtrip) {
+  TreeFactory f;
+  auto tree = f.generate_nd_tree({6, 2});
+  std::string filename = "test_serialisation_tree.bin";
+  save(tree, filename);
+  auto loaded = load_tree(f, filename);
+  std::remove(filename.c_str());
+  BOOST_TEST(*loaded == *tree);
+  BOOST_TEST(loaded != tree);
+}
+
+BOOST_AUTO_TEST_CASE(test_corrupted_data) {
+  TreeFactory f;
+  auto data = serialise(f.generate_nd_tree({3, 3}));
+  auto flipped = data;
+  flipped[data.size() - 5] ^= 1;
+  BOOST_CHECK_THROW(deserialise_tree(f, flipped.data(), flipped.size()),
+                    FormatError);
+  BOOST_CHECK_THROW(deserialise_tree(f, data.data(), data.size() - 4),
+                    FormatError);
+  BOOST_CHECK_THROW(deserialise_tree(f, data.data(), 16), FormatError);
+  auto other_version = data;
+  other_version[4] += 1;
+  BOOST_CHECK_THROW(
+      deserialise_tree(f, other_version.data(), other_version.size()),
+      FormatError);
+  TransformNetwork n;
+  BOOST_CHECK_THROW(deserialise_network(f, data.data(), data.size(), n),
+                    FormatError);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_network_roundtrip, codegen_fixtures::BuildFork1) {
+  std::string filename = "test_serialisation_network.bin";
+  save(n, filename);
+  TreeFactory g;
+  TransformNetwork loaded;
+  load_network(g, filename, loaded);
+  std::remove(filename.c_str());
+
+  BOOST_TEST(loaded.nnodes() == n.nnodes());
+  BOOST_TEST(loaded.narcs() == n.narcs());
+  BOOST_TEST(loaded.nodenames() == n.nodenames());
+  for (const auto &name : n.nodenames()) {
+    BOOST_TEST(*loaded[name]->output_tree == *n[name]->output_tree);
+    BOOST_TEST(loaded[name]->output_levelnames == n[name]->output_levelnames);
+  }
+
+  for (std::string end : {"vector", "mpi-border-bulk", "vector level swap"}) {
+    auto t = n.get_transform("root", end);
+    auto loaded_t = loaded.get_transform("root", end);
+    for (int x = 0; x < 12; ++x)
+      for (int y = 0; y < 12; ++y) {
+        auto outs = t->apply({x, y});
+        BOOST_TEST(loaded_t->apply({x, y}) == outs);
+        for (const auto &out : outs)
+          BOOST_TEST(loaded_t->inverse(out) == t->inverse(out));
+      }
+  }
+  // padding leaves have no inverse
+  auto t = loaded.get_transform("root", "vector");
+  const auto &padded = loaded["vector"]->output_tree->children[0].second;
+  BOOST_TEST(t->inverse({0, 0, (int)padded->children.size() - 1}).size() == 0);
+
+  BOOST_CHECK(serialise(loaded) == serialise(n));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
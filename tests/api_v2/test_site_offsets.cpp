@@ -0,0 +1,78 @@
+#include "api_v2/site_offsets.hpp"
+#include "api_v2/transform_request_makers.hpp"
+#include "geometry/geometry.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace hypercubes::slow::internals;
+using namespace site_offsets;
+using namespace trms;
+using hypercubes::slow::BoundaryCondition;
+using transform_requests::Build;
+
+BOOST_AUTO_TEST_SUITE(test_site_offsets)
+
+namespace {
+struct HaloAndUneven {
+  TreeFactory f;
+  TransformNetwork n;
+  HaloAndUneven() {
+    Build(f, n,
+          {Id({8, 4}, {"X", "Y"}, "root"),
+           Fork({QFull("X", 2, "MPI X", 1, BoundaryCondition::OPEN, "halo"),
+                 QFull("X", 3, "MPI X", 0, BoundaryCondition::OPEN,
+                       "uneven")})});
+  }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(test_box_extents, HaloAndUneven) {
+  BOOST_TEST(box_extents(n["root"]->output_tree) == (vector<int>{8, 4}));
+  BOOST_CHECK_THROW(box_extents(n["uneven"]->output_tree),
+                    std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_padding_and_copies, HaloAndUneven) {
+  auto sites = make_site_offsets(n, "root", "halo");
+  BOOST_TEST(sites.extents == (vector<int>{8, 4}));
+  BOOST_TEST(sites.nsites() == 8 * 4);
+  BOOST_TEST(sites.leaves == leaf_indices(n["halo"]->output_tree));
+  // 2 partitions of 4+2 sites in X, 4 in Y
+  BOOST_TEST_REQUIRE(sites.coords.size() == 2 * 6 * 4);
+  for (int s = 0; s < sites.nsites(); ++s)
+    BOOST_TEST(sites.offset_of_site[s] != -1);
+  int npadding = 0, ncopies = 0;
+  for (int o = 0; o < sites.coords.size(); ++o) {
+    if (sites.coords[o].empty()) {
+      ++npadding;
+      continue;
+    }
+    const int first = sites.offset_of_site[sites.lex(sites.coords[o])];
+    BOOST_TEST(first <= o);
+    BOOST_TEST(sites.coords[first] == sites.coords[o]);
+    ncopies += first != o;
+  }
+  // halo outside of the lattice with open boundaries
+  BOOST_TEST(npadding == 2 * 4);
+  BOOST_TEST(ncopies == 2 * 4);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_neighbour_table, HaloAndUneven) {
+  auto sites = make_site_offsets(n, "root", "halo");
+  auto nb = neighbour_table(sites);
+  BOOST_TEST_REQUIRE(nb.size() == sites.coords.size() * 4);
+  for (int o = 0; o < sites.coords.size(); ++o) {
+    if (sites.coords[o].empty()) {
+      BOOST_TEST(nb[4 * o] == o);
+      continue;
+    }
+    for (int d = 0; d < 2; ++d) {
+      auto x = sites.coords[nb[4 * o + 2 * d + 1]];
+      auto y = sites.coords[o];
+      y[d] = (y[d] + 1) % sites.extents[d];
+      BOOST_TEST(x == y);
+      BOOST_TEST(sites.offset_of_site[sites.lex(x)] == nb[4 * o + 2 * d + 1]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
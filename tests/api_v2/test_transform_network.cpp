@@ -4,6 +4,8 @@
 #include <boost/test/tools/old/interface.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/test/unit_test_suite.hpp>
+#include <functional>
+#include <map>
 #include <memory>
 #include <stdexcept>
 
@@ -278,9 +280,9 @@ BOOST_AUTO_TEST_CASE(test_get_transformer_from_arc_direct) {
                                    0,         //
                                    BoundaryCondition::OPEN);
 
-  TransformNetwork::Arc a{q, TransformNetwork::ArcType::DIRECT};
+  TransformNetwork::Step s{R, {q, TransformNetwork::ArcType::DIRECT}};
 
-  auto q2 = TransformNetwork::get_transformer(a);
+  auto q2 = TransformNetwork::get_transformer(s);
 
   // Check that q2 is the same as q1
 
@@ -316,9 +318,10 @@ BOOST_AUTO_TEST_CASE(test_get_transformer_from_arc_inverse) {
                                    0,         //
                                    BoundaryCondition::OPEN);
 
-  TransformNetwork::Arc a{q, TransformNetwork::ArcType::INVERSE};
+  // the arc from q back to R
+  TransformNetwork::Step s{q, {R, TransformNetwork::ArcType::INVERSE}};
 
-  auto q2 = TransformNetwork::get_transformer(a);
+  auto q2 = TransformNetwork::get_transformer(s);
 
   // Check that q2 is the inverse of q1
 
@@ -335,6 +338,54 @@ BOOST_AUTO_TEST_CASE(test_get_transformer_from_arc_inverse) {
   }
 }
 
+namespace {
+vector<vector<int>> leaves_of(const KVTreePv2<NodeType> &tree) {
+  vector<vector<int>> leaves;
+  vector<int> idx;
+  std::function<void(const KVTreePv2<NodeType> &)> collect =
+      [&](const KVTreePv2<NodeType> &t) {
+        if (t->children.size() == 0)
+          leaves.push_back(idx);
+        for (int i = 0; i < t->children.size(); ++i) {
+          idx.push_back(i);
+          collect(t->children[i].second);
+          idx.pop_back();
+        }
+      };
+  collect(tree);
+  return leaves;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(test_get_transformer_along_path, BuildFork1) {
+  auto steps = n.find_transformations("vector", "domain decomposition");
+  BOOST_TEST(steps.front().source == n["vector"]);
+  BOOST_TEST(steps.back().arc.destination == n["domain decomposition"]);
+  int ninverse = 0;
+  for (int i = 0; i < steps.size(); ++i) {
+    if (i + 1 < steps.size())
+      BOOST_TEST(steps[i].arc.destination == steps[i + 1].source);
+    ninverse += steps[i].arc.type == TransformNetwork::ArcType::INVERSE;
+  }
+  BOOST_TEST(ninverse == steps.size());
+
+  // Applying the transformers of the steps one after the other
+  // is the same as get_transform
+  auto transform = n.get_transform("vector", "domain decomposition");
+  for (const auto &leaf : leaves_of(n["vector"]->output_tree)) {
+    vector<vector<int>> idxs{leaf};
+    for (const auto &step : steps) {
+      auto t = TransformNetwork::get_transformer(step);
+      vector<vector<int>> next;
+      for (const auto &i : idxs)
+        for (const auto &out : t->apply(i))
+          next.push_back(out);
+      idxs = next;
+    }
+    BOOST_TEST(idxs == transform->apply(leaf));
+  }
+}
+
 BOOST_FIXTURE_TEST_CASE(test_get_transform, BuildFork1) {
 
   auto transform = n.get_transform("root", "mpi-border-bulk");
@@ -365,4 +416,131 @@ BOOST_FIXTURE_TEST_CASE(test_get_transform, BuildFork1) {
   }
 }
 
+BOOST_FIXTURE_TEST_CASE(test_get_transform_backwards, BuildFork1) {
+  auto forward = n.get_transform("root", "mpi-border-bulk");
+  auto backward = n.get_transform("mpi-border-bulk", "root");
+  for (int x = 0; x < 12; ++x)
+    for (int y = 0; y < 12; ++y) {
+      vector<int> in{x, y};
+      for (const auto &out : forward->apply(in)) {
+        auto back = backward->apply(out);
+        BOOST_TEST(back.size() == 1);
+        BOOST_TEST(back[0] == in);
+      }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_get_transform_is_cached, BuildFork1) {
+  auto t = n.get_transform("root", "vector");
+  BOOST_TEST(n.get_transform("root", "vector") == t);
+  BOOST_TEST(n.get_transform("vector", "root") != t);
+
+  n.add_node(std::make_shared<transformers::Renumber>(f, n["vector"]),
+             "vector renumbered");
+  BOOST_TEST(n.get_transform("root", "vector") != t);
+  BOOST_TEST(n.find_transformations("root", "vector renumbered").size() == 9);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fused_transform_same_as_composition,
+                        BuildFork1) {
+  for (std::string end : {"mpi-border-bulk", "vector"}) {
+    auto t = n.get_transform("root", end);
+    auto fused = n.get_fused_transform("root", end);
+    BOOST_TEST(n.get_fused_transform("root", end) == fused);
+    vector<int> ins;
+    vector<vector<int>> outs;
+    for (int x = 0; x < 12; ++x)
+      for (int y = 0; y < 12; ++y) {
+        vector<int> in{x, y};
+        auto out = t->apply(in);
+        BOOST_TEST(fused->apply(in) == out);
+        for (const auto &o : out)
+          BOOST_TEST(fused->inverse(o) == t->inverse(o));
+        ins.insert(ins.end(), in.begin(), in.end());
+        outs.insert(outs.end(), out.begin(), out.end());
+      }
+    IndexList batch_out;
+    vector<int> first_result;
+    fused->apply(ins.data(), 144, 2, batch_out, first_result);
+    BOOST_TEST(first_result.size() == 145);
+    BOOST_TEST(batch_out.size() == outs.size());
+    for (int i = 0; i < outs.size(); ++i)
+      BOOST_TEST(batch_out[i] == outs[i]);
+
+    BOOST_TEST(fused->apply({12, 0}).size() == 0);
+    BOOST_TEST(fused->apply({0}).size() == 0);
+    BOOST_CHECK_THROW(fused->inverse({-1}), KeyNotFoundError);
+  }
+}
+
+namespace {
+class ThrowingInverse : public transformers::IIndexTransformer {
+public:
+  ThrowingInverse(transformers::IndexTransformerP t) : wrapped(t) {}
+  vector<vector<int>> apply(const vector<int> &in) const {
+    return wrapped->apply(in);
+  }
+  vector<vector<int>> inverse(const vector<int> &) const {
+    throw std::invalid_argument("Not a missing preimage.");
+  }
+
+private:
+  transformers::IndexTransformerP wrapped;
+};
+
+class Identity : public transformers::IIndexTransformer {
+public:
+  vector<vector<int>> apply(const vector<int> &in) const { return {in}; }
+  vector<vector<int>> inverse(const vector<int> &in) const { return {in}; }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(test_fused_transform_padding_and_halo, BuildFork1) {
+  for (std::string end : {"mpi-border-bulk", "vector"}) {
+    auto t = n.get_transform("root", end);
+    auto fused = n.get_fused_transform("root", end);
+    std::map<vector<int>, vector<int>> preimage;
+    for (const auto &in : leaves_of(n["root"]->output_tree))
+      for (const auto &out : t->apply(in))
+        preimage[out] = in;
+    int nmissing = 0, ncopies = 0;
+    for (const auto &out : leaves_of(n[end]->output_tree)) {
+      auto ins = fused->inverse(out);
+      if (preimage.count(out) == 0) {
+        // padding, or halo outside of the lattice (open boundaries)
+        BOOST_TEST(ins.size() == 0);
+        nmissing++;
+        continue;
+      }
+      BOOST_TEST(ins == vector<vector<int>>{preimage[out]});
+      ncopies += t->apply(preimage[out]).size() > 1;
+    }
+    BOOST_TEST(nmissing > 0);
+    BOOST_TEST(ncopies > 0); // halo leaves that are copies
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fused_transform_propagates_errors, BuildFork1) {
+  auto t = std::make_shared<ThrowingInverse>(n.get_transform("root", "vector"));
+  BOOST_CHECK_THROW(transformers::FusedComposition(n["root"]->output_tree,
+                                                   n["vector"]->output_tree, t),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_fused_transform_shared_subtrees) {
+  // A node shared at different depths is numbered before
+  // some of its parents when the tree is compiled.
+  auto L = mtkv(LEAF, {});
+  auto A = mtkv(NODE, {{{0}, L}, {{1}, L}});
+  auto B = mtkv(NODE, {{{0}, A}});
+  auto root = mtkv(NODE, {{{0}, A}, {{1}, B}, {{2}, L}});
+  transformers::FusedComposition fused(root, root,
+                                       std::make_shared<Identity>());
+  const vector<vector<int>> leaves{{0, 0}, {0, 1}, {1, 0, 0}, {1, 0, 1}, {2}};
+  for (const auto &leaf : leaves) {
+    BOOST_TEST(fused.apply(leaf) == vector<vector<int>>{leaf});
+    BOOST_TEST(fused.inverse(leaf) == vector<vector<int>>{leaf});
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,6 +1,8 @@
 #include "api_v2/transformer.hpp"
 #include "api_v2/tree_transform.hpp"
+#include "geometry/eo.hpp"
 #include "geometry/geometry.hpp"
+#include "geometry/sfc.hpp"
 #include "trees/kvtree_data_structure.hpp"
 #include "utils/print_utils.hpp"
 #include <boost/test/tools/old/interface.hpp>
@@ -11,6 +13,8 @@
 using namespace hypercubes::slow::internals;
 using namespace hypercubes::slow::internals::transformers;
 using hypercubes::slow::BoundaryCondition;
+namespace eo = hypercubes::slow::eo;
+namespace sfc = hypercubes::slow::sfc;
 
 BOOST_AUTO_TEST_SUITE(test_transformers)
 
@@ -523,6 +527,27 @@ BOOST_AUTO_TEST_CASE(test_remap_inverse) {
                                 expout.begin(), expout.end());
 }
 
+BOOST_AUTO_TEST_CASE(test_space_filling_curve) {
+  TreeFactory f;
+  auto R = std::make_shared<Id>(f, //
+                                vector<int>{4, 3, 2},
+                                vector<std::string>{"X", "Y", "Z"});
+  auto flat = std::make_shared<Flatten>(f, R, "X", "Y", "XY");
+  auto curve =
+      std::make_shared<SpaceFillingCurve>(f, flat, "XY", sfc::HILBERT);
+  BOOST_TEST(curve->output_levelnames == flat->output_levelnames);
+
+  auto order = sfc::curve_order({4, 3}, sfc::HILBERT);
+  for (int i = 0; i < order.size(); ++i) {
+    auto xy = eo::lex_idx_to_coord(order[i], {4, 3});
+    auto in = flat->apply({xy[0], xy[1], 1})[0];
+    auto out = curve->apply(in);
+    BOOST_TEST(out.size() == 1);
+    BOOST_TEST(out[0] == (vector<int>{i, 1}));
+    BOOST_TEST(curve->inverse(out[0])[0] == in);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(test_sum_constructor) {
   TreeFactory f;
   auto R = std::make_shared<Id>(f,                 //
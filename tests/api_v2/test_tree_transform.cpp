@@ -10,6 +10,7 @@
 #include <boost/test/tools/old/interface.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/test/unit_test_suite.hpp>
+#include <future>
 #include <stdexcept>
 
 using namespace hypercubes::slow::internals;
@@ -1242,4 +1243,121 @@ BOOST_AUTO_TEST_CASE(test_eo_fix) {
   BOOST_TEST(*t_fix == *new_t);
 }
 
+BOOST_AUTO_TEST_CASE(test_eo_origin_parity) {
+  auto leaf = mtkv(NodeType::LEAF, {});
+  auto half = mtkv(NodeType::NODE, {{{0}, leaf}, {{1}, leaf}});
+  auto t = mtkv(NodeType::NODE, {{{0}, half}, {{1}, half}});
+  auto shifted = [](const vector<int> idx) -> vector<vector<int>> {
+    return {{idx[0] + 1, idx[1] * 2 + idx[2]}};
+  };
+  BOOST_TEST(TreeFactory::eo_origin_parity(t, {0}, shifted, {0, 1}) == 1);
+  BOOST_TEST(TreeFactory::eo_origin_parity(t, {0}, shifted, {1}) == 0);
+
+  auto padding = [](const vector<int>) -> vector<vector<int>> { return {}; };
+  BOOST_CHECK_THROW(TreeFactory::eo_origin_parity(t, {0}, padding, {0, 1}),
+                    std::invalid_argument);
+  auto copies = [](const vector<int> idx) -> vector<vector<int>> {
+    return {idx, idx};
+  };
+  BOOST_CHECK_THROW(TreeFactory::eo_origin_parity(t, {0}, copies, {0, 1}),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_budget) {
+  TreeFactory f, f_bounded;
+  f_bounded.set_cache_budget(2);
+  auto t = f.generate_nd_tree({8, 6, 4});
+  auto t_exp = f.hbb(f.qh(t, 1, 2, 1, 0, BoundaryCondition::PERIODIC), 2, 1);
+  auto t_bounded = f_bounded.hbb(
+      f_bounded.qh(t, 1, 2, 1, 0, BoundaryCondition::PERIODIC), 2, 1);
+  BOOST_TEST(*t_exp == *t_bounded);
+  BOOST_TEST(f_bounded.cache.qh.size() <= 2);
+  BOOST_TEST(f_bounded.cache.renumber.size() <= 2);
+  BOOST_TEST(f_bounded.cache.qh.evicted() + f_bounded.cache.hbb.evicted() +
+                 f_bounded.cache.renumber.evicted() >
+             0);
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_factory) {
+  auto build = [](TreeFactory &f) {
+    auto t = f.generate_nd_tree({8, 6, 4, 4});
+    auto t1 = f.qh(t, 0, 2, 1, 0, BoundaryCondition::PERIODIC);
+    auto t2 = f.qh(t1, 2, 2, 1, 0, BoundaryCondition::PERIODIC);
+    auto t3 = f.hbb(t2, 3, 1);
+    return f.eo_naive(f.flatten(t3, 5, 6), 5);
+  };
+  TreeFactory f_serial;
+  auto t_exp = build(f_serial);
+
+  TreeFactory f;
+  f.set_max_threads(4);
+  vector<std::future<KVTreePv2<NodeType>>> results;
+  for (int i = 0; i < 4; ++i)
+    results.push_back(std::async(std::launch::async, build, std::ref(f)));
+  for (auto &r : results)
+    BOOST_TEST(*r.get() == *t_exp);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_same_as_eager) {
+  TreeFactory f;
+  auto t = f.generate_nd_tree({8, 6, 4});
+  auto t1 = f.qh(t, 0, 2, 1, 0, BoundaryCondition::PERIODIC);
+  auto t2 = f.qh(t1, 2, 2, 1, 0, BoundaryCondition::OPEN);
+  auto t3 = f.hbb(t2, 3, 1);
+  auto t4 = f.bb(t3, 3, 1);
+
+  auto lt = TreeFactory::lazy_nd_tree({8, 6, 4});
+  auto lt1 = TreeFactory::lazy_qh(lt, 0, 2, 1, 0, BoundaryCondition::PERIODIC);
+  auto lt2 = TreeFactory::lazy_qh(lt1, 2, 2, 1, 0, BoundaryCondition::OPEN);
+  auto lt3 = TreeFactory::lazy_hbb(lt2, 3, 1);
+  auto lt4 = TreeFactory::lazy_bb(lt3, 3, 1);
+
+  BOOST_TEST(*f.materialise(lt) == *t);
+  BOOST_TEST(*f.materialise(lt4) == *t4);
+  BOOST_TEST(*f.materialise(TreeFactory::lazy_renumber_children(lt2)) ==
+             *f.renumber_children(t2));
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_index_functions) {
+  TreeFactory f;
+  auto t = f.qh(f.generate_nd_tree({8, 6}), 0, 2, 1, 0,
+                BoundaryCondition::PERIODIC);
+  auto lt = TreeFactory::lazy_qh(TreeFactory::lazy_nd_tree({8, 6}), 0, 2, 1,
+                                 0, BoundaryCondition::PERIODIC);
+  for (int x = 0; x < 8; ++x)
+    for (int y = 0; y < 6; ++y) {
+      auto out = index_pushforward(lt, {x, y});
+      BOOST_TEST(out == index_pushforward(t, {x, y}));
+      for (const auto &idx : out)
+        BOOST_TEST(index_pullback(lt, idx) == (vector<int>{x, y}));
+    }
+  BOOST_CHECK_THROW(index_pullback(lt, {2, 0, 0}), KeyNotFoundError);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_only_visited_nodes) {
+  TreeFactory f;
+  auto lt = TreeFactory::lazy_nd_tree({96, 96, 96, 96});
+  auto lt1 = TreeFactory::lazy_qh(lt, 0, 4, 1, 0, BoundaryCondition::PERIODIC);
+  auto lt2 = TreeFactory::lazy_qh(lt1, 2, 4, 1, 0, BoundaryCondition::PERIODIC);
+
+  BOOST_TEST(not lt2->expanded());
+  auto idx1 = index_pullback(lt2, {1, 0, 2, 3, 4, 5});
+  BOOST_TEST(idx1 == (vector<int>{1, 0, 50, 4, 5}));
+  BOOST_TEST(index_pullback(lt1, idx1) == (vector<int>{23, 50, 4, 5}));
+  BOOST_TEST(lt2->expanded());
+  // The subtrees of the other parts have not been generated
+  BOOST_TEST(not lt2->children()[0].second->expanded());
+  BOOST_TEST(lt2->children()[1].second->expanded());
+
+  // Only the part {1,...} is selected and generated.
+  TreeFactory::Predicate p = [](const std::vector<int> &idx) {
+    return idx[0] == 1 ? BoolM::T : BoolM::F;
+  };
+  auto selected = f.select_subtree(lt2, p);
+  BOOST_TEST(not lt2->children()[0].second->expanded());
+  BOOST_TEST(not lt2->children()[2].second->expanded());
+  BOOST_TEST(selected->children.size() == 1);
+  BOOST_TEST(selected->children[0].second->children.size() == 26);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,6 @@
 #include "trees/kvtree.hpp"
 #include "trees/kvtree_data_structure.hpp"
+#include "trees/kvtree_node_store.hpp"
 #include "trees/kvtree_v2.hpp"
 #include "trees/tree_data_structure.hpp"
 #include <boost/test/tools/old/interface.hpp>
@@ -69,4 +70,56 @@ BOOST_AUTO_TEST_CASE(test_collapse_level_by_index) {
   BOOST_TEST(*tcollapsed_exp == *tcollapsed);
 }
 
+BOOST_AUTO_TEST_CASE(test_node_store_interns_identical_subtrees) {
+  NodeStore<int> store;
+  auto t1 = store.mtkv(1, {{{2}, store.mtkv(80, {})}, //
+                           {{3}, store.mtkv(80, {})}});
+  auto t2 = store.mtkv(1, {{{2}, store.mtkv(80, {})}, //
+                           {{3}, store.mtkv(80, {})}});
+  // roots keep their identity, subtrees are shared
+  BOOST_TEST(t1 != t2);
+  BOOST_TEST(t1->children[0].second == t1->children[1].second);
+  BOOST_TEST(t1->children[0].second == t2->children[0].second);
+  BOOST_TEST(store.size() == 1);
+
+  BOOST_TEST(store.intern(t1) == t1);
+  BOOST_TEST(store.intern(t2) == t1);
+  BOOST_TEST(store.id(t2) == 1);
+  BOOST_TEST(store[store.id(t2)] == t1);
+
+  auto t3 = store.mtkv(1, {{{2}, store.mtkv(80, {})}, //
+                           {{4}, store.mtkv(80, {})}});
+  BOOST_TEST(store.intern(t3) != t1);
+  BOOST_TEST(*t3 != *t1);
+}
+
+BOOST_AUTO_TEST_CASE(test_node_store_intern_external_tree) {
+  NodeStore<int> store;
+  auto t = mtkv(1, {{{2}, mtkv(80, {})}, //
+                    {{3}, mtkv(80, {})}});
+  auto t_interned = store.intern(t);
+  BOOST_TEST(t_interned != t);
+  BOOST_TEST(*t_interned == *t);
+  BOOST_TEST(store.intern(t_interned) == t_interned);
+  BOOST_TEST(store.intern(t) == t_interned);
+  BOOST_TEST(store.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_node_store_releases_unused_nodes) {
+  NodeStore<int> store;
+  auto t = store.intern(mtkv(1, {{{2}, mtkv(80, {})}}));
+  BOOST_TEST(store.size() == 2);
+  auto id = store.id(t);
+  t.reset();
+  BOOST_TEST(store[id] == nullptr);
+  BOOST_TEST(store.size() == 0);
+  for (int i = 0; i < 1000; ++i)
+    store.intern(mtkv(i, {}));
+  BOOST_TEST(store.size() == 0);
+  // a new canonical copy is made
+  auto t2 = store.intern(mtkv(1, {{{2}, mtkv(80, {})}}));
+  BOOST_TEST(store.id(t2) != id);
+  BOOST_TEST(store[store.id(t2)] == t2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
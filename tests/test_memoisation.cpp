@@ -1,4 +1,5 @@
 #include "trees/kvtree.hpp"
+#include "trees/memoisation/bounded_cache.hpp"
 #include "trees/memoisation/memoisation.hpp"
 #include "trees/partition_tree.hpp"
 #include "trees/tree.hpp"
@@ -6,6 +7,8 @@
 #include <boost/test/unit_test.hpp>
 #include <functional>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 int fib(std::function<int(int)> f, int i) {
   if (i == 0)
@@ -122,4 +125,120 @@ BOOST_AUTO_TEST_CASE(test_get_partition_tree_via_maxidx) {
   BOOST_TEST(*tmax == *tmaxM);
 }
 
+BOOST_AUTO_TEST_CASE(test_bounded_cache_unbounded) {
+  BoundedCache<std::tuple<int, int>, int> cache;
+  for (int i = 0; i < 100; ++i)
+    cache.insert({i, i + 1}, 2 * i);
+  BOOST_TEST(cache.size() == 100);
+  BOOST_TEST(cache.evicted() == 0);
+  BOOST_TEST(*cache.find({3, 4}) == 6);
+  BOOST_TEST(cache.find({3, 3}) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_bounded_cache_eviction) {
+  BoundedCache<int, int> cache(4);
+  for (int i = 0; i < 4; ++i)
+    cache.insert(i, i);
+  BOOST_TEST(cache.size() == 4);
+  BOOST_TEST(cache.evicted() == 0);
+  // 0 is used, so it survives
+  BOOST_TEST(*cache.find(0) == 0);
+  cache.insert(4, 4);
+  cache.insert(5, 5);
+  BOOST_TEST(cache.size() <= 4);
+  BOOST_TEST(cache.evicted() > 0);
+  BOOST_TEST(cache.find(0) != nullptr);
+  BOOST_TEST(cache.find(1) == nullptr);
+  BOOST_TEST(*cache.find(5) == 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_bounded_cache_tiny_budget) {
+  for (std::size_t max_size : {1, 2, 3}) {
+    BoundedCache<int, int> cache(max_size);
+    for (int i = 0; i < 20; ++i) {
+      cache.insert(i, i);
+      BOOST_TEST(cache.size() <= max_size);
+    }
+    BOOST_TEST(*cache.find(19) == 19);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_sharded_cache_global_budget) {
+  for (std::size_t max_size : {1, 2, 5, 16}) {
+    ShardedCache<int, int> cache(max_size);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+      threads.emplace_back([&cache, t] {
+        for (int i = 0; i < 200; ++i)
+          BOOST_CHECK(cache.insert(i, i) == i);
+      });
+    for (auto &t : threads)
+      t.join();
+    // not per shard: the whole cache holds at most max_size entries
+    BOOST_TEST(cache.size() <= max_size);
+    BOOST_TEST(cache.evicted() > 0);
+    int v = -1;
+    BOOST_TEST(cache.insert(1000, 7) == 7);
+    BOOST_TEST(cache.find(1000, v));
+    BOOST_TEST(v == 7);
+  }
+  ShardedCache<int, int> unbounded;
+  for (int i = 0; i < 200; ++i)
+    unbounded.insert(i, i);
+  BOOST_TEST(unbounded.size() == 200);
+  BOOST_TEST(unbounded.evicted() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_memoiser_stats) {
+  Memoiser<int, int> R(fib);
+  BOOST_TEST(R(20) == 6765);
+  auto s = R.stats();
+  // Each of fib(0..20) is computed once,
+  // every other call is a hit.
+  BOOST_TEST(s.size == 21);
+  BOOST_TEST(s.total - s.cached == 21);
+  BOOST_TEST(s.evicted == 0);
+  BOOST_TEST(R(20) == 6765);
+  BOOST_TEST(R.stats().cached == s.cached + 1);
+
+  std::stringstream ss;
+  R.print_diagnostics("fib", ss);
+  BOOST_TEST(ss.str().find("CACHE COUNTS") != std::string::npos);
+  BOOST_TEST(ss.str().find("fib") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_memoiser_bounded) {
+  Memoiser<int, int> R(fib, 4);
+  BOOST_TEST(R(20) == 6765);
+  BOOST_TEST(R.stats().size <= 4);
+  BOOST_TEST(R.stats().evicted > 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_sharded_memoiser) {
+  ShardedMemoiser<int, int> R(fib);
+  std::vector<std::thread> threads;
+  std::vector<int> results(4);
+  for (int i = 0; i < 4; ++i)
+    threads.emplace_back([&R, &results, i] { results[i] = R(25 + i); });
+  for (auto &t : threads)
+    t.join();
+  BOOST_TEST(results == (std::vector<int>{75025, 121393, 196418, 317811}));
+  BOOST_TEST(R.stats().size == 29);
+}
+
+BOOST_AUTO_TEST_CASE(test_thread_local_memoiser) {
+  using namespace memodetails::get_leaves_list;
+  auto t = mt(1, {mt(2, {}), mt(3, {})});
+  auto &memo = thread_local_memoiser<Memo<int>>();
+  BOOST_TEST(memo(t) == get_leaves_list(t));
+  BOOST_TEST(memo(t) == get_leaves_list(t));
+  BOOST_TEST(&memo == &thread_local_memoiser<Memo<int>>());
+  BOOST_TEST(memo.stats().cached == 1);
+  bool same_instance = true;
+  std::thread([&memo, &same_instance] {
+    same_instance = &memo == &thread_local_memoiser<Memo<int>>();
+  }).join();
+  BOOST_TEST(not same_instance);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
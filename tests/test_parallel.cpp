@@ -0,0 +1,88 @@
+#include "utils/parallel.hpp"
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+using namespace hypercubes::slow;
+
+BOOST_AUTO_TEST_SUITE(test_parallel)
+
+BOOST_AUTO_TEST_CASE(test_task_pool_map) {
+  for (int nthreads : {1, 2, 4}) {
+    TaskPool pool(nthreads);
+    auto res = pool.map(100, [](int i) { return i * i; });
+    BOOST_TEST(res.size() == 100);
+    for (int i = 0; i < 100; ++i)
+      BOOST_TEST(res[i] == i * i);
+    BOOST_TEST(pool.map(0, [](int i) { return i; }).empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_task_pool_reuses_threads) {
+  TaskPool pool(4);
+  std::mutex m;
+  std::set<std::thread::id> ids;
+  for (int it = 0; it < 50; ++it)
+    pool.map(8, [&](int) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      std::lock_guard<std::mutex> lock(m);
+      ids.insert(std::this_thread::get_id());
+      return 0;
+    });
+  // the caller and the 3 workers, not a new thread per call
+  BOOST_TEST(ids.size() <= 4);
+  BOOST_TEST(ids.count(std::this_thread::get_id()) == 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_task_pool_nested) {
+  TaskPool pool(3);
+  auto res = pool.map(6, [&pool](int i) {
+    auto inner = pool.map(6, [i](int j) { return i * 10 + j; });
+    int sum = 0;
+    for (int x : inner)
+      sum += x;
+    return sum;
+  });
+  for (int i = 0; i < 6; ++i)
+    BOOST_TEST(res[i] == 60 * i + 15);
+}
+
+BOOST_AUTO_TEST_CASE(test_task_pool_rethrows) {
+  TaskPool pool(4);
+  BOOST_CHECK_THROW(pool.map(10,
+                             [](int i) {
+                               if (i == 7)
+                                 throw std::invalid_argument("7");
+                               return i;
+                             }),
+                    std::invalid_argument);
+  // the pool is still usable
+  BOOST_TEST(pool.map(3, [](int i) { return i; }) == (std::vector<int>{0, 1, 2}));
+}
+
+BOOST_AUTO_TEST_CASE(test_task_pool_scaling) {
+  // Calls that wait (instead of computing) scale
+  // even on a machine with few cores.
+  auto elapsed = [](int nthreads) {
+    TaskPool pool(nthreads);
+    pool.map(nthreads, [](int i) { return i; }); // starting the workers
+    auto start = std::chrono::steady_clock::now();
+    pool.map(8, [](int i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      return i;
+    });
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+  const double t1 = elapsed(1), t4 = elapsed(4);
+  BOOST_TEST_MESSAGE("8 calls: 1 thread " << t1 << " s, 4 threads " << t4
+                                          << " s");
+  BOOST_TEST(t1 >= 8 * 0.020);
+  BOOST_TEST(t4 < t1 / 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 #include "selectors/partition_predicates.hpp"
 #include "selectors/prune_tree.hpp"
 #include "test_utils.hpp"
+#include "trees/flat_offset_tree.hpp"
 #include "trees/kvtree.hpp"
 #include "trees/partition_tree.hpp"
 #include "trees/partition_tree_allocations.hpp"
@@ -199,6 +200,21 @@ BOOST_FIXTURE_TEST_CASE(test_offset_tree_lesssimple, LessSimple1D) {
   int site_level = 3;
   BOOST_TEST(*truncate_tree(offset_tree, site_level) == *expected);
 }
+BOOST_FIXTURE_TEST_CASE(test_flat_offset_tree_lesssimple, LessSimple1D) {
+
+  int site_level = 3;
+  auto offset_tree = truncate_tree(get_offset_tree(sizetree), site_level);
+  FlatOffsetTree flat = flatten_offset_tree(offset_tree, true);
+  BOOST_TEST(flat.nnodes() == 7);
+  for (int offset = 0; offset < 32; ++offset) {
+    Indices idxs = get_indices(offset_tree, offset);
+    BOOST_TEST(get_indices(flat, offset) == idxs);
+    BOOST_TEST(get_offset(flat, idxs) == offset);
+    BOOST_TEST(get_offset(flat, idxs) == get_offset(offset_tree, idxs));
+  }
+  BOOST_TEST(get_offset(flat, Indices{1, 1}) == 24);
+  BOOST_CHECK_THROW(get_offset(flat, Indices{2, 0, 0}), KeyNotFoundError);
+}
 
 BOOST_AUTO_TEST_CASE(test_no_zerosize) {
 
@@ -0,0 +1,90 @@
+#include <boost/test/unit_test.hpp>
+
+#include "geometry/eo.hpp"
+#include "geometry/sfc.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <stdexcept>
+
+using namespace hypercubes::slow;
+BOOST_AUTO_TEST_SUITE(test_sfc)
+
+int distance(const std::vector<int> &a, const std::vector<int> &b) {
+  int res = 0;
+  for (int i = 0; i < a.size(); ++i)
+    res += std::abs(a[i] - b[i]);
+  return res;
+}
+
+bool is_permutation_of_iota(std::vector<int> v) {
+  std::sort(v.begin(), v.end());
+  for (int i = 0; i < v.size(); ++i)
+    if (v[i] != i)
+      return false;
+  return true;
+}
+
+BOOST_AUTO_TEST_CASE(test_bits_for) {
+  BOOST_TEST(sfc::bits_for(1) == 0);
+  BOOST_TEST(sfc::bits_for(2) == 1);
+  BOOST_TEST(sfc::bits_for(5) == 3);
+  BOOST_TEST(sfc::bits_for(8) == 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_morton_2x2) {
+  // The last dimension runs fastest
+  BOOST_TEST(sfc::morton_key({0, 0}, 1) == 0);
+  BOOST_TEST(sfc::morton_key({0, 1}, 1) == 1);
+  BOOST_TEST(sfc::morton_key({1, 0}, 1) == 2);
+  BOOST_TEST(sfc::morton_key({1, 1}, 1) == 3);
+  BOOST_TEST(sfc::morton_key({2, 3}, 2) == 0b1101);
+}
+
+BOOST_AUTO_TEST_CASE(test_hilbert_is_continuous) {
+  for (auto sizes : std::vector<std::vector<int>>{{8, 8}, {4, 4, 4}, //
+                                                  {4, 4, 4, 4}}) {
+    auto order = sfc::curve_order(sizes, sfc::HILBERT);
+    BOOST_TEST(is_permutation_of_iota(order));
+    for (int i = 1; i < order.size(); ++i)
+      BOOST_TEST(distance(eo::lex_idx_to_coord(order[i - 1], sizes),
+                          eo::lex_idx_to_coord(order[i], sizes)) == 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_hilbert_keys_are_distinct) {
+  std::vector<int> sizes{8, 8, 8};
+  std::vector<std::uint64_t> keys;
+  for (int i = 0; i < 8 * 8 * 8; ++i)
+    keys.push_back(sfc::hilbert_key(eo::lex_idx_to_coord(i, sizes), 3));
+  std::sort(keys.begin(), keys.end());
+  for (int i = 0; i < keys.size(); ++i)
+    BOOST_TEST(keys[i] == i);
+}
+
+BOOST_AUTO_TEST_CASE(test_non_power_of_two) {
+  for (auto curve : {sfc::MORTON, sfc::HILBERT}) {
+    std::vector<int> sizes{3, 5, 6};
+    auto order = sfc::curve_order(sizes, curve);
+    BOOST_TEST(order.size() == 3 * 5 * 6);
+    BOOST_TEST(is_permutation_of_iota(order));
+    // The order is the one of the enclosing 8x8x8 box
+    auto full = sfc::curve_order({8, 8, 8}, curve);
+    std::vector<int> restricted;
+    for (int i : full) {
+      auto x = eo::lex_idx_to_coord(i, {8, 8, 8});
+      if (x[0] < 3 and x[1] < 5 and x[2] < 6)
+        restricted.push_back(x[0] + 3 * (x[1] + 5 * x[2]));
+    }
+    BOOST_TEST(order == restricted);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_key_too_large_throws) {
+  BOOST_CHECK_THROW(sfc::morton_key(std::vector<int>(5, 0), 13),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(sfc::hilbert_key(std::vector<int>(5, 0), 13),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+#include "partitioners/partitioners.hpp"
+#include "partitioners/sfc_partitioning.hpp"
+#include "trees/partition_tree.hpp"
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+
+using namespace hypercubes::slow;
+using partitioning::SFC;
+
+struct SFC3 {
+  const PartInfos sp{{6, Parity::EVEN}, {4, Parity::NONE}, {5, Parity::ODD}};
+  const SFC::DimFlags dimflags{true, false, true};
+  SFC P;
+  SFC3() : P(sp, dimflags, sfc::HILBERT, "test3") {}
+};
+
+BOOST_AUTO_TEST_SUITE(sfc_partitioning)
+
+BOOST_AUTO_TEST_CASE(test_constructor_throws) {
+  const PartInfos sp{{6, Parity::EVEN}, {4, Parity::NONE}};
+  BOOST_CHECK_THROW(SFC(sp, {true}, sfc::MORTON, "test"),
+                    std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_max_idx_value, SFC3) {
+  BOOST_TEST(P.max_idx_value() == 30);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_idx_coord_roundtrip, SFC3) {
+  for (int idx = 0; idx < P.max_idx_value(); ++idx) {
+    auto x = P.idx_to_coords(idx, Coordinates{0, 3, 0});
+    BOOST_TEST(x[1] == 3);
+    auto res = P.coord_to_idxs(x);
+    BOOST_TEST(res.size() == 1);
+    BOOST_TEST(res[0].idx == idx);
+    BOOST_TEST((res[0].rest == Coordinates{0, 3, 0}));
+    BOOST_TEST(not res[0].cached_flag);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_coord_outside, SFC3) {
+  BOOST_TEST(P.coord_to_idxs(Coordinates{6, 0, 0}).size() == 0);
+  BOOST_TEST(P.coord_to_idxs(Coordinates{0, 0, -1}).size() == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_batch_same_as_single, SFC3) {
+  partitioning::CoordinateBlock block;
+  block.x.resize(3);
+  vector<IndexResultD> expected;
+  for (int x = -1; x < 7; ++x)
+    for (int z = 0; z < 6; ++z) {
+      block.x[0].push_back(x);
+      block.x[1].push_back(2);
+      block.x[2].push_back(z);
+      auto r = P.coord_to_idxs(Coordinates{x, 2, z});
+      expected.push_back(r.size() == 0 ? IndexResultD{-1, {x, 2, z}, false}
+                                       : r[0]);
+    }
+  vector<int> idx(block.size());
+  P.coord_to_real_idxs(block, 0, block.size(), idx.data());
+  for (int i = 0; i < block.size(); ++i) {
+    BOOST_TEST(idx[i] == expected[i].idx);
+    for (int d = 0; d < 3; ++d)
+      BOOST_TEST(block.x[d][i] == expected[i].rest[d]);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_sub_partinfo_kinds_parity, SFC3) {
+  // The parities of x and z give 4 kinds of sites
+  BOOST_TEST(P.sub_partinfo_kinds().size() == 4);
+  for (int idx = 0; idx < P.max_idx_value(); ++idx) {
+    auto x = P.idx_to_coords(idx, Coordinates{0, 0, 0});
+    auto kind = P.sub_partinfo_kinds()[P.idx_to_partinfo_kind(idx)];
+    BOOST_TEST(kind[0].size == 1);
+    BOOST_TEST(kind[0].parity == static_cast<Parity>(x[0] % 2));
+    BOOST_TEST(kind[1].size == 4);
+    BOOST_TEST(kind[1].parity == Parity::NONE);
+    BOOST_TEST(kind[2].parity == static_cast<Parity>((x[2] + 1) % 2));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_partition_tree) {
+  namespace pm = partitioner_makers;
+  PartInfoD sp{{6, Parity::EVEN}, {5, Parity::NONE}};
+  auto t = internals::get_partition_tree(sp, //
+                                         PartList{
+                                             pm::SFC("SFC", {true, true},
+                                                     sfc::MORTON),
+                                             pm::Site(),
+                                         });
+  auto tmax = internals::get_max_idx_tree(t);
+  BOOST_TEST(tmax->n == 30);
+  for (const auto &c : tmax->children)
+    BOOST_TEST(c->n == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
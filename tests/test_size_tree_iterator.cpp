@@ -106,4 +106,47 @@ BOOST_FIXTURE_TEST_CASE(test_offset_indices_roundtrip, Part1D42) {
     idx = next(no_sites, idx);
   }
 }
+
+BOOST_FIXTURE_TEST_CASE(test_size_tree_iterator_simple, SimpleSizeTree) {
+  SizeTreeIterator it(tree);
+  BOOST_TEST(*it == Indices({0, 0, 0}));
+  it += 7;
+  BOOST_TEST(*it == Indices({0, 0, 7}));
+  ++it;
+  BOOST_TEST(*it == Indices({0, 1, 0}));
+  it += 9;
+  BOOST_TEST(*it == Indices({1, 0, 1}));
+  it += 14;
+  BOOST_TEST(*it == Indices({1, 1, 7}));
+  ++it;
+  BOOST_TEST((it == SizeTreeIterator()));
+}
+
+BOOST_FIXTURE_TEST_CASE(test_size_tree_iterator_matches_next, Part1D42) {
+  auto size_tree = get_size_tree(prune_tree(get_skeleton_tree(t), //
+                                            [&](Indices idxs) -> BoolM {
+                                              return selectors::no_bulk_borders(
+                                                  idxs, partitioners);
+                                            }));
+  auto no_sites = truncate_tree(size_tree,                     //
+                                get_max_depth(size_tree) - 1); //
+
+  Indices idx = get_start_idxs(no_sites);
+  int nsites = 0;
+  for (const Indices &it_idx : sites(no_sites)) {
+    BOOST_TEST(it_idx == idx);
+    idx = next(no_sites, idx);
+    ++nsites;
+  }
+  BOOST_TEST(idx == get_end_idxs());
+  BOOST_TEST(nsites == no_sites->n.second);
+
+  auto offset_tree = get_offset_tree(no_sites);
+  for (int jump = 1; jump < 6; ++jump) {
+    SizeTreeIterator it(no_sites);
+    for (int offset = 0; offset < nsites; offset += jump, it += jump)
+      BOOST_TEST(get_offset(offset_tree, *it) == offset);
+    BOOST_TEST((it == SizeTreeIterator()));
+  }
+}
 BOOST_AUTO_TEST_SUITE_END()